@@ -0,0 +1,324 @@
+// Bounding volume hierarchy benchmark.
+//
+// Scatters boxes through a cube, builds a BVH over them and times, per object count:
+// the SAH build, a refit after every object moved, wide and narrow frustum queries against the
+// linear FrustumCuller, ray casts and box overlap queries. It then lets the objects drift with
+// refits only and runs partial rebuilds on the worker thread while they keep moving, next to a
+// tree that is only ever refitted, and reports the SAH cost of both. Query results are checked
+// against brute force. Prints JSON; the exit code is non-zero when a check fails.
+//
+// Usage: bvh_bench [--objects=N] [--repeat=N]
+
+#include "bvh.h"
+#include "frustum_culler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+double median(std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+// Column-major OpenGL perspective projection; the camera sits at the origin looking down -z
+void perspective(float fovY, float aspect, float zNear, float zFar, float* m) {
+    float f = 1.0f / std::tan(fovY * 0.5f);
+    std::memset(m, 0, 16 * sizeof(float));
+    m[0] = f / aspect;
+    m[5] = f;
+    m[10] = (zFar + zNear) / (zNear - zFar);
+    m[11] = -1.0f;
+    m[14] = 2.0f * zFar * zNear / (zNear - zFar);
+}
+
+struct Random {
+    uint32_t seed;
+    // Uniform in [0, 1)
+    float next() {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) * (1.0f / 16777216.0f);
+    }
+};
+
+struct Objects {
+    std::vector<float> center;    // xyz
+    std::vector<float> extents;   // xyz
+    std::vector<float> velocity;  // xyz, units per step
+    std::vector<Aabb> bounds;
+
+    void updateBounds() {
+        bounds.resize(center.size() / 3);
+        for (size_t i = 0; i < bounds.size(); ++i) {
+            for (int k = 0; k < 3; ++k) {
+                bounds[i].min[k] = center[i * 3 + k] - extents[i * 3 + k];
+                bounds[i].max[k] = center[i * 3 + k] + extents[i * 3 + k];
+            }
+        }
+    }
+
+    // Moves every object, bouncing off the walls of the cube
+    void step() {
+        for (size_t i = 0; i < center.size(); ++i) {
+            center[i] += velocity[i];
+            if (center[i] < -100.0f || center[i] > 100.0f) {
+                velocity[i] = -velocity[i];
+            }
+        }
+        updateBounds();
+    }
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t maxObjects = 1000000;
+    int repeat = 11;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (std::strncmp(arg, "--objects=", 10) == 0) {
+            maxObjects = static_cast<size_t>(std::atoll(arg + 10));
+        } else if (std::strncmp(arg, "--repeat=", 9) == 0) {
+            repeat = std::atoi(arg + 9);
+        } else {
+            std::cerr << "Unknown option: " << arg << "\n"
+                      << "Usage: bvh_bench [--objects=N] [--repeat=N]" << std::endl;
+            return 1;
+        }
+    }
+    if (maxObjects == 0 || repeat < 1) {
+        std::cerr << "Invalid arguments" << std::endl;
+        return 1;
+    }
+
+    Frustum frustums[2];
+    const char* frustumNames[2] = { "wide", "narrow" };
+    for (int f = 0; f < 2; ++f) {
+        float viewProjection[16];
+        perspective(f == 0 ? 1.0f : 0.1f, 16.0f / 9.0f, 0.1f, 150.0f, viewProjection);
+        frustums[f] = Frustum::fromMatrix(viewProjection);
+    }
+    const int RayCount = 10000;
+    const int RegionCount = 1000;
+    const int DriftSteps = 50;
+
+    bool matched = true;
+    std::cout << std::fixed << std::setprecision(4) << "{\"results\": [";
+    for (size_t objectCount = 10000; objectCount <= maxObjects; objectCount *= 10) {
+        Random random = { 12345 };
+        Objects objects;
+        FrustumCuller culler;
+        for (size_t i = 0; i < objectCount; ++i) {
+            for (int k = 0; k < 3; ++k) {
+                objects.center.push_back(random.next() * 200.0f - 100.0f);
+            }
+            for (int k = 0; k < 3; ++k) {
+                objects.extents.push_back(0.1f + random.next());
+            }
+            for (int k = 0; k < 3; ++k) {
+                objects.velocity.push_back((random.next() - 0.5f) * 0.5f);
+            }
+            culler.add(&objects.center[i * 3], &objects.extents[i * 3]);
+        }
+        objects.updateBounds();
+
+        // Builds take long at 1M objects, so they get fewer samples
+        Bvh bvh;
+        std::vector<double> samples;
+        for (int r = 0; r < std::max(1, repeat / 4); ++r) {
+            Clock::time_point start = Clock::now();
+            bvh.build(objects.bounds);
+            samples.push_back(elapsedMs(start));
+        }
+        double buildMs = median(samples);
+        float builtCost = bvh.cost();
+
+        Bvh refitOnly;
+        refitOnly.build(objects.bounds);
+
+        // Frustums: BVH against the linear SIMD scan, which also provides the reference set
+        std::ostringstream frustumJson;
+        frustumJson << std::fixed << std::setprecision(4);
+        for (int f = 0; f < 2; ++f) {
+            std::vector<uint32_t> linear;
+            std::vector<uint32_t> visible;
+            samples.clear();
+            for (int r = 0; r < repeat; ++r) {
+                Clock::time_point start = Clock::now();
+                culler.cull(frustums[f], linear);
+                samples.push_back(elapsedMs(start));
+            }
+            double linearMs = median(samples);
+            samples.clear();
+            for (int r = 0; r < repeat; ++r) {
+                visible.clear();
+                Clock::time_point start = Clock::now();
+                bvh.queryFrustum(frustums[f], visible);
+                samples.push_back(elapsedMs(start));
+            }
+            double frustumMs = median(samples);
+            std::sort(visible.begin(), visible.end());
+            frustumJson << (f == 0 ? "" : ", ") << "\"" << frustumNames[f] << "\": {\"visible\": " << linear.size()
+                        << ", \"bvh_ms\": " << frustumMs << ", \"linear_ms\": " << linearMs
+                        << ", \"matches_linear\": " << (visible == linear ? "true" : "false") << "}";
+            matched = matched && visible == linear;
+        }
+
+        // Rays from random points on the cube's surface towards random points inside it
+        std::vector<float> rays(RayCount * 6);
+        for (int r = 0; r < RayCount; ++r) {
+            float* ray = &rays[r * 6];
+            int face = static_cast<int>(random.next() * 6.0f) % 6;
+            for (int k = 0; k < 3; ++k) {
+                ray[k] = random.next() * 200.0f - 100.0f;
+                ray[3 + k] = random.next() * 200.0f - 100.0f;
+            }
+            ray[face / 2] = face % 2 == 0 ? -110.0f : 110.0f;
+            for (int k = 0; k < 3; ++k) {
+                ray[3 + k] -= ray[k];
+            }
+        }
+        int hits = 0;
+        Clock::time_point rayStart = Clock::now();
+        for (int r = 0; r < RayCount; ++r) {
+            hits += bvh.raycast(&rays[r * 6], &rays[r * 6 + 3], 1.0f) >= 0 ? 1 : 0;
+        }
+        double rayMs = elapsedMs(rayStart);
+        // Brute force on a sample: the nearest entry distance must agree
+        bool raysMatch = true;
+        for (int r = 0; r < 100; ++r) {
+            const float* ray = &rays[r * 6];
+            float bvhDistance = 0.0f;
+            int64_t bvhHit = bvh.raycast(ray, ray + 3, 1.0f, &bvhDistance);
+            float nearest = 2.0f;
+            for (size_t i = 0; i < objectCount; ++i) {
+                const Aabb& box = objects.bounds[i];
+                float enter = 0.0f;
+                float exit = 1.0f;
+                for (int k = 0; k < 3; ++k) {
+                    float inverse = ray[3 + k] != 0.0f ? 1.0f / ray[3 + k] : std::copysign(1e30f, ray[3 + k]);
+                    float t0 = (box.min[k] - ray[k]) * inverse;
+                    float t1 = (box.max[k] - ray[k]) * inverse;
+                    enter = std::max(enter, std::min(t0, t1));
+                    exit = std::min(exit, std::max(t0, t1));
+                }
+                if (enter <= exit) {
+                    nearest = std::min(nearest, enter);
+                }
+            }
+            if ((bvhHit >= 0) != (nearest <= 1.0f) || (bvhHit >= 0 && bvhDistance != nearest)) {
+                raysMatch = false;
+            }
+        }
+
+        // Box overlap queries the size of a small neighbourhood
+        std::vector<Aabb> regions(RegionCount);
+        for (int r = 0; r < RegionCount; ++r) {
+            for (int k = 0; k < 3; ++k) {
+                regions[r].min[k] = random.next() * 190.0f - 100.0f;
+                regions[r].max[k] = regions[r].min[k] + 10.0f;
+            }
+        }
+        std::vector<uint32_t> overlapping;
+        size_t found = 0;
+        Clock::time_point regionStart = Clock::now();
+        for (int r = 0; r < RegionCount; ++r) {
+            overlapping.clear();
+            bvh.queryAabb(regions[r], overlapping);
+            found += overlapping.size();
+        }
+        double regionMs = elapsedMs(regionStart);
+        // Brute force on a sample: the same objects, in any order
+        bool regionsMatch = true;
+        for (int r = 0; r < 100; ++r) {
+            overlapping.clear();
+            bvh.queryAabb(regions[r], overlapping);
+            std::sort(overlapping.begin(), overlapping.end());
+            std::vector<uint32_t> expected;
+            for (size_t i = 0; i < objectCount; ++i) {
+                if (objects.bounds[i].overlaps(regions[r])) {
+                    expected.push_back(static_cast<uint32_t>(i));
+                }
+            }
+            if (overlapping != expected) {
+                regionsMatch = false;
+            }
+        }
+        matched = matched && raysMatch && regionsMatch;
+
+        // Refit after one step of motion, then drift with refits only
+        samples.clear();
+        for (int r = 0; r < repeat; ++r) {
+            objects.step();
+            Clock::time_point start = Clock::now();
+            bvh.refit(objects.bounds);
+            samples.push_back(elapsedMs(start));
+        }
+        double refitMs = median(samples);
+        for (int s = 0; s < DriftSteps; ++s) {
+            objects.step();
+        }
+        bvh.refit(objects.bounds);
+        float driftedCost = bvh.cost();
+
+        // Partial rebuilds while the objects keep moving and the tree keeps being refitted, as a
+        // frame loop would. Counts the frames each rebuild spans.
+        const int PartialRebuilds = 8;
+        double partialMs = 0.0;
+        int partialFrames = 0;
+        int rebuilds = 0;
+        for (; rebuilds < PartialRebuilds; ++rebuilds) {
+            Clock::time_point start = Clock::now();
+            // False for a tree too shallow to have subtrees RebuildDepth levels down
+            if (!bvh.beginPartialRebuild(objects.bounds)) {
+                break;
+            }
+            do {
+                objects.step();
+                bvh.refit(objects.bounds);
+                ++partialFrames;
+            } while (!bvh.finishPartialRebuild(objects.bounds));
+            partialMs += elapsedMs(start);
+        }
+        float rebuiltCost = bvh.cost();
+        refitOnly.refit(objects.bounds);
+        Bvh fresh;
+        fresh.build(objects.bounds);
+
+        std::cout << (objectCount == 10000 ? "" : ", ") << "{\"objects\": " << objectCount
+                  << ", \"nodes\": " << bvh.nodeCount()
+                  << ", \"depth\": " << bvh.depth()
+                  << ", \"build_ms\": " << buildMs
+                  << ", \"refit_ms\": " << refitMs
+                  << ", \"frustum\": {" << frustumJson.str() << "}"
+                  << ", \"rays\": {\"count\": " << RayCount << ", \"hits\": " << hits
+                  << ", \"per_ms\": " << RayCount / rayMs << ", \"matches_brute_force\": " << (raysMatch ? "true" : "false") << "}"
+                  << ", \"regions\": {\"count\": " << RegionCount << ", \"found\": " << found
+                  << ", \"per_ms\": " << RegionCount / regionMs << ", \"matches_brute_force\": " << (regionsMatch ? "true" : "false") << "}"
+                  << ", \"sah_cost\": {\"built\": " << builtCost << ", \"drifted\": " << driftedCost
+                  << ", \"refit_only\": " << refitOnly.cost() << ", \"partial_rebuilt\": " << rebuiltCost << ", \"fresh_build\": " << fresh.cost() << "}"
+                  << ", \"partial_rebuild\": {\"count\": " << rebuilds << ", \"avg_ms\": " << partialMs / std::max(rebuilds, 1)
+                  << ", \"avg_frames\": " << static_cast<double>(partialFrames) / std::max(rebuilds, 1) << "}}";
+        std::cout.flush();
+    }
+    std::cout << "]}" << std::endl;
+    if (!matched) {
+        std::cerr << "bvh_bench: a query disagreed with brute force" << std::endl;
+        return 1;
+    }
+    return 0;
+}
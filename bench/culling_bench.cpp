@@ -0,0 +1,118 @@
+// Frustum culling microbenchmark.
+//
+// Scatters boxes through a cube around a perspective camera and culls them with every code path
+// the CPU supports, for sphere and box tests. Prints the median time per cull and objects per
+// microsecond as JSON, and checks that every path returns the same indices as the scalar one; the
+// exit code is non-zero when one doesn't.
+//
+// Usage: culling_bench [--objects=N] [--repeat=N]
+
+#include "frustum_culler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+// Column-major OpenGL perspective projection; the camera sits at the origin looking down -z
+void perspective(float fovY, float aspect, float zNear, float zFar, float* m) {
+    float f = 1.0f / std::tan(fovY * 0.5f);
+    std::memset(m, 0, 16 * sizeof(float));
+    m[0] = f / aspect;
+    m[5] = f;
+    m[10] = (zFar + zNear) / (zNear - zFar);
+    m[11] = -1.0f;
+    m[14] = 2.0f * zFar * zNear / (zNear - zFar);
+}
+
+double median(std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t maxObjects = 1000000;
+    int repeat = 21;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (std::strncmp(arg, "--objects=", 10) == 0) {
+            maxObjects = static_cast<size_t>(std::atoll(arg + 10));
+        } else if (std::strncmp(arg, "--repeat=", 9) == 0) {
+            repeat = std::atoi(arg + 9);
+        } else {
+            std::cerr << "Unknown option: " << arg << "\n"
+                      << "Usage: culling_bench [--objects=N] [--repeat=N]" << std::endl;
+            return 1;
+        }
+    }
+    if (maxObjects == 0 || repeat < 1) {
+        std::cerr << "Invalid arguments" << std::endl;
+        return 1;
+    }
+
+    float viewProjection[16];
+    perspective(1.0f, 16.0f / 9.0f, 0.1f, 150.0f, viewProjection);
+    Frustum frustum = Frustum::fromMatrix(viewProjection);
+
+    std::cout << std::fixed << std::setprecision(4)
+              << "{\"best_path\": \"" << FrustumCuller::pathName(FrustumCuller::bestPath()) << "\", \"results\": [";
+    bool first = true;
+    bool ok = true;
+    for (size_t objects = 10000; objects <= maxObjects; objects *= 10) {
+        FrustumCuller culler;
+        uint32_t seed = 12345;
+        for (size_t i = 0; i < objects; ++i) {
+            float values[6];
+            for (int k = 0; k < 6; ++k) {
+                seed = seed * 1664525u + 1013904223u;
+                values[k] = (seed >> 8) * (1.0f / 16777216.0f);
+            }
+            const float center[3] = { values[0] * 200.0f - 100.0f, values[1] * 200.0f - 100.0f, values[2] * 200.0f - 100.0f };
+            const float extents[3] = { 0.1f + values[3], 0.1f + values[4], 0.1f + values[5] };
+            culler.add(center, extents);
+        }
+
+        for (int t = 0; t < 2; ++t) {
+            FrustumCuller::Test test = t == 0 ? FrustumCuller::Test::Sphere : FrustumCuller::Test::Box;
+            std::vector<uint32_t> reference;
+            culler.setPath(FrustumCuller::Path::Scalar);
+            culler.cull(frustum, reference, test);
+            for (int p = 0; p <= static_cast<int>(FrustumCuller::bestPath()); ++p) {
+                culler.setPath(static_cast<FrustumCuller::Path>(p));
+                std::vector<uint32_t> visible;
+                std::vector<double> samples;
+                for (int r = 0; r < repeat; ++r) {
+                    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                    culler.cull(frustum, visible, test);
+                    samples.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+                }
+                double ms = median(samples);
+                std::cout << (first ? "" : ", ") << "{\"objects\": " << objects
+                          << ", \"test\": \"" << (t == 0 ? "sphere" : "box") << "\""
+                          << ", \"path\": \"" << FrustumCuller::pathName(culler.path()) << "\""
+                          << ", \"visible\": " << visible.size()
+                          << ", \"ms\": " << ms
+                          << ", \"objects_per_us\": " << objects / (ms * 1000.0)
+                          << ", \"matches_scalar\": " << (visible == reference ? "true" : "false") << "}";
+                std::cout.flush();
+                first = false;
+                if (visible != reference) {
+                    std::cerr << "culling_bench: " << FrustumCuller::pathName(culler.path()) << " "
+                              << (t == 0 ? "sphere" : "box") << " test at " << objects
+                              << " objects differs from scalar" << std::endl;
+                    ok = false;
+                }
+            }
+        }
+    }
+    std::cout << "]}" << std::endl;
+    return ok ? 0 : 1;
+}
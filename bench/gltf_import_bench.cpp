@@ -0,0 +1,238 @@
+// glTF import benchmark: the GltfLoader stages on 1..N threads.
+//
+// Writes a .glb of many heightfield chunks, one mesh and node each, laid out on a grid. Chunks
+// alternate 16- and 32-bit indices; every third has no normals and every fourth no texture
+// coordinates, so the decode stage widens, narrows and generates normals and tangents as a real
+// asset would; every fifth node is turned a quarter turn about z. The file is then imported
+// repeatedly with each thread count, and the stage timings of the median run printed as JSON.
+// The first import is also flattened and its normals checked against the node rotations.
+//
+// Usage: gltf_import_bench [--chunks=N] [--triangles=N] [--threads=N] [--repeat=N] [--dir=PATH] [--keep]
+
+#include "gltf_loader.h"
+#include "job_system.h"
+#include "mesh_data.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+void append(std::vector<char>& out, const void* data, size_t bytes) {
+    out.insert(out.end(), static_cast<const char*>(data), static_cast<const char*>(data) + bytes);
+    out.resize((out.size() + 3) & ~static_cast<size_t>(3));
+}
+
+void appendLe32(std::vector<char>& out, uint32_t value) {
+    char bytes[4];
+    std::memcpy(bytes, &value, 4);
+    out.insert(out.end(), bytes, bytes + 4);
+}
+
+// Adds a tightly packed buffer view and an accessor over it; returns the accessor's index
+size_t addAccessor(std::ostringstream& views, std::ostringstream& accessors, size_t& accessorCount,
+                   std::vector<char>& binary, const void* data, size_t bytes, uint32_t componentType,
+                   size_t count, const char* type) {
+    if (accessorCount) {
+        views << ",";
+        accessors << ",";
+    }
+    views << "{\"buffer\":0,\"byteOffset\":" << binary.size() << ",\"byteLength\":" << bytes << "}";
+    accessors << "{\"bufferView\":" << accessorCount << ",\"componentType\":" << componentType
+              << ",\"count\":" << count << ",\"type\":\"" << type << "\"}";
+    append(binary, data, bytes);
+    return accessorCount++;
+}
+
+bool writeGlb(const std::string& path, size_t chunks, size_t trianglesPerChunk) {
+    MeshData chunk;
+    generateTerrain(trianglesPerChunk, chunk);
+    size_t vertexCount = chunk.vertexCount();
+    std::vector<float> positions, normals, texcoords;
+    for (size_t v = 0; v < vertexCount; ++v) {
+        const float* vertex = &chunk.vertices[v * chunk.stride];
+        positions.insert(positions.end(), vertex, vertex + 3);
+        normals.insert(normals.end(), vertex + chunk.normalOffset(), vertex + chunk.normalOffset() + 3);
+        texcoords.insert(texcoords.end(), vertex + chunk.texcoordOffset(), vertex + chunk.texcoordOffset() + 2);
+    }
+    std::vector<uint16_t> indices16(chunk.indices.begin(), chunk.indices.end());
+    bool narrow = vertexCount <= 0x10000u;
+
+    std::vector<char> binary;
+    std::ostringstream views, accessors, meshes, nodes;
+    size_t accessorCount = 0;
+    size_t side = 1;
+    while (side * side < chunks) {
+        ++side;
+    }
+    for (size_t c = 0; c < chunks; ++c) {
+        size_t position = addAccessor(views, accessors, accessorCount, binary, positions.data(),
+                                      positions.size() * sizeof(float), 5126, vertexCount, "VEC3");
+        std::ostringstream attributes;
+        attributes << "\"POSITION\":" << position;
+        if (c % 3 != 0) {
+            attributes << ",\"NORMAL\":" << addAccessor(views, accessors, accessorCount, binary, normals.data(),
+                                                        normals.size() * sizeof(float), 5126, vertexCount, "VEC3");
+        }
+        if (c % 4 != 3) {
+            attributes << ",\"TEXCOORD_0\":" << addAccessor(views, accessors, accessorCount, binary, texcoords.data(),
+                                                            texcoords.size() * sizeof(float), 5126, vertexCount, "VEC2");
+        }
+        size_t indices = c % 2 == 0 && narrow
+            ? addAccessor(views, accessors, accessorCount, binary, indices16.data(), indices16.size() * 2, 5123,
+                          indices16.size(), "SCALAR")
+            : addAccessor(views, accessors, accessorCount, binary, chunk.indices.data(), chunk.indices.size() * 4,
+                          5125, chunk.indices.size(), "SCALAR");
+        meshes << (c ? "," : "") << "{\"name\":\"chunk" << c << "\",\"primitives\":[{\"attributes\":{"
+               << attributes.str() << "},\"indices\":" << indices << "}]}";
+        nodes << (c ? "," : "") << "{\"mesh\":" << c << ",\"translation\":[" << (c % side) * 100.0 << ",0,"
+              << (c / side) * 100.0 << "]" << (c % 5 == 4 ? ",\"rotation\":[0,0,0.70710678,0.70710678]" : "") << "}";
+    }
+    std::ostringstream sceneNodes;
+    for (size_t c = 0; c < chunks; ++c) {
+        sceneNodes << (c ? "," : "") << c;
+    }
+    std::ostringstream json;
+    json << "{\"asset\":{\"version\":\"2.0\",\"generator\":\"gltf_import_bench\"},\"scene\":0,"
+         << "\"scenes\":[{\"nodes\":[" << sceneNodes.str() << "]}],\"nodes\":[" << nodes.str() << "],"
+         << "\"meshes\":[" << meshes.str() << "],\"accessors\":[" << accessors.str() << "],"
+         << "\"bufferViews\":[" << views.str() << "],\"buffers\":[{\"byteLength\":" << binary.size() << "}]}";
+    std::string text = json.str();
+    text.resize((text.size() + 3) & ~static_cast<size_t>(3), ' ');
+
+    std::vector<char> file;
+    appendLe32(file, 0x46546c67u);
+    appendLe32(file, 2);
+    appendLe32(file, static_cast<uint32_t>(12 + 8 + text.size() + 8 + binary.size()));
+    appendLe32(file, static_cast<uint32_t>(text.size()));
+    appendLe32(file, 0x4e4f534au);
+    file.insert(file.end(), text.begin(), text.end());
+    appendLe32(file, static_cast<uint32_t>(binary.size()));
+    appendLe32(file, 0x004e4942u);
+    file.insert(file.end(), binary.begin(), binary.end());
+
+    std::ofstream out(path.c_str(), std::ios::binary);
+    out.write(file.data(), static_cast<std::streamsize>(file.size()));
+    if (!out) {
+        std::cerr << "Failed to write " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Whether flattenGltfScene() turned every normal with its instance: nodes only translate and
+// rotate, so the normal matrix is the rotation itself
+bool checkNormals(const GltfScene& scene) {
+    MeshData flat;
+    flattenGltfScene(scene, flat);
+    size_t vertex = 0;
+    for (size_t i = 0; i < scene.instances.size(); ++i) {
+        const float* m = scene.instances[i].transform;
+        const GltfMesh& mesh = scene.meshes[scene.instances[i].mesh];
+        for (size_t p = mesh.firstPrimitive; p < mesh.firstPrimitive + mesh.primitiveCount; ++p) {
+            const MeshData& part = scene.primitives[p].data;
+            for (size_t v = 0; v < part.vertexCount(); ++v, ++vertex) {
+                const float* n = &part.vertices[v * part.stride + part.normalOffset()];
+                const float* turned = &flat.vertices[vertex * flat.stride + flat.normalOffset()];
+                for (int r = 0; r < 3; ++r) {
+                    float expected = m[r] * n[0] + m[4 + r] * n[1] + m[8 + r] * n[2];
+                    if (std::fabs(turned[r] - expected) > 1e-3f) {
+                        std::cerr << "gltf_import_bench: instance " << i << " vertex " << v << " normal is ("
+                                  << turned[0] << ", " << turned[1] << ", " << turned[2] << "), expected it turned from ("
+                                  << n[0] << ", " << n[1] << ", " << n[2] << ")" << std::endl;
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t chunks = 256;
+    size_t triangles = 20000;
+    int maxThreads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    int repeat = 5;
+    std::string directory = ".";
+    bool keep = false;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (std::strncmp(arg, "--chunks=", 9) == 0) {
+            chunks = std::max<size_t>(1, static_cast<size_t>(std::atoll(arg + 9)));
+        } else if (std::strncmp(arg, "--triangles=", 12) == 0) {
+            triangles = static_cast<size_t>(std::atoll(arg + 12));
+        } else if (std::strncmp(arg, "--threads=", 10) == 0) {
+            maxThreads = std::max(1, std::atoi(arg + 10));
+        } else if (std::strncmp(arg, "--repeat=", 9) == 0) {
+            repeat = std::max(1, std::atoi(arg + 9));
+        } else if (std::strncmp(arg, "--dir=", 6) == 0) {
+            directory = arg + 6;
+        } else if (std::strcmp(arg, "--keep") == 0) {
+            keep = true;
+        } else {
+            std::cerr << "Usage: gltf_import_bench [--chunks=N] [--triangles=N] [--threads=N] [--repeat=N] "
+                         "[--dir=PATH] [--keep]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::string path = directory + "/gltf_import_bench.glb";
+    if (!writeGlb(path, chunks, triangles)) {
+        return 1;
+    }
+
+    std::cout << std::fixed << std::setprecision(4) << "{\"chunks\": " << chunks << ", \"repeat\": " << repeat
+              << ", \"runs\": [";
+    // Powers of two, then maxThreads itself
+    std::vector<int> threadCounts;
+    for (int threads = 1; threads < maxThreads; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(maxThreads);
+    double singleMs = 0.0;
+    for (size_t t = 0; t < threadCounts.size(); ++t) {
+        int threads = threadCounts[t];
+        JobSystem jobs(threads - 1);
+        GltfLoader loader(&jobs);
+        std::vector<std::pair<double, std::string> > runs;
+        for (int r = 0; r < repeat; ++r) {
+            GltfScene scene;
+            if (!loader.load(path, scene)) {
+                return 1;
+            }
+            if (t == 0 && r == 0 && !checkNormals(scene)) {
+                return 1;
+            }
+            std::ostringstream stats;
+            stats << std::fixed << std::setprecision(4);
+            loader.printJson(stats);
+            runs.push_back(std::make_pair(loader.stats().totalMs, stats.str()));
+        }
+        std::sort(runs.begin(), runs.end());
+        const std::pair<double, std::string>& median = runs[runs.size() / 2];
+        if (t == 0) {
+            singleMs = median.first;
+        }
+        std::cout << (t == 0 ? "" : ", ") << "{\"threads\": " << threads
+                  << ", \"speedup\": " << singleMs / median.first << ", \"stats\": " << median.second << "}";
+    }
+    std::cout << "]}" << std::endl;
+
+    if (!keep) {
+        std::remove(path.c_str());
+    }
+    return 0;
+}
@@ -0,0 +1,193 @@
+// Scaling microbenchmark for JobSystem.
+//
+// Runs the same workloads with 1, 2, ... N threads and prints the median time of each step and
+// its speedup over one thread as JSON:
+//   compute  parallelFor over items doing a few hundred flops each (should scale with cores)
+//   stream   parallelFor over items doing one multiply-add each (bound by memory bandwidth)
+//   fine     parallelFor with a grain of one item, far more jobs than a thread's job ring holds
+//   spawn    empty child jobs of one root, for the per-job overhead
+//
+// Every run's results are checked; the exit code is non-zero when one is wrong.
+//
+// Usage: job_system_bench [--threads=N] [--items=N] [--repeat=N]
+
+#include "job_system.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Workload {
+    std::vector<float> input;
+    std::vector<float> output;
+    std::atomic<size_t> counted;
+};
+
+float computeItem(float x) {
+    float sum = 0.0f;
+    for (int k = 0; k < 64; ++k) {
+        sum += std::sin(x + k * 0.1f) * 0.5f;
+    }
+    return sum;
+}
+
+void computeRange(size_t begin, size_t end, void* context) {
+    Workload& work = *static_cast<Workload*>(context);
+    for (size_t i = begin; i < end; ++i) {
+        work.output[i] = computeItem(work.input[i]);
+    }
+}
+
+void streamRange(size_t begin, size_t end, void* context) {
+    Workload& work = *static_cast<Workload*>(context);
+    for (size_t i = begin; i < end; ++i) {
+        work.output[i] = work.input[i] * 1.5f + 0.25f;
+    }
+}
+
+void countRange(size_t begin, size_t end, void* context) {
+    static_cast<Workload*>(context)->counted.fetch_add(end - begin, std::memory_order_relaxed);
+}
+
+void countJob(JobSystem::Job&, void* data) {
+    Workload* work;
+    std::memcpy(&work, data, sizeof(work));
+    work->counted.fetch_add(1, std::memory_order_relaxed);
+}
+
+double elapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+double median(std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+// Whether the last run of workload left the right results
+bool check(const char* workload, Workload& work, size_t items) {
+    if (std::strcmp(workload, "compute") == 0) {
+        for (size_t i = 0; i < items / 16; ++i) {
+            if (work.output[i] != computeItem(work.input[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+    if (std::strcmp(workload, "stream") == 0) {
+        for (size_t i = 0; i < items; ++i) {
+            if (work.output[i] != work.input[i] * 1.5f + 0.25f) {
+                return false;
+            }
+        }
+        return true;
+    }
+    return work.counted.load() == items / 16;
+}
+
+// Median time of repeat runs of one workload on jobs; ok is cleared when a run goes wrong
+double measure(JobSystem& jobs, const char* workload, Workload& work, size_t items, int repeat, bool& ok) {
+    std::vector<double> samples;
+    for (int r = 0; r < repeat; ++r) {
+        std::fill(work.output.begin(), work.output.end(), -1.0f);
+        work.counted = 0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (std::strcmp(workload, "compute") == 0) {
+            jobs.parallelFor(items / 16, 256, computeRange, &work);
+        } else if (std::strcmp(workload, "stream") == 0) {
+            jobs.parallelFor(items, 16384, streamRange, &work);
+        } else if (std::strcmp(workload, "fine") == 0) {
+            jobs.parallelFor(items / 16, 1, countRange, &work);
+        } else {
+            Workload* data = &work;
+            JobSystem::Job* root = jobs.create(countJob, data);
+            for (size_t i = 0; i < items / 16; ++i) {
+                jobs.run(jobs.create(countJob, data, root));
+            }
+            jobs.run(root);
+            jobs.wait(root);
+            // The root counts itself too
+            work.counted.fetch_sub(1);
+        }
+        samples.push_back(elapsedMs(start));
+        if (!check(workload, work, items)) {
+            std::cerr << "job_system_bench: " << workload << " on " << jobs.threadCount()
+                      << " threads produced wrong results" << std::endl;
+            ok = false;
+        }
+    }
+    return median(samples);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int maxThreads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    size_t items = 1 << 22;
+    int repeat = 9;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (std::strncmp(arg, "--threads=", 10) == 0) {
+            maxThreads = std::atoi(arg + 10);
+        } else if (std::strncmp(arg, "--items=", 8) == 0) {
+            items = static_cast<size_t>(std::atoll(arg + 8));
+        } else if (std::strncmp(arg, "--repeat=", 9) == 0) {
+            repeat = std::atoi(arg + 9);
+        } else {
+            std::cerr << "Unknown option: " << arg << "\n"
+                      << "Usage: job_system_bench [--threads=N] [--items=N] [--repeat=N]" << std::endl;
+            return 1;
+        }
+    }
+    if (maxThreads < 1 || items < 16 || repeat < 1) {
+        std::cerr << "Invalid arguments" << std::endl;
+        return 1;
+    }
+
+    Workload work;
+    work.input.resize(items);
+    work.output.resize(items);
+    for (size_t i = 0; i < items; ++i) {
+        work.input[i] = static_cast<float>(i % 1000) * 0.001f;
+    }
+
+    const char* const Workloads[] = { "compute", "stream", "fine", "spawn" };
+    const int WorkloadCount = 4;
+    double baseline[WorkloadCount] = { 0.0, 0.0, 0.0, 0.0 };
+    bool ok = true;
+    std::cout << std::fixed << std::setprecision(4)
+              << "{\"hardware_threads\": " << std::thread::hardware_concurrency()
+              << ", \"items\": " << items << ", \"results\": [";
+    bool first = true;
+    for (int threads = 1; threads <= maxThreads; ++threads) {
+        JobSystem jobs(threads - 1);
+        for (int w = 0; w < WorkloadCount; ++w) {
+            // One untimed run to wake the workers and fault in the pages
+            measure(jobs, Workloads[w], work, items, 1, ok);
+            jobs.resetStats();
+            double ms = measure(jobs, Workloads[w], work, items, repeat, ok);
+            if (threads == 1) {
+                baseline[w] = ms;
+            }
+            std::cout << (first ? "" : ", ") << "{\"workload\": \"" << Workloads[w] << "\""
+                      << ", \"threads\": " << threads
+                      << ", \"ms\": " << ms
+                      << ", \"speedup\": " << baseline[w] / ms
+                      << ", \"jobs\": " << jobs.executed() / repeat
+                      << ", \"stolen\": " << jobs.stolen() / repeat << "}";
+            std::cout.flush();
+            first = false;
+        }
+    }
+    std::cout << "]}" << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,212 @@
+// Mesh loading benchmark: text OBJ against the binary mesh format.
+//
+// Generates a heightfield, writes it as an OBJ and as two mesh files (float vertices and the
+// quantised layout), then times loading each: loadObj() parsing the text into an indexed mesh,
+// ObjParser doing the same in parallel chunks on --threads=N (checked to give the same mesh),
+// against MeshFile mapping and validating the binary file and reading every byte of its vertex
+// and index blobs, which is what the upload does. The files stay in the page cache between
+// runs, so both sides measure the parse rather than the disk. Prints JSON; the exit code is
+// non-zero when ObjParser's mesh differs from loadObj()'s.
+//
+// Usage: mesh_load_bench [--triangles=N] [--threads=N] [--repeat=N] [--dir=PATH] [--keep]
+
+#include "job_system.h"
+#include "mesh_data.h"
+#include "mesh_file.h"
+#include "obj_parser.h"
+#include "vertex_layout.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+double median(std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+size_t fileSize(const std::string& path) {
+    MappedFile file;
+    return file.open(path) ? file.size() : 0;
+}
+
+// Sums the bytes a word at a time so every page of the blob is read
+uint64_t touch(const void* data, size_t bytes) {
+    const char* cursor = static_cast<const char*>(data);
+    uint64_t sum = 0;
+    size_t i = 0;
+    for (; i + 8 <= bytes; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, cursor + i, 8);
+        sum += word;
+    }
+    for (; i < bytes; ++i) {
+        sum += static_cast<unsigned char>(cursor[i]);
+    }
+    return sum;
+}
+
+bool writeBinary(const std::string& path, const MeshData& mesh, bool quantize) {
+    VertexLayout layout;
+    layout.add(0, VertexSemantic::Position, 3, quantize ? VertexEncoding::Unorm16 : VertexEncoding::Float32)
+          .add(1, VertexSemantic::Normal, 3, quantize ? VertexEncoding::Packed1010102 : VertexEncoding::Float32)
+          .add(2, VertexSemantic::TexCoord, 2, quantize ? VertexEncoding::Half : VertexEncoding::Float32);
+    std::vector<char> packed;
+    Dequantization dequantization;
+    if (!packVertices(layout, mesh.vertices.data(), mesh.vertexCount(), packed, dequantization)) {
+        return false;
+    }
+    MeshFileSubmesh submesh;
+    std::memset(&submesh, 0, sizeof(submesh));
+    submesh.indexCount = static_cast<uint32_t>(mesh.indices.size());
+    for (size_t v = 0; v < mesh.vertices.size(); v += mesh.stride) {
+        for (int k = 0; k < 3; ++k) {
+            submesh.boundsMin[k] = v == 0 ? mesh.vertices[k] : std::min(submesh.boundsMin[k], mesh.vertices[v + k]);
+            submesh.boundsMax[k] = v == 0 ? mesh.vertices[k] : std::max(submesh.boundsMax[k], mesh.vertices[v + k]);
+        }
+    }
+    return writeMeshFile(path, layout, dequantization, packed.data(), mesh.vertexCount(), mesh.indices.data(),
+                         mesh.indices.size(), std::vector<MeshFileSubmesh>(1, submesh));
+}
+
+struct Result {
+    const char* format;
+    size_t bytes;
+    double ms;
+    uint64_t check;  // triangles parsed, or the byte sum, so nothing is optimised away
+};
+
+void printResult(const Result& result, double textMs, bool first) {
+    std::cout << (first ? "" : ", ") << "{\"format\": \"" << result.format << "\""
+              << ", \"bytes\": " << result.bytes << ", \"ms\": " << result.ms
+              << ", \"mb_per_s\": " << result.bytes / (1024.0 * 1024.0) / (result.ms / 1000.0)
+              << ", \"speedup\": " << textMs / result.ms << ", \"check\": " << result.check << "}";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t triangles = 2000000;
+    int repeat = 3;
+    int threads = -1;
+    std::string directory = ".";
+    bool keep = false;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (std::strncmp(arg, "--triangles=", 12) == 0) {
+            triangles = static_cast<size_t>(std::atoll(arg + 12));
+        } else if (std::strncmp(arg, "--threads=", 10) == 0) {
+            threads = std::max(1, std::atoi(arg + 10));
+        } else if (std::strncmp(arg, "--repeat=", 9) == 0) {
+            repeat = std::max(1, std::atoi(arg + 9));
+        } else if (std::strncmp(arg, "--dir=", 6) == 0) {
+            directory = arg + 6;
+        } else if (std::strcmp(arg, "--keep") == 0) {
+            keep = true;
+        } else {
+            std::cerr << "Usage: mesh_load_bench [--triangles=N] [--threads=N] [--repeat=N] [--dir=PATH] [--keep]" << std::endl;
+            return 1;
+        }
+    }
+
+    MeshData mesh;
+    generateTerrain(triangles, mesh);
+    std::string objPath = directory + "/mesh_load_bench.obj";
+    std::string floatPath = directory + "/mesh_load_bench.gmesh";
+    std::string quantizedPath = directory + "/mesh_load_bench_quantized.gmesh";
+    if (!writeObj(objPath, mesh, mesh.indices) || !writeBinary(floatPath, mesh, false)
+        || !writeBinary(quantizedPath, mesh, true)) {
+        return 1;
+    }
+
+    std::vector<Result> results;
+    std::vector<double> samples;
+    Result text = { "obj", fileSize(objPath), 0.0, 0 };
+    MeshData reference;
+    for (int r = 0; r < repeat; ++r) {
+        MeshData loaded;
+        Clock::time_point start = Clock::now();
+        if (!loadObj(objPath, loaded)) {
+            return 1;
+        }
+        samples.push_back(elapsedMs(start));
+        text.check = loaded.indices.size() / 3;
+        std::swap(reference, loaded);
+    }
+    text.ms = median(samples);
+
+    // threads counts the calling thread; -1 means one per hardware thread
+    JobSystem jobs(threads < 0 ? -1 : threads - 1);
+    ObjParser parser(&jobs);
+    Result chunked = { "obj_parallel", text.bytes, 0.0, 0 };
+    bool identical = true;
+    samples.clear();
+    for (int r = 0; r < repeat; ++r) {
+        MeshData loaded;
+        Clock::time_point start = Clock::now();
+        if (!parser.load(objPath, loaded)) {
+            return 1;
+        }
+        samples.push_back(elapsedMs(start));
+        chunked.check = loaded.indices.size() / 3;
+        identical = identical && loaded.stride == reference.stride && loaded.indices == reference.indices
+            && loaded.vertices == reference.vertices;
+    }
+    chunked.ms = median(samples);
+    results.push_back(chunked);
+
+    const char* names[2] = { "binary", "binary_quantized" };
+    const std::string* paths[2] = { &floatPath, &quantizedPath };
+    for (int f = 0; f < 2; ++f) {
+        Result binary = { names[f], fileSize(*paths[f]), 0.0, 0 };
+        samples.clear();
+        for (int r = 0; r < repeat; ++r) {
+            Clock::time_point start = Clock::now();
+            MeshFile file;
+            if (!file.open(*paths[f])) {
+                return 1;
+            }
+            binary.check = touch(file.vertices(), file.vertexBytes()) + touch(file.indices(), file.indexBytes());
+            samples.push_back(elapsedMs(start));
+        }
+        binary.ms = median(samples);
+        results.push_back(binary);
+    }
+
+    std::cout << std::fixed << std::setprecision(4)
+              << "{\"triangles\": " << mesh.indices.size() / 3 << ", \"vertices\": " << mesh.vertexCount()
+              << ", \"repeat\": " << repeat << ", \"threads\": " << jobs.threadCount()
+              << ", \"obj_parallel_identical\": " << (identical ? "true" : "false") << ", \"obj_parallel\": ";
+    parser.printJson(std::cout);
+    std::cout << ", \"results\": [";
+    printResult(text, text.ms, true);
+    for (size_t i = 0; i < results.size(); ++i) {
+        printResult(results[i], text.ms, false);
+    }
+    std::cout << "]}" << std::endl;
+
+    if (!keep) {
+        std::remove(objPath.c_str());
+        std::remove(floatPath.c_str());
+        std::remove(quantizedPath.c_str());
+    }
+    if (!identical) {
+        std::cerr << "mesh_load_bench: ObjParser and loadObj() gave different meshes" << std::endl;
+        return 1;
+    }
+    return 0;
+}
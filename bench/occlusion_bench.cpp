@@ -0,0 +1,285 @@
+// Occlusion culling benchmark and regression check.
+//
+// Builds a fixed city: blocks of buildings as occluders along a street the camera looks down,
+// and small boxes scattered over the ground. The boxes are frustum culled, then occlusion culled
+// against the software depth buffer, with the SIMD and scalar rasterisers. Prints timings, the
+// survivor counts and a checksum of the surviving indices and of the depth buffer as JSON. The
+// scene is deterministic, so the checksums only change when the culling results do.
+//
+// As a regression check every culled box is tested against the buildings analytically: if a
+// segment from the eye to any of its corners or its centre that lies on screen misses every
+// building, the box was culled while visible. The culler is conservative, so any such false cull
+// is a bug and fails the run.
+//
+// Usage: occlusion_bench [--objects=N] [--repeat=N] [--size=WxH] [--dump=depth.pgm]
+
+#include "frustum_culler.h"
+#include "hash.h"
+#include "occlusion_culler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+double median(std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+// Column-major OpenGL perspective projection looking down -z
+void perspective(float fovY, float aspect, float zNear, float zFar, float* m) {
+    float f = 1.0f / std::tan(fovY * 0.5f);
+    std::memset(m, 0, 16 * sizeof(float));
+    m[0] = f / aspect;
+    m[5] = f;
+    m[10] = (zFar + zNear) / (zNear - zFar);
+    m[11] = -1.0f;
+    m[14] = 2.0f * zFar * zNear / (zNear - zFar);
+}
+
+struct Random {
+    uint32_t seed;
+    // Uniform in [0, 1)
+    float next() {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) * (1.0f / 16777216.0f);
+    }
+};
+
+// Twelve triangles of a box
+void boxMesh(const Aabb& box, std::vector<float>& positions, std::vector<uint32_t>& indices) {
+    positions.clear();
+    for (int corner = 0; corner < 8; ++corner) {
+        positions.push_back(corner & 1 ? box.max[0] : box.min[0]);
+        positions.push_back(corner & 2 ? box.max[1] : box.min[1]);
+        positions.push_back(corner & 4 ? box.max[2] : box.min[2]);
+    }
+    static const uint32_t faces[36] = {
+        0, 2, 1, 1, 2, 3,  4, 5, 6, 5, 7, 6,  0, 1, 4, 1, 5, 4,
+        2, 6, 3, 3, 6, 7,  0, 4, 2, 2, 4, 6,  1, 3, 5, 3, 7, 5
+    };
+    indices.assign(faces, faces + 36);
+}
+
+// True when the segment from a to b passes through box before reaching b
+bool segmentBlocked(const float* a, const float* b, const Aabb& box) {
+    float enter = 0.0f;
+    float exit = 1.0f;
+    for (int k = 0; k < 3; ++k) {
+        float direction = b[k] - a[k];
+        if (direction == 0.0f) {
+            if (a[k] < box.min[k] || a[k] > box.max[k]) {
+                return false;
+            }
+            continue;
+        }
+        float t0 = (box.min[k] - a[k]) / direction;
+        float t1 = (box.max[k] - a[k]) / direction;
+        enter = std::max(enter, std::min(t0, t1));
+        exit = std::min(exit, std::max(t0, t1));
+    }
+    return enter < exit && enter < 0.999f;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t objectCount = 100000;
+    int repeat = 11;
+    int width = OcclusionCuller::DefaultWidth;
+    int height = OcclusionCuller::DefaultHeight;
+    std::string dumpPath;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (std::strncmp(arg, "--objects=", 10) == 0) {
+            objectCount = static_cast<size_t>(std::atoll(arg + 10));
+        } else if (std::strncmp(arg, "--repeat=", 9) == 0) {
+            repeat = std::atoi(arg + 9);
+        } else if (std::strncmp(arg, "--size=", 7) == 0) {
+            if (std::sscanf(arg + 7, "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0) {
+                std::cerr << "Invalid size (expected WxH): " << arg << std::endl;
+                return 1;
+            }
+        } else if (std::strncmp(arg, "--dump=", 7) == 0) {
+            dumpPath = arg + 7;
+        } else {
+            std::cerr << "Unknown option: " << arg << "\n"
+                      << "Usage: occlusion_bench [--objects=N] [--repeat=N] [--size=WxH] [--dump=depth.pgm]" << std::endl;
+            return 1;
+        }
+    }
+    if (objectCount == 0 || repeat < 1) {
+        std::cerr << "Invalid arguments" << std::endl;
+        return 1;
+    }
+
+    // Buildings in blocks on both sides of a street along -z, plus a wall across its far end
+    std::vector<Aabb> buildings;
+    Random random = { 2024 };
+    for (int row = 0; row < 12; ++row) {
+        for (int column = -5; column < 5; ++column) {
+            float x = column * 20.0f + 6.0f;
+            float z = -15.0f - row * 20.0f;
+            float tall = 8.0f + random.next() * 24.0f;
+            Aabb building = { { x, 0.0f, z - 14.0f }, { x + 8.0f + random.next() * 4.0f, tall, z } };
+            buildings.push_back(building);
+        }
+    }
+    Aabb farWall = { { -8.0f, 0.0f, -255.0f }, { 8.0f, 20.0f, -254.0f } };
+    buildings.push_back(farWall);
+
+    std::vector<Aabb> objects(objectCount);
+    FrustumCuller frustumCuller;
+    for (size_t i = 0; i < objectCount; ++i) {
+        float center[3] = { random.next() * 200.0f - 100.0f, 0.5f + random.next() * 2.0f, -random.next() * 300.0f };
+        float extents[3] = { 0.25f + random.next() * 0.5f, 0.5f, 0.25f + random.next() * 0.5f };
+        for (int k = 0; k < 3; ++k) {
+            objects[i].min[k] = center[k] - extents[k];
+            objects[i].max[k] = center[k] + extents[k];
+        }
+        frustumCuller.add(center, extents);
+    }
+
+    // Eye height, looking down the street; only a translation, so the view matrix is folded in
+    const float eye[3] = { 0.0f, 1.7f, 0.0f };
+    float viewProjection[16];
+    perspective(1.0f, static_cast<float>(width) / height, 0.5f, 400.0f, viewProjection);
+    for (int row = 0; row < 4; ++row) {
+        viewProjection[12 + row] -= viewProjection[row] * eye[0] + viewProjection[4 + row] * eye[1] + viewProjection[8 + row] * eye[2];
+    }
+    Frustum frustum = Frustum::fromMatrix(viewProjection);
+
+    std::vector<uint32_t> candidates;
+    frustumCuller.cull(frustum, candidates);
+
+    std::cout << std::fixed << std::setprecision(4)
+              << "{\"objects\": " << objectCount << ", \"occluders\": " << buildings.size()
+              << ", \"frustum_visible\": " << candidates.size() << ", \"results\": [";
+    std::vector<uint32_t> references[2];
+    std::vector<float> referenceDepth;
+    bool consistent = true;
+    bool culledVisible = false;
+    for (int simd = 1; simd >= 0; --simd) {
+        if (simd && !OcclusionCuller::simdAvailable()) {
+            continue;
+        }
+        OcclusionCuller culler(width, height);
+        culler.setSimd(simd != 0);
+        std::vector<float> positions;
+        std::vector<uint32_t> indices;
+        for (size_t b = 0; b < buildings.size(); ++b) {
+            boxMesh(buildings[b], positions, indices);
+            culler.addOccluder(positions.data(), positions.size() / 3, indices.data(), indices.size());
+        }
+
+        std::vector<double> renderSamples;
+        std::vector<double> testSamples;
+        std::vector<uint32_t> survivors;
+        for (int r = 0; r < repeat; ++r) {
+            Clock::time_point start = Clock::now();
+            culler.render(viewProjection);
+            renderSamples.push_back(elapsedMs(start));
+            survivors = candidates;
+            start = Clock::now();
+            culler.cull(objects, survivors);
+            testSamples.push_back(elapsedMs(start));
+        }
+
+        const std::vector<float>& depth = culler.depthBuffer();
+        uint64_t visibleChecksum = fnv1a64(survivors.data(), survivors.size() * sizeof(uint32_t));
+        uint64_t depthChecksum = fnv1a64(depth.data(), depth.size() * sizeof(float));
+        if (referenceDepth.empty()) {
+            referenceDepth = depth;
+            references[0] = survivors;
+        } else {
+            consistent = consistent && depth == referenceDepth && survivors == references[0];
+        }
+
+        // Culled boxes with a clear line of sight to an on-screen corner or the centre
+        size_t falseCulls = 0;
+        std::vector<bool> kept(objectCount, false);
+        for (size_t i = 0; i < survivors.size(); ++i) {
+            kept[survivors[i]] = true;
+        }
+        for (size_t c = 0; c < candidates.size(); ++c) {
+            const Aabb& box = objects[candidates[c]];
+            if (kept[candidates[c]]) {
+                continue;
+            }
+            bool seen = false;
+            for (int point = 0; point < 9 && !seen; ++point) {
+                float target[3];
+                for (int k = 0; k < 3; ++k) {
+                    target[k] = point == 8 ? (box.min[k] + box.max[k]) * 0.5f : (point >> k & 1 ? box.max[k] : box.min[k]);
+                }
+                // Boxes straddling the frustum only count as seen where they're in view
+                float clip[4];
+                for (int row = 0; row < 4; ++row) {
+                    clip[row] = viewProjection[row] * target[0] + viewProjection[4 + row] * target[1]
+                        + viewProjection[8 + row] * target[2] + viewProjection[12 + row];
+                }
+                if (clip[3] <= 0.0f || std::fabs(clip[0]) > clip[3] || std::fabs(clip[1]) > clip[3] || std::fabs(clip[2]) > clip[3]) {
+                    continue;
+                }
+                bool blocked = false;
+                for (size_t b = 0; b < buildings.size() && !blocked; ++b) {
+                    blocked = segmentBlocked(eye, target, buildings[b]);
+                }
+                seen = !blocked;
+            }
+            falseCulls += seen ? 1 : 0;
+        }
+        if (falseCulls > 0) {
+            std::cerr << "occlusion_bench: " << falseCulls << " visible boxes culled with simd " << (simd ? "on" : "off") << std::endl;
+            culledVisible = true;
+        }
+
+        char checksums[2][17];
+        std::snprintf(checksums[0], sizeof(checksums[0]), "%016llx", static_cast<unsigned long long>(visibleChecksum));
+        std::snprintf(checksums[1], sizeof(checksums[1]), "%016llx", static_cast<unsigned long long>(depthChecksum));
+        std::cout << (simd ? "" : ", ") << "{\"simd\": " << (simd ? "true" : "false")
+                  << ", \"render_ms\": " << median(renderSamples)
+                  << ", \"test_ms\": " << median(testSamples)
+                  << ", \"occlusion_visible\": " << survivors.size()
+                  << ", \"false_culls\": " << falseCulls
+                  << ", \"visible_checksum\": \"" << checksums[0] << "\""
+                  << ", \"depth_checksum\": \"" << checksums[1] << "\""
+                  << ", \"stats\": ";
+        culler.printJson(std::cout);
+        std::cout << "}";
+
+        if (!dumpPath.empty() && simd == (OcclusionCuller::simdAvailable() ? 1 : 0)) {
+            // Binary greymap, near is white; PGM rows go top down
+            std::ofstream out(dumpPath.c_str(), std::ios::binary);
+            out << "P5\n" << culler.width() << " " << culler.height() << "\n255\n";
+            for (int y = culler.height() - 1; y >= 0; --y) {
+                for (int x = 0; x < culler.width(); ++x) {
+                    float d = depth[static_cast<size_t>(y) * culler.width() + x];
+                    out.put(static_cast<char>(static_cast<unsigned char>(255.0f * (1.0f - d) * 20.0f > 255.0f ? 255 : 255.0f * (1.0f - d) * 20.0f)));
+                }
+            }
+            if (!out) {
+                std::cerr << "Failed to write " << dumpPath << std::endl;
+                return 1;
+            }
+        }
+    }
+    std::cout << "], \"simd_matches_scalar\": " << (consistent ? "true" : "false") << "}" << std::endl;
+    return consistent && !culledVisible ? 0 : 1;
+}
@@ -0,0 +1,569 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+const uint32_t Bvh::MaxLeafSize;
+const int Bvh::BinCount;
+const int Bvh::RebuildDepth;
+
+// ---- Aabb ----
+
+Aabb Aabb::empty() {
+    const float huge = std::numeric_limits<float>::max();
+    Aabb box = { { huge, huge, huge }, { -huge, -huge, -huge } };
+    return box;
+}
+
+void Aabb::grow(const Aabb& other) {
+    for (int i = 0; i < 3; ++i) {
+        min[i] = std::min(min[i], other.min[i]);
+        max[i] = std::max(max[i], other.max[i]);
+    }
+}
+
+float Aabb::surfaceArea() const {
+    float x = max[0] - min[0];
+    float y = max[1] - min[1];
+    float z = max[2] - min[2];
+    if (x < 0.0f || y < 0.0f || z < 0.0f) {
+        return 0.0f;
+    }
+    return 2.0f * (x * y + y * z + z * x);
+}
+
+bool Aabb::overlaps(const Aabb& other) const {
+    return min[0] <= other.max[0] && other.min[0] <= max[0]
+        && min[1] <= other.max[1] && other.min[1] <= max[1]
+        && min[2] <= other.max[2] && other.min[2] <= max[2];
+}
+
+namespace {
+
+// Slab test. Returns the entry distance, or a negative value on a miss.
+float intersectRay(const Aabb& box, const float origin[3], const float inverse[3], float maxDistance) {
+    float enter = 0.0f;
+    float exit = maxDistance;
+    for (int i = 0; i < 3; ++i) {
+        float t0 = (box.min[i] - origin[i]) * inverse[i];
+        float t1 = (box.max[i] - origin[i]) * inverse[i];
+        enter = std::max(enter, std::min(t0, t1));
+        exit = std::min(exit, std::max(t0, t1));
+    }
+    return enter <= exit ? enter : -1.0f;
+}
+
+enum class Containment {
+    Outside,
+    Intersecting,
+    Inside
+};
+
+Containment classify(const Frustum& frustum, const Aabb& box) {
+    Containment result = Containment::Inside;
+    for (int p = 0; p < 6; ++p) {
+        const float* plane = frustum.planes[p];
+        float distance = 0.0f;
+        float reach = 0.0f;
+        for (int i = 0; i < 3; ++i) {
+            distance += plane[i] * (box.min[i] + box.max[i]) * 0.5f;
+            reach += std::fabs(plane[i]) * (box.max[i] - box.min[i]) * 0.5f;
+        }
+        distance += plane[3];
+        if (distance + reach < 0.0f) {
+            return Containment::Outside;
+        }
+        if (distance - reach < 0.0f) {
+            result = Containment::Intersecting;
+        }
+    }
+    return result;
+}
+
+} // namespace
+
+// ---- Bvh ----
+
+Bvh::Bvh()
+    : orphanedNodes(0),
+      workerDone(false),
+      rebuildNode(0),
+      rebuildFirst(0) {
+}
+
+Bvh::~Bvh() {
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+void Bvh::build(const std::vector<Aabb>& bounds) {
+    // A rebuild in flight refers to the old tree
+    if (worker.joinable()) {
+        worker.join();
+    }
+    Subtree tree;
+    buildSubtree(bounds, tree);
+    nodes.swap(tree.nodes);
+    primitives.swap(tree.primitives);
+    orphanedNodes = 0;
+    primitiveBounds.resize(primitives.size());
+    for (size_t i = 0; i < primitives.size(); ++i) {
+        primitiveBounds[i] = bounds[primitives[i]];
+    }
+}
+
+void Bvh::buildSubtree(const std::vector<Aabb>& bounds, Subtree& out) {
+    out.nodes.clear();
+    out.primitives.clear();
+    uint32_t count = static_cast<uint32_t>(bounds.size());
+    if (count == 0) {
+        return;
+    }
+    out.primitives.resize(count);
+    std::vector<float> centroids(count * 3);
+    for (uint32_t i = 0; i < count; ++i) {
+        out.primitives[i] = i;
+        for (int axis = 0; axis < 3; ++axis) {
+            centroids[i * 3 + axis] = (bounds[i].min[axis] + bounds[i].max[axis]) * 0.5f;
+        }
+    }
+    out.nodes.reserve(count * 2 / MaxLeafSize + 1);
+    Node root = { Aabb::empty(), 0, count };
+    out.nodes.push_back(root);
+
+    struct Bin {
+        Aabb bounds;
+        uint32_t count;
+    };
+
+    std::vector<uint32_t> pending(1, 0);
+    while (!pending.empty()) {
+        uint32_t index = pending.back();
+        pending.pop_back();
+        uint32_t first = out.nodes[index].first;
+        uint32_t nodeCount = out.nodes[index].count;
+        uint32_t* range = &out.primitives[first];
+
+        Aabb box = Aabb::empty();
+        Aabb centroidBox = Aabb::empty();
+        for (uint32_t i = 0; i < nodeCount; ++i) {
+            box.grow(bounds[range[i]]);
+            const float* c = &centroids[range[i] * 3];
+            Aabb point = { { c[0], c[1], c[2] }, { c[0], c[1], c[2] } };
+            centroidBox.grow(point);
+        }
+        out.nodes[index].bounds = box;
+        if (nodeCount <= MaxLeafSize) {
+            continue;
+        }
+
+        // Bin centroids along each axis and sweep the bin boundaries for the cheapest split,
+        // costing each side as its surface area times its object count
+        int bestAxis = -1;
+        int bestSplit = 0;
+        float bestCost = std::numeric_limits<float>::max();
+        for (int axis = 0; axis < 3; ++axis) {
+            float lo = centroidBox.min[axis];
+            float extent = centroidBox.max[axis] - lo;
+            if (!(extent > 0.0f)) {
+                continue;
+            }
+            float scale = BinCount / extent;
+            Bin bins[BinCount];
+            for (int b = 0; b < BinCount; ++b) {
+                bins[b].bounds = Aabb::empty();
+                bins[b].count = 0;
+            }
+            for (uint32_t i = 0; i < nodeCount; ++i) {
+                int b = std::min(BinCount - 1, static_cast<int>((centroids[range[i] * 3 + axis] - lo) * scale));
+                bins[b].bounds.grow(bounds[range[i]]);
+                ++bins[b].count;
+            }
+            float rightArea[BinCount];
+            uint32_t rightCount[BinCount];
+            Aabb accumulated = Aabb::empty();
+            uint32_t accumulatedCount = 0;
+            for (int b = BinCount - 1; b > 0; --b) {
+                accumulated.grow(bins[b].bounds);
+                accumulatedCount += bins[b].count;
+                rightArea[b] = accumulated.surfaceArea();
+                rightCount[b] = accumulatedCount;
+            }
+            accumulated = Aabb::empty();
+            accumulatedCount = 0;
+            for (int b = 0; b + 1 < BinCount; ++b) {
+                accumulated.grow(bins[b].bounds);
+                accumulatedCount += bins[b].count;
+                if (accumulatedCount == 0 || rightCount[b + 1] == 0) {
+                    continue;
+                }
+                float cost = accumulated.surfaceArea() * accumulatedCount + rightArea[b + 1] * rightCount[b + 1];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = b;
+                }
+            }
+        }
+
+        uint32_t leftCount;
+        if (bestAxis >= 0) {
+            float lo = centroidBox.min[bestAxis];
+            float scale = BinCount / (centroidBox.max[bestAxis] - lo);
+            const float* centroidData = centroids.data();
+            uint32_t* middle = std::partition(range, range + nodeCount, [=](uint32_t primitive) {
+                int b = std::min(BinCount - 1, static_cast<int>((centroidData[primitive * 3 + bestAxis] - lo) * scale));
+                return b <= bestSplit;
+            });
+            leftCount = static_cast<uint32_t>(middle - range);
+        } else {
+            // Every centroid in the same place; any split is as good as another
+            leftCount = nodeCount / 2;
+        }
+        if (leftCount == 0 || leftCount == nodeCount) {
+            leftCount = nodeCount / 2;
+        }
+
+        uint32_t left = static_cast<uint32_t>(out.nodes.size());
+        Node leftNode = { Aabb::empty(), first, leftCount };
+        Node rightNode = { Aabb::empty(), first + leftCount, nodeCount - leftCount };
+        out.nodes.push_back(leftNode);
+        out.nodes.push_back(rightNode);
+        out.nodes[index].first = left;
+        out.nodes[index].count = 0;
+        pending.push_back(left + 1);
+        pending.push_back(left);
+    }
+}
+
+void Bvh::refitNode(uint32_t index) {
+    Node& node = nodes[index];
+    if (node.count > 0) {
+        Aabb box = primitiveBounds[node.first];
+        for (uint32_t i = 1; i < node.count; ++i) {
+            box.grow(primitiveBounds[node.first + i]);
+        }
+        node.bounds = box;
+    } else {
+        Aabb box = nodes[node.first].bounds;
+        box.grow(nodes[node.first + 1].bounds);
+        node.bounds = box;
+    }
+}
+
+void Bvh::refit(const std::vector<Aabb>& bounds) {
+    for (size_t i = 0; i < primitives.size(); ++i) {
+        primitiveBounds[i] = bounds[primitives[i]];
+    }
+    // Children always sit after their parent, so one backwards pass sees them first
+    for (size_t i = nodes.size(); i-- > 0;) {
+        refitNode(static_cast<uint32_t>(i));
+    }
+}
+
+float Bvh::subtreeCost(uint32_t root, uint32_t* first, uint32_t* count) const {
+    float cost = 0.0f;
+    uint32_t lowest = std::numeric_limits<uint32_t>::max();
+    uint32_t total = 0;
+    std::vector<uint32_t> stack(1, root);
+    while (!stack.empty()) {
+        const Node& node = nodes[stack.back()];
+        stack.pop_back();
+        float area = node.bounds.surfaceArea();
+        if (node.count > 0) {
+            cost += area * node.count;
+            lowest = std::min(lowest, node.first);
+            total += node.count;
+        } else {
+            cost += area;
+            stack.push_back(node.first);
+            stack.push_back(node.first + 1);
+        }
+    }
+    if (first) {
+        *first = lowest;
+    }
+    if (count) {
+        *count = total;
+    }
+    return cost;
+}
+
+float Bvh::cost() const {
+    if (nodes.empty()) {
+        return 0.0f;
+    }
+    float rootArea = nodes[0].bounds.surfaceArea();
+    return rootArea > 0.0f ? subtreeCost(0, nullptr, nullptr) / rootArea : 0.0f;
+}
+
+int Bvh::depth() const {
+    if (nodes.empty()) {
+        return 0;
+    }
+    int deepest = 0;
+    std::vector<std::pair<uint32_t, int> > stack(1, std::make_pair(0u, 1));
+    while (!stack.empty()) {
+        std::pair<uint32_t, int> entry = stack.back();
+        stack.pop_back();
+        const Node& node = nodes[entry.first];
+        deepest = std::max(deepest, entry.second);
+        if (node.count == 0) {
+            stack.push_back(std::make_pair(node.first, entry.second + 1));
+            stack.push_back(std::make_pair(node.first + 1, entry.second + 1));
+        }
+    }
+    return deepest;
+}
+
+bool Bvh::beginPartialRebuild(const std::vector<Aabb>& bounds) {
+    if (worker.joinable() || nodes.empty()) {
+        return false;
+    }
+
+    // Candidates are the subtrees RebuildDepth levels down, which an SAH build leaves roughly
+    // equal in size, so the one adding the most to the tree's cost is the one that degraded most
+    uint32_t worst = 0;
+    float worstCost = -1.0f;
+    std::vector<std::pair<uint32_t, int> > stack(1, std::make_pair(0u, 0));
+    while (!stack.empty()) {
+        std::pair<uint32_t, int> entry = stack.back();
+        stack.pop_back();
+        const Node& node = nodes[entry.first];
+        if (node.count > 0) {
+            continue;
+        }
+        if (entry.second < RebuildDepth) {
+            stack.push_back(std::make_pair(node.first, entry.second + 1));
+            stack.push_back(std::make_pair(node.first + 1, entry.second + 1));
+            continue;
+        }
+        float cost = subtreeCost(entry.first, nullptr, nullptr);
+        if (cost > worstCost) {
+            worstCost = cost;
+            worst = entry.first;
+        }
+    }
+    if (worstCost < 0.0f) {
+        return false;
+    }
+
+    // The worker only sees a snapshot of the subtree's objects; the tree itself stays usable
+    uint32_t count = 0;
+    subtreeCost(worst, &rebuildFirst, &count);
+    rebuildNode = worst;
+    rebuildBounds.resize(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        rebuildBounds[i] = bounds[primitives[rebuildFirst + i]];
+    }
+    workerDone.store(false, std::memory_order_relaxed);
+    worker = std::thread([this]() {
+        buildSubtree(rebuildBounds, rebuilt);
+        workerDone.store(true, std::memory_order_release);
+    });
+    return true;
+}
+
+bool Bvh::finishPartialRebuild(const std::vector<Aabb>& bounds, bool wait) {
+    if (!worker.joinable()) {
+        return false;
+    }
+    if (!wait && !workerDone.load(std::memory_order_acquire)) {
+        return false;
+    }
+    worker.join();
+
+    // Count the nodes being replaced; all but the subtree root become unreachable
+    size_t replaced = 0;
+    std::vector<uint32_t> stack(1, rebuildNode);
+    while (!stack.empty()) {
+        const Node& node = nodes[stack.back()];
+        stack.pop_back();
+        ++replaced;
+        if (node.count == 0) {
+            stack.push_back(node.first);
+            stack.push_back(node.first + 1);
+        }
+    }
+    orphanedNodes += replaced - 1;
+
+    // The new root takes the old root's slot and the rest are appended, which keeps every child
+    // after its parent. Local indices are rebased onto the whole tree.
+    uint32_t base = static_cast<uint32_t>(nodes.size());
+    for (size_t i = 0; i < rebuilt.nodes.size(); ++i) {
+        Node node = rebuilt.nodes[i];
+        node.first += node.count > 0 ? rebuildFirst : base - 1;
+        if (i == 0) {
+            nodes[rebuildNode] = node;
+        } else {
+            nodes.push_back(node);
+        }
+    }
+    std::vector<uint32_t> previous(primitives.begin() + rebuildFirst, primitives.begin() + rebuildFirst + rebuilt.primitives.size());
+    for (size_t i = 0; i < rebuilt.primitives.size(); ++i) {
+        uint32_t primitive = previous[rebuilt.primitives[i]];
+        primitives[rebuildFirst + i] = primitive;
+        primitiveBounds[rebuildFirst + i] = bounds[primitive];
+    }
+
+    // Objects kept moving while the worker ran
+    for (size_t i = nodes.size(); i-- > base;) {
+        refitNode(static_cast<uint32_t>(i));
+    }
+    refitNode(rebuildNode);
+    rebuilt.nodes.clear();
+    rebuilt.primitives.clear();
+
+    if (orphanedNodes > nodeCount() / 2) {
+        compact();
+    }
+    return true;
+}
+
+void Bvh::compact() {
+    // Depth-first copy of the reachable nodes, keeping siblings adjacent
+    std::vector<Node> live;
+    live.reserve(nodeCount());
+    live.push_back(nodes[0]);
+    std::vector<uint32_t> stack(1, 0);
+    while (!stack.empty()) {
+        uint32_t index = stack.back();
+        stack.pop_back();
+        Node& node = live[index];
+        if (node.count > 0) {
+            continue;
+        }
+        uint32_t left = static_cast<uint32_t>(live.size());
+        uint32_t oldLeft = node.first;
+        node.first = left;
+        live.push_back(nodes[oldLeft]);
+        live.push_back(nodes[oldLeft + 1]);
+        stack.push_back(left + 1);
+        stack.push_back(left);
+    }
+    nodes.swap(live);
+    orphanedNodes = 0;
+}
+
+void Bvh::queryFrustum(const Frustum& frustum, std::vector<uint32_t>& out) const {
+    if (nodes.empty()) {
+        return;
+    }
+    std::vector<uint32_t> stack;
+    stack.reserve(64);
+    stack.push_back(0);
+    // Subtrees found entirely inside are collected here and emptied without further tests
+    std::vector<uint32_t> inside;
+    while (!stack.empty()) {
+        uint32_t index = stack.back();
+        stack.pop_back();
+        const Node& node = nodes[index];
+        Containment containment = classify(frustum, node.bounds);
+        if (containment == Containment::Outside) {
+            continue;
+        }
+        if (containment == Containment::Inside) {
+            inside.push_back(index);
+            while (!inside.empty()) {
+                const Node& child = nodes[inside.back()];
+                inside.pop_back();
+                if (child.count > 0) {
+                    out.insert(out.end(), primitives.begin() + child.first, primitives.begin() + child.first + child.count);
+                } else {
+                    inside.push_back(child.first);
+                    inside.push_back(child.first + 1);
+                }
+            }
+        } else if (node.count > 0) {
+            for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                if (classify(frustum, primitiveBounds[i]) != Containment::Outside) {
+                    out.push_back(primitives[i]);
+                }
+            }
+        } else {
+            stack.push_back(node.first);
+            stack.push_back(node.first + 1);
+        }
+    }
+}
+
+void Bvh::queryAabb(const Aabb& region, std::vector<uint32_t>& out) const {
+    if (nodes.empty()) {
+        return;
+    }
+    std::vector<uint32_t> stack;
+    stack.reserve(64);
+    stack.push_back(0);
+    while (!stack.empty()) {
+        const Node& node = nodes[stack.back()];
+        stack.pop_back();
+        if (!node.bounds.overlaps(region)) {
+            continue;
+        }
+        if (node.count > 0) {
+            for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                if (primitiveBounds[i].overlaps(region)) {
+                    out.push_back(primitives[i]);
+                }
+            }
+        } else {
+            stack.push_back(node.first);
+            stack.push_back(node.first + 1);
+        }
+    }
+}
+
+int64_t Bvh::raycast(const float origin[3], const float direction[3], float maxDistance, float* hitDistance) const {
+    if (nodes.empty()) {
+        return -1;
+    }
+    // A huge finite inverse keeps axis-parallel rays out of 0 * inf
+    float inverse[3];
+    for (int i = 0; i < 3; ++i) {
+        inverse[i] = direction[i] != 0.0f ? 1.0f / direction[i] : std::copysign(1e30f, direction[i]);
+    }
+
+    int64_t hit = -1;
+    float nearest = maxDistance;
+    std::vector<uint32_t> stack;
+    stack.reserve(64);
+    if (intersectRay(nodes[0].bounds, origin, inverse, nearest) >= 0.0f) {
+        stack.push_back(0);
+    }
+    while (!stack.empty()) {
+        const Node& node = nodes[stack.back()];
+        stack.pop_back();
+        // Boxes were tested when pushed, but a closer hit may have been found since
+        if (intersectRay(node.bounds, origin, inverse, nearest) < 0.0f) {
+            continue;
+        }
+        if (node.count > 0) {
+            for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                float t = intersectRay(primitiveBounds[i], origin, inverse, nearest);
+                if (t >= 0.0f && (hit < 0 || t < nearest)) {
+                    nearest = t;
+                    hit = primitives[i];
+                }
+            }
+            continue;
+        }
+        // Visit the nearer child first so the farther one is more likely to be skipped
+        float left = intersectRay(nodes[node.first].bounds, origin, inverse, nearest);
+        float right = intersectRay(nodes[node.first + 1].bounds, origin, inverse, nearest);
+        if (left >= 0.0f && right >= 0.0f) {
+            bool leftFirst = left <= right;
+            stack.push_back(leftFirst ? node.first + 1 : node.first);
+            stack.push_back(leftFirst ? node.first : node.first + 1);
+        } else if (left >= 0.0f) {
+            stack.push_back(node.first);
+        } else if (right >= 0.0f) {
+            stack.push_back(node.first + 1);
+        }
+    }
+    if (hit >= 0 && hitDistance) {
+        *hitDistance = nearest;
+    }
+    return hit;
+}
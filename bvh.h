@@ -0,0 +1,108 @@
+#pragma once
+
+#include "frustum_culler.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// Axis-aligned box by corners.
+struct Aabb {
+    float min[3];
+    float max[3];
+
+    static Aabb empty();
+    void grow(const Aabb& other);
+    float surfaceArea() const;
+    bool overlaps(const Aabb& other) const;
+};
+
+// Bounding volume hierarchy over a set of object boxes, for culling, picking and region queries.
+//
+// build() runs a binned SAH build. Each object is a primitive, and each leaf covers a contiguous
+// range of a primitive index array. When objects move, refit() recomputes every node box from the
+// objects' new boxes in one bottom-up pass, keeping the topology. That is cheap, but the tree gets
+// worse as objects drift away from where they were built.
+//
+// To restore it without a full rebuild, beginPartialRebuild() picks, among the subtrees
+// RebuildDepth levels down, the one with the highest absolute SAH cost (an SAH build leaves them
+// roughly equal in size, so that is the one that degraded most) and rebuilds a copy of it on a
+// worker thread. Meanwhile the tree keeps being refitted and queried. finishPartialRebuild() splices the new subtree in once the worker
+// is done. Nodes the splice orphans are reclaimed by compacting the tree when they pile up.
+//
+// Object indices are positions in the bounds vector passed to build(); every call that takes
+// bounds expects the same objects in the same order.
+class Bvh {
+public:
+    static const uint32_t MaxLeafSize = 4;
+    static const int BinCount = 12;
+    // Partial rebuilds pick among the subtrees this many levels below the root
+    static const int RebuildDepth = 3;
+
+    Bvh();
+    ~Bvh();
+
+    void build(const std::vector<Aabb>& bounds);
+    void refit(const std::vector<Aabb>& bounds);
+
+    // Returns false when a rebuild is already running or the tree is too small to bother.
+    bool beginPartialRebuild(const std::vector<Aabb>& bounds);
+    // Non-blocking unless wait is set. Returns true when a finished subtree was spliced in; it is
+    // refitted to bounds, since the objects may have moved while it was being built.
+    bool finishPartialRebuild(const std::vector<Aabb>& bounds, bool wait = false);
+    bool rebuilding() const { return worker.joinable(); }
+
+    // Appends every object whose box touches the frustum. Subtrees entirely inside are added
+    // without testing their objects.
+    void queryFrustum(const Frustum& frustum, std::vector<uint32_t>& out) const;
+    // Appends every object whose box overlaps region.
+    void queryAabb(const Aabb& region, std::vector<uint32_t>& out) const;
+    // Nearest object box hit by the ray within maxDistance (direction need not be normalised;
+    // distances are in units of its length). Returns -1 on a miss.
+    int64_t raycast(const float origin[3], const float direction[3], float maxDistance, float* hitDistance = nullptr) const;
+
+    // SAH cost of the tree normalised by the root's surface area; lower is better.
+    float cost() const;
+    size_t nodeCount() const { return nodes.size() - orphanedNodes; }
+    size_t objectCount() const { return primitives.size(); }
+    int depth() const;
+
+private:
+    Bvh(const Bvh&);
+    Bvh& operator=(const Bvh&);
+
+    // Leaves have count > 0 and cover primitives [first, first + count); inner nodes have
+    // count == 0 and children first and first + 1.
+    struct Node {
+        Aabb bounds;
+        uint32_t first;
+        uint32_t count;
+    };
+
+    // Output of a subtree build, node and primitive indices local to the subtree
+    struct Subtree {
+        std::vector<Node> nodes;
+        std::vector<uint32_t> primitives;
+    };
+
+    static void buildSubtree(const std::vector<Aabb>& bounds, Subtree& out);
+    void refitNode(uint32_t index);
+    // Unnormalised SAH cost; optionally reports the primitive range the subtree covers
+    float subtreeCost(uint32_t root, uint32_t* first, uint32_t* count) const;
+    void compact();
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> primitives;
+    std::vector<Aabb> primitiveBounds;  // object boxes in primitive order, for the leaf tests
+    size_t orphanedNodes;
+
+    // Partial rebuild in flight
+    std::thread worker;
+    std::atomic<bool> workerDone;
+    uint32_t rebuildNode;
+    uint32_t rebuildFirst;
+    Subtree rebuilt;
+    std::vector<Aabb> rebuildBounds;
+};
@@ -0,0 +1,133 @@
+#include "frame_pipeline.h"
+
+#include <iomanip>
+
+namespace {
+
+double elapsedMs(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+void printRow(std::ostream& out, const char* label, const FrameTimeHistogram& h) {
+    out << "  " << std::left << std::setw(16) << label << std::right
+        << std::setw(10) << h.percentile(50.0)
+        << std::setw(10) << h.percentile(99.0)
+        << std::setw(10) << h.max()
+        << std::setw(10) << h.mean() << "\n";
+}
+
+} // namespace
+
+const int FramePipeline::Depth;
+
+FramePipeline::FramePipeline()
+    : nextSequence(0), stopRequested(false) {
+    for (int i = 0; i < Depth; ++i) {
+        packets[i].sequence = 0;
+        packets[i].frameIndex = 0;
+        packets[i].variant = 0;
+        freePackets.push_back(&packets[i]);
+    }
+}
+
+FramePacket* FramePipeline::beginPacket() {
+    Clock::time_point start = Clock::now();
+    std::unique_lock<std::mutex> lock(mutex);
+    packetFree.wait(lock, [this]() { return stopRequested || !freePackets.empty(); });
+    if (stopRequested) {
+        return nullptr;
+    }
+    FramePacket* packet = freePackets.back();
+    freePackets.pop_back();
+    Clock::time_point now = Clock::now();
+    simulationWait.add(elapsedMs(start, now));
+    packet->sequence = nextSequence++;
+    packet->simulateStart = now;
+    return packet;
+}
+
+void FramePipeline::publish(FramePacket* packet) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        packet->published = Clock::now();
+        readyPackets.push_back(packet);
+    }
+    packetReady.notify_one();
+}
+
+FramePacket* FramePipeline::acquire() {
+    Clock::time_point start = Clock::now();
+    std::unique_lock<std::mutex> lock(mutex);
+    packetReady.wait(lock, [this]() { return stopRequested || !readyPackets.empty(); });
+    if (readyPackets.empty()) {
+        return nullptr;
+    }
+    FramePacket* packet = readyPackets.front();
+    readyPackets.pop_front();
+    Clock::time_point now = Clock::now();
+    renderWait.add(elapsedMs(start, now));
+    queued.add(elapsedMs(packet->published, now));
+    return packet;
+}
+
+void FramePipeline::release(FramePacket* packet) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        latency.add(elapsedMs(packet->simulateStart, Clock::now()));
+        freePackets.push_back(packet);
+    }
+    packetFree.notify_one();
+}
+
+void FramePipeline::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopRequested = true;
+    }
+    packetFree.notify_all();
+    packetReady.notify_all();
+}
+
+uint64_t FramePipeline::presented() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return latency.count();
+}
+
+void FramePipeline::reset() {
+    std::lock_guard<std::mutex> lock(mutex);
+    latency.reset();
+    queued.reset();
+    simulationWait.reset();
+    renderWait.reset();
+}
+
+void FramePipeline::printReport(std::ostream& out) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(3);
+
+    out << "Frame pipeline (depth " << Depth << ", " << latency.count() << " frames)\n";
+    out << "  " << std::left << std::setw(16) << "ms" << std::right
+        << std::setw(10) << "p50" << std::setw(10) << "p99" << std::setw(10) << "max" << std::setw(10) << "mean" << "\n";
+    printRow(out, "latency", latency);
+    printRow(out, "queued", queued);
+    printRow(out, "simulation wait", simulationWait);
+    printRow(out, "render wait", renderWait);
+
+    out.flags(flags);
+    out.precision(precision);
+}
+
+void FramePipeline::printJson(std::ostream& out) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    out << "{\"depth\": " << Depth << ", \"frames\": " << latency.count() << ", \"latency_ms\": ";
+    latency.printJson(out);
+    out << ", \"queued_ms\": ";
+    queued.printJson(out);
+    out << ", \"simulation_wait_ms\": ";
+    simulationWait.printJson(out);
+    out << ", \"render_wait_ms\": ";
+    renderWait.printJson(out);
+    out << "}";
+}
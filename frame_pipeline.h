@@ -0,0 +1,81 @@
+#pragma once
+
+#include "frame_stats.h"
+#include "shader_variants.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+// Everything the render side needs to draw one frame, computed by the simulation without any
+// GL calls. Once published, a packet is only read until the render side releases it.
+struct FramePacket {
+    uint64_t sequence;
+    unsigned frameIndex;                   // drives the animations
+    ShaderVariantSet::VariantKey variant;
+    std::vector<float> dynamicVertices;    // xyz triangles to stream this frame
+    std::vector<uint32_t> staticVisible;   // static meshes that survived culling
+    std::vector<uint8_t> staticLevels;     // their levels of detail, with --lod
+    std::chrono::steady_clock::time_point simulateStart;
+    std::chrono::steady_clock::time_point published;
+};
+
+// Hands frame packets from a simulation thread to the render thread that owns the GL context.
+//
+// Depth packets circulate. The simulation fills a free one and publishes it; the render thread
+// takes published packets in order and releases each once its frame has been presented. With a
+// depth of 2 the simulation builds frame N+1 while frame N is submitted, and blocks instead of
+// running further ahead, which bounds the simulate-to-present latency to about two frames.
+//
+// Latency is measured per packet: from the start of its simulation to its release, the time it
+// sat published before the render thread picked it up, and how long each side waited.
+class FramePipeline {
+public:
+    static const int Depth = 2;
+
+    FramePipeline();
+
+    // Simulation side. Blocks until a packet is free; returns nullptr once stopped.
+    // The packet keeps whatever the last frame left in it, so its vectors can be reused.
+    FramePacket* beginPacket();
+    void publish(FramePacket* packet);
+
+    // Render side. Blocks until a packet is published; returns nullptr once stopped and drained.
+    FramePacket* acquire();
+    void release(FramePacket* packet);
+
+    // Wakes both sides. Packets already published are still handed out.
+    void stop();
+
+    uint64_t presented() const;
+    void reset();
+
+    // Latency percentile table
+    void printReport(std::ostream& out) const;
+    // {"depth": 2, "frames": .., "latency_ms": {..}, "queued_ms": {..}, "simulation_wait_ms": {..}, "render_wait_ms": {..}}
+    void printJson(std::ostream& out) const;
+
+private:
+    FramePipeline(const FramePipeline&);
+    FramePipeline& operator=(const FramePipeline&);
+
+    typedef std::chrono::steady_clock Clock;
+
+    mutable std::mutex mutex;
+    std::condition_variable packetFree;
+    std::condition_variable packetReady;
+    FramePacket packets[Depth];
+    std::vector<FramePacket*> freePackets;
+    std::deque<FramePacket*> readyPackets;
+    uint64_t nextSequence;
+    bool stopRequested;
+
+    FrameTimeHistogram latency;         // simulation start -> release
+    FrameTimeHistogram queued;          // publish -> acquire
+    FrameTimeHistogram simulationWait;  // beginPacket() blocked on a free packet
+    FrameTimeHistogram renderWait;      // acquire() blocked on a published packet
+};
@@ -0,0 +1,226 @@
+#include "frame_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <string>
+
+namespace {
+
+const int PhaseCount = static_cast<int>(FramePhase::Count);
+
+double elapsedMs(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+void printPercentileRow(std::ostream& out, const char* label, const FrameTimeHistogram& h) {
+    out << "  " << std::left << std::setw(8) << label << std::right
+        << std::setw(10) << h.percentile(50.0)
+        << std::setw(10) << h.percentile(95.0)
+        << std::setw(10) << h.percentile(99.0)
+        << std::setw(10) << h.max()
+        << std::setw(10) << h.mean() << "\n";
+}
+
+} // namespace
+
+const char* framePhaseName(FramePhase phase) {
+    switch (phase) {
+    case FramePhase::Scene: return "scene";
+    case FramePhase::Clear: return "clear";
+    case FramePhase::Draw:  return "draw";
+    case FramePhase::Swap:  return "swap";
+    case FramePhase::Poll:  return "poll";
+    default:                return "?";
+    }
+}
+
+// ---- FrameTimeHistogram ----
+
+FrameTimeHistogram::FrameTimeHistogram() {
+    reset();
+}
+
+void FrameTimeHistogram::reset() {
+    std::memset(buckets, 0, sizeof(buckets));
+    total = 0;
+    sumMs = 0.0;
+    maxMs = 0.0;
+}
+
+int FrameTimeHistogram::bucketIndex(double ms) {
+    double us = ms * 1000.0;
+    if (!(us >= 1.0)) {
+        return 0;
+    }
+    int exponent;
+    double mantissa = std::frexp(us, &exponent); // us = mantissa * 2^exponent, mantissa in [0.5, 1)
+    int octave = exponent - 1;
+    if (octave >= Octaves) {
+        return BucketCount - 1;
+    }
+    int sub = static_cast<int>((mantissa * 2.0 - 1.0) * SubBuckets);
+    return octave * SubBuckets + std::min(sub, SubBuckets - 1);
+}
+
+double FrameTimeHistogram::bucketLowerMs(int index) {
+    int octave = index / SubBuckets;
+    int sub = index % SubBuckets;
+    return std::ldexp(1.0 + static_cast<double>(sub) / SubBuckets, octave) / 1000.0;
+}
+
+void FrameTimeHistogram::add(double ms) {
+    ++buckets[bucketIndex(ms)];
+    ++total;
+    sumMs += ms;
+    maxMs = std::max(maxMs, ms);
+}
+
+double FrameTimeHistogram::mean() const {
+    return total ? sumMs / static_cast<double>(total) : 0.0;
+}
+
+double FrameTimeHistogram::percentile(double p) const {
+    if (total == 0) {
+        return 0.0;
+    }
+    uint64_t rank = static_cast<uint64_t>(std::ceil(p / 100.0 * static_cast<double>(total)));
+    rank = std::max<uint64_t>(rank, 1);
+    uint64_t seen = 0;
+    for (int i = 0; i < BucketCount; ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            double mid = 0.5 * (bucketLowerMs(i) + bucketLowerMs(i + 1));
+            return std::min(mid, maxMs);
+        }
+    }
+    return maxMs;
+}
+
+void FrameTimeHistogram::print(std::ostream& out) const {
+    uint64_t octaveCounts[Octaves] = {};
+    uint64_t largest = 0;
+    for (int o = 0; o < Octaves; ++o) {
+        for (int s = 0; s < SubBuckets; ++s) {
+            octaveCounts[o] += buckets[o * SubBuckets + s];
+        }
+        largest = std::max(largest, octaveCounts[o]);
+    }
+    if (largest == 0) {
+        out << "  (no samples)\n";
+        return;
+    }
+
+    const int barWidth = 50;
+    for (int o = 0; o < Octaves; ++o) {
+        if (octaveCounts[o] == 0) {
+            continue;
+        }
+        double lo = o == 0 ? 0.0 : bucketLowerMs(o * SubBuckets);
+        double hi = bucketLowerMs((o + 1) * SubBuckets);
+        int bar = static_cast<int>(static_cast<double>(octaveCounts[o]) * barWidth / static_cast<double>(largest));
+        out << "  [" << std::setw(9) << lo << ", " << std::setw(9) << hi << ") ms "
+            << std::setw(9) << octaveCounts[o] << " "
+            << std::setw(6) << 100.0 * static_cast<double>(octaveCounts[o]) / static_cast<double>(total) << "% "
+            << std::string(std::max(bar, 1), '#') << "\n";
+    }
+}
+
+void FrameTimeHistogram::printJson(std::ostream& out) const {
+    out << "{\"p50\": " << percentile(50.0)
+        << ", \"p95\": " << percentile(95.0)
+        << ", \"p99\": " << percentile(99.0)
+        << ", \"max\": " << max()
+        << ", \"mean\": " << mean() << "}";
+}
+
+// ---- FrameRecorder ----
+
+FrameRecorder::FrameRecorder(size_t ringCapacity)
+    : ring(ringCapacity), dropped(0) {
+    std::memset(&current, 0, sizeof(current));
+}
+
+void FrameRecorder::beginFrame() {
+    std::memset(&current, 0, sizeof(current));
+    frameStart = Clock::now();
+    lastMark = frameStart;
+}
+
+void FrameRecorder::endPhase(FramePhase phase) {
+    Clock::time_point now = Clock::now();
+    current.phaseMs[static_cast<int>(phase)] += static_cast<float>(elapsedMs(lastMark, now));
+    lastMark = now;
+}
+
+void FrameRecorder::endFrame() {
+    current.totalMs = static_cast<float>(elapsedMs(frameStart, Clock::now()));
+    if (!ring.push(current)) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void FrameRecorder::collect() {
+    FrameSample sample;
+    while (ring.pop(sample)) {
+        totalHistogram.add(sample.totalMs);
+        intervalHistogram.add(sample.totalMs);
+        for (int i = 0; i < PhaseCount; ++i) {
+            phaseHistograms[i].add(sample.phaseMs[i]);
+        }
+    }
+}
+
+void FrameRecorder::reset() {
+    totalHistogram.reset();
+    intervalHistogram.reset();
+    for (int i = 0; i < PhaseCount; ++i) {
+        phaseHistograms[i].reset();
+    }
+    dropped.store(0, std::memory_order_relaxed);
+}
+
+void FrameRecorder::printReport(std::ostream& out) const {
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(3);
+
+    out << "Frame time report (" << totalHistogram.count() << " frames";
+    if (droppedSamples() > 0) {
+        out << ", " << droppedSamples() << " samples dropped";
+    }
+    out << ")\n";
+    out << "  " << std::left << std::setw(8) << "ms" << std::right
+        << std::setw(10) << "p50" << std::setw(10) << "p95" << std::setw(10) << "p99"
+        << std::setw(10) << "max" << std::setw(10) << "mean" << "\n";
+    printPercentileRow(out, "frame", totalHistogram);
+    for (int i = 0; i < PhaseCount; ++i) {
+        printPercentileRow(out, framePhaseName(static_cast<FramePhase>(i)), phaseHistograms[i]);
+    }
+    out << "Frame time histogram:\n";
+    totalHistogram.print(out);
+
+    out.flags(flags);
+    out.precision(precision);
+}
+
+void FrameRecorder::printJson(std::ostream& out) const {
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(4);
+
+    out << "{\"frames\": " << totalHistogram.count()
+        << ", \"dropped\": " << droppedSamples()
+        << ", \"frame_ms\": ";
+    totalHistogram.printJson(out);
+    out << ", \"phase_ms\": {";
+    for (int i = 0; i < PhaseCount; ++i) {
+        out << (i ? ", " : "") << "\"" << framePhaseName(static_cast<FramePhase>(i)) << "\": ";
+        phaseHistograms[i].printJson(out);
+    }
+    out << "}}";
+
+    out.flags(flags);
+    out.precision(precision);
+}
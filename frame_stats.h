@@ -0,0 +1,107 @@
+#pragma once
+
+#include "spsc_ring.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+// Phases of the render loop that are timed separately.
+enum class FramePhase {
+    Scene,  // simulating the frame, or waiting for the simulation thread's packet
+    Clear,
+    Draw,
+    Swap,
+    Poll,
+    Count
+};
+
+const char* framePhaseName(FramePhase phase);
+
+// CPU time of one frame, in milliseconds.
+struct FrameSample {
+    float totalMs;
+    float phaseMs[static_cast<int>(FramePhase::Count)];
+};
+
+// Log-bucketed histogram of frame times.
+// Every power of two (in microseconds) is split into SubBuckets linear buckets,
+// so percentiles are accurate to within 1/SubBuckets of the value.
+class FrameTimeHistogram {
+public:
+    static const int SubBuckets = 8;
+    static const int Octaves = 24; // 1 us .. ~16 s
+    static const int BucketCount = SubBuckets * Octaves;
+
+    FrameTimeHistogram();
+
+    void add(double ms);
+    void reset();
+
+    uint64_t count() const { return total; }
+    double mean() const;
+    double max() const { return maxMs; }
+    // p in [0, 100]. Returns the midpoint of the bucket holding the p-th percentile.
+    double percentile(double p) const;
+
+    // Prints one row per non-empty octave with an ASCII bar.
+    void print(std::ostream& out) const;
+    // {"p50": .., "p95": .., "p99": .., "max": .., "mean": ..}
+    void printJson(std::ostream& out) const;
+
+private:
+    static int bucketIndex(double ms);
+    static double bucketLowerMs(int index);
+
+    uint64_t buckets[BucketCount];
+    uint64_t total;
+    double sumMs;
+    double maxMs;
+};
+
+// Records per-frame CPU timings on the render thread and aggregates them on the reporting side.
+//
+// beginFrame()/endPhase()/endFrame() are called by the render loop; they only read the clock
+// and push a fixed-size sample into a lock-free ring. collect() drains the ring into the
+// histograms and may run on another thread (or the same one, once in a while).
+class FrameRecorder {
+public:
+    explicit FrameRecorder(size_t ringCapacity = 1 << 16);
+
+    void beginFrame();
+    // Attributes the time since the previous mark to the given phase.
+    void endPhase(FramePhase phase);
+    void endFrame();
+
+    // Drains pending samples into the run-wide and interval histograms.
+    void collect();
+
+    // Stats since startup (or the last reset()).
+    const FrameTimeHistogram& total() const { return totalHistogram; }
+    const FrameTimeHistogram& phase(FramePhase p) const { return phaseHistograms[static_cast<int>(p)]; }
+    // Stats since the last resetInterval(); used for the window title.
+    const FrameTimeHistogram& interval() const { return intervalHistogram; }
+    void resetInterval() { intervalHistogram.reset(); }
+
+    void reset();
+    uint64_t droppedSamples() const { return dropped.load(std::memory_order_relaxed); }
+
+    // Percentile table for the frame and each phase, followed by the frame-time histogram.
+    void printReport(std::ostream& out) const;
+    // Same data as a JSON object, for perf jobs that parse the output.
+    void printJson(std::ostream& out) const;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    SpscRing<FrameSample> ring;
+    FrameSample current;
+    Clock::time_point frameStart;
+    Clock::time_point lastMark;
+    std::atomic<uint64_t> dropped;
+
+    FrameTimeHistogram totalHistogram;
+    FrameTimeHistogram phaseHistograms[static_cast<int>(FramePhase::Count)];
+    FrameTimeHistogram intervalHistogram;
+};
@@ -0,0 +1,281 @@
+#include "frustum_culler.h"
+
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRUSTUM_CULLER_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#endif
+
+// Lets the AVX2 path live next to the others without building the whole file for AVX2
+#if defined(FRUSTUM_CULLER_X86) && (defined(__GNUC__) || defined(__clang__))
+#define FRUSTUM_CULLER_AVX2_TARGET __attribute__((target("avx2")))
+#else
+#define FRUSTUM_CULLER_AVX2_TARGET
+#endif
+
+namespace {
+
+void normalizePlane(float* plane) {
+    float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+    if (length > 0.0f) {
+        for (int i = 0; i < 4; ++i) {
+            plane[i] /= length;
+        }
+    }
+}
+
+void setPlane(float* plane, float x, float y, float z, float w) {
+    plane[0] = x;
+    plane[1] = y;
+    plane[2] = z;
+    plane[3] = w;
+}
+
+} // namespace
+
+// ---- Frustum ----
+
+Frustum Frustum::fromMatrix(const float* m) {
+    // Gribb/Hartmann: each plane is the last row of the matrix plus or minus one of the others
+    Frustum frustum;
+    for (int i = 0; i < 3; ++i) {
+        for (int side = 0; side < 2; ++side) {
+            float sign = side == 0 ? 1.0f : -1.0f;
+            float* plane = frustum.planes[i * 2 + side];
+            for (int c = 0; c < 4; ++c) {
+                plane[c] = m[c * 4 + 3] + sign * m[c * 4 + i];
+            }
+            normalizePlane(plane);
+        }
+    }
+    return frustum;
+}
+
+Frustum Frustum::orthographic(float left, float right, float bottom, float top, float zNear, float zFar) {
+    // Looking down -z, like glOrtho
+    Frustum frustum;
+    setPlane(frustum.planes[0], 1.0f, 0.0f, 0.0f, -left);
+    setPlane(frustum.planes[1], -1.0f, 0.0f, 0.0f, right);
+    setPlane(frustum.planes[2], 0.0f, 1.0f, 0.0f, -bottom);
+    setPlane(frustum.planes[3], 0.0f, -1.0f, 0.0f, top);
+    setPlane(frustum.planes[4], 0.0f, 0.0f, -1.0f, -zNear);
+    setPlane(frustum.planes[5], 0.0f, 0.0f, 1.0f, zFar);
+    return frustum;
+}
+
+// ---- FrustumCuller ----
+
+FrustumCuller::FrustumCuller()
+    : activePath(bestPath()) {
+}
+
+uint32_t FrustumCuller::add(const float center[3], const float extents[3]) {
+    uint32_t index = static_cast<uint32_t>(centerX.size());
+    centerX.push_back(0.0f);
+    centerY.push_back(0.0f);
+    centerZ.push_back(0.0f);
+    extentX.push_back(0.0f);
+    extentY.push_back(0.0f);
+    extentZ.push_back(0.0f);
+    radius.push_back(0.0f);
+    set(index, center, extents);
+    return index;
+}
+
+void FrustumCuller::set(uint32_t index, const float center[3], const float extents[3]) {
+    centerX[index] = center[0];
+    centerY[index] = center[1];
+    centerZ[index] = center[2];
+    extentX[index] = extents[0];
+    extentY[index] = extents[1];
+    extentZ[index] = extents[2];
+    radius[index] = std::sqrt(extents[0] * extents[0] + extents[1] * extents[1] + extents[2] * extents[2]);
+}
+
+void FrustumCuller::clear() {
+    centerX.clear();
+    centerY.clear();
+    centerZ.clear();
+    extentX.clear();
+    extentY.clear();
+    extentZ.clear();
+    radius.clear();
+}
+
+FrustumCuller::Path FrustumCuller::bestPath() {
+#ifdef FRUSTUM_CULLER_X86
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] >= 7) {
+        __cpuid(info, 1);
+        bool osSavesYmm = (info[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6;
+        __cpuidex(info, 7, 0);
+        if (osSavesYmm && (info[1] & (1 << 5))) {
+            return Path::Avx2;
+        }
+    }
+#else
+    if (__builtin_cpu_supports("avx2")) {
+        return Path::Avx2;
+    }
+#endif
+    return Path::Sse;
+#else
+    return Path::Scalar;
+#endif
+}
+
+void FrustumCuller::setPath(Path requested) {
+    Path best = bestPath();
+    activePath = static_cast<int>(requested) <= static_cast<int>(best) ? requested : best;
+}
+
+const char* FrustumCuller::pathName(Path path) {
+    switch (path) {
+    case Path::Scalar: return "scalar";
+    case Path::Sse:    return "sse";
+    case Path::Avx2:   return "avx2";
+    default:           return "?";
+    }
+}
+
+size_t FrustumCuller::cull(const Frustum& frustum, std::vector<uint32_t>& visible, Test test) const {
+    // SIMD groups write every lane before advancing, so leave room for one group past the end
+    visible.resize(size() + 8);
+    size_t count;
+    switch (activePath) {
+    case Path::Avx2:
+        count = cullAvx2(frustum, visible.data(), test);
+        break;
+    case Path::Sse:
+        count = cullSse(frustum, visible.data(), test);
+        break;
+    default:
+        count = cullScalar(frustum, 0, visible.data(), test);
+        break;
+    }
+    visible.resize(count);
+    return count;
+}
+
+size_t FrustumCuller::cullScalar(const Frustum& frustum, size_t begin, uint32_t* out, Test test) const {
+    size_t count = 0;
+    for (size_t i = begin; i < size(); ++i) {
+        bool inside = true;
+        for (int p = 0; p < 6 && inside; ++p) {
+            const float* plane = frustum.planes[p];
+            float distance = plane[0] * centerX[i] + plane[1] * centerY[i] + plane[2] * centerZ[i] + plane[3];
+            float reach = test == Test::Box
+                ? std::fabs(plane[0]) * extentX[i] + std::fabs(plane[1]) * extentY[i] + std::fabs(plane[2]) * extentZ[i]
+                : radius[i];
+            inside = distance + reach >= 0.0f;
+        }
+        if (inside) {
+            out[count++] = static_cast<uint32_t>(i);
+        }
+    }
+    return count;
+}
+
+#ifdef FRUSTUM_CULLER_X86
+
+size_t FrustumCuller::cullSse(const Frustum& frustum, uint32_t* out, Test test) const {
+    __m128 nx[6], ny[6], nz[6], nw[6], ax[6], ay[6], az[6];
+    for (int p = 0; p < 6; ++p) {
+        const float* plane = frustum.planes[p];
+        nx[p] = _mm_set1_ps(plane[0]);
+        ny[p] = _mm_set1_ps(plane[1]);
+        nz[p] = _mm_set1_ps(plane[2]);
+        nw[p] = _mm_set1_ps(plane[3]);
+        ax[p] = _mm_set1_ps(std::fabs(plane[0]));
+        ay[p] = _mm_set1_ps(std::fabs(plane[1]));
+        az[p] = _mm_set1_ps(std::fabs(plane[2]));
+    }
+    const __m128 zero = _mm_setzero_ps();
+    bool box = test == Test::Box;
+    size_t groups = size() & ~static_cast<size_t>(3);
+    size_t count = 0;
+    for (size_t i = 0; i < groups; i += 4) {
+        __m128 cx = _mm_loadu_ps(&centerX[i]);
+        __m128 cy = _mm_loadu_ps(&centerY[i]);
+        __m128 cz = _mm_loadu_ps(&centerZ[i]);
+        __m128 ex = box ? _mm_loadu_ps(&extentX[i]) : zero;
+        __m128 ey = box ? _mm_loadu_ps(&extentY[i]) : zero;
+        __m128 ez = box ? _mm_loadu_ps(&extentZ[i]) : zero;
+        __m128 r = box ? zero : _mm_loadu_ps(&radius[i]);
+        __m128 inside = _mm_cmpeq_ps(zero, zero);
+        for (int p = 0; p < 6; ++p) {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx[p], cx), _mm_mul_ps(ny[p], cy)),
+                                         _mm_add_ps(_mm_mul_ps(nz[p], cz), nw[p]));
+            __m128 reach = box ? _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax[p], ex), _mm_mul_ps(ay[p], ey)), _mm_mul_ps(az[p], ez))
+                               : r;
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, reach), zero));
+        }
+        int mask = _mm_movemask_ps(inside);
+        for (int lane = 0; lane < 4; ++lane) {
+            out[count] = static_cast<uint32_t>(i + lane);
+            count += (mask >> lane) & 1;
+        }
+    }
+    return count + cullScalar(frustum, groups, out + count, test);
+}
+
+FRUSTUM_CULLER_AVX2_TARGET
+size_t FrustumCuller::cullAvx2(const Frustum& frustum, uint32_t* out, Test test) const {
+    __m256 nx[6], ny[6], nz[6], nw[6], ax[6], ay[6], az[6];
+    for (int p = 0; p < 6; ++p) {
+        const float* plane = frustum.planes[p];
+        nx[p] = _mm256_set1_ps(plane[0]);
+        ny[p] = _mm256_set1_ps(plane[1]);
+        nz[p] = _mm256_set1_ps(plane[2]);
+        nw[p] = _mm256_set1_ps(plane[3]);
+        ax[p] = _mm256_set1_ps(std::fabs(plane[0]));
+        ay[p] = _mm256_set1_ps(std::fabs(plane[1]));
+        az[p] = _mm256_set1_ps(std::fabs(plane[2]));
+    }
+    const __m256 zero = _mm256_setzero_ps();
+    bool box = test == Test::Box;
+    size_t groups = size() & ~static_cast<size_t>(7);
+    size_t count = 0;
+    for (size_t i = 0; i < groups; i += 8) {
+        __m256 cx = _mm256_loadu_ps(&centerX[i]);
+        __m256 cy = _mm256_loadu_ps(&centerY[i]);
+        __m256 cz = _mm256_loadu_ps(&centerZ[i]);
+        __m256 ex = box ? _mm256_loadu_ps(&extentX[i]) : zero;
+        __m256 ey = box ? _mm256_loadu_ps(&extentY[i]) : zero;
+        __m256 ez = box ? _mm256_loadu_ps(&extentZ[i]) : zero;
+        __m256 r = box ? zero : _mm256_loadu_ps(&radius[i]);
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; ++p) {
+            __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx[p], cx), _mm256_mul_ps(ny[p], cy)),
+                                            _mm256_add_ps(_mm256_mul_ps(nz[p], cz), nw[p]));
+            __m256 reach = box ? _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax[p], ex), _mm256_mul_ps(ay[p], ey)),
+                                               _mm256_mul_ps(az[p], ez))
+                               : r;
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, reach), zero, _CMP_GE_OQ));
+        }
+        int mask = _mm256_movemask_ps(inside);
+        for (int lane = 0; lane < 8; ++lane) {
+            out[count] = static_cast<uint32_t>(i + lane);
+            count += (mask >> lane) & 1;
+        }
+    }
+    return count + cullScalar(frustum, groups, out + count, test);
+}
+
+#else
+
+size_t FrustumCuller::cullSse(const Frustum& frustum, uint32_t* out, Test test) const {
+    return cullScalar(frustum, 0, out, test);
+}
+
+size_t FrustumCuller::cullAvx2(const Frustum& frustum, uint32_t* out, Test test) const {
+    return cullScalar(frustum, 0, out, test);
+}
+
+#endif
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Six planes with normals pointing inwards. A point p is inside when
+// dot(plane.xyz, p) + plane.w >= 0 for every plane.
+struct Frustum {
+    float planes[6][4];
+
+    // Planes of a column-major view-projection matrix with OpenGL clip space (-w <= z <= w),
+    // normalised so plane distances are in world units.
+    static Frustum fromMatrix(const float* viewProjection);
+    static Frustum orthographic(float left, float right, float bottom, float top, float zNear, float zFar);
+};
+
+// Frustum culling over a structure-of-arrays of bounding boxes.
+//
+// Every object is an axis-aligned box stored as centre and half extents, one array per component,
+// plus the radius of its bounding sphere. cull() tests 8 objects at a time with AVX2, 4 with SSE
+// or one with plain C++, whichever the CPU supports, and writes the indices of the objects that
+// intersect the frustum to a compact list. The SIMD paths write all lanes and only advance the
+// output by the lanes that passed, so there is no branch per object.
+class FrustumCuller {
+public:
+    enum class Path {
+        Scalar,
+        Sse,
+        Avx2
+    };
+
+    enum class Test {
+        Sphere,  // cheaper, looser
+        Box      // centre/extent box against each plane
+    };
+
+    FrustumCuller();
+
+    // Returns the object's index, which is what cull() reports.
+    uint32_t add(const float center[3], const float extents[3]);
+    void set(uint32_t index, const float center[3], const float extents[3]);
+    void clear();
+    size_t size() const { return centerX.size(); }
+
+    // Replaces visible with the indices of the objects touching the frustum, in ascending order.
+    // Returns their count.
+    size_t cull(const Frustum& frustum, std::vector<uint32_t>& visible, Test test = Test::Box) const;
+
+    // Defaults to bestPath(); requests for a path the CPU lacks fall back to the best one it has.
+    void setPath(Path requested);
+    Path path() const { return activePath; }
+    static Path bestPath();
+    static const char* pathName(Path path);
+
+private:
+    size_t cullScalar(const Frustum& frustum, size_t begin, uint32_t* out, Test test) const;
+    size_t cullSse(const Frustum& frustum, uint32_t* out, Test test) const;
+    size_t cullAvx2(const Frustum& frustum, uint32_t* out, Test test) const;
+
+    std::vector<float> centerX;
+    std::vector<float> centerY;
+    std::vector<float> centerZ;
+    std::vector<float> extentX;
+    std::vector<float> extentY;
+    std::vector<float> extentZ;
+    std::vector<float> radius;
+    Path activePath;
+};
@@ -0,0 +1,211 @@
+#include "gl_state.h"
+
+#include <cstring>
+
+namespace {
+
+// Cached value that matches nothing GL can hold
+const GLuint Unknown = 0xFFFFFFFFu;
+
+const char* const KindNames[] = { "program", "vertex_array", "buffer", "texture", "capability", "fixed_function", "uniform" };
+
+} // namespace
+
+const int GlStateCache::MaxTextureUnits;
+
+GlStateCache::GlStateCache(bool enabled)
+    : enabled(enabled) {
+    reset();
+    beginFrame();
+}
+
+void GlStateCache::reset() {
+    program = Unknown;
+    vertexArray = Unknown;
+    arrayBuffer = Unknown;
+    elementBuffer = Unknown;
+    uniformBuffer = Unknown;
+    activeUnit = Unknown;
+    for (int i = 0; i < MaxTextureUnits; ++i) {
+        textures2D[i] = Unknown;
+        texturesCube[i] = Unknown;
+    }
+    for (int i = 0; i < 3; ++i) {
+        capabilities[i] = Unknown;
+    }
+    blendSource = Unknown;
+    blendDestination = Unknown;
+    depthFunction = Unknown;
+    depthWrite = Unknown;
+    culledFace = Unknown;
+    uniforms.clear();
+}
+
+bool GlStateCache::changed(Kind kind, GLuint& cached, GLuint value) {
+    bool issue = !enabled || cached != value;
+    cached = value;
+    count(kind, issue);
+    return issue;
+}
+
+void GlStateCache::useProgram(GLuint name) {
+    if (changed(Kind::Program, program, name)) {
+        glUseProgram(name);
+    }
+}
+
+void GlStateCache::bindVertexArray(GLuint vao) {
+    if (changed(Kind::VertexArray, vertexArray, vao)) {
+        glBindVertexArray(vao);
+        elementBuffer = Unknown;
+    }
+}
+
+void GlStateCache::bindBuffer(GLenum target, GLuint buffer) {
+    GLuint* cached = target == GL_ARRAY_BUFFER ? &arrayBuffer
+                   : target == GL_ELEMENT_ARRAY_BUFFER ? &elementBuffer
+                   : target == GL_UNIFORM_BUFFER ? &uniformBuffer : nullptr;
+    if (!cached) {
+        count(Kind::Buffer, true);
+        glBindBuffer(target, buffer);
+    } else if (changed(Kind::Buffer, *cached, buffer)) {
+        glBindBuffer(target, buffer);
+    }
+}
+
+void GlStateCache::bindTexture(unsigned unit, GLenum target, GLuint texture) {
+    GLuint* cached = nullptr;
+    if (unit < static_cast<unsigned>(MaxTextureUnits)) {
+        cached = target == GL_TEXTURE_2D ? &textures2D[unit] : target == GL_TEXTURE_CUBE_MAP ? &texturesCube[unit] : nullptr;
+    }
+    if (cached && enabled && *cached == texture) {
+        count(Kind::Texture, false);
+        return;
+    }
+    // Switching units is part of the bind, so it is counted with it
+    if (!enabled || activeUnit != unit) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        activeUnit = unit;
+    }
+    glBindTexture(target, texture);
+    if (cached) {
+        *cached = texture;
+    }
+    count(Kind::Texture, true);
+}
+
+int GlStateCache::capabilityIndex(GLenum capability) {
+    switch (capability) {
+    case GL_BLEND:
+        return 0;
+    case GL_DEPTH_TEST:
+        return 1;
+    case GL_CULL_FACE:
+        return 2;
+    default:
+        return -1;
+    }
+}
+
+void GlStateCache::setCapability(GLenum capability, bool on) {
+    int index = capabilityIndex(capability);
+    if (index < 0 || changed(Kind::Capability, capabilities[index], on ? 1u : 0u)) {
+        if (index < 0) {
+            count(Kind::Capability, true);
+        }
+        if (on) {
+            glEnable(capability);
+        } else {
+            glDisable(capability);
+        }
+    }
+}
+
+void GlStateCache::blendFunc(GLenum source, GLenum destination) {
+    bool issue = !enabled || blendSource != source || blendDestination != destination;
+    blendSource = source;
+    blendDestination = destination;
+    count(Kind::FixedFunction, issue);
+    if (issue) {
+        glBlendFunc(source, destination);
+    }
+}
+
+void GlStateCache::depthFunc(GLenum function) {
+    if (changed(Kind::FixedFunction, depthFunction, function)) {
+        glDepthFunc(function);
+    }
+}
+
+void GlStateCache::depthMask(GLboolean mask) {
+    if (changed(Kind::FixedFunction, depthWrite, mask)) {
+        glDepthMask(mask);
+    }
+}
+
+void GlStateCache::cullFace(GLenum face) {
+    if (changed(Kind::FixedFunction, culledFace, face)) {
+        glCullFace(face);
+    }
+}
+
+bool GlStateCache::uniformChanged(GLint location, float x, float y, float z, float w) {
+    // A location has one type, so 1f values are stored with zeroes in yzw
+    UniformValue value = { { x, y, z, w } };
+    bool issue = true;
+    if (enabled && program != Unknown) {
+        uint64_t key = (static_cast<uint64_t>(program) << 32) | static_cast<uint32_t>(location);
+        std::unordered_map<uint64_t, UniformValue>::iterator it = uniforms.find(key);
+        if (it == uniforms.end()) {
+            uniforms[key] = value;
+        } else if (std::memcmp(it->second.v, value.v, sizeof(value.v)) == 0) {
+            issue = false;
+        } else {
+            it->second = value;
+        }
+    }
+    count(Kind::Uniform, issue);
+    return issue;
+}
+
+void GlStateCache::uniform1f(GLint location, float x) {
+    if (location >= 0 && uniformChanged(location, x, 0.0f, 0.0f, 0.0f)) {
+        glUniform1f(location, x);
+    }
+}
+
+void GlStateCache::uniform4f(GLint location, float x, float y, float z, float w) {
+    if (location >= 0 && uniformChanged(location, x, y, z, w)) {
+        glUniform4f(location, x, y, z, w);
+    }
+}
+
+void GlStateCache::beginFrame() {
+    std::memset(counts, 0, sizeof(counts));
+}
+
+uint64_t GlStateCache::issuedTotal() const {
+    uint64_t total = 0;
+    for (int i = 0; i < static_cast<int>(Kind::Count); ++i) {
+        total += counts[i][0];
+    }
+    return total;
+}
+
+uint64_t GlStateCache::elidedTotal() const {
+    uint64_t total = 0;
+    for (int i = 0; i < static_cast<int>(Kind::Count); ++i) {
+        total += counts[i][1];
+    }
+    return total;
+}
+
+void GlStateCache::printJson(std::ostream& out) const {
+    out << "{\"enabled\": " << (enabled ? "true" : "false")
+        << ", \"issued\": " << issuedTotal()
+        << ", \"elided\": " << elidedTotal();
+    for (int i = 0; i < static_cast<int>(Kind::Count); ++i) {
+        out << ", \"" << KindNames[i] << "\": {\"issued\": " << counts[i][0] << ", \"elided\": " << counts[i][1] << "}";
+    }
+    out << "}";
+}
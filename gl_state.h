@@ -0,0 +1,97 @@
+#pragma once
+
+#include "glad/gl_core_33.h"
+
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+
+// Shadow copy of the GL state the demo touches, so calls that wouldn't change anything are
+// skipped instead of going through the driver.
+//
+// Every bind, enable and uniform upload that goes through the cache is compared with the last
+// value it saw; only differences reach GL. After GL state changes behind its back (other code,
+// a program deleted and its name reused) call reset(), which marks everything unknown so the
+// next call of each kind is issued. Issued and elided calls are counted per kind and frame.
+class GlStateCache {
+public:
+    static const int MaxTextureUnits = 16;
+
+    enum class Kind {
+        Program,
+        VertexArray,
+        Buffer,
+        Texture,
+        Capability,  // glEnable/glDisable
+        FixedFunction, // blend, depth and cull settings
+        Uniform,
+        Count
+    };
+
+    // disabled passes every call through (still counting), for A/B comparisons.
+    explicit GlStateCache(bool enabled = true);
+
+    void setEnabled(bool on) { enabled = on; reset(); }
+    bool isEnabled() const { return enabled; }
+    void reset();
+
+    void useProgram(GLuint program);
+    // Also forgets the element array binding, which belongs to the VAO.
+    void bindVertexArray(GLuint vao);
+    // GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER and GL_UNIFORM_BUFFER are cached; others pass through.
+    void bindBuffer(GLenum target, GLuint buffer);
+    // GL_TEXTURE_2D and GL_TEXTURE_CUBE_MAP are cached per unit; selects the unit as needed.
+    void bindTexture(unsigned unit, GLenum target, GLuint texture);
+    // GL_BLEND, GL_DEPTH_TEST and GL_CULL_FACE are cached; others pass through.
+    void setCapability(GLenum capability, bool on);
+    void blendFunc(GLenum source, GLenum destination);
+    void depthFunc(GLenum function);
+    void depthMask(GLboolean mask);
+    void cullFace(GLenum face);
+
+    // Uniforms of the current program, remembered per (program, location).
+    void uniform1f(GLint location, float x);
+    void uniform4f(GLint location, float x, float y, float z, float w);
+
+    // Starts a new frame of counters.
+    void beginFrame();
+    uint64_t issued(Kind kind) const { return counts[static_cast<int>(kind)][0]; }
+    uint64_t elided(Kind kind) const { return counts[static_cast<int>(kind)][1]; }
+    uint64_t issuedTotal() const;
+    uint64_t elidedTotal() const;
+
+    // {"enabled": .., "issued": .., "elided": .., "program": {"issued": .., "elided": ..}, ...}
+    void printJson(std::ostream& out) const;
+
+private:
+    GlStateCache(const GlStateCache&);
+    GlStateCache& operator=(const GlStateCache&);
+
+    // Returns true (and records the new value) when the call has to be issued
+    bool changed(Kind kind, GLuint& cached, GLuint value);
+    void count(Kind kind, bool issuedCall) { ++counts[static_cast<int>(kind)][issuedCall ? 0 : 1]; }
+    static int capabilityIndex(GLenum capability);
+    bool uniformChanged(GLint location, float x, float y, float z, float w);
+
+    struct UniformValue {
+        float v[4];
+    };
+
+    bool enabled;
+    GLuint program;
+    GLuint vertexArray;
+    GLuint arrayBuffer;
+    GLuint elementBuffer;
+    GLuint uniformBuffer;
+    GLuint activeUnit;
+    GLuint textures2D[MaxTextureUnits];
+    GLuint texturesCube[MaxTextureUnits];
+    GLuint capabilities[3];
+    GLuint blendSource;
+    GLuint blendDestination;
+    GLuint depthFunction;
+    GLuint depthWrite;
+    GLuint culledFace;
+    std::unordered_map<uint64_t, UniformValue> uniforms;
+    uint64_t counts[static_cast<int>(Kind::Count)][2];
+};
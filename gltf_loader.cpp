@@ -0,0 +1,1014 @@
+#include "gltf_loader.h"
+
+#include "json_parser.h"
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <sstream>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+const uint32_t GlbMagic = 0x46546c67u;        // "glTF"
+const uint32_t GlbJsonChunk = 0x4e4f534au;    // "JSON"
+const uint32_t GlbBinaryChunk = 0x004e4942u;  // "BIN\0"
+
+// Elements an accessor without a buffer view may have. It reads as zeros (plus any sparse
+// values), so nothing in the file bounds it; anything near this is a broken or hostile file.
+const size_t MaxUnbackedCount = size_t(1) << 24;
+
+enum ComponentType : uint32_t {
+    Byte = 5120,
+    UnsignedByte = 5121,
+    Short = 5122,
+    UnsignedShort = 5123,
+    UnsignedInt = 5125,
+    Float = 5126
+};
+
+enum PrimitiveMode : uint32_t { Triangles = 4, TriangleStrip = 5, TriangleFan = 6 };
+
+size_t componentSize(uint32_t type) {
+    switch (type) {
+    case Byte: case UnsignedByte: return 1;
+    case Short: case UnsignedShort: return 2;
+    case UnsignedInt: case Float: return 4;
+    }
+    return 0;
+}
+
+int typeComponents(const std::string& type) {
+    if (type == "SCALAR") return 1;
+    if (type == "VEC2") return 2;
+    if (type == "VEC3") return 3;
+    if (type == "VEC4") return 4;
+    return 0;  // matrices are never vertex attributes or indices
+}
+
+uint32_t readLe32(const char* p) {
+    uint32_t value;
+    std::memcpy(&value, p, 4);
+    return value;
+}
+
+struct Buffer {
+    const char* data;
+    size_t size;
+};
+
+struct BufferView {
+    uint32_t buffer;
+    size_t offset;
+    size_t length;
+    size_t stride;  // 0 when tightly packed
+};
+
+// An accessor with its range checked, reduced to where its elements are
+struct Accessor {
+    const char* data;   // first element; nullptr when it has no buffer view and reads as zeros
+    size_t stride;
+    uint32_t componentType;
+    int components;
+    bool normalized;
+    size_t count;
+    size_t sparseCount;
+    const char* sparseIndices;
+    uint32_t sparseIndexType;
+    const char* sparseValues;  // tightly packed elements
+};
+
+struct PrimitiveSource {
+    Accessor position;
+    Accessor normal;
+    Accessor tangent;
+    Accessor texcoord;
+    Accessor indices;
+    bool hasNormal;
+    bool hasTangent;
+    bool hasTexcoord;
+    bool hasIndices;
+    uint32_t mode;
+};
+
+struct PrimitiveResult {
+    double accessorsMs;
+    double indicesMs;
+    double normalsMs;
+    double tangentsMs;
+    double boundsMs;
+    bool generatedNormals;
+    bool generatedTangents;
+    bool decoded;       // set last, so a primitive the decode stage skipped is caught
+    const char* error;  // static message, or nullptr
+};
+
+float readComponent(const char* p, uint32_t type, bool normalized) {
+    switch (type) {
+    case Float: {
+        float value;
+        std::memcpy(&value, p, 4);
+        return value;
+    }
+    case UnsignedByte: {
+        float value = static_cast<unsigned char>(*p);
+        return normalized ? value / 255.0f : value;
+    }
+    case Byte: {
+        float value = static_cast<signed char>(*p);
+        return normalized ? std::max(value / 127.0f, -1.0f) : value;
+    }
+    case UnsignedShort: {
+        uint16_t raw;
+        std::memcpy(&raw, p, 2);
+        return normalized ? raw / 65535.0f : static_cast<float>(raw);
+    }
+    case Short: {
+        int16_t raw;
+        std::memcpy(&raw, p, 2);
+        return normalized ? std::max(raw / 32767.0f, -1.0f) : static_cast<float>(raw);
+    }
+    case UnsignedInt:
+        return static_cast<float>(readLe32(p));
+    }
+    return 0.0f;
+}
+
+uint32_t readIndex(const char* p, uint32_t type) {
+    switch (type) {
+    case UnsignedByte: return static_cast<unsigned char>(*p);
+    case UnsignedShort: {
+        uint16_t value;
+        std::memcpy(&value, p, 2);
+        return value;
+    }
+    default: return readLe32(p);
+    }
+}
+
+// Writes wanted floats per element at out, outStride floats apart; components the accessor
+// lacks are 0
+void readAccessor(const Accessor& accessor, int wanted, float* out, size_t outStride) {
+    int present = std::min(wanted, accessor.components);
+    size_t size = componentSize(accessor.componentType);
+    for (size_t i = 0; i < accessor.count; ++i) {
+        float* element = out + i * outStride;
+        const char* source = accessor.data ? accessor.data + i * accessor.stride : nullptr;
+        for (int c = 0; c < wanted; ++c) {
+            element[c] = source && c < present ? readComponent(source + c * size, accessor.componentType, accessor.normalized) : 0.0f;
+        }
+    }
+    size_t elementSize = size * accessor.components;
+    size_t indexSize = componentSize(accessor.sparseIndexType);
+    for (size_t s = 0; s < accessor.sparseCount; ++s) {
+        uint32_t target = readIndex(accessor.sparseIndices + s * indexSize, accessor.sparseIndexType);
+        const char* source = accessor.sparseValues + s * elementSize;
+        for (int c = 0; c < present && target < accessor.count; ++c) {
+            out[target * outStride + c] = readComponent(source + c * size, accessor.componentType, accessor.normalized);
+        }
+    }
+}
+
+// Widens any index type to 32 bits
+void readIndices(const Accessor& accessor, uint32_t* out) {
+    size_t size = componentSize(accessor.componentType);
+    for (size_t i = 0; i < accessor.count; ++i) {
+        out[i] = accessor.data ? readIndex(accessor.data + i * accessor.stride, accessor.componentType) : 0;
+    }
+    size_t indexSize = componentSize(accessor.sparseIndexType);
+    for (size_t s = 0; s < accessor.sparseCount; ++s) {
+        uint32_t target = readIndex(accessor.sparseIndices + s * indexSize, accessor.sparseIndexType);
+        if (target < accessor.count) {
+            out[target] = readIndex(accessor.sparseValues + s * size, accessor.componentType);
+        }
+    }
+}
+
+void normalize3(float* v, const float* fallback) {
+    float length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    if (length > 1e-20f) {
+        v[0] /= length;
+        v[1] /= length;
+        v[2] /= length;
+    } else {
+        std::copy(fallback, fallback + 3, v);
+    }
+}
+
+// Area-weighted vertex normals. glTF asks for flat normals when there are none; the vertices
+// are already shared here, and splitting them would change the vertex count under the indices.
+void generateNormals(MeshData& mesh) {
+    size_t stride = mesh.stride;
+    float* vertices = mesh.vertices.data();
+    for (size_t v = 0; v < mesh.vertexCount(); ++v) {
+        std::fill(vertices + v * stride + 3, vertices + v * stride + 6, 0.0f);
+    }
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        const float* a = vertices + mesh.indices[i] * stride;
+        const float* b = vertices + mesh.indices[i + 1] * stride;
+        const float* c = vertices + mesh.indices[i + 2] * stride;
+        float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+        float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+        float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+        for (int k = 0; k < 3; ++k) {
+            float* normal = vertices + mesh.indices[i + k] * stride + 3;
+            normal[0] += n[0];
+            normal[1] += n[1];
+            normal[2] += n[2];
+        }
+    }
+    const float up[3] = { 0.0f, 0.0f, 1.0f };
+    for (size_t v = 0; v < mesh.vertexCount(); ++v) {
+        normalize3(vertices + v * stride + 3, up);
+    }
+}
+
+// Per-vertex tangents from the texture coordinate gradients of the triangles around each vertex
+// (Lengyel's method), made orthogonal to the normal. w is the handedness glTF expects: the
+// bitangent is cross(normal, tangent) * w.
+void generateTangents(MeshData& mesh) {
+    size_t stride = mesh.stride;
+    size_t tangentOffset = mesh.tangentOffset();
+    size_t texcoordOffset = mesh.texcoordOffset();
+    float* vertices = mesh.vertices.data();
+    std::vector<float> bitangents(mesh.vertexCount() * 3, 0.0f);
+    for (size_t v = 0; v < mesh.vertexCount(); ++v) {
+        std::fill(vertices + v * stride + tangentOffset, vertices + v * stride + tangentOffset + 4, 0.0f);
+    }
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        uint32_t index[3] = { mesh.indices[i], mesh.indices[i + 1], mesh.indices[i + 2] };
+        const float* a = vertices + index[0] * stride;
+        const float* b = vertices + index[1] * stride;
+        const float* c = vertices + index[2] * stride;
+        float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+        float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+        float du1 = b[texcoordOffset] - a[texcoordOffset];
+        float dv1 = b[texcoordOffset + 1] - a[texcoordOffset + 1];
+        float du2 = c[texcoordOffset] - a[texcoordOffset];
+        float dv2 = c[texcoordOffset + 1] - a[texcoordOffset + 1];
+        float determinant = du1 * dv2 - du2 * dv1;
+        if (std::fabs(determinant) < 1e-20f) {
+            continue;
+        }
+        float r = 1.0f / determinant;
+        float s[3] = { (e1[0] * dv2 - e2[0] * dv1) * r, (e1[1] * dv2 - e2[1] * dv1) * r, (e1[2] * dv2 - e2[2] * dv1) * r };
+        float t[3] = { (e2[0] * du1 - e1[0] * du2) * r, (e2[1] * du1 - e1[1] * du2) * r, (e2[2] * du1 - e1[2] * du2) * r };
+        for (int k = 0; k < 3; ++k) {
+            float* tangent = vertices + index[k] * stride + tangentOffset;
+            float* bitangent = &bitangents[index[k] * 3];
+            for (int j = 0; j < 3; ++j) {
+                tangent[j] += s[j];
+                bitangent[j] += t[j];
+            }
+        }
+    }
+    for (size_t v = 0; v < mesh.vertexCount(); ++v) {
+        const float* n = vertices + v * stride + 3;
+        float* tangent = vertices + v * stride + tangentOffset;
+        float d = n[0] * tangent[0] + n[1] * tangent[1] + n[2] * tangent[2];
+        for (int j = 0; j < 3; ++j) {
+            tangent[j] -= n[j] * d;
+        }
+        // No gradient (or one along the normal): any direction perpendicular to the normal
+        float fallback[3] = { 1.0f, 0.0f, 0.0f };
+        if (std::fabs(n[0]) > 0.9f) {
+            fallback[0] = 0.0f;
+            fallback[1] = 1.0f;
+        }
+        float fd = n[0] * fallback[0] + n[1] * fallback[1];
+        for (int j = 0; j < 3; ++j) {
+            fallback[j] -= n[j] * fd;
+        }
+        normalize3(fallback, fallback);
+        normalize3(tangent, fallback);
+        const float* bitangent = &bitangents[v * 3];
+        float cross[3] = { n[1] * tangent[2] - n[2] * tangent[1], n[2] * tangent[0] - n[0] * tangent[2],
+                           n[0] * tangent[1] - n[1] * tangent[0] };
+        tangent[3] = cross[0] * bitangent[0] + cross[1] * bitangent[1] + cross[2] * bitangent[2] < 0.0f ? -1.0f : 1.0f;
+    }
+}
+
+struct DecodeContext {
+    const std::vector<PrimitiveSource>* sources;
+    std::vector<GltfPrimitive>* primitives;
+    std::vector<PrimitiveResult>* results;
+};
+
+void decodePrimitive(const PrimitiveSource& source, GltfPrimitive& primitive, PrimitiveResult& result) {
+    Clock::time_point start = Clock::now();
+    MeshData& mesh = primitive.data;
+    size_t vertexCount = source.position.count;
+    // Normals are always there after import; tangents whenever they can be derived
+    mesh.setAttributes(true, source.hasTangent || source.hasTexcoord, source.hasTexcoord);
+    mesh.vertices.assign(vertexCount * mesh.stride, 0.0f);
+    float* vertices = mesh.vertices.data();
+    readAccessor(source.position, 3, vertices, mesh.stride);
+    if (source.hasNormal) {
+        readAccessor(source.normal, 3, vertices + mesh.normalOffset(), mesh.stride);
+    }
+    if (source.hasTangent) {
+        readAccessor(source.tangent, 4, vertices + mesh.tangentOffset(), mesh.stride);
+    }
+    if (source.hasTexcoord) {
+        readAccessor(source.texcoord, 2, vertices + mesh.texcoordOffset(), mesh.stride);
+    }
+    result.accessorsMs = elapsedMs(start);
+
+    start = Clock::now();
+    std::vector<uint32_t> corners;
+    if (source.hasIndices) {
+        corners.resize(source.indices.count);
+        readIndices(source.indices, corners.data());
+    } else {
+        corners.resize(vertexCount);
+        for (size_t i = 0; i < vertexCount; ++i) {
+            corners[i] = static_cast<uint32_t>(i);
+        }
+    }
+    for (size_t i = 0; i < corners.size(); ++i) {
+        if (corners[i] >= vertexCount) {
+            result.error = "index out of range";
+            return;
+        }
+    }
+    if (source.mode == TriangleStrip || source.mode == TriangleFan) {
+        // Every other strip triangle is flipped back to the first one's winding
+        for (size_t i = 2; i < corners.size(); ++i) {
+            uint32_t triangle[3] = { corners[i - 2], corners[i - 1], corners[i] };
+            if (source.mode == TriangleFan) {
+                triangle[0] = corners[0];
+            } else if (i % 2 == 1) {
+                std::swap(triangle[0], triangle[1]);
+            }
+            mesh.indices.insert(mesh.indices.end(), triangle, triangle + 3);
+        }
+    } else {
+        corners.resize(corners.size() / 3 * 3);
+        mesh.indices.swap(corners);
+    }
+    MeshGroup group = { primitive.name, 0, mesh.indices.size() };
+    mesh.groups.assign(1, group);
+    result.indicesMs = elapsedMs(start);
+
+    start = Clock::now();
+    if (!source.hasNormal) {
+        generateNormals(mesh);
+        result.generatedNormals = true;
+    }
+    result.normalsMs = elapsedMs(start);
+
+    start = Clock::now();
+    if (mesh.tangents && !source.hasTangent) {
+        generateTangents(mesh);
+        result.generatedTangents = true;
+    }
+    result.tangentsMs = elapsedMs(start);
+
+    start = Clock::now();
+    for (int k = 0; k < 3; ++k) {
+        primitive.boundsMin[k] = vertexCount ? vertices[k] : 0.0f;
+        primitive.boundsMax[k] = vertexCount ? vertices[k] : 0.0f;
+    }
+    for (size_t v = 0; v < vertexCount; ++v) {
+        const float* position = vertices + v * mesh.stride;
+        for (int k = 0; k < 3; ++k) {
+            primitive.boundsMin[k] = std::min(primitive.boundsMin[k], position[k]);
+            primitive.boundsMax[k] = std::max(primitive.boundsMax[k], position[k]);
+        }
+    }
+    result.boundsMs = elapsedMs(start);
+    result.decoded = true;
+}
+
+void decodeRange(size_t begin, size_t end, void* context) {
+    DecodeContext& decode = *static_cast<DecodeContext*>(context);
+    for (size_t i = begin; i < end; ++i) {
+        // Counts are bounded by the file, but a big enough one still fails to allocate; an
+        // exception escaping a job would take the whole process down
+        try {
+            decodePrimitive((*decode.sources)[i], (*decode.primitives)[i], (*decode.results)[i]);
+        } catch (const std::bad_alloc&) {
+            (*decode.results)[i].error = "out of memory";
+        }
+    }
+}
+
+int base64Value(char c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+' || c == '-') return 62;
+    if (c == '/' || c == '_') return 63;
+    return -1;
+}
+
+bool decodeBase64(const std::string& text, size_t start, std::vector<char>& out) {
+    out.clear();
+    out.reserve((text.size() - start) / 4 * 3);
+    uint32_t bits = 0;
+    int count = 0;
+    for (size_t i = start; i < text.size() && text[i] != '='; ++i) {
+        int value = base64Value(text[i]);
+        if (value < 0) {
+            return false;
+        }
+        bits = (bits << 6) | static_cast<uint32_t>(value);
+        count += 6;
+        if (count >= 8) {
+            count -= 8;
+            out.push_back(static_cast<char>((bits >> count) & 0xff));
+        }
+    }
+    return true;
+}
+
+std::string percentDecode(const std::string& uri) {
+    std::string out;
+    for (size_t i = 0; i < uri.size(); ++i) {
+        if (uri[i] == '%' && i + 2 < uri.size() && std::isxdigit(static_cast<unsigned char>(uri[i + 1]))
+            && std::isxdigit(static_cast<unsigned char>(uri[i + 2]))) {
+            out += static_cast<char>(std::strtol(uri.substr(i + 1, 2).c_str(), nullptr, 16));
+            i += 2;
+        } else {
+            out += uri[i];
+        }
+    }
+    return out;
+}
+
+// Column-major 4x4 matrices
+void multiply(const float* a, const float* b, float* out) {
+    float result[16];
+    for (int column = 0; column < 4; ++column) {
+        for (int row = 0; row < 4; ++row) {
+            float sum = 0.0f;
+            for (int k = 0; k < 4; ++k) {
+                sum += a[k * 4 + row] * b[column * 4 + k];
+            }
+            result[column * 4 + row] = sum;
+        }
+    }
+    std::copy(result, result + 16, out);
+}
+
+void identity(float* m) {
+    std::fill(m, m + 16, 0.0f);
+    m[0] = m[5] = m[10] = m[15] = 1.0f;
+}
+
+// The node's local transform: its matrix, or translation * rotation * scale
+void localTransform(const JsonDocument& json, JsonDocument::Value node, float* m) {
+    identity(m);
+    JsonDocument::Value matrix = json.find(node, "matrix");
+    if (matrix != JsonDocument::None && json.count(matrix) == 16) {
+        int i = 0;
+        for (JsonDocument::Value v = json.first(matrix); v != JsonDocument::None; v = json.next(v)) {
+            m[i++] = static_cast<float>(json.number(v));
+        }
+        return;
+    }
+    float t[3] = { 0.0f, 0.0f, 0.0f };
+    float r[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    float s[3] = { 1.0f, 1.0f, 1.0f };
+    const char* names[3] = { "translation", "rotation", "scale" };
+    float* targets[3] = { t, r, s };
+    uint32_t sizes[3] = { 3, 4, 3 };
+    for (int p = 0; p < 3; ++p) {
+        JsonDocument::Value array = json.find(node, names[p]);
+        if (array != JsonDocument::None && json.count(array) == sizes[p]) {
+            int i = 0;
+            for (JsonDocument::Value v = json.first(array); v != JsonDocument::None; v = json.next(v)) {
+                targets[p][i++] = static_cast<float>(json.number(v));
+            }
+        }
+    }
+    float x = r[0], y = r[1], z = r[2], w = r[3];
+    float rotation[9] = {
+        1 - 2 * (y * y + z * z), 2 * (x * y + z * w), 2 * (x * z - y * w),
+        2 * (x * y - z * w), 1 - 2 * (x * x + z * z), 2 * (y * z + x * w),
+        2 * (x * z + y * w), 2 * (y * z - x * w), 1 - 2 * (x * x + y * y)
+    };
+    for (int column = 0; column < 3; ++column) {
+        for (int row = 0; row < 3; ++row) {
+            m[column * 4 + row] = rotation[column * 3 + row] * s[column];
+        }
+    }
+    m[12] = t[0];
+    m[13] = t[1];
+    m[14] = t[2];
+}
+
+} // namespace
+
+GltfLoader::GltfLoader(JobSystem* jobs)
+    : jobs(jobs) {
+    std::memset(&loadStats, 0, sizeof(loadStats));
+}
+
+bool GltfLoader::load(const std::string& path, GltfScene& scene) {
+    typedef JsonDocument::Value Value;
+    const Value None = JsonDocument::None;
+    std::memset(&loadStats, 0, sizeof(loadStats));
+    scene.primitives.clear();
+    scene.meshes.clear();
+    scene.instances.clear();
+    Clock::time_point loadStart = Clock::now();
+
+    // ---- map ----
+    Clock::time_point start = Clock::now();
+    MappedFile file;
+    if (!file.open(path)) {
+        std::cerr << "Failed to open " << path << std::endl;
+        return false;
+    }
+    const char* jsonText = file.data();
+    size_t jsonLength = file.size();
+    Buffer binaryChunk = { nullptr, 0 };
+    if (file.size() >= 12 && readLe32(file.data()) == GlbMagic) {
+        // Header, then chunks of (length, type, data) padded to 4 bytes: JSON first, then BIN
+        if (readLe32(file.data() + 4) != 2 || readLe32(file.data() + 8) > file.size()) {
+            std::cerr << path << ": unsupported or truncated glTF binary" << std::endl;
+            return false;
+        }
+        size_t end = readLe32(file.data() + 8);
+        size_t offset = 12;
+        jsonText = nullptr;
+        while (offset + 8 <= end) {
+            size_t length = readLe32(file.data() + offset);
+            uint32_t type = readLe32(file.data() + offset + 4);
+            if (length > end - offset - 8) {
+                std::cerr << path << ": truncated chunk" << std::endl;
+                return false;
+            }
+            if (type == GlbJsonChunk && !jsonText) {
+                jsonText = file.data() + offset + 8;
+                jsonLength = length;
+            } else if (type == GlbBinaryChunk && !binaryChunk.data) {
+                binaryChunk.data = file.data() + offset + 8;
+                binaryChunk.size = length;
+            }
+            offset += 8 + ((length + 3) & ~static_cast<size_t>(3));
+        }
+        if (!jsonText) {
+            std::cerr << path << ": no JSON chunk" << std::endl;
+            return false;
+        }
+    }
+    loadStats.mapMs = elapsedMs(start);
+    loadStats.jsonBytes = jsonLength;
+
+    // ---- parse ----
+    start = Clock::now();
+    JsonDocument json;
+    if (!json.parse(jsonText, jsonLength, path)) {
+        return false;
+    }
+    Value root = json.root();
+    std::string version = json.string(json.find(root, "asset"), "version");
+    if (version.compare(0, 2, "2.") != 0) {
+        std::cerr << path << ": glTF version \"" << version << "\", expected 2.x" << std::endl;
+        return false;
+    }
+    loadStats.parseMs = elapsedMs(start);
+
+    // ---- map the buffers ----
+    start = Clock::now();
+    std::string directory;
+    size_t slash = path.find_last_of("/\\");
+    if (slash != std::string::npos) {
+        directory = path.substr(0, slash + 1);
+    }
+    Value bufferArray = json.find(root, "buffers");
+    size_t bufferCount = bufferArray != None ? json.count(bufferArray) : 0;
+    std::vector<Buffer> buffers;
+    std::vector<MappedFile> bufferFiles;
+    std::vector<std::vector<char> > embedded;
+    // Reserved up front: buffers point into these
+    bufferFiles.reserve(bufferCount);
+    embedded.reserve(bufferCount);
+    for (Value b = bufferArray != None ? json.first(bufferArray) : None; b != None; b = json.next(b)) {
+        Buffer buffer = { nullptr, 0 };
+        double byteLength = json.number(b, "byteLength", -1.0);
+        Value uriValue = json.find(b, "uri");
+        std::string uri = json.string(uriValue);
+        if (uriValue == None) {
+            if (buffers.empty() && binaryChunk.data) {
+                buffer = binaryChunk;
+            }
+        } else if (uri.compare(0, 5, "data:") == 0) {
+            size_t comma = uri.find(";base64,");
+            embedded.push_back(std::vector<char>());
+            if (comma == std::string::npos || !decodeBase64(uri, comma + 8, embedded.back())) {
+                std::cerr << path << ": buffer " << buffers.size() << " has an unsupported data URI" << std::endl;
+                return false;
+            }
+            buffer.data = embedded.back().data();
+            buffer.size = embedded.back().size();
+        } else {
+            bufferFiles.push_back(MappedFile());
+            std::string bufferPath = directory + percentDecode(uri);
+            if (!bufferFiles.back().open(bufferPath)) {
+                std::cerr << "Failed to open " << bufferPath << std::endl;
+                return false;
+            }
+            buffer.data = bufferFiles.back().data();
+            buffer.size = bufferFiles.back().size();
+        }
+        if (!buffer.data || byteLength < 0.0 || byteLength > static_cast<double>(buffer.size)) {
+            std::cerr << path << ": buffer " << buffers.size() << " is missing or shorter than its byteLength" << std::endl;
+            return false;
+        }
+        buffer.size = static_cast<size_t>(byteLength);
+        loadStats.bufferBytes += buffer.size;
+        buffers.push_back(buffer);
+    }
+    loadStats.mapMs += elapsedMs(start);
+
+    // ---- resolve ----
+    start = Clock::now();
+    std::vector<BufferView> views;
+    Value viewArray = json.find(root, "bufferViews");
+    for (Value v = viewArray != None ? json.first(viewArray) : None; v != None; v = json.next(v)) {
+        BufferView view = { json.index(v, "buffer"), 0, 0, 0 };
+        bool sizes = json.size(v, "byteOffset", 0, view.offset) && json.size(v, "byteLength", 0, view.length)
+            && json.size(v, "byteStride", 0, view.stride);
+        if (!sizes || view.buffer >= buffers.size() || view.offset > buffers[view.buffer].size
+            || view.length > buffers[view.buffer].size - view.offset) {
+            std::cerr << path << ": buffer view " << views.size() << " is out of range" << std::endl;
+            return false;
+        }
+        views.push_back(view);
+    }
+    std::vector<Value> accessorValues;
+    Value accessorArray = json.find(root, "accessors");
+    for (Value a = accessorArray != None ? json.first(accessorArray) : None; a != None; a = json.next(a)) {
+        accessorValues.push_back(a);
+    }
+
+    // Locates count elements of elementSize bytes, stride apart, from offset of a buffer view,
+    // or nullptr when they run past its end. The bound is divided rather than the span
+    // multiplied, so no count can overflow it.
+    struct Ranges {
+        const std::vector<Buffer>& buffers;
+        const std::vector<BufferView>& views;
+        const char* locate(uint32_t viewIndex, size_t offset, size_t count, size_t elementSize, size_t stride) const {
+            if (viewIndex >= views.size()) {
+                return nullptr;
+            }
+            const BufferView& view = views[viewIndex];
+            if (offset > view.length) {
+                return nullptr;
+            }
+            size_t room = view.length - offset;
+            if (count && (elementSize > room || count - 1 > (room - elementSize) / stride)) {
+                return nullptr;
+            }
+            return buffers[view.buffer].data + view.offset + offset;
+        }
+    } ranges = { buffers, views };
+
+    // Resolves accessor index into where its elements are, checking every byte it reads lies in
+    // its buffer view
+    auto resolveAccessor = [&](uint32_t index, Accessor& accessor) -> bool {
+        std::memset(&accessor, 0, sizeof(accessor));
+        if (index >= accessorValues.size()) {
+            return false;
+        }
+        Value a = accessorValues[index];
+        accessor.componentType = json.index(a, "componentType", 0);
+        accessor.components = typeComponents(json.string(a, "type"));
+        accessor.normalized = json.boolean(json.find(a, "normalized"));
+        size_t size = componentSize(accessor.componentType);
+        size_t elementSize = size * static_cast<size_t>(accessor.components);
+        if (size == 0 || accessor.components == 0 || !json.size(a, "count", 0, accessor.count)) {
+            return false;
+        }
+        uint32_t viewIndex = json.index(a, "bufferView");
+        if (viewIndex == None && accessor.count > MaxUnbackedCount) {
+            return false;
+        }
+        if (viewIndex != None) {
+            size_t viewStride = views.size() > viewIndex ? views[viewIndex].stride : 0;
+            accessor.stride = viewStride ? viewStride : elementSize;
+            size_t offset;
+            if (!json.size(a, "byteOffset", 0, offset)) {
+                return false;
+            }
+            accessor.data = ranges.locate(viewIndex, offset, accessor.count, elementSize, accessor.stride);
+            if (!accessor.data) {
+                return false;
+            }
+        }
+        Value sparse = json.find(a, "sparse");
+        if (sparse != None) {
+            Value indices = json.find(sparse, "indices");
+            Value values = json.find(sparse, "values");
+            size_t indicesOffset, valuesOffset;
+            if (!json.size(sparse, "count", 0, accessor.sparseCount) || !json.size(indices, "byteOffset", 0, indicesOffset)
+                || !json.size(values, "byteOffset", 0, valuesOffset)) {
+                return false;
+            }
+            accessor.sparseIndexType = json.index(indices, "componentType", 0);
+            size_t indexSize = componentSize(accessor.sparseIndexType);
+            if (indexSize == 0 || accessor.sparseIndexType == Byte || accessor.sparseIndexType == Short
+                || accessor.sparseIndexType == Float) {
+                return false;
+            }
+            accessor.sparseIndices = ranges.locate(json.index(indices, "bufferView"), indicesOffset,
+                                                   accessor.sparseCount, indexSize, indexSize);
+            accessor.sparseValues = ranges.locate(json.index(values, "bufferView"), valuesOffset,
+                                                  accessor.sparseCount, elementSize, elementSize);
+            if (!accessor.sparseIndices || !accessor.sparseValues) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    std::vector<PrimitiveSource> sources;
+    Value meshArray = json.find(root, "meshes");
+    for (Value m = meshArray != None ? json.first(meshArray) : None; m != None; m = json.next(m)) {
+        GltfMesh mesh = { json.string(m, "name"), scene.primitives.size(), 0 };
+        if (mesh.name.empty()) {
+            std::ostringstream name;
+            name << "mesh" << scene.meshes.size();
+            mesh.name = name.str();
+        }
+        Value primitiveArray = json.find(m, "primitives");
+        uint32_t primitiveIndex = 0;
+        for (Value p = primitiveArray != None ? json.first(primitiveArray) : None; p != None;
+             p = json.next(p), ++primitiveIndex) {
+            PrimitiveSource source;
+            std::memset(&source, 0, sizeof(source));
+            source.mode = json.index(p, "mode", Triangles);
+            if (source.mode != Triangles && source.mode != TriangleStrip && source.mode != TriangleFan) {
+                std::cerr << path << ": skipping " << mesh.name << " primitive " << primitiveIndex
+                          << " (mode " << source.mode << " is not triangles)" << std::endl;
+                continue;
+            }
+            Value attributes = json.find(p, "attributes");
+            uint32_t positionIndex = json.index(attributes, "POSITION");
+            uint32_t normalIndex = json.index(attributes, "NORMAL");
+            uint32_t tangentIndex = json.index(attributes, "TANGENT");
+            uint32_t texcoordIndex = json.index(attributes, "TEXCOORD_0");
+            uint32_t indicesIndex = json.index(p, "indices");
+            source.hasNormal = normalIndex != None;
+            source.hasTangent = tangentIndex != None;
+            source.hasTexcoord = texcoordIndex != None;
+            source.hasIndices = indicesIndex != None;
+            bool valid = resolveAccessor(positionIndex, source.position) && source.position.components == 3
+                && (!source.hasNormal || (resolveAccessor(normalIndex, source.normal) && source.normal.count == source.position.count))
+                && (!source.hasTangent || (resolveAccessor(tangentIndex, source.tangent) && source.tangent.count == source.position.count))
+                && (!source.hasTexcoord || (resolveAccessor(texcoordIndex, source.texcoord) && source.texcoord.count == source.position.count))
+                && (!source.hasIndices || (resolveAccessor(indicesIndex, source.indices) && source.indices.data
+                                           && source.indices.components == 1
+                                           && (source.indices.componentType == UnsignedByte
+                                               || source.indices.componentType == UnsignedShort
+                                               || source.indices.componentType == UnsignedInt)));
+            if (!valid || source.position.count > 0xffffffffu) {
+                std::cerr << path << ": " << mesh.name << " primitive " << primitiveIndex
+                          << " has a missing, mismatched or out of range accessor" << std::endl;
+                return false;
+            }
+            GltfPrimitive primitive;
+            std::fill(primitive.boundsMin, primitive.boundsMin + 3, 0.0f);
+            std::fill(primitive.boundsMax, primitive.boundsMax + 3, 0.0f);
+            primitive.name = mesh.name;
+            if (json.count(primitiveArray) > 1) {
+                std::ostringstream name;
+                name << mesh.name << "#" << primitiveIndex;
+                primitive.name = name.str();
+            }
+            uint32_t material = json.index(p, "material");
+            primitive.material = material <= 0x7fffffffu ? static_cast<int>(material) : -1;
+            scene.primitives.push_back(primitive);
+            sources.push_back(source);
+            ++mesh.primitiveCount;
+        }
+        scene.meshes.push_back(mesh);
+    }
+    loadStats.resolveMs = elapsedMs(start);
+
+    // ---- decode ----
+    start = Clock::now();
+    std::vector<PrimitiveResult> results(sources.size());
+    std::memset(results.data(), 0, results.size() * sizeof(PrimitiveResult));
+    DecodeContext context = { &sources, &scene.primitives, &results };
+    // parallelFor does nothing on a thread outside the system; decode inline then
+    bool parallel = jobs && jobs->ownsThread();
+    if (parallel) {
+        jobs->parallelFor(sources.size(), 1, decodeRange, &context);
+    } else {
+        decodeRange(0, sources.size(), &context);
+    }
+    loadStats.threads = parallel ? jobs->threadCount() : 1;
+    loadStats.decodeMs = elapsedMs(start);
+    for (size_t i = 0; i < results.size(); ++i) {
+        const PrimitiveResult& result = results[i];
+        if (result.error || !result.decoded) {
+            std::cerr << path << ": " << scene.primitives[i].name << ": "
+                      << (result.error ? result.error : "was not decoded") << std::endl;
+            return false;
+        }
+        loadStats.accessorsMs += result.accessorsMs;
+        loadStats.indicesMs += result.indicesMs;
+        loadStats.normalsMs += result.normalsMs;
+        loadStats.tangentsMs += result.tangentsMs;
+        loadStats.boundsMs += result.boundsMs;
+        loadStats.generatedNormals += result.generatedNormals;
+        loadStats.generatedTangents += result.generatedTangents;
+        loadStats.vertices += scene.primitives[i].data.vertexCount();
+        loadStats.triangles += scene.primitives[i].data.indices.size() / 3;
+    }
+    loadStats.primitives = scene.primitives.size();
+
+    // ---- nodes ----
+    start = Clock::now();
+    Value nodeArray = json.find(root, "nodes");
+    std::vector<Value> nodes;
+    for (Value n = nodeArray != None ? json.first(nodeArray) : None; n != None; n = json.next(n)) {
+        nodes.push_back(n);
+    }
+    // Roots: the default scene's, or every node no other node lists as a child
+    std::vector<uint32_t> roots;
+    Value scenes = json.find(root, "scenes");
+    Value defaultScene = json.at(scenes, json.index(root, "scene", 0));
+    Value sceneNodes = json.find(defaultScene, "nodes");
+    if (sceneNodes != None) {
+        for (Value n = json.first(sceneNodes); n != None; n = json.next(n)) {
+            uint32_t node = json.index(n);
+            if (node != None) {
+                roots.push_back(node);
+            }
+        }
+    } else {
+        std::vector<bool> isChild(nodes.size(), false);
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            Value children = json.find(nodes[i], "children");
+            for (Value c = children != None ? json.first(children) : None; c != None; c = json.next(c)) {
+                uint32_t child = json.index(c);
+                if (child < nodes.size()) {
+                    isChild[child] = true;
+                }
+            }
+        }
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            if (!isChild[i]) {
+                roots.push_back(static_cast<uint32_t>(i));
+            }
+        }
+    }
+    // Depth first; visited guards against the cycles and shared children the spec forbids
+    std::vector<bool> visited(nodes.size(), false);
+    std::vector<std::pair<uint32_t, GltfInstance> > stack;
+    for (size_t i = roots.size(); i-- > 0;) {
+        GltfInstance top;
+        top.mesh = 0;
+        identity(top.transform);
+        stack.push_back(std::make_pair(roots[i], top));
+    }
+    while (!stack.empty()) {
+        uint32_t index = stack.back().first;
+        GltfInstance parent = stack.back().second;
+        stack.pop_back();
+        if (index >= nodes.size() || visited[index]) {
+            continue;
+        }
+        visited[index] = true;
+        float local[16];
+        localTransform(json, nodes[index], local);
+        GltfInstance instance;
+        multiply(parent.transform, local, instance.transform);
+        uint32_t mesh = json.index(nodes[index], "mesh");
+        if (mesh < scene.meshes.size()) {
+            instance.mesh = mesh;
+            scene.instances.push_back(instance);
+        }
+        Value children = json.find(nodes[index], "children");
+        for (Value c = children != None ? json.first(children) : None; c != None; c = json.next(c)) {
+            uint32_t child = json.index(c);
+            if (child != None) {
+                stack.push_back(std::make_pair(child, instance));
+            }
+        }
+    }
+    if (nodes.empty()) {
+        // Meshes without a scene graph: one untransformed instance each
+        for (size_t m = 0; m < scene.meshes.size(); ++m) {
+            GltfInstance instance;
+            instance.mesh = m;
+            identity(instance.transform);
+            scene.instances.push_back(instance);
+        }
+    }
+    loadStats.nodesMs = elapsedMs(start);
+    loadStats.totalMs = elapsedMs(loadStart);
+    return true;
+}
+
+void GltfLoader::printJson(std::ostream& out) const {
+    const Stats& s = loadStats;
+    out << "{\"map_ms\": " << s.mapMs << ", \"parse_ms\": " << s.parseMs << ", \"resolve_ms\": " << s.resolveMs
+        << ", \"decode_ms\": " << s.decodeMs << ", \"nodes_ms\": " << s.nodesMs << ", \"total_ms\": " << s.totalMs
+        << ", \"decode_tasks\": {\"accessors_ms\": " << s.accessorsMs << ", \"indices_ms\": " << s.indicesMs
+        << ", \"normals_ms\": " << s.normalsMs << ", \"tangents_ms\": " << s.tangentsMs << ", \"bounds_ms\": " << s.boundsMs << "}"
+        << ", \"json_bytes\": " << s.jsonBytes << ", \"buffer_bytes\": " << s.bufferBytes
+        << ", \"primitives\": " << s.primitives << ", \"vertices\": " << s.vertices << ", \"triangles\": " << s.triangles
+        << ", \"generated_normals\": " << s.generatedNormals << ", \"generated_tangents\": " << s.generatedTangents
+        << ", \"threads\": " << s.threads << "}";
+}
+
+void flattenGltfScene(const GltfScene& scene, MeshData& mesh) {
+    bool tangents = true;
+    bool texcoords = true;
+    for (size_t i = 0; i < scene.instances.size(); ++i) {
+        const GltfMesh& source = scene.meshes[scene.instances[i].mesh];
+        for (size_t p = source.firstPrimitive; p < source.firstPrimitive + source.primitiveCount; ++p) {
+            tangents = tangents && scene.primitives[p].data.tangents;
+            texcoords = texcoords && scene.primitives[p].data.texcoords;
+        }
+    }
+    mesh.vertices.clear();
+    mesh.indices.clear();
+    mesh.groups.clear();
+    mesh.corners = 0;
+    mesh.setAttributes(true, tangents, texcoords);
+
+    for (size_t i = 0; i < scene.instances.size(); ++i) {
+        const float* m = scene.instances[i].transform;
+        // Normals go through the inverse transpose of the upper 3x3: its cofactor matrix divided
+        // by the determinant, of which only the sign matters before normalising. Column-major
+        // like m, so cofactor[r + 3 * c] is row r, column c.
+        float cofactor[9] = {
+            m[5] * m[10] - m[6] * m[9], m[6] * m[8] - m[4] * m[10], m[4] * m[9] - m[5] * m[8],
+            m[2] * m[9] - m[1] * m[10], m[0] * m[10] - m[2] * m[8], m[1] * m[8] - m[0] * m[9],
+            m[1] * m[6] - m[2] * m[5], m[2] * m[4] - m[0] * m[6], m[0] * m[5] - m[1] * m[4]
+        };
+        float determinant = m[0] * cofactor[0] + m[1] * cofactor[1] + m[2] * cofactor[2];
+        bool mirrored = determinant < 0.0f;
+        if (mirrored) {
+            for (int k = 0; k < 9; ++k) {
+                cofactor[k] = -cofactor[k];
+            }
+        }
+        const GltfMesh& source = scene.meshes[scene.instances[i].mesh];
+        for (size_t p = source.firstPrimitive; p < source.firstPrimitive + source.primitiveCount; ++p) {
+            const MeshData& part = scene.primitives[p].data;
+            uint32_t base = static_cast<uint32_t>(mesh.vertexCount());
+            for (size_t v = 0; v < part.vertexCount(); ++v) {
+                const float* in = &part.vertices[v * part.stride];
+                float vertex[12];
+                for (int r = 0; r < 3; ++r) {
+                    vertex[r] = m[r] * in[0] + m[4 + r] * in[1] + m[8 + r] * in[2] + m[12 + r];
+                }
+                const float* n = in + part.normalOffset();
+                const float up[3] = { 0.0f, 0.0f, 1.0f };
+                for (int r = 0; r < 3; ++r) {
+                    vertex[3 + r] = cofactor[r] * n[0] + cofactor[3 + r] * n[1] + cofactor[6 + r] * n[2];
+                }
+                normalize3(vertex + 3, up);
+                size_t offset = 6;
+                if (tangents) {
+                    const float* t = in + part.tangentOffset();
+                    for (int r = 0; r < 3; ++r) {
+                        vertex[offset + r] = m[r] * t[0] + m[4 + r] * t[1] + m[8 + r] * t[2];
+                    }
+                    const float x[3] = { 1.0f, 0.0f, 0.0f };
+                    normalize3(vertex + offset, x);
+                    vertex[offset + 3] = mirrored ? -t[3] : t[3];
+                    offset += 4;
+                }
+                if (texcoords) {
+                    const float* uv = in + part.texcoordOffset();
+                    vertex[offset] = uv[0];
+                    vertex[offset + 1] = uv[1];
+                }
+                mesh.vertices.insert(mesh.vertices.end(), vertex, vertex + mesh.stride);
+            }
+            MeshGroup group = { scene.primitives[p].name, mesh.indices.size(), part.indices.size() };
+            for (size_t t = 0; t + 2 < part.indices.size(); t += 3) {
+                // A mirroring transform turns the winding around; swap it back
+                uint32_t triangle[3] = { base + part.indices[t], base + part.indices[t + 1], base + part.indices[t + 2] };
+                if (mirrored) {
+                    std::swap(triangle[1], triangle[2]);
+                }
+                mesh.indices.insert(mesh.indices.end(), triangle, triangle + 3);
+            }
+            if (group.indexCount) {
+                mesh.groups.push_back(group);
+            }
+        }
+    }
+}
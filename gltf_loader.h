@@ -0,0 +1,100 @@
+#pragma once
+
+#include "job_system.h"
+#include "mesh_data.h"
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// glTF 2.0 importer for .gltf (with external or data: URI buffers) and .glb files.
+//
+// Import runs in stages, each timed:
+//
+//   map       the file and its external buffers are mapped; .glb binary chunks are used in place
+//   parse     one pass of JsonDocument over the mapped JSON
+//   resolve   buffer views, accessors and primitives are looked up and range-checked, serially
+//   decode    every primitive in parallel on the JobSystem: accessors decoded and interleaved
+//             into floats, indices widened to 32 bits (and narrowed to 16 when they fit), missing
+//             normals and tangents generated, bounds computed
+//   nodes     the node hierarchy is flattened into world transforms of the meshes it draws
+//
+// The per-primitive work of decode is also summed per task over all threads, to show where the
+// time goes when the stage is spread out. Each primitive becomes a MeshData with position,
+// normal, tangent (when it has texture coordinates) and texture coordinate. Triangle strips
+// and fans become lists; points and lines are skipped. Sparse accessors are applied. Materials,
+// textures, skins, morph targets and animations are not read.
+struct GltfPrimitive {
+    std::string name;                  // the mesh's name, with the primitive index when it has several
+    int material;                      // glTF material index, or -1
+    MeshData data;
+    float boundsMin[3];
+    float boundsMax[3];
+};
+
+struct GltfMesh {
+    std::string name;
+    size_t firstPrimitive;
+    size_t primitiveCount;
+};
+
+// A node of the default scene that draws a mesh
+struct GltfInstance {
+    size_t mesh;
+    float transform[16];  // column-major, mesh to world
+};
+
+struct GltfScene {
+    std::vector<GltfPrimitive> primitives;
+    std::vector<GltfMesh> meshes;
+    std::vector<GltfInstance> instances;
+};
+
+class GltfLoader {
+public:
+    struct Stats {
+        double mapMs;
+        double parseMs;
+        double resolveMs;
+        double decodeMs;
+        double nodesMs;
+        double totalMs;
+        // Summed over the primitives, whichever thread decoded them
+        double accessorsMs;
+        double indicesMs;
+        double normalsMs;
+        double tangentsMs;
+        double boundsMs;
+        size_t jsonBytes;
+        size_t bufferBytes;
+        size_t primitives;
+        size_t vertices;
+        size_t triangles;
+        size_t generatedNormals;   // primitives that had none
+        size_t generatedTangents;
+        int threads;
+    };
+
+    // jobs runs the decode stage; without one, or on a thread that doesn't belong to it,
+    // everything runs on the calling thread.
+    explicit GltfLoader(JobSystem* jobs = nullptr);
+
+    // On failure says why on stderr and returns false; scene is then undefined.
+    bool load(const std::string& path, GltfScene& scene);
+
+    const Stats& stats() const { return loadStats; }
+    // {"map_ms": .., "parse_ms": .., .., "primitives": .., "vertices": .., "triangles": .., "threads": ..}
+    void printJson(std::ostream& out) const;
+
+private:
+    GltfLoader(const GltfLoader&);
+    GltfLoader& operator=(const GltfLoader&);
+
+    JobSystem* jobs;
+    Stats loadStats;
+};
+
+// Every instance's primitives transformed to world space and appended to mesh, one group per
+// instance and primitive. Attributes the primitives don't all have are dropped.
+void flattenGltfScene(const GltfScene& scene, MeshData& mesh);
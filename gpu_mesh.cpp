@@ -0,0 +1,56 @@
+#include "gpu_mesh.h"
+
+#include "vertex_format.h"
+
+GpuMesh::GpuMesh()
+    : vao(0), vbo(0), ibo(0), indexType(GL_UNSIGNED_INT), indexSize(4) {
+}
+
+GpuMesh::~GpuMesh() {
+    destroy();
+}
+
+bool GpuMesh::upload(const MeshFile& file) {
+    destroy();
+    if (!file.isOpen()) {
+        return false;
+    }
+    indexSize = file.indexSize();
+    indexType = indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    for (size_t i = 0; i < file.submeshCount(); ++i) {
+        submeshes.push_back(file.submesh(i));
+    }
+
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    glGenBuffers(1, &ibo);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, file.vertexBytes(), file.vertices(), GL_STATIC_DRAW);
+    VertexFormat::fromLayout(file.layout()).apply();
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, file.indexBytes(), file.indices(), GL_STATIC_DRAW);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return true;
+}
+
+void GpuMesh::destroy() {
+    if (vao) {
+        glDeleteVertexArrays(1, &vao);
+        glDeleteBuffers(1, &vbo);
+        glDeleteBuffers(1, &ibo);
+        vao = vbo = ibo = 0;
+    }
+    submeshes.clear();
+}
+
+void GpuMesh::draw(size_t submesh, GlStateCache& state) const {
+    const MeshFileSubmesh& range = submeshes[submesh];
+    if (range.indexCount == 0) {
+        return;
+    }
+    state.bindVertexArray(vao);
+    glDrawRangeElements(GL_TRIANGLES, range.minVertex, range.maxVertex, range.indexCount, indexType,
+                        reinterpret_cast<const void*>(static_cast<size_t>(range.firstIndex) * indexSize));
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "gl_state.h"
+#include "glad/gl_core_33.h"
+#include "mesh_file.h"
+
+#include <cstddef>
+#include <vector>
+
+// A MeshFile in GL buffers.
+//
+// upload() hands the file's vertex and index blobs to glBufferData() straight from the mapping,
+// so the only copy is the driver's, and points a VAO at them with VertexFormat::fromLayout().
+// The file can be closed once upload() returns.
+class GpuMesh {
+public:
+    GpuMesh();
+    ~GpuMesh();
+
+    // Needs a current context
+    bool upload(const MeshFile& file);
+    void destroy();
+
+    // Draws one submesh with glDrawRangeElements. The current program must read the file's
+    // layout; binds go through state.
+    void draw(size_t submesh, GlStateCache& state) const;
+
+    GLuint vertexArray() const { return vao; }
+    size_t submeshCount() const { return submeshes.size(); }
+    size_t triangleCount(size_t submesh) const { return submeshes[submesh].indexCount / 3; }
+
+private:
+    GpuMesh(const GpuMesh&);
+    GpuMesh& operator=(const GpuMesh&);
+
+    GLuint vao;
+    GLuint vbo;
+    GLuint ibo;
+    GLenum indexType;
+    size_t indexSize;
+    std::vector<MeshFileSubmesh> submeshes;
+};
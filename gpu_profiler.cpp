@@ -0,0 +1,225 @@
+#include "gpu_profiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+
+namespace {
+
+double elapsedMs(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+} // namespace
+
+GpuProfiler::GpuProfiler()
+    : current(0), skipped(0) {
+    for (int i = 0; i < FrameLatency; ++i) {
+        slots[i].queriesUsed = 0;
+        slots[i].pending = false;
+        slots[i].active = false;
+    }
+}
+
+GpuProfiler::~GpuProfiler() {
+    shutdown();
+}
+
+void GpuProfiler::shutdown() {
+    for (int i = 0; i < FrameLatency; ++i) {
+        FrameSlot& slot = slots[i];
+        if (!slot.queries.empty()) {
+            glDeleteQueries(static_cast<GLsizei>(slot.queries.size()), slot.queries.data());
+            slot.queries.clear();
+        }
+        slot.records.clear();
+        slot.queriesUsed = 0;
+        slot.pending = false;
+        slot.active = false;
+    }
+    openScopes.clear();
+}
+
+GLuint GpuProfiler::acquireQuery(FrameSlot& slot) {
+    if (slot.queriesUsed == slot.queries.size()) {
+        GLuint query;
+        glGenQueries(1, &query);
+        slot.queries.push_back(query);
+    }
+    return slot.queries[slot.queriesUsed++];
+}
+
+int GpuProfiler::statIndexFor(const char* name, int depth) {
+    // Scope names are literals, so a pointer compare almost always hits first
+    for (size_t i = 0; i < statNames.size(); ++i) {
+        if (statNames[i] == name) {
+            return static_cast<int>(i);
+        }
+    }
+    for (size_t i = 0; i < statNames.size(); ++i) {
+        if (std::strcmp(statNames[i], name) == 0) {
+            return static_cast<int>(i);
+        }
+    }
+    ScopeStats s;
+    s.name = name;
+    s.depth = depth;
+    s.samples = 0;
+    s.gpuTotalMs = s.gpuMaxMs = s.gpuLastMs = 0.0;
+    s.cpuTotalMs = s.cpuMaxMs = s.cpuLastMs = 0.0;
+    statNames.push_back(name);
+    stats.push_back(s);
+    return static_cast<int>(stats.size() - 1);
+}
+
+void GpuProfiler::beginFrame() {
+    collect();
+    current = (current + 1) % FrameLatency;
+    FrameSlot& slot = slots[current];
+    if (slot.pending) {
+        // The GPU is more than FrameLatency frames behind; skip rather than wait
+        slot.active = false;
+        ++skipped;
+        return;
+    }
+    slot.records.clear();
+    slot.queriesUsed = 0;
+    slot.active = true;
+}
+
+void GpuProfiler::endFrame() {
+    FrameSlot& slot = slots[current];
+    if (!slot.active) {
+        return;
+    }
+    slot.active = false;
+    slot.pending = !slot.records.empty();
+    openScopes.clear();
+}
+
+void GpuProfiler::beginScope(const char* name) {
+    FrameSlot& slot = slots[current];
+    if (!slot.active) {
+        return;
+    }
+    ScopeRecord record;
+    record.statIndex = statIndexFor(name, static_cast<int>(openScopes.size()));
+    record.beginQuery = acquireQuery(slot);
+    record.endQuery = 0;
+    record.cpuMs = 0.0;
+    glQueryCounter(record.beginQuery, GL_TIMESTAMP);
+    record.cpuBegin = Clock::now();
+    openScopes.push_back(slot.records.size());
+    slot.records.push_back(record);
+}
+
+void GpuProfiler::endScope() {
+    FrameSlot& slot = slots[current];
+    if (!slot.active || openScopes.empty()) {
+        return;
+    }
+    ScopeRecord& record = slot.records[openScopes.back()];
+    openScopes.pop_back();
+    record.cpuMs = elapsedMs(record.cpuBegin, Clock::now());
+    record.endQuery = acquireQuery(slot);
+    glQueryCounter(record.endQuery, GL_TIMESTAMP);
+}
+
+bool GpuProfiler::readBack(FrameSlot& slot) {
+    for (size_t i = 0; i < slot.queriesUsed; ++i) {
+        GLint available = 0;
+        glGetQueryObjectiv(slot.queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < slot.records.size(); ++i) {
+        const ScopeRecord& record = slot.records[i];
+        if (!record.endQuery) {
+            continue; // scope left open at endFrame()
+        }
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(record.beginQuery, GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(record.endQuery, GL_QUERY_RESULT, &end);
+        double gpuMs = end > begin ? static_cast<double>(end - begin) / 1.0e6 : 0.0;
+
+        ScopeStats& s = stats[record.statIndex];
+        ++s.samples;
+        s.gpuTotalMs += gpuMs;
+        s.gpuMaxMs = std::max(s.gpuMaxMs, gpuMs);
+        s.gpuLastMs = gpuMs;
+        s.cpuTotalMs += record.cpuMs;
+        s.cpuMaxMs = std::max(s.cpuMaxMs, record.cpuMs);
+        s.cpuLastMs = record.cpuMs;
+    }
+    return true;
+}
+
+void GpuProfiler::collect() {
+    // Oldest slot first so results are accumulated in frame order
+    for (int i = 1; i <= FrameLatency; ++i) {
+        FrameSlot& slot = slots[(current + i) % FrameLatency];
+        if (slot.pending && readBack(slot)) {
+            slot.pending = false;
+        }
+    }
+}
+
+void GpuProfiler::reset() {
+    for (size_t i = 0; i < stats.size(); ++i) {
+        ScopeStats& s = stats[i];
+        s.samples = 0;
+        s.gpuTotalMs = s.gpuMaxMs = s.gpuLastMs = 0.0;
+        s.cpuTotalMs = s.cpuMaxMs = s.cpuLastMs = 0.0;
+    }
+    skipped = 0;
+}
+
+void GpuProfiler::printReport(std::ostream& out) const {
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(3);
+
+    out << "GPU/CPU scope timings";
+    if (skipped > 0) {
+        out << " (" << skipped << " frames skipped, GPU too far behind)";
+    }
+    out << "\n  " << std::left << std::setw(20) << "scope (ms)" << std::right
+        << std::setw(10) << "gpu avg" << std::setw(10) << "gpu max"
+        << std::setw(10) << "cpu avg" << std::setw(10) << "cpu max"
+        << std::setw(10) << "samples" << "\n";
+    for (size_t i = 0; i < stats.size(); ++i) {
+        const ScopeStats& s = stats[i];
+        double n = s.samples ? static_cast<double>(s.samples) : 1.0;
+        std::string label = std::string(2 * s.depth, ' ') + s.name;
+        out << "  " << std::left << std::setw(20) << label << std::right
+            << std::setw(10) << s.gpuTotalMs / n << std::setw(10) << s.gpuMaxMs
+            << std::setw(10) << s.cpuTotalMs / n << std::setw(10) << s.cpuMaxMs
+            << std::setw(10) << s.samples << "\n";
+    }
+
+    out.flags(flags);
+    out.precision(precision);
+}
+
+void GpuProfiler::printJson(std::ostream& out) const {
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(4);
+
+    out << "{";
+    for (size_t i = 0; i < stats.size(); ++i) {
+        const ScopeStats& s = stats[i];
+        double n = s.samples ? static_cast<double>(s.samples) : 1.0;
+        out << (i ? ", " : "") << "\"" << s.name << "\": {"
+            << "\"gpu_ms\": " << s.gpuTotalMs / n
+            << ", \"gpu_max_ms\": " << s.gpuMaxMs
+            << ", \"cpu_ms\": " << s.cpuTotalMs / n
+            << ", \"cpu_max_ms\": " << s.cpuMaxMs
+            << ", \"samples\": " << s.samples << "}";
+    }
+    out << "}";
+
+    out.flags(flags);
+    out.precision(precision);
+}
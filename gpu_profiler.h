@@ -0,0 +1,101 @@
+#pragma once
+
+#include "glad/gl_core_33.h"
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Per-scope GPU and CPU timing for render passes.
+//
+// Each scope brackets its GL commands with GL_TIMESTAMP queries (glQueryCounter), so scopes
+// may nest. Query objects live in a pool of FrameLatency frame slots that are reused round
+// robin; a slot's results are read back only once GL_QUERY_RESULT_AVAILABLE says they're
+// ready, so the profiler never stalls the pipeline. If a slot is still pending when it comes
+// around again, that frame is simply not profiled.
+class GpuProfiler {
+public:
+    static const int FrameLatency = 4;
+
+    // Aggregated timings of one named scope, in milliseconds.
+    struct ScopeStats {
+        std::string name;
+        int depth;
+        uint64_t samples;
+        double gpuTotalMs;
+        double gpuMaxMs;
+        double gpuLastMs;
+        double cpuTotalMs;
+        double cpuMaxMs;
+        double cpuLastMs;
+    };
+
+    GpuProfiler();
+    ~GpuProfiler();
+
+    // Needs a current GL context; queries are created lazily.
+    void shutdown();
+
+    void beginFrame();
+    void endFrame();
+
+    // name must outlive the profiler (string literals in practice).
+    void beginScope(const char* name);
+    void endScope();
+
+    // Polls pending slots without blocking; beginFrame() does this too.
+    void collect();
+
+    const std::vector<ScopeStats>& scopes() const { return stats; }
+    uint64_t skippedFrames() const { return skipped; }
+    void reset();
+
+    void printReport(std::ostream& out) const;
+    // {"scope": {"gpu_ms": .., "gpu_max_ms": .., "cpu_ms": .., "cpu_max_ms": .., "samples": ..}, ...}
+    void printJson(std::ostream& out) const;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct ScopeRecord {
+        int statIndex;
+        GLuint beginQuery;
+        GLuint endQuery;
+        double cpuMs;
+        Clock::time_point cpuBegin;
+    };
+
+    struct FrameSlot {
+        std::vector<ScopeRecord> records;
+        std::vector<GLuint> queries; // pool owned by this slot, reused every lap
+        size_t queriesUsed;
+        bool pending;
+        bool active;
+    };
+
+    GLuint acquireQuery(FrameSlot& slot);
+    int statIndexFor(const char* name, int depth);
+    bool readBack(FrameSlot& slot);
+
+    FrameSlot slots[FrameLatency];
+    int current;
+    std::vector<size_t> openScopes; // indices into the current slot's records
+    std::vector<const char*> statNames;
+    std::vector<ScopeStats> stats;
+    uint64_t skipped;
+};
+
+// Times the enclosing block as a named scope.
+class GpuScope {
+public:
+    GpuScope(GpuProfiler& profiler, const char* name) : profiler(profiler) { profiler.beginScope(name); }
+    ~GpuScope() { profiler.endScope(); }
+
+private:
+    GpuScope(const GpuScope&);
+    GpuScope& operator=(const GpuScope&);
+
+    GpuProfiler& profiler;
+};
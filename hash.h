@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 64-bit FNV-1a. Not cryptographic; used for cache keys and content fingerprints.
+const uint64_t Fnv1aOffsetBasis = 14695981039346656037ULL;
+
+inline uint64_t fnv1a64(const void* data, size_t size, uint64_t hash = Fnv1aOffsetBasis) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+inline uint64_t fnv1a64(const std::string& text, uint64_t hash = Fnv1aOffsetBasis) {
+    // Length is mixed in so ("ab", "c") and ("a", "bc") hash differently when chained
+    uint64_t length = text.size();
+    hash = fnv1a64(&length, sizeof(length), hash);
+    return fnv1a64(text.data(), text.size(), hash);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "glad/gl_core_33.h"
+
+// OpenGL 3.3 core context with no window, for unattended benchmark runs.
+// Uses EGL with the Mesa surfaceless platform when available, so it works on machines
+// without a display server or GPU (llvmpipe). Only built when CMake finds EGL.
+class HeadlessContext {
+public:
+    HeadlessContext();
+    ~HeadlessContext();
+
+    // Creates the context and makes it current on the calling thread.
+    bool create();
+    void destroy();
+
+    // Moves the context between threads: release() on the old one, then makeCurrent() on the new one.
+    bool makeCurrent();
+    void release();
+
+    // Function loader to pass to gladLoadGL once the context is current.
+    static GLADloadfunc loader();
+
+private:
+    HeadlessContext(const HeadlessContext&);
+    HeadlessContext& operator=(const HeadlessContext&);
+
+    // EGLDisplay / EGLContext / EGLSurface, kept opaque so EGL's platform headers
+    // don't leak into every file that includes this one.
+    void* display;
+    void* context;
+    void* surface;
+};
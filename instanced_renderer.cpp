@@ -0,0 +1,101 @@
+#include "instanced_renderer.h"
+
+#include <cstring>
+#include <iostream>
+
+const GLuint InstancedRenderer::PositionAttribute;
+const GLuint InstancedRenderer::PlacementAttribute;
+const GLuint InstancedRenderer::ColorAttribute;
+
+InstancedRenderer::InstancedRenderer()
+    : meshVbo(0), vao(0), meshVertices(0), capacity(0) {
+}
+
+InstancedRenderer::~InstancedRenderer() {
+    destroy();
+}
+
+bool InstancedRenderer::create(const float* positions, int vertexCount, size_t maxInstances, bool persistentMap) {
+    destroy();
+    meshVertices = vertexCount;
+    capacity = maxInstances;
+    if (!instanceStream.create(maxInstances * sizeof(Instance), persistentMap)) {
+        return false;
+    }
+
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &meshVbo);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, meshVbo);
+    glBufferData(GL_ARRAY_BUFFER, vertexCount * 3 * sizeof(float), positions, GL_STATIC_DRAW);
+    glVertexAttribPointer(PositionAttribute, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(PositionAttribute);
+
+    // Per-instance attributes; their pointers are set in draw(), where the data lands in the stream
+    glVertexAttribDivisor(PlacementAttribute, 1);
+    glVertexAttribDivisor(ColorAttribute, 1);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+    return true;
+}
+
+void InstancedRenderer::destroy() {
+    if (vao) {
+        glDeleteVertexArrays(1, &vao);
+        vao = 0;
+    }
+    if (meshVbo) {
+        glDeleteBuffers(1, &meshVbo);
+        meshVbo = 0;
+    }
+    instanceStream.destroy();
+    capacity = 0;
+}
+
+void InstancedRenderer::draw(const Instance* instances, size_t count, GlStateCache& state) {
+    count = prepare(instances, count, state);
+    if (count > 0) {
+        glDrawArraysInstanced(GL_TRIANGLES, 0, meshVertices, static_cast<GLsizei>(count));
+    }
+}
+
+size_t InstancedRenderer::prepare(const Instance* instances, size_t count, GlStateCache& state) {
+    if (count > capacity) {
+        count = capacity;
+    }
+    if (count == 0) {
+        return 0;
+    }
+    size_t offset = 0;
+    void* destination = instanceStream.allocate(count * sizeof(Instance), sizeof(Instance), offset);
+    if (!destination) {
+        return 0;
+    }
+    std::memcpy(destination, instances, count * sizeof(Instance));
+    instanceStream.commit();
+
+    state.bindVertexArray(vao);
+    state.bindBuffer(GL_ARRAY_BUFFER, instanceStream.buffer());
+    const char* base = reinterpret_cast<const char*>(offset);
+    glVertexAttribPointer(PlacementAttribute, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), base + offsetof(Instance, x));
+    glVertexAttribPointer(ColorAttribute, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Instance), base + offsetof(Instance, color));
+    glEnableVertexAttribArray(PlacementAttribute);
+    glEnableVertexAttribArray(ColorAttribute);
+    return count;
+}
+
+void InstancedRenderer::drawEach(const Instance* instances, size_t count, GLint placementLocation, GLint colorLocation,
+                                 GlStateCache& state) {
+    state.bindVertexArray(vao);
+    // The naive shader reads uniforms instead, so the instance arrays must stay off
+    glDisableVertexAttribArray(PlacementAttribute);
+    glDisableVertexAttribArray(ColorAttribute);
+    for (size_t i = 0; i < count; ++i) {
+        const Instance& instance = instances[i];
+        state.uniform4f(placementLocation, instance.x, instance.y, instance.scale, instance.phase);
+        state.uniform4f(colorLocation, instance.color[0] / 255.0f, instance.color[1] / 255.0f,
+                        instance.color[2] / 255.0f, instance.color[3] / 255.0f);
+        glDrawArrays(GL_TRIANGLES, 0, meshVertices);
+    }
+}
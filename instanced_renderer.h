@@ -0,0 +1,68 @@
+#pragma once
+
+#include "gl_state.h"
+#include "glad/gl_core_33.h"
+#include "stream_buffer.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// Placement and colour of one copy of the mesh (20 bytes, read by shaders/instanced_vertex.glsl).
+struct Instance {
+    float x;
+    float y;
+    float scale;
+    float phase;       // added to the rotation angle
+    uint8_t color[4];  // RGBA, normalised in the shader
+};
+
+// Draws many copies of one small mesh.
+//
+// draw() streams the per-instance data into a StreamBuffer and issues a single
+// glDrawArraysInstanced, with the instance attributes advancing once per instance
+// (glVertexAttribDivisor 1). drawEach() is the naive reference: one glDrawArrays per
+// instance with its placement and colour set as uniforms, to measure what instancing saves.
+class InstancedRenderer {
+public:
+    // Attribute locations shared with the shader
+    static const GLuint PositionAttribute = 0;
+    static const GLuint PlacementAttribute = 1;
+    static const GLuint ColorAttribute = 2;
+
+    InstancedRenderer();
+    ~InstancedRenderer();
+
+    // positions is vertexCount xyz triangles in mesh space. Instance data for up to maxInstances
+    // copies per frame is streamed; larger draws are clamped.
+    bool create(const float* positions, int vertexCount, size_t maxInstances, bool persistentMap = true);
+    void destroy();
+
+    // Bracket every frame's draws, so the instance stream can rotate its regions.
+    void beginFrame() { instanceStream.beginFrame(); }
+    void endFrame() { instanceStream.endFrame(); }
+
+    // One draw call for all instances. The current program must use the instanced attributes.
+    // Binds go through state, which is left with vertexArray() bound.
+    void draw(const Instance* instances, size_t count, GlStateCache& state);
+    // Streams the instances and points vertexArray() at them without drawing, for callers that
+    // record the draw for later. Returns how many instances fit.
+    size_t prepare(const Instance* instances, size_t count, GlStateCache& state);
+    // One draw call per instance, setting vec4 placement and colour uniforms in between.
+    void drawEach(const Instance* instances, size_t count, GLint placementLocation, GLint colorLocation,
+                  GlStateCache& state);
+
+    GLuint vertexArray() const { return vao; }
+    int vertexCount() const { return meshVertices; }
+    size_t maxInstances() const { return capacity; }
+    const StreamBuffer& stream() const { return instanceStream; }
+
+private:
+    InstancedRenderer(const InstancedRenderer&);
+    InstancedRenderer& operator=(const InstancedRenderer&);
+
+    GLuint meshVbo;
+    GLuint vao;
+    int meshVertices;
+    size_t capacity;
+    StreamBuffer instanceStream;
+};
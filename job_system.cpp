@@ -0,0 +1,320 @@
+#include "job_system.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace {
+
+// Which system and slot the current thread belongs to
+thread_local JobSystem* threadSystem = nullptr;
+thread_local int threadIndex = -1;
+
+// Failed searches before an idle worker goes to sleep
+const int SpinRounds = 64;
+
+// Ring slots create() looks at between jobs it helps with while the ring is full
+const size_t ScanSlots = 64;
+
+struct RangeJobData {
+    JobSystem::RangeFunction function;
+    void* context;
+    size_t begin;
+    size_t end;
+    size_t grain;
+};
+
+} // namespace
+
+const size_t JobSystem::MaxJobsPerThread;
+const size_t JobSystem::JobDataSize;
+const int64_t JobSystem::Deque::Capacity;
+
+// ---- Deque ----
+
+JobSystem::Deque::Deque()
+    : top(0), bottom(0) {
+    for (size_t i = 0; i < MaxJobsPerThread; ++i) {
+        slots[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+bool JobSystem::Deque::push(Job* job) {
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_acquire);
+    if (b - t >= Capacity) {
+        return false;
+    }
+    slots[b & (Capacity - 1)].store(job, std::memory_order_relaxed);
+    // Publishes the slot and the job's contents to thieves, who read bottom with acquire
+    bottom.store(b + 1, std::memory_order_release);
+    return true;
+}
+
+JobSystem::Job* JobSystem::Deque::pop() {
+    int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_relaxed);
+    if (t > b) {
+        // Empty
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    Job* job = slots[b & (Capacity - 1)].load(std::memory_order_relaxed);
+    if (t == b) {
+        // Last job: race the thieves for it
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            job = nullptr;
+        }
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+JobSystem::Job* JobSystem::Deque::steal() {
+    int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom.load(std::memory_order_acquire);
+    if (t >= b) {
+        return nullptr;
+    }
+    Job* job = slots[t & (Capacity - 1)].load(std::memory_order_relaxed);
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        return nullptr;
+    }
+    return job;
+}
+
+// ---- JobSystem ----
+
+JobSystem::JobSystem(int workerThreads)
+    : stopping(false), sleepers(0) {
+    if (workerThreads < 0) {
+        unsigned hardware = std::thread::hardware_concurrency();
+        workerThreads = hardware > 1 ? static_cast<int>(hardware) - 1 : 0;
+    }
+    for (int i = 0; i <= workerThreads; ++i) {
+        Worker* worker = new Worker();
+        worker->nextJob = 0;
+        worker->random = 0x9E3779B9u * (i + 1);
+        worker->executed = 0;
+        worker->stolen = 0;
+        for (size_t j = 0; j < MaxJobsPerThread; ++j) {
+            worker->jobs[j].unfinished.store(0, std::memory_order_relaxed);
+        }
+        workers.push_back(worker);
+    }
+    threadSystem = this;
+    threadIndex = 0;
+    for (int i = 1; i <= workerThreads; ++i) {
+        workers[i]->thread = std::thread(&JobSystem::workerMain, this, i);
+    }
+}
+
+JobSystem::~JobSystem() {
+    stopping = true;
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        wake.notify_all();
+    }
+    for (size_t i = 1; i < workers.size(); ++i) {
+        workers[i]->thread.join();
+    }
+    for (size_t i = 0; i < workers.size(); ++i) {
+        delete workers[i];
+    }
+    if (threadSystem == this) {
+        threadSystem = nullptr;
+        threadIndex = -1;
+    }
+}
+
+bool JobSystem::ownsThread() const {
+    return threadSystem == this;
+}
+
+JobSystem::Job* JobSystem::create(JobFunction function, Job* parent) {
+    if (threadSystem != this) {
+        std::cerr << "JobSystem: jobs can only be created on its own threads" << std::endl;
+        return nullptr;
+    }
+    Worker& worker = *workers[threadIndex];
+    // Next free slot of the ring. Parents stay in flight while their children run, so slots
+    // don't free up in creation order; while the ones looked at are in flight, help until one
+    // frees up.
+    Job* job = nullptr;
+    while (!job) {
+        for (size_t i = 0; i < ScanSlots && !job; ++i) {
+            Job* slot = &worker.jobs[worker.nextJob++ & (MaxJobsPerThread - 1)];
+            if (slot->unfinished.load(std::memory_order_acquire) == 0) {
+                job = slot;
+            }
+        }
+        if (job) {
+            break;
+        }
+        Job* next = findJob(threadIndex);
+        if (!next) {
+            std::this_thread::yield();
+            continue;
+        }
+        execute(next);
+        // A job of our own ring without children frees its slot right away; take it rather
+        // than scanning the whole ring for it again
+        if (next >= worker.jobs && next < worker.jobs + MaxJobsPerThread &&
+            next->unfinished.load(std::memory_order_acquire) == 0) {
+            job = next;
+        }
+    }
+    job->function = function;
+    job->parent = parent;
+    job->unfinished.store(1, std::memory_order_relaxed);
+    if (parent) {
+        parent->unfinished.fetch_add(1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+void JobSystem::run(Job* job) {
+    if (!workers[threadIndex]->queue.push(job)) {
+        // Only happens with more than MaxJobsPerThread jobs in flight
+        execute(job);
+        return;
+    }
+    if (sleepers.load(std::memory_order_relaxed) > 0) {
+        wake.notify_one();
+    }
+}
+
+void JobSystem::wait(const Job* job) {
+    while (job->unfinished.load(std::memory_order_acquire) > 0) {
+        Job* next = findJob(threadIndex);
+        if (next) {
+            execute(next);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+JobSystem::Job* JobSystem::findJob(int index) {
+    Worker& worker = *workers[index];
+    Job* job = worker.queue.pop();
+    if (job) {
+        return job;
+    }
+    int count = static_cast<int>(workers.size());
+    if (count < 2) {
+        return nullptr;
+    }
+    // Start at a random victim so thieves spread out
+    worker.random ^= worker.random << 13;
+    worker.random ^= worker.random >> 17;
+    worker.random ^= worker.random << 5;
+    int start = static_cast<int>(worker.random % static_cast<uint32_t>(count));
+    for (int i = 0; i < count; ++i) {
+        int victim = (start + i) % count;
+        if (victim == index) {
+            continue;
+        }
+        job = workers[victim]->queue.steal();
+        if (job) {
+            worker.stolen.fetch_add(1, std::memory_order_relaxed);
+            return job;
+        }
+    }
+    return nullptr;
+}
+
+void JobSystem::execute(Job* job) {
+    job->function(*job, job->data);
+    workers[threadIndex]->executed.fetch_add(1, std::memory_order_relaxed);
+    finish(job);
+}
+
+void JobSystem::finish(Job* job) {
+    // Read before the decrement: once it reaches zero a waiter may recycle the slot
+    Job* parent = job->parent;
+    if (job->unfinished.fetch_sub(1, std::memory_order_acq_rel) == 1 && parent) {
+        finish(parent);
+    }
+}
+
+void JobSystem::workerMain(int index) {
+    threadSystem = this;
+    threadIndex = index;
+    int idle = 0;
+    while (!stopping.load(std::memory_order_relaxed)) {
+        Job* job = findJob(index);
+        if (job) {
+            execute(job);
+            idle = 0;
+            continue;
+        }
+        if (++idle < SpinRounds) {
+            std::this_thread::yield();
+            continue;
+        }
+        // A wakeup can be missed between the search and the wait; the timeout bounds the cost
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepers.fetch_add(1, std::memory_order_relaxed);
+        wake.wait_for(lock, std::chrono::milliseconds(1));
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+void JobSystem::parallelForJob(Job& job, void* data) {
+    RangeJobData range;
+    std::memcpy(&range, data, sizeof(range));
+    JobSystem& system = *threadSystem;
+    // Split in halves until a piece fits the grain; thieves take the big halves first
+    while (range.end - range.begin > range.grain) {
+        size_t middle = range.begin + (range.end - range.begin) / 2;
+        RangeJobData upper = range;
+        upper.begin = middle;
+        system.run(system.create(parallelForJob, upper, &job));
+        range.end = middle;
+    }
+    range.function(range.begin, range.end, range.context);
+}
+
+void JobSystem::parallelFor(size_t count, size_t grain, RangeFunction function, void* context) {
+    if (count == 0) {
+        return;
+    }
+    RangeJobData range = { function, context, 0, count, std::max<size_t>(grain, 1) };
+    Job* root = create(parallelForJob, range);
+    if (!root) {
+        return;
+    }
+    run(root);
+    wait(root);
+}
+
+uint64_t JobSystem::executed() const {
+    uint64_t total = 0;
+    for (size_t i = 0; i < workers.size(); ++i) {
+        total += workers[i]->executed.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+uint64_t JobSystem::stolen() const {
+    uint64_t total = 0;
+    for (size_t i = 0; i < workers.size(); ++i) {
+        total += workers[i]->stolen.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void JobSystem::resetStats() {
+    for (size_t i = 0; i < workers.size(); ++i) {
+        workers[i]->executed = 0;
+        workers[i]->stolen = 0;
+    }
+}
+
+void JobSystem::printJson(std::ostream& out) const {
+    out << "{\"threads\": " << threadCount() << ", \"executed\": " << executed() << ", \"stolen\": " << stolen() << "}";
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+// Fixed-size work-stealing thread pool for per-frame CPU work.
+//
+// Every thread owns a Chase-Lev deque: it pushes and pops its own jobs at the bottom (LIFO, so
+// the data it just touched is still in cache) while idle threads steal from the top (FIFO, so
+// they take the biggest, oldest pieces of work). Jobs come out of a per-thread ring of
+// MaxJobsPerThread preallocated slots, so creating one never allocates. A slot is reused once
+// its job and all its children have finished; a thread with that many jobs in flight runs
+// queued jobs inside create() until one does, so it must not hold that many created but not run.
+//
+// A job counts itself and its unfinished children. Creating a job with a parent adds one to the
+// parent, and finishing it subtracts one, so waiting on the root of a tree waits for all of it.
+// wait() runs other jobs instead of blocking.
+//
+// The thread that constructs the JobSystem is thread 0 and, besides the workers, the only thread
+// that may create, run and wait for jobs.
+class JobSystem {
+public:
+    static const size_t MaxJobsPerThread = 4096;
+    static const size_t JobDataSize = 40;
+
+    struct Job;
+    typedef void (*JobFunction)(Job& job, void* data);
+    // Processes items [begin, end); context is parallelFor()'s argument.
+    typedef void (*RangeFunction)(size_t begin, size_t end, void* context);
+
+    // 64 bytes, one cache line
+    struct Job {
+        JobFunction function;
+        Job* parent;
+        std::atomic<int32_t> unfinished;
+        alignas(8) char data[JobDataSize];
+    };
+
+    // workerThreads < 0 starts one per hardware thread besides the caller; 0 runs everything on
+    // the calling thread.
+    explicit JobSystem(int workerThreads = -1);
+    ~JobSystem();
+
+    // Worker threads plus the calling thread
+    int threadCount() const { return static_cast<int>(workers.size()); }
+    // Whether the calling thread may create jobs: the constructing thread or a worker
+    bool ownsThread() const;
+
+    // Returns nullptr when called from a thread that doesn't belong to this system.
+    Job* create(JobFunction function, Job* parent = nullptr);
+    // data is copied into the job; it must be trivially copyable and fit in JobDataSize bytes.
+    template <typename T>
+    Job* create(JobFunction function, const T& data, Job* parent = nullptr) {
+        static_assert(sizeof(T) <= JobDataSize, "job data too large");
+        Job* job = create(function, parent);
+        if (job) {
+            std::memcpy(job->data, &data, sizeof(T));
+        }
+        return job;
+    }
+    void run(Job* job);
+    // Runs jobs until job and all its children have finished.
+    void wait(const Job* job);
+
+    // Calls function on ranges of at most grain items covering [0, count), in parallel, and
+    // returns when all have finished.
+    void parallelFor(size_t count, size_t grain, RangeFunction function, void* context);
+
+    // Counters since construction or the last resetStats()
+    uint64_t executed() const;
+    uint64_t stolen() const;
+    void resetStats();
+    // {"threads": .., "executed": .., "stolen": ..}
+    void printJson(std::ostream& out) const;
+
+private:
+    JobSystem(const JobSystem&);
+    JobSystem& operator=(const JobSystem&);
+
+    // Chase-Lev deque over a fixed ring (Lê et al., "Correct and Efficient Work-Stealing for Weak
+    // Memory Models"). push() and pop() only from the owner; steal() from any thread.
+    class Deque {
+    public:
+        Deque();
+        bool push(Job* job);
+        Job* pop();
+        Job* steal();
+
+    private:
+        static const int64_t Capacity = static_cast<int64_t>(MaxJobsPerThread);
+        std::atomic<int64_t> top;
+        char padding[64 - sizeof(std::atomic<int64_t>)];  // top is written by thieves, bottom by the owner
+        std::atomic<int64_t> bottom;
+        std::atomic<Job*> slots[MaxJobsPerThread];
+    };
+
+    struct Worker {
+        Deque queue;
+        Job jobs[MaxJobsPerThread];
+        size_t nextJob;
+        uint32_t random;  // xorshift state for picking a victim
+        std::atomic<uint64_t> executed;
+        std::atomic<uint64_t> stolen;
+        std::thread thread;
+    };
+
+    void workerMain(int index);
+    Job* findJob(int index);
+    void execute(Job* job);
+    void finish(Job* job);
+    static void parallelForJob(Job& job, void* data);
+
+    std::vector<Worker*> workers;
+    std::atomic<bool> stopping;
+    std::atomic<int> sleepers;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+};
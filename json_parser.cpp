@@ -0,0 +1,386 @@
+#include "json_parser.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+const JsonDocument::Value JsonDocument::None;
+
+namespace {
+
+// Deep enough for any sane document, shallow enough that the recursion can't exhaust the stack
+const uint32_t MaxDepth = 256;
+
+int hexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+void appendUtf8(std::string& out, uint32_t codePoint) {
+    if (codePoint < 0x80) {
+        out += static_cast<char>(codePoint);
+    } else if (codePoint < 0x800) {
+        out += static_cast<char>(0xc0 | (codePoint >> 6));
+        out += static_cast<char>(0x80 | (codePoint & 0x3f));
+    } else if (codePoint < 0x10000) {
+        out += static_cast<char>(0xe0 | (codePoint >> 12));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+        out += static_cast<char>(0x80 | (codePoint & 0x3f));
+    } else {
+        out += static_cast<char>(0xf0 | (codePoint >> 18));
+        out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3f));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+        out += static_cast<char>(0x80 | (codePoint & 0x3f));
+    }
+}
+
+uint32_t readHex4(const char* text) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; ++i) {
+        value = value * 16 + static_cast<uint32_t>(hexDigit(text[i]));
+    }
+    return value;
+}
+
+// Resolves the escapes of a string the parser has already validated
+std::string unescape(const char* text, uint32_t length) {
+    std::string out;
+    out.reserve(length);
+    const char* end = text + length;
+    while (text < end) {
+        if (*text != '\\') {
+            out += *text++;
+            continue;
+        }
+        char escape = text[1];
+        text += 2;
+        switch (escape) {
+        case 'b': out += '\b'; break;
+        case 'f': out += '\f'; break;
+        case 'n': out += '\n'; break;
+        case 'r': out += '\r'; break;
+        case 't': out += '\t'; break;
+        case 'u': {
+            uint32_t codePoint = readHex4(text);
+            text += 4;
+            // A high surrogate followed by a low one is a single code point above the BMP
+            if (codePoint >= 0xd800 && codePoint < 0xdc00 && end - text >= 6 && text[0] == '\\' && text[1] == 'u') {
+                uint32_t low = readHex4(text + 2);
+                if (low >= 0xdc00 && low < 0xe000) {
+                    codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + (low - 0xdc00);
+                    text += 6;
+                }
+            }
+            appendUtf8(out, codePoint);
+            break;
+        }
+        default: out += escape; break;  // \" \\ \/
+        }
+    }
+    return out;
+}
+
+} // namespace
+
+bool JsonDocument::parse(const char* text, size_t length, const std::string& name) {
+    nodes.clear();
+    begin = text;
+    cursor = text;
+    end = text + length;
+    documentName = name;
+    // Skip a UTF-8 byte order mark
+    if (length >= 3 && std::memcmp(text, "\xef\xbb\xbf", 3) == 0) {
+        cursor += 3;
+    }
+    // Every value takes at least a character, so 32-bit value indices need a 32-bit length
+    if (length > 0xffffffffu) {
+        return fail("document too large");
+    }
+    skipSpace();
+    if (!parseValue(0)) {
+        nodes.clear();
+        return false;
+    }
+    skipSpace();
+    if (cursor != end) {
+        nodes.clear();
+        return fail("trailing characters after the document");
+    }
+    return true;
+}
+
+bool JsonDocument::fail(const char* message) {
+    size_t line = 1;
+    for (const char* c = begin; c < cursor && c < end; ++c) {
+        line += *c == '\n';
+    }
+    std::cerr << documentName << ":" << line << ": " << message << std::endl;
+    return false;
+}
+
+void JsonDocument::skipSpace() {
+    while (cursor < end && (*cursor == ' ' || *cursor == '\n' || *cursor == '\r' || *cursor == '\t')) {
+        ++cursor;
+    }
+}
+
+bool JsonDocument::parseString(const char*& start, uint32_t& length, bool& escaped) {
+    // cursor is on the opening quote
+    ++cursor;
+    start = cursor;
+    escaped = false;
+    while (cursor < end && *cursor != '"') {
+        unsigned char c = static_cast<unsigned char>(*cursor);
+        if (c < 0x20) {
+            return fail("control character in string");
+        }
+        if (c == '\\') {
+            escaped = true;
+            if (end - cursor < 2) {
+                return fail("unterminated string");
+            }
+            char escape = cursor[1];
+            if (escape == 'u') {
+                if (end - cursor < 6 || hexDigit(cursor[2]) < 0 || hexDigit(cursor[3]) < 0
+                    || hexDigit(cursor[4]) < 0 || hexDigit(cursor[5]) < 0) {
+                    return fail("invalid \\u escape");
+                }
+                cursor += 6;
+                continue;
+            }
+            if (!std::strchr("\"\\/bfnrt", escape) || escape == '\0') {
+                return fail("invalid escape");
+            }
+            cursor += 2;
+            continue;
+        }
+        ++cursor;
+    }
+    if (cursor >= end) {
+        return fail("unterminated string");
+    }
+    length = static_cast<uint32_t>(cursor - start);
+    ++cursor;
+    return true;
+}
+
+bool JsonDocument::parseValue(uint32_t depth) {
+    if (depth > MaxDepth) {
+        return fail("nested too deeply");
+    }
+    if (cursor >= end) {
+        return fail("unexpected end of document");
+    }
+    Node node;
+    std::memset(&node, 0, sizeof(node));
+    node.firstChild = None;
+    node.nextSibling = None;
+    uint32_t self = static_cast<uint32_t>(nodes.size());
+    char c = *cursor;
+    if (c == '{' || c == '[') {
+        bool object = c == '{';
+        char close = object ? '}' : ']';
+        node.type = object ? Type::Object : Type::Array;
+        nodes.push_back(node);
+        ++cursor;
+        skipSpace();
+        uint32_t previous = None;
+        if (cursor < end && *cursor == close) {
+            ++cursor;
+            return true;
+        }
+        for (;;) {
+            const char* key = nullptr;
+            uint32_t keyLength = 0;
+            bool keyEscaped = false;
+            if (object) {
+                if (cursor >= end || *cursor != '"') {
+                    return fail("expected a member name");
+                }
+                if (!parseString(key, keyLength, keyEscaped)) {
+                    return false;
+                }
+                skipSpace();
+                if (cursor >= end || *cursor != ':') {
+                    return fail("expected ':'");
+                }
+                ++cursor;
+                skipSpace();
+            }
+            uint32_t child = static_cast<uint32_t>(nodes.size());
+            if (!parseValue(depth + 1)) {
+                return false;
+            }
+            // nodes may have grown; index, don't hold references
+            nodes[child].key = key;
+            nodes[child].keyLength = keyLength;
+            nodes[child].keyEscaped = keyEscaped;
+            if (previous == None) {
+                nodes[self].firstChild = child;
+            } else {
+                nodes[previous].nextSibling = child;
+            }
+            previous = child;
+            ++nodes[self].childCount;
+            skipSpace();
+            if (cursor < end && *cursor == ',') {
+                ++cursor;
+                skipSpace();
+                continue;
+            }
+            if (cursor < end && *cursor == close) {
+                ++cursor;
+                return true;
+            }
+            return fail(object ? "expected ',' or '}'" : "expected ',' or ']'");
+        }
+    }
+    if (c == '"') {
+        node.type = Type::String;
+        if (!parseString(node.text, node.textLength, node.escaped)) {
+            return false;
+        }
+        nodes.push_back(node);
+        return true;
+    }
+    if (c == '-' || (c >= '0' && c <= '9')) {
+        // Find the number's extent by the JSON grammar, then convert a terminated copy: the text
+        // may end right after it
+        const char* start = cursor;
+        if (*cursor == '-') ++cursor;
+        const char* digits = cursor;
+        while (cursor < end && *cursor >= '0' && *cursor <= '9') ++cursor;
+        if (cursor == digits || (*digits == '0' && cursor - digits > 1)) {
+            return fail("invalid number");
+        }
+        if (cursor < end && *cursor == '.') {
+            ++cursor;
+            digits = cursor;
+            while (cursor < end && *cursor >= '0' && *cursor <= '9') ++cursor;
+            if (cursor == digits) {
+                return fail("invalid number");
+            }
+        }
+        if (cursor < end && (*cursor == 'e' || *cursor == 'E')) {
+            ++cursor;
+            if (cursor < end && (*cursor == '+' || *cursor == '-')) ++cursor;
+            digits = cursor;
+            while (cursor < end && *cursor >= '0' && *cursor <= '9') ++cursor;
+            if (cursor == digits) {
+                return fail("invalid number");
+            }
+        }
+        char buffer[64];
+        size_t length = static_cast<size_t>(cursor - start);
+        if (length < sizeof(buffer)) {
+            std::memcpy(buffer, start, length);
+            buffer[length] = '\0';
+            node.numberValue = std::strtod(buffer, nullptr);
+        } else {
+            node.numberValue = std::strtod(std::string(start, length).c_str(), nullptr);
+        }
+        node.type = Type::Number;
+        nodes.push_back(node);
+        return true;
+    }
+    static const struct { const char* text; size_t length; Type type; } literals[] = {
+        { "true", 4, Type::True }, { "false", 5, Type::False }, { "null", 4, Type::Null }
+    };
+    for (size_t i = 0; i < 3; ++i) {
+        if (static_cast<size_t>(end - cursor) >= literals[i].length
+            && std::memcmp(cursor, literals[i].text, literals[i].length) == 0) {
+            cursor += literals[i].length;
+            node.type = literals[i].type;
+            nodes.push_back(node);
+            return true;
+        }
+    }
+    return fail("unexpected character");
+}
+
+JsonDocument::Value JsonDocument::find(Value object, const char* key) const {
+    if (object == None || nodes[object].type != Type::Object) {
+        return None;
+    }
+    for (Value member = nodes[object].firstChild; member != None; member = nodes[member].nextSibling) {
+        if (keyEquals(member, key)) {
+            return member;
+        }
+    }
+    return None;
+}
+
+JsonDocument::Value JsonDocument::at(Value array, uint32_t index) const {
+    if (array == None || nodes[array].type != Type::Array || index >= nodes[array].childCount) {
+        return None;
+    }
+    Value element = nodes[array].firstChild;
+    for (uint32_t i = 0; i < index; ++i) {
+        element = nodes[element].nextSibling;
+    }
+    return element;
+}
+
+bool JsonDocument::keyEquals(Value member, const char* key) const {
+    const Node& node = nodes[member];
+    size_t length = std::strlen(key);
+    if (node.keyEscaped) {
+        return unescape(node.key, node.keyLength) == key;
+    }
+    return node.keyLength == length && std::memcmp(node.key, key, length) == 0;
+}
+
+double JsonDocument::number(Value value, double fallback) const {
+    return value != None && nodes[value].type == Type::Number ? nodes[value].numberValue : fallback;
+}
+
+bool JsonDocument::boolean(Value value, bool fallback) const {
+    if (value == None || (nodes[value].type != Type::True && nodes[value].type != Type::False)) {
+        return fallback;
+    }
+    return nodes[value].type == Type::True;
+}
+
+std::string JsonDocument::string(Value value) const {
+    if (value == None || nodes[value].type != Type::String) {
+        return std::string();
+    }
+    const Node& node = nodes[value];
+    return node.escaped ? unescape(node.text, node.textLength) : std::string(node.text, node.textLength);
+}
+
+double JsonDocument::number(Value object, const char* key, double fallback) const {
+    return number(find(object, key), fallback);
+}
+
+uint32_t JsonDocument::index(Value value, uint32_t fallback) const {
+    double parsed = number(value, -1.0);
+    return parsed >= 0.0 && parsed < 4294967295.0 && parsed == static_cast<double>(static_cast<uint32_t>(parsed))
+        ? static_cast<uint32_t>(parsed) : fallback;
+}
+
+uint32_t JsonDocument::index(Value object, const char* key, uint32_t fallback) const {
+    return index(find(object, key), fallback);
+}
+
+bool JsonDocument::size(Value object, const char* key, size_t fallback, size_t& result) const {
+    Value member = find(object, key);
+    if (member == None) {
+        result = fallback;
+        return true;
+    }
+    double value = number(member, -1.0);
+    // Below 2^53 every integer is exact, so the round trip catches fractions
+    if (value < 0.0 || value >= 9007199254740992.0 || value > static_cast<double>(SIZE_MAX)
+        || value != static_cast<double>(static_cast<uint64_t>(value))) {
+        return false;
+    }
+    result = static_cast<size_t>(value);
+    return true;
+}
+
+std::string JsonDocument::string(Value object, const char* key) const {
+    return string(find(object, key));
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Read-only JSON document parsed in one pass over text that outlives it, such as a mapped file.
+//
+// Values are stored in a flat array in document order; containers link to their first child
+// and every value to its next sibling, so walking a document never allocates. Strings and keys
+// point into the text with their escapes still in place: find() compares raw bytes unless
+// the key has escapes, and string() resolves them on request.
+class JsonDocument {
+public:
+    enum class Type : uint8_t { Null, False, True, Number, String, Array, Object };
+
+    typedef uint32_t Value;
+    static const Value None = 0xffffffffu;
+
+    JsonDocument() {}
+
+    // Parses text[0, length); on failure says where on stderr and returns false. name is only
+    // used in messages.
+    bool parse(const char* text, size_t length, const std::string& name);
+
+    Value root() const { return nodes.empty() ? None : 0; }
+    size_t size() const { return nodes.size(); }
+
+    Type type(Value value) const { return nodes[value].type; }
+    // Members and elements in order: first(container), then next(child) until None
+    Value first(Value container) const { return nodes[container].firstChild; }
+    Value next(Value value) const { return nodes[value].nextSibling; }
+    uint32_t count(Value container) const { return nodes[container].childCount; }
+
+    // The member named key of an object, or None (also for values that aren't objects)
+    Value find(Value object, const char* key) const;
+    // Element index of an array, or None
+    Value at(Value array, uint32_t index) const;
+    // Whether an object member is named key
+    bool keyEquals(Value member, const char* key) const;
+
+    double number(Value value, double fallback = 0.0) const;
+    // A non-negative integer that fits uint32_t below None, such as an array element naming an
+    // index; fallback for anything else
+    uint32_t index(Value value, uint32_t fallback = None) const;
+    bool boolean(Value value, bool fallback = false) const;
+    std::string string(Value value) const;
+
+    // Shorthands for find() and a conversion, with fallbacks for missing or mistyped members
+    double number(Value object, const char* key, double fallback) const;
+    uint32_t index(Value object, const char* key, uint32_t fallback = None) const;
+    // A byte count or offset: false when the member is there but not a non-negative integer
+    // that fits size_t, else true with result set to it, or to fallback when it's missing
+    bool size(Value object, const char* key, size_t fallback, size_t& result) const;
+    std::string string(Value object, const char* key) const;
+
+private:
+    struct Node {
+        Type type;
+        bool escaped;        // string or key with backslashes
+        bool keyEscaped;
+        uint32_t firstChild;
+        uint32_t nextSibling;
+        uint32_t childCount;
+        const char* key;     // member name when the parent is an object
+        uint32_t keyLength;
+        const char* text;    // string contents
+        uint32_t textLength;
+        double numberValue;
+    };
+
+    bool parseValue(uint32_t depth);
+    bool parseString(const char*& start, uint32_t& length, bool& escaped);
+    bool fail(const char* message);
+    void skipSpace();
+
+    std::vector<Node> nodes;
+    const char* begin;
+    const char* cursor;
+    const char* end;
+    std::string documentName;
+};
@@ -0,0 +1,143 @@
+#include "lod_manager.h"
+
+#include <algorithm>
+#include <cmath>
+
+const int LodManager::MaxLevels;
+
+namespace {
+
+// The bias stays within this range however long the frames get
+const float MinBias = 1.0f / 64.0f;
+const float MaxBias = 64.0f;
+
+} // namespace
+
+LodManager::View LodManager::View::makePerspective(const float eye[3], float fovY, int viewportHeight) {
+    View view;
+    std::copy(eye, eye + 3, view.eye);
+    view.pixelsPerUnit = viewportHeight / (2.0f * std::tan(fovY * 0.5f));
+    view.perspective = true;
+    return view;
+}
+
+LodManager::View LodManager::View::makeOrthographic(float viewHeight, int viewportHeight) {
+    View view;
+    view.eye[0] = view.eye[1] = view.eye[2] = 0.0f;
+    view.pixelsPerUnit = viewportHeight / viewHeight;
+    view.perspective = false;
+    return view;
+}
+
+LodManager::LodManager()
+    : thresholdPixels(1.0f),
+      hysteresis(0.2f),
+      currentBias(1.0f),
+      budgetMs(0.0),
+      smoothedFrameMs(0.0),
+      selectedTriangles(0),
+      levelSwitches(0),
+      totalSwitches(0) {
+    std::fill(levelObjects, levelObjects + MaxLevels, 0);
+}
+
+uint32_t LodManager::addMesh(const float* errors, const uint32_t* triangles, int levelCount) {
+    Mesh mesh;
+    mesh.levelCount = std::max(1, std::min(levelCount, static_cast<int>(MaxLevels)));
+    for (int i = 0; i < mesh.levelCount; ++i) {
+        mesh.errors[i] = errors[i];
+        mesh.triangles[i] = triangles[i];
+    }
+    meshes.push_back(mesh);
+    return static_cast<uint32_t>(meshes.size() - 1);
+}
+
+uint32_t LodManager::addObject(uint32_t mesh, const float center[3], float radius) {
+    Object object;
+    object.mesh = mesh;
+    object.level = 0;
+    objects.push_back(object);
+    setObject(static_cast<uint32_t>(objects.size() - 1), center, radius);
+    return static_cast<uint32_t>(objects.size() - 1);
+}
+
+void LodManager::setObject(uint32_t object, const float center[3], float radius) {
+    std::copy(center, center + 3, objects[object].center);
+    objects[object].radius = radius;
+}
+
+void LodManager::setBias(float value) {
+    currentBias = std::max(MinBias, std::min(value, MaxBias));
+}
+
+void LodManager::adaptBias(double frameMs) {
+    if (budgetMs <= 0.0 || frameMs <= 0.0) {
+        return;
+    }
+    // Smoothed so a single hitch does not drop detail across the board
+    smoothedFrameMs = smoothedFrameMs > 0.0 ? smoothedFrameMs * 0.9 + frameMs * 0.1 : frameMs;
+    if (smoothedFrameMs > budgetMs * 1.05) {
+        setBias(currentBias * 1.1f);
+    } else if (smoothedFrameMs < budgetMs * 0.8) {
+        setBias(currentBias / 1.05f);
+    }
+}
+
+uint64_t LodManager::select(const View& view, const uint32_t* objectIndices, size_t count) {
+    float allowed = thresholdPixels * currentBias;
+    float refineAbove = allowed * (1.0f + hysteresis);
+    float coarsenBelow = allowed * (1.0f - hysteresis);
+    selectedTriangles = 0;
+    levelSwitches = 0;
+    std::fill(levelObjects, levelObjects + MaxLevels, 0);
+    for (size_t i = 0; i < count; ++i) {
+        Object& object = objects[objectIndices[i]];
+        const Mesh& mesh = meshes[object.mesh];
+
+        // Pixels per world unit at the object's nearest point
+        float scale = view.pixelsPerUnit;
+        if (view.perspective) {
+            float dx = object.center[0] - view.eye[0];
+            float dy = object.center[1] - view.eye[1];
+            float dz = object.center[2] - view.eye[2];
+            float distance = std::sqrt(dx * dx + dy * dy + dz * dz) - object.radius;
+            // Inside the bounds: as much detail as there is
+            scale = distance > 1e-3f ? scale / distance : 1e30f;
+        }
+
+        int level = std::min(object.level, mesh.levelCount - 1);
+        while (level > 0 && mesh.errors[level] * scale > refineAbove) {
+            --level;
+        }
+        while (level + 1 < mesh.levelCount && mesh.errors[level + 1] * scale <= coarsenBelow) {
+            ++level;
+        }
+        if (level != object.level) {
+            object.level = level;
+            ++levelSwitches;
+        }
+        selectedTriangles += mesh.triangles[level];
+        ++levelObjects[level];
+    }
+    totalSwitches += levelSwitches;
+    return selectedTriangles;
+}
+
+void LodManager::printJson(std::ostream& out) const {
+    out << "{\"threshold_px\": " << thresholdPixels
+        << ", \"hysteresis\": " << hysteresis
+        << ", \"bias\": " << currentBias
+        << ", \"budget_ms\": " << budgetMs
+        << ", \"triangles\": " << selectedTriangles
+        << ", \"switches\": " << levelSwitches
+        << ", \"total_switches\": " << totalSwitches
+        << ", \"levels\": [";
+    int used = MaxLevels;
+    while (used > 1 && levelObjects[used - 1] == 0) {
+        --used;
+    }
+    for (int i = 0; i < used; ++i) {
+        out << (i ? ", " : "") << levelObjects[i];
+    }
+    out << "]}";
+}
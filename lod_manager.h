@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// Picks a level of detail per object from its projected screen-space error.
+//
+// A mesh has up to MaxLevels levels, finest first. Each level has a geometric error: how far its
+// surface can be from the full-detail one, in world units. select() projects that error to pixels
+// for every object it is given and picks the coarsest level within threshold * bias pixels.
+//
+// Near the threshold, small camera moves or bias changes would flip objects between two levels
+// every frame. Hysteresis widens the switch points into a band. An object only refines once its
+// level's error exceeds the threshold by the hysteresis fraction. It only coarsens once the next
+// level's error is that fraction below it.
+//
+// With a frame-time budget set, adaptBias() raises the bias when frames take too long and
+// lowers it again once there is headroom.
+class LodManager {
+public:
+    static const int MaxLevels = 8;
+
+    // How world-space error turns into pixels
+    struct View {
+        float eye[3];
+        float pixelsPerUnit;  // at distance 1 for perspective views
+        bool perspective;
+
+        static View makePerspective(const float eye[3], float fovY, int viewportHeight);
+        // viewHeight is the world-space height the viewport shows
+        static View makeOrthographic(float viewHeight, int viewportHeight);
+    };
+
+    LodManager();
+
+    // errors and triangles hold levelCount entries, finest level first. Returns the mesh's index.
+    uint32_t addMesh(const float* errors, const uint32_t* triangles, int levelCount);
+    // Objects start at their mesh's finest level. Returns the object's index.
+    uint32_t addObject(uint32_t mesh, const float center[3], float radius);
+    void setObject(uint32_t object, const float center[3], float radius);
+    size_t objectCount() const { return objects.size(); }
+
+    void setThreshold(float pixels) { thresholdPixels = pixels; }
+    float threshold() const { return thresholdPixels; }
+    void setHysteresis(float fraction) { hysteresis = fraction; }
+    // Above 1 accepts more error, below 1 less
+    void setBias(float value);
+    float bias() const { return currentBias; }
+
+    // 0 turns the controller off and leaves the bias where it is
+    void setBudget(double frameMs) { budgetMs = frameMs; }
+    double budget() const { return budgetMs; }
+    void adaptBias(double frameMs);
+
+    // Updates the levels of the listed objects; the rest keep theirs. Returns the listed objects'
+    // triangle count at their new levels.
+    uint64_t select(const View& view, const uint32_t* objectIndices, size_t count);
+    int level(uint32_t object) const { return objects[object].level; }
+
+    // Of the last select()
+    uint64_t triangles() const { return selectedTriangles; }
+    uint64_t switches() const { return levelSwitches; }
+
+    // {"threshold_px": .., "hysteresis": .., "bias": .., "budget_ms": .., "triangles": ..,
+    //  "switches": .., "total_switches": .., "levels": [objects per level]}
+    void printJson(std::ostream& out) const;
+
+private:
+    struct Mesh {
+        int levelCount;
+        float errors[MaxLevels];
+        uint32_t triangles[MaxLevels];
+    };
+
+    struct Object {
+        uint32_t mesh;
+        float center[3];
+        float radius;
+        int level;
+    };
+
+    std::vector<Mesh> meshes;
+    std::vector<Object> objects;
+    float thresholdPixels;
+    float hysteresis;
+    float currentBias;
+    double budgetMs;
+    double smoothedFrameMs;
+    uint64_t selectedTriangles;
+    uint64_t levelSwitches;
+    uint64_t totalSwitches;
+    uint64_t levelObjects[MaxLevels];
+};
@@ -1,69 +1,914 @@
 #include "glad/gl_core_33.h"
 #include <GLFW/glfw3.h>
+#include "frame_pipeline.h"
+#include "frame_stats.h"
+#include "bvh.h"
+#include "frustum_culler.h"
+#include "gl_state.h"
+#include "gpu_mesh.h"
+#include "gpu_profiler.h"
+#include "instanced_renderer.h"
+#include "job_system.h"
+#include "lod_manager.h"
+#include "mesh_file.h"
+#include "mesh_batcher.h"
+#include "render_queue.h"
+#include "render_target.h"
+#include "shader.h"
+#include "shader_cache.h"
+#include "shader_manager.h"
+#include "shader_variants.h"
+#include "shader_watcher.h"
+#include "stream_buffer.h"
+#include "vertex_format.h"
+#include "vertex_layout.h"
+#ifdef GRAPHICS_DEMO_HAS_EGL
+#include "headless_context.h"
+#endif
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
-#include <fstream>
+#include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
 #include <iomanip>
 
+// Input flags set from GLFW callbacks and consumed by the render loop
+struct InputState {
+    bool reportRequested = false;
+    bool cycleQuality = false;  // Q
+    bool toggleDither = false;  // B
+};
 
-// Function to load shader from file
-std::string loadShaderSource(const char* filepath) {
-    std::ifstream file(filepath);
-    if (!file.is_open()) {
-        std::cerr << "Failed to open shader file: " << filepath << std::endl;
-        return "";
+void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    (void)scancode;
+    (void)mods;
+    InputState* input = static_cast<InputState*>(glfwGetWindowUserPointer(window));
+    if (!input || action != GLFW_PRESS) {
+        return;
+    }
+    if (key == GLFW_KEY_F1) {
+        input->reportRequested = true;
+    } else if (key == GLFW_KEY_Q) {
+        input->cycleQuality = true;
+    } else if (key == GLFW_KEY_B) {
+        input->toggleDither = true;
     }
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    return buffer.str();
 }
 
-// Function to compile shader
-GLuint compileShader(GLenum type, const char* source) {
-    GLuint shader = glCreateShader(type);
-    glShaderSource(shader, 1, &source, nullptr);
-    glCompileShader(shader);
-    
-    GLint success;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        char infoLog[512];
-        glGetShaderInfoLog(shader, 512, nullptr, infoLog);
-        std::cerr << "Shader compilation failed:\n" << infoLog << std::endl;
-        return 0;
+// Command line options
+struct DemoOptions {
+    bool headless = false;  // --headless: render offscreen into an FBO and exit
+    int frames = 1000;      // --frames=N: frame count for headless runs
+    int width = 800;        // --size=WxH
+    int height = 600;
+    bool shaderCache = true; // --no-shader-cache: always compile shaders from source
+    bool hotReload = true;   // --no-hot-reload: don't watch shaders/ for changes
+    int quality = 0;         // --quality=low|medium|high: fragment shader variant
+    bool dither = false;     // --dither
+    bool lazyVariants = false; // --lazy-variants: build shader variants on first use
+    int dynamicTriangles = 0;  // --dynamic=N: animated triangles streamed every frame
+    bool persistentMap = true; // --no-persistent-map: stream through glMapBufferRange only
+    int instances = 0;           // --instances=N: copies of a mesh drawn with one instanced call
+    bool naiveInstances = false; // --naive-instances: draw them with one call each instead
+    bool instanceSweep = false;  // --instance-sweep: headless 1..1M instance benchmark
+    int staticMeshes = 0;        // --static-meshes=N: static shapes merged by MeshBatcher
+    bool batching = true;        // --no-batching: draw them one call per mesh instead
+    bool renderQueue = false;    // --render-queue: record draws, sort them by state and replay
+    bool stateCache = true;      // --no-state-cache: issue every bind and uniform upload
+    bool renderThread = false;   // --render-thread: simulate on this thread, draw on another
+    double simulationMs = 0.0;   // --sim-ms=X: extra CPU work per simulated frame
+    int jobThreads = -1;         // --jobs=N: simulation worker threads (default: one per extra core)
+    int cullPath = -1;           // --cull-path=scalar|sse|avx2 (default: the best the CPU has)
+    bool bvh = false;            // --bvh: cull static meshes through a BVH instead of a linear scan
+    bool lod = false;            // --lod: static meshes become discs with levels of detail
+    float lodBias = 1.0f;        // --lod-bias=X: scales the screen-space error allowed
+    double lodBudgetMs = 0.0;    // --lod-budget=MS: adapt the bias to this frame time
+    bool lodSweep = false;       // --lod-sweep: headless triangles vs frame time per bias
+    bool quantize = false;       // --quantize: coloured static meshes store 16-bit normalised positions
+    std::string meshPath;        // --mesh=FILE: draw a mesh file written by mesh_convert
+};
+
+bool parseOptions(int argc, char** argv, DemoOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (std::strcmp(arg, "--headless") == 0) {
+            options.headless = true;
+        } else if (std::strncmp(arg, "--frames=", 9) == 0) {
+            options.frames = std::atoi(arg + 9);
+            if (options.frames <= 0) {
+                std::cerr << "Invalid frame count: " << arg << std::endl;
+                return false;
+            }
+        } else if (std::strncmp(arg, "--size=", 7) == 0) {
+            if (std::sscanf(arg + 7, "%dx%d", &options.width, &options.height) != 2
+                || options.width <= 0 || options.height <= 0) {
+                std::cerr << "Invalid size (expected WxH): " << arg << std::endl;
+                return false;
+            }
+        } else if (std::strcmp(arg, "--no-shader-cache") == 0) {
+            options.shaderCache = false;
+        } else if (std::strcmp(arg, "--no-hot-reload") == 0) {
+            options.hotReload = false;
+        } else if (std::strncmp(arg, "--quality=", 10) == 0) {
+            const char* level = arg + 10;
+            if (std::strcmp(level, "low") == 0) {
+                options.quality = 0;
+            } else if (std::strcmp(level, "medium") == 0) {
+                options.quality = 1;
+            } else if (std::strcmp(level, "high") == 0) {
+                options.quality = 2;
+            } else {
+                std::cerr << "Invalid quality (expected low, medium or high): " << arg << std::endl;
+                return false;
+            }
+        } else if (std::strcmp(arg, "--dither") == 0) {
+            options.dither = true;
+        } else if (std::strcmp(arg, "--lazy-variants") == 0) {
+            options.lazyVariants = true;
+        } else if (std::strncmp(arg, "--dynamic=", 10) == 0) {
+            options.dynamicTriangles = std::atoi(arg + 10);
+            if (options.dynamicTriangles < 0) {
+                std::cerr << "Invalid triangle count: " << arg << std::endl;
+                return false;
+            }
+        } else if (std::strcmp(arg, "--no-persistent-map") == 0) {
+            options.persistentMap = false;
+        } else if (std::strncmp(arg, "--instances=", 12) == 0) {
+            options.instances = std::atoi(arg + 12);
+            if (options.instances < 0) {
+                std::cerr << "Invalid instance count: " << arg << std::endl;
+                return false;
+            }
+        } else if (std::strcmp(arg, "--naive-instances") == 0) {
+            options.naiveInstances = true;
+        } else if (std::strncmp(arg, "--static-meshes=", 16) == 0) {
+            options.staticMeshes = std::atoi(arg + 16);
+            if (options.staticMeshes < 0) {
+                std::cerr << "Invalid mesh count: " << arg << std::endl;
+                return false;
+            }
+        } else if (std::strcmp(arg, "--no-batching") == 0) {
+            options.batching = false;
+        } else if (std::strcmp(arg, "--render-queue") == 0) {
+            options.renderQueue = true;
+        } else if (std::strcmp(arg, "--no-state-cache") == 0) {
+            options.stateCache = false;
+        } else if (std::strcmp(arg, "--render-thread") == 0) {
+            options.renderThread = true;
+        } else if (std::strncmp(arg, "--sim-ms=", 9) == 0) {
+            options.simulationMs = std::atof(arg + 9);
+            if (options.simulationMs < 0.0) {
+                std::cerr << "Invalid simulation time: " << arg << std::endl;
+                return false;
+            }
+        } else if (std::strncmp(arg, "--jobs=", 7) == 0) {
+            options.jobThreads = std::atoi(arg + 7);
+            if (options.jobThreads < 0) {
+                std::cerr << "Invalid worker thread count: " << arg << std::endl;
+                return false;
+            }
+        } else if (std::strncmp(arg, "--cull-path=", 12) == 0) {
+            const char* path = arg + 12;
+            if (std::strcmp(path, "scalar") == 0) {
+                options.cullPath = static_cast<int>(FrustumCuller::Path::Scalar);
+            } else if (std::strcmp(path, "sse") == 0) {
+                options.cullPath = static_cast<int>(FrustumCuller::Path::Sse);
+            } else if (std::strcmp(path, "avx2") == 0) {
+                options.cullPath = static_cast<int>(FrustumCuller::Path::Avx2);
+            } else {
+                std::cerr << "Invalid culling path (expected scalar, sse or avx2): " << arg << std::endl;
+                return false;
+            }
+        } else if (std::strcmp(arg, "--bvh") == 0) {
+            options.bvh = true;
+        } else if (std::strcmp(arg, "--lod") == 0) {
+            options.lod = true;
+        } else if (std::strncmp(arg, "--lod-bias=", 11) == 0) {
+            options.lodBias = static_cast<float>(std::atof(arg + 11));
+            options.lod = true;
+            if (options.lodBias <= 0.0f) {
+                std::cerr << "Invalid LOD bias: " << arg << std::endl;
+                return false;
+            }
+        } else if (std::strncmp(arg, "--lod-budget=", 13) == 0) {
+            options.lodBudgetMs = std::atof(arg + 13);
+            options.lod = true;
+            if (options.lodBudgetMs <= 0.0) {
+                std::cerr << "Invalid LOD frame budget: " << arg << std::endl;
+                return false;
+            }
+        } else if (std::strcmp(arg, "--lod-sweep") == 0) {
+            options.lodSweep = true;
+            options.lod = true;
+            options.headless = true;
+        } else if (std::strcmp(arg, "--quantize") == 0) {
+            options.quantize = true;
+        } else if (std::strncmp(arg, "--mesh=", 7) == 0) {
+            options.meshPath = arg + 7;
+        } else if (std::strcmp(arg, "--instance-sweep") == 0) {
+            options.instanceSweep = true;
+            options.headless = true;
+        } else {
+            std::cerr << "Unknown option: " << arg << "\n"
+                      << "Usage: graphics_demo [--headless] [--frames=N] [--size=WxH] [--no-shader-cache] [--no-hot-reload]\n"
+                      << "                     [--quality=low|medium|high] [--dither] [--lazy-variants]\n"
+                      << "                     [--dynamic=N] [--no-persistent-map] [--instances=N] [--naive-instances]\n"
+                      << "                     [--instance-sweep] [--static-meshes=N] [--no-batching]\n"
+                      << "                     [--render-queue] [--no-state-cache] [--render-thread] [--sim-ms=X]\n"
+                      << "                     [--jobs=N] [--cull-path=scalar|sse|avx2] [--bvh]\n"
+                      << "                     [--lod] [--lod-bias=X] [--lod-budget=MS] [--lod-sweep]\n"
+                      << "                     [--quantize] [--mesh=FILE]" << std::endl;
+            return false;
+        }
     }
-    return shader;
+    if (options.lod && options.staticMeshes == 0) {
+        options.staticMeshes = 256;
+    }
+    return true;
 }
 
-// Function to create shader program
-GLuint createShaderProgram(const char* vertexPath, const char* fragmentPath) {
-    std::string vertexSource = loadShaderSource(vertexPath);
-    std::string fragmentSource = loadShaderSource(fragmentPath);
+// Level-of-detail state of the static meshes, only touched by the thread that simulates
+struct LodScene {
+    LodManager manager;
+    std::vector<MeshBatcher::MeshHandle> finestLevel;  // batcher handle per static mesh; coarser levels follow it
+    int viewportHeight = 0;
+    std::chrono::steady_clock::time_point lastFrame;
+};
+
+// Uniform locations of the programs that map quantised positions back, looked up once per
+// program instead of by name on every draw
+struct PositionUniforms {
+    GLuint program = 0;  // what the locations belong to; 0 until the first lookup
+    GLint scale = -1;
+    GLint offset = -1;
+    GLint fit = -1;
+    GLint time = -1;
+
+    void update(GLuint current) {
+        if (current == program) {
+            return;
+        }
+        program = current;
+        scale = glGetUniformLocation(program, "uPositionScale");
+        offset = glGetUniformLocation(program, "uPositionOffset");
+        fit = glGetUniformLocation(program, "uFit");
+        time = glGetUniformLocation(program, "uTime");
+    }
+};
+
+// GL objects for the demo scene
+struct Scene {
+    std::unique_ptr<ShaderVariantSet> variants;
+    ShaderVariantSet::VariantKey variant = 0;
+    int qualityAxis = 0;
+    int ditherAxis = 0;
+    GLuint vao = 0;
+    GLuint vbo = 0;
+    // Per-frame geometry, rewritten into a ring of mapped regions every frame
+    StreamBuffer stream;
+    GLuint dynamicVao = 0;
+    int dynamicTriangles = 0;
+    // Simulation state of the serial loop, which builds every frame's packet right before drawing it
+    unsigned frameIndex = 0;
+    FramePacket packet;
+    double simulationMs = 0.0;
+    // Simulation work fans out over this; owned by the thread that simulates
+    JobSystem* jobs = nullptr;
+    // Instancing stress test: instanceCount copies of a small triangle
+    ShaderManager* shaders = nullptr;
+    ShaderManager::ProgramHandle instancedProgram = ShaderManager::InvalidProgram;
+    ShaderManager::ProgramHandle naiveProgram = ShaderManager::InvalidProgram;
+    InstancedRenderer instanced;
+    std::vector<Instance> instances;
+    size_t instanceCount = 0;
+    bool naiveInstances = false;
+    // Static shapes merged into a few draw calls, culled against a camera panning across them
+    MeshBatcher batcher;
+    FrustumCuller staticBounds;
+    Bvh staticTree;
+    bool useBvh = false;
+    std::unique_ptr<LodScene> lod;
+    bool batching = true;
+    // Vertex layout of the coloured static meshes; quantised ones share positionRange and a
+    // program that maps positions back from it
+    VertexLayout colorLayout;
+    bool quantized = false;
+    ShaderManager::ProgramHandle quantizedProgram = ShaderManager::InvalidProgram;
+    Dequantization positionRange;
+    PositionUniforms quantizedUniforms;
+    std::vector<PackingError> packingErrors;
+    size_t packedVertices = 0;
+    // A mesh file, mapped and uploaded at startup
+    GpuMesh mesh;
+    ShaderManager::ProgramHandle meshProgram = ShaderManager::InvalidProgram;
+    std::string meshPath;
+    Dequantization meshDequantization;
+    PositionUniforms meshUniforms;
+    float meshFit[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    size_t meshFileBytes = 0;
+    size_t meshVertices = 0;
+    double meshOpenMs = 0.0;
+    double meshUploadMs = 0.0;
+    // Draw packets of the frame, when recording instead of drawing inline
+    RenderQueue queue;
+    bool useQueue = false;
+    // Every bind and uniform upload of the frame goes through here
+    GlStateCache glState;
+    uint64_t programGeneration = 0;
+    double shaderSetupMs = 0.0;
+};
+
+// Picks the layout of the coloured static meshes and the program that draws them: float
+// positions, or 16-bit ones over the [-1, 1] square every static mesh sits in, so all of them
+// still share one dequantisation and one batch.
+ShaderManager::ProgramHandle setupColorLayout(Scene& scene, ShaderManager& shaders) {
+    scene.colorLayout = VertexLayout();
+    if (!scene.quantized) {
+        scene.colorLayout.add(0, VertexSemantic::Position, 3, VertexEncoding::Float32)
+                         .add(1, VertexSemantic::Color, 4, VertexEncoding::Unorm8);
+        return shaders.add("shaders/static_vertex.glsl", "shaders/color_fragment.glsl");
+    }
+    scene.colorLayout.add(0, VertexSemantic::Position, 3, VertexEncoding::Unorm16)
+                     .add(1, VertexSemantic::Color, 4, VertexEncoding::Unorm8);
+    Dequantization range = { { 2.0f, 2.0f, 1.0f }, { -1.0f, -1.0f, 0.0f } };
+    scene.positionRange = range;
+    scene.quantizedProgram = shaders.add("shaders/static_vertex.glsl", "shaders/color_fragment.glsl", "QUANTIZED");
+    return scene.quantizedProgram;
+}
+
+// Packs vertexCount coloured vertices (position and colour as floats) into scene.colorLayout
+// and folds their round-trip error into the scene's totals.
+void packColored(Scene& scene, const std::vector<float>& source, size_t vertexCount, std::vector<char>& packed) {
+    Dequantization dequantization;
+    std::vector<PackingError> errors;
+    packVertices(scene.colorLayout, source.data(), vertexCount, packed, dequantization, &scene.positionRange, &errors);
+    if (scene.packingErrors.empty()) {
+        scene.packingErrors = errors;
+    } else {
+        double total = static_cast<double>(scene.packedVertices + vertexCount);
+        for (size_t i = 0; i < errors.size(); ++i) {
+            PackingError& sum = scene.packingErrors[i];
+            sum.maxError = std::max(sum.maxError, errors[i].maxError);
+            sum.rmsError = std::sqrt((sum.rmsError * sum.rmsError * scene.packedVertices
+                                      + errors[i].rmsError * errors[i].rmsError * vertexCount) / total);
+        }
+    }
+    scene.packedVertices += vertexCount;
+}
+
+// Submits count small static shapes (triangles, quads and hexagons) on a grid, alternating
+// between a plain position-only format and a coloured one so they fall into two batches.
+void addStaticMeshes(Scene& scene, ShaderManager& shaders, int count) {
+    ShaderManager::ProgramHandle plainProgram = shaders.add("shaders/vertex.glsl", "shaders/fragment.glsl", "QUALITY_LOW");
+    ShaderManager::ProgramHandle colorProgram = setupColorLayout(scene, shaders);
+    VertexFormat plainFormat;
+    plainFormat.add(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float));
+    VertexFormat colorFormat = VertexFormat::fromLayout(scene.colorLayout);
+
+    int columns = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(count))));
+    float cell = 2.0f / columns;
+    std::vector<float> plain;
+    std::vector<float> colored;
+    std::vector<char> packed;
+    std::vector<uint32_t> indices;
+    std::vector<Aabb> bounds;
+    for (int i = 0; i < count; ++i) {
+        float cx = -1.0f + (i % columns + 0.5f) * cell;
+        float cy = -1.0f + (i / columns + 0.5f) * cell;
+        float radius = cell * 0.4f;
+        int sides = 3 + (i % 3) * (i % 3 == 2 ? 2 : 1); // 3, 4 or 6
+        plain.clear();
+        colored.clear();
+        indices.clear();
+        for (int v = 0; v < sides; ++v) {
+            float angle = 6.2831853f * v / sides + 0.5235988f;
+            float position[3] = { cx + radius * std::cos(angle), cy + radius * std::sin(angle), 0.0f };
+            plain.insert(plain.end(), position, position + 3);
+            colored.insert(colored.end(), position, position + 3);
+            float color[4] = { (96 + v * 24) / 255.0f, 200 / 255.0f, (255 - v * 24) / 255.0f, 1.0f };
+            colored.insert(colored.end(), color, color + 4);
+        }
+        for (int v = 1; v + 1 < sides; ++v) {
+            uint32_t triangle[3] = { 0, static_cast<uint32_t>(v), static_cast<uint32_t>(v + 1) };
+            indices.insert(indices.end(), triangle, triangle + 3);
+        }
+        if (i % 2 == 0) {
+            scene.batcher.add(plainProgram, plainFormat, plain.data(), sides, indices.data(), indices.size());
+        } else {
+            packColored(scene, colored, sides, packed);
+            scene.batcher.add(colorProgram, colorFormat, packed.data(), sides, indices.data(), indices.size());
+        }
+        const float center[3] = { cx, cy, 0.0f };
+        const float extents[3] = { radius, radius, 0.0f };
+        scene.staticBounds.add(center, extents);
+        Aabb box = { { cx - radius, cy - radius, 0.0f }, { cx + radius, cy + radius, 0.0f } };
+        bounds.push_back(box);
+    }
+    scene.batcher.build();
+    if (scene.useBvh) {
+        scene.staticTree.build(bounds);
+    }
+}
+
+// Discs with LodLevels levels of detail, each a fan over every other vertex of the level above
+const int LodLevels = 6;
+const int LodFinestSegments = 192;
+
+// Submits count discs of varying size on a grid. Every level shares the disc's vertices and has
+// its own index range, and its error is how far its edges fall inside the circle.
+void addLodDiscs(Scene& scene, ShaderManager& shaders, int count) {
+    ShaderManager::ProgramHandle program = setupColorLayout(scene, shaders);
+    VertexFormat format = VertexFormat::fromLayout(scene.colorLayout);
+
+    int columns = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(count))));
+    float cell = 2.0f / columns;
+    std::vector<float> vertices;
+    std::vector<char> packed;
+    std::vector<uint32_t> indices;
+    std::vector<Aabb> bounds;
+    for (int i = 0; i < count; ++i) {
+        float cx = -1.0f + (i % columns + 0.5f) * cell;
+        float cy = -1.0f + (i / columns + 0.5f) * cell;
+        uint32_t hash = static_cast<uint32_t>(i) * 2654435761u;
+        float radius = cell * 0.45f * (0.2f + 0.8f * (hash >> 8) / 16777216.0f);
+        vertices.clear();
+        for (int v = 0; v < LodFinestSegments; ++v) {
+            float angle = 6.2831853f * v / LodFinestSegments;
+            float position[3] = { cx + radius * std::cos(angle), cy + radius * std::sin(angle), 0.0f };
+            vertices.insert(vertices.end(), position, position + 3);
+            float color[4] = { (96 + (hash >> 24) / 2) / 255.0f, 200 / 255.0f, (128 + v % 2 * 64) / 255.0f, 1.0f };
+            vertices.insert(vertices.end(), color, color + 4);
+        }
+        packColored(scene, vertices, LodFinestSegments, packed);
+
+        float errors[LodLevels];
+        uint32_t triangles[LodLevels];
+        for (int level = 0; level < LodLevels; ++level) {
+            int stride = 1 << level;
+            int segments = LodFinestSegments / stride;
+            indices.clear();
+            for (int v = 1; v + 1 < segments; ++v) {
+                uint32_t triangle[3] = { 0, static_cast<uint32_t>(v * stride), static_cast<uint32_t>((v + 1) * stride) };
+                indices.insert(indices.end(), triangle, triangle + 3);
+            }
+            errors[level] = radius * (1.0f - std::cos(3.1415927f / segments));
+            triangles[level] = static_cast<uint32_t>(segments - 2);
+            if (level == 0) {
+                scene.lod->finestLevel.push_back(scene.batcher.add(program, format, packed.data(), LodFinestSegments,
+                                                                   indices.data(), indices.size()));
+            } else {
+                scene.batcher.addLevel(scene.lod->finestLevel.back(), indices.data(), indices.size());
+            }
+        }
+        // Sizes vary continuously, so every disc gets a mesh of its own
+        uint32_t mesh = scene.lod->manager.addMesh(errors, triangles, LodLevels);
+        const float center[3] = { cx, cy, 0.0f };
+        const float extents[3] = { radius, radius, 0.0f };
+        scene.lod->manager.addObject(mesh, center, radius);
+        scene.staticBounds.add(center, extents);
+        Aabb box = { { cx - radius, cy - radius, 0.0f }, { cx + radius, cy + radius, 0.0f } };
+        bounds.push_back(box);
+    }
+    scene.batcher.build();
+    if (scene.useBvh) {
+        scene.staticTree.build(bounds);
+    }
+}
+
+// Maps a mesh file and uploads it from the mapping. The mapping is dropped once GL has the data.
+bool loadMesh(Scene& scene, const std::string& path) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    MeshFile file;
+    if (!file.open(path)) {
+        return false;
+    }
+    std::chrono::steady_clock::time_point opened = std::chrono::steady_clock::now();
+    if (!scene.mesh.upload(file)) {
+        return false;
+    }
+    // Without a finish the upload time is only the driver's copy; include the transfer
+    glFinish();
+    std::chrono::steady_clock::time_point uploaded = std::chrono::steady_clock::now();
+    scene.meshOpenMs = std::chrono::duration<double, std::milli>(opened - start).count();
+    scene.meshUploadMs = std::chrono::duration<double, std::milli>(uploaded - opened).count();
+    scene.meshPath = path;
+    scene.meshDequantization = file.dequantization();
+    scene.meshFileBytes = file.fileSize();
+    scene.meshVertices = file.vertexCount();
+    const MeshFileHeader& header = file.header();
+    float extent = 0.0f;
+    for (int k = 0; k < 3; ++k) {
+        scene.meshFit[k] = (header.boundsMin[k] + header.boundsMax[k]) * 0.5f;
+        extent = std::max(extent, (header.boundsMax[k] - header.boundsMin[k]) * 0.5f);
+    }
+    scene.meshFit[3] = extent > 0.0f ? 1.0f / extent : 1.0f;
+    return true;
+}
+
+// The most instances --instance-sweep draws
+const size_t SweepMaxInstances = 1000000;
+
+// Lays count instances out on a square grid covering the viewport
+void layoutInstances(std::vector<Instance>& instances, size_t count) {
+    instances.resize(count);
+    size_t columns = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+    float cell = 2.0f / columns;
+    for (size_t i = 0; i < count; ++i) {
+        Instance& instance = instances[i];
+        instance.x = -1.0f + (i % columns + 0.5f) * cell;
+        instance.y = -1.0f + (i / columns + 0.5f) * cell;
+        instance.scale = cell * 0.4f;
+        instance.phase = i * 0.1f;
+        uint32_t hash = static_cast<uint32_t>(i) * 2654435761u;
+        instance.color[0] = static_cast<uint8_t>(128 + (hash >> 25));
+        instance.color[1] = static_cast<uint8_t>(128 + ((hash >> 17) & 127));
+        instance.color[2] = static_cast<uint8_t>(128 + ((hash >> 9) & 127));
+        instance.color[3] = 255;
+    }
+}
+
+bool createScene(Scene& scene, ShaderManager& shaders, const DemoOptions& options) {
+    // Declare every program, then submit them together so the driver can compile in parallel.
+    // Link status is only checked when a program is first drawn with.
+    std::chrono::steady_clock::time_point shaderStart = std::chrono::steady_clock::now();
+    scene.variants.reset(new ShaderVariantSet(shaders, "shaders/vertex.glsl", "shaders/fragment.glsl"));
+    scene.qualityAxis = scene.variants->addAxis("QUALITY", { "QUALITY_LOW", "QUALITY_MEDIUM", "QUALITY_HIGH" });
+    scene.ditherAxis = scene.variants->addAxis("DITHER", { "", "DITHER" });
+    if (scene.qualityAxis < 0 || scene.ditherAxis < 0) {
+        return false;
+    }
+    scene.variant = scene.variants->with(scene.variant, scene.qualityAxis, options.quality);
+    scene.variant = scene.variants->with(scene.variant, scene.ditherAxis, options.dither ? 1 : 0);
+    scene.shaders = &shaders;
+    scene.useQueue = options.renderQueue;
+    scene.glState.setEnabled(options.stateCache);
+    scene.simulationMs = options.simulationMs;
+    if (options.cullPath >= 0) {
+        scene.staticBounds.setPath(static_cast<FrustumCuller::Path>(options.cullPath));
+    }
+    scene.useBvh = options.bvh;
+    scene.quantized = options.quantize;
+    if (options.staticMeshes > 0 && options.lod) {
+        scene.lod.reset(new LodScene());
+        scene.lod->manager.setBias(options.lodBias);
+        scene.lod->manager.setBudget(options.lodBudgetMs);
+        scene.lod->viewportHeight = options.height;
+        addLodDiscs(scene, shaders, options.staticMeshes);
+        scene.batching = options.batching;
+    } else if (options.staticMeshes > 0) {
+        addStaticMeshes(scene, shaders, options.staticMeshes);
+        scene.batching = options.batching;
+    }
+    if (options.instances > 0 || options.instanceSweep) {
+        scene.instancedProgram = shaders.add("shaders/instanced_vertex.glsl", "shaders/color_fragment.glsl", "INSTANCED");
+        scene.naiveProgram = shaders.add("shaders/instanced_vertex.glsl", "shaders/color_fragment.glsl");
+    }
+    if (!options.meshPath.empty()) {
+        scene.meshProgram = shaders.add("shaders/mesh_vertex.glsl", "shaders/color_fragment.glsl");
+    }
+    if (!options.lazyVariants) {
+        // Build the whole table now so switching variants at runtime never compiles
+        scene.variants->precompile();
+    }
+    scene.shaderSetupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - shaderStart).count();
+    
+    // Define triangle vertices
+    float vertices[] = {
+        -0.5f, -0.5f, 0.0f,
+         0.5f, -0.5f, 0.0f,
+         0.0f,  0.5f, 0.0f
+    };
     
-    GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexSource.c_str());
-    GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentSource.c_str());
+    // Create VAO and VBO
+    glGenVertexArrays(1, &scene.vao);
+    glGenBuffers(1, &scene.vbo);
     
-    GLuint program = glCreateProgram();
-    glAttachShader(program, vertexShader);
-    glAttachShader(program, fragmentShader);
-    glLinkProgram(program);
+    glBindVertexArray(scene.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, scene.vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
     
-    GLint success;
-    glGetProgramiv(program, GL_LINK_STATUS, &success);
-    if (!success) {
-        char infoLog[512];
-        glGetProgramInfoLog(program, 512, nullptr, infoLog);
-        std::cerr << "Program linking failed:\n" << infoLog << std::endl;
-    }
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
     
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+
+    if (options.instances > 0 || options.instanceSweep) {
+        const float mesh[] = {
+            -1.0f, -1.0f, 0.0f,
+             1.0f, -1.0f, 0.0f,
+             0.0f,  1.0f, 0.0f
+        };
+        size_t capacity = options.instanceSweep ? SweepMaxInstances : static_cast<size_t>(options.instances);
+        scene.instanced.create(mesh, 3, capacity, options.persistentMap);
+        layoutInstances(scene.instances, options.instanceSweep ? 1 : capacity);
+        scene.instanceCount = scene.instances.size();
+        scene.naiveInstances = options.naiveInstances;
+    }
+
+    if (!options.meshPath.empty() && !loadMesh(scene, options.meshPath)) {
+        return false;
+    }
+
+    if (options.dynamicTriangles > 0) {
+        scene.dynamicTriangles = options.dynamicTriangles;
+        scene.stream.create(options.dynamicTriangles * 9 * sizeof(float), options.persistentMap);
+        // The attribute pointer is set every frame, since the data moves between regions
+        glGenVertexArrays(1, &scene.dynamicVao);
+        glBindVertexArray(scene.dynamicVao);
+        glEnableVertexAttribArray(0);
+        glBindVertexArray(0);
+    }
+    return true;
+}
+
+// Applies key presses. Runs on the thread that polls events; the report is printed by the
+// thread that renders.
+void handleInput(InputState& input, Scene& scene, std::atomic<bool>& reportRequested) {
+    if (input.cycleQuality || input.toggleDither) {
+        if (input.cycleQuality) {
+            scene.variant = scene.variants->next(scene.variant, scene.qualityAxis);
+        }
+        if (input.toggleDither) {
+            scene.variant = scene.variants->next(scene.variant, scene.ditherAxis);
+        }
+        std::cout << "Shader variant: " << scene.variants->describe(scene.variant) << std::endl;
+        input.cycleQuality = input.toggleDither = false;
+    }
+    if (input.reportRequested) {
+        reportRequested = true;
+        input.reportRequested = false;
+    }
+}
+
+// Simulation work handed to parallelFor
+struct DynamicTriangleJob {
+    float* out;
+    int count;
+    unsigned frameIndex;
+};
+
+// Writes triangles [begin, end) of count small ones on a grid, each wobbling on its own phase
+void writeDynamicTriangles(size_t begin, size_t end, void* context) {
+    const DynamicTriangleJob& job = *static_cast<const DynamicTriangleJob*>(context);
+    float* out = job.out;
+    int columns = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(job.count))));
+    float cell = 2.0f / columns;
+    float size = cell * 0.35f;
+    float time = job.frameIndex * 0.05f;
+    for (int i = static_cast<int>(begin); i < static_cast<int>(end); ++i) {
+        float x = -1.0f + (i % columns + 0.5f) * cell + std::sin(time + i * 0.37f) * cell * 0.25f;
+        float y = -1.0f + (i / columns + 0.5f) * cell + std::cos(time + i * 0.61f) * cell * 0.25f;
+        const float triangle[9] = {
+            x - size, y - size, 0.0f,
+            x + size, y - size, 0.0f,
+            x,        y + size, 0.0f
+        };
+        std::memcpy(out + i * 9, triangle, sizeof(triangle));
+    }
+}
+
+// The CPU side of a frame: animation and visibility, computed into packet without any GL calls so
+// it can run on a simulation thread. Only reads scene data that is fixed after createScene(). The
+// LOD state it updates, scene.lod, comes in separately as lod, so frames are simulated one at a time.
+void simulateFrame(const Scene& scene, LodScene* lod, unsigned frameIndex, ShaderVariantSet::VariantKey variant,
+                   FramePacket& packet) {
+    packet.frameIndex = frameIndex;
+    packet.variant = variant;
+    packet.dynamicVertices.resize(scene.dynamicTriangles * 9);
+    if (scene.dynamicTriangles > 0) {
+        DynamicTriangleJob job = { packet.dynamicVertices.data(), scene.dynamicTriangles, frameIndex };
+        scene.jobs->parallelFor(scene.dynamicTriangles, 1024, writeDynamicTriangles, &job);
+    }
+
+    // The static meshes are culled against an orthographic camera panning across them, 1.5
+    // units wide, so the batcher has to split its ranges
+    float windowStart = std::fmod(frameIndex * 0.005f, 3.0f) - 2.0f;
+    Frustum camera = Frustum::orthographic(windowStart, windowStart + 1.5f, -1.0f, 1.0f, -1.0f, 1.0f);
+    if (scene.useBvh) {
+        packet.staticVisible.clear();
+        scene.staticTree.queryFrustum(camera, packet.staticVisible);
+    } else {
+        scene.staticBounds.cull(camera, packet.staticVisible);
+    }
+
+    // Levels for what survived, judged by how big the discs are on screen
+    if (lod) {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (lod->lastFrame != std::chrono::steady_clock::time_point()) {
+            lod->manager.adaptBias(std::chrono::duration<double, std::milli>(now - lod->lastFrame).count());
+        }
+        lod->lastFrame = now;
+        lod->manager.select(LodManager::View::makeOrthographic(2.0f, lod->viewportHeight),
+                            packet.staticVisible.data(), packet.staticVisible.size());
+        packet.staticLevels.resize(packet.staticVisible.size());
+        for (size_t i = 0; i < packet.staticVisible.size(); ++i) {
+            packet.staticLevels[i] = static_cast<uint8_t>(lod->manager.level(packet.staticVisible[i]));
+        }
+    }
+
+    // Stand-in for heavier game logic, to see how much of it the render thread hides
+    if (scene.simulationMs > 0.0) {
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now()
+            + std::chrono::microseconds(static_cast<long long>(scene.simulationMs * 1000.0));
+        while (std::chrono::steady_clock::now() < end) {
+        }
+    }
+}
+
+// Clears and draws the frame described by packet into the currently bound framebuffer. With
+// --render-queue the scene only records its draws, and they are sorted and replayed at the end.
+void drawScene(Scene& scene, const FramePacket& packet, FrameRecorder& frameRecorder, GpuProfiler& profiler) {
+    GpuScope frameScope(profiler, "frame");
+    RenderQueue* queue = scene.useQueue ? &scene.queue : nullptr;
+    GlStateCache& state = scene.glState;
+    state.beginFrame();
+    // A reload deleted a program whose name GL may hand out again
+    if (scene.shaders->programGeneration() != scene.programGeneration) {
+        state.reset();
+        scene.quantizedUniforms.program = 0;
+        scene.meshUniforms.program = 0;
+        scene.programGeneration = scene.shaders->programGeneration();
+    }
+
+    // Clear screen
+    {
+        GpuScope scope(profiler, "clear");
+        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+    frameRecorder.endPhase(FramePhase::Clear);
+
+    // Flat, unblended 2D throughout. Declared every frame; after the first it costs nothing
+    state.setCapability(GL_DEPTH_TEST, false);
+    state.setCapability(GL_BLEND, false);
+    state.setCapability(GL_CULL_FACE, false);
+
+    // Streamed data must stay fenced until the draws reading it have been issued, so the
+    // streams span the whole frame, replay included
+    if (scene.dynamicTriangles > 0) {
+        scene.stream.beginFrame();
+    }
+    if (scene.instanceCount > 0) {
+        scene.instanced.beginFrame();
+    }
     
-    return program;
+    // Draw triangle
+    {
+        GpuScope scope(profiler, "triangle");
+        GLuint program = scene.variants->program(packet.variant);
+        if (queue) {
+            queue->pushArrays(RenderQueue::makeKey(0, program, 0, scene.vao), program, scene.vao, GL_TRIANGLES, 0, 3);
+        } else {
+            state.useProgram(program);
+            state.bindVertexArray(scene.vao);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+    }
+
+    // Stream this frame's animated triangles: a plain copy into mapped memory, no glBufferData
+    if (scene.dynamicTriangles > 0) {
+        GpuScope scope(profiler, "dynamic");
+        size_t offset = 0;
+        size_t bytes = scene.dynamicTriangles * 9 * sizeof(float);
+        float* vertices = static_cast<float*>(scene.stream.allocate(bytes, sizeof(float), offset));
+        if (vertices) {
+            std::memcpy(vertices, packet.dynamicVertices.data(), bytes);
+            scene.stream.commit();
+            state.bindVertexArray(scene.dynamicVao);
+            state.bindBuffer(GL_ARRAY_BUFFER, scene.stream.buffer());
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), reinterpret_cast<void*>(offset));
+            GLuint program = scene.variants->program(packet.variant);
+            if (queue) {
+                queue->pushArrays(RenderQueue::makeKey(0, program, 0, scene.dynamicVao), program, scene.dynamicVao,
+                                  GL_TRIANGLES, 0, scene.dynamicTriangles * 3);
+            } else {
+                state.useProgram(program);
+                glDrawArrays(GL_TRIANGLES, 0, scene.dynamicTriangles * 3);
+            }
+        }
+    }
+
+    if (scene.batcher.meshCount() > 0) {
+        GpuScope scope(profiler, queue ? "static_queued" : scene.batching ? "static_batched" : "static_unbatched");
+        for (size_t i = 0; i < scene.batcher.meshCount(); ++i) {
+            scene.batcher.setVisible(static_cast<MeshBatcher::MeshHandle>(i), false);
+        }
+        for (size_t i = 0; i < packet.staticVisible.size(); ++i) {
+            MeshBatcher::MeshHandle mesh = static_cast<MeshBatcher::MeshHandle>(packet.staticVisible[i]);
+            if (scene.lod) {
+                mesh = scene.lod->finestLevel[mesh] + packet.staticLevels[i];
+            }
+            scene.batcher.setVisible(mesh, true);
+        }
+        if (scene.quantized) {
+            // Uniforms are program state, so this also holds for draws replayed from the queue
+            GLuint program = scene.shaders->program(scene.quantizedProgram);
+            const Dequantization& range = scene.positionRange;
+            PositionUniforms& uniforms = scene.quantizedUniforms;
+            uniforms.update(program);
+            state.useProgram(program);
+            state.uniform4f(uniforms.scale, range.scale[0], range.scale[1], range.scale[2], 0.0f);
+            state.uniform4f(uniforms.offset, range.offset[0], range.offset[1], range.offset[2], 0.0f);
+        }
+        if (queue) {
+            scene.batcher.submit(*queue, *scene.shaders);
+        } else if (scene.batching) {
+            scene.batcher.draw(*scene.shaders, state);
+        } else {
+            scene.batcher.drawUnbatched(*scene.shaders, state);
+        }
+    }
+
+    if (scene.mesh.vertexArray()) {
+        // Drawn directly even when recording: a few submeshes gain nothing from the sort
+        GpuScope scope(profiler, "mesh_file");
+        GLuint program = scene.shaders->program(scene.meshProgram);
+        const Dequantization& range = scene.meshDequantization;
+        PositionUniforms& uniforms = scene.meshUniforms;
+        uniforms.update(program);
+        state.useProgram(program);
+        state.uniform4f(uniforms.scale, range.scale[0], range.scale[1], range.scale[2], 0.0f);
+        state.uniform4f(uniforms.offset, range.offset[0], range.offset[1], range.offset[2], 0.0f);
+        state.uniform4f(uniforms.fit, scene.meshFit[0], scene.meshFit[1], scene.meshFit[2], scene.meshFit[3]);
+        state.uniform1f(uniforms.time, packet.frameIndex * 0.01f);
+        for (size_t i = 0; i < scene.mesh.submeshCount(); ++i) {
+            scene.mesh.draw(i, state);
+        }
+    }
+
+    if (scene.instanceCount > 0) {
+        GpuScope scope(profiler, scene.naiveInstances ? "instances_naive" : "instances");
+        GLuint program = scene.shaders->program(scene.naiveInstances ? scene.naiveProgram : scene.instancedProgram);
+        state.useProgram(program);
+        state.uniform1f(glGetUniformLocation(program, "uTime"), packet.frameIndex * 0.02f);
+        if (scene.naiveInstances) {
+            // Per-draw uniforms don't fit in a draw packet; the naive path always draws directly
+            scene.instanced.drawEach(scene.instances.data(), scene.instanceCount,
+                                     glGetUniformLocation(program, "uPlacement"), glGetUniformLocation(program, "uColor"),
+                                     state);
+        } else if (queue) {
+            size_t count = scene.instanced.prepare(scene.instances.data(), scene.instanceCount, state);
+            if (count > 0) {
+                GLuint vao = scene.instanced.vertexArray();
+                queue->pushArrays(RenderQueue::makeKey(0, program, 0, vao), program, vao, GL_TRIANGLES, 0,
+                                  scene.instanced.vertexCount(), static_cast<GLsizei>(count));
+            }
+        } else {
+            scene.instanced.draw(scene.instances.data(), scene.instanceCount, state);
+        }
+    }
+
+    if (queue) {
+        GpuScope scope(profiler, "queue_replay");
+        queue->sort();
+        queue->execute(state);
+    }
+    if (scene.dynamicTriangles > 0) {
+        scene.stream.endFrame();
+    }
+    if (scene.instanceCount > 0) {
+        scene.instanced.endFrame();
+    }
+    frameRecorder.endPhase(FramePhase::Draw);
 }
 
-int main() {
+void destroyScene(Scene& scene) {
+    glDeleteVertexArrays(1, &scene.vao);
+    glDeleteBuffers(1, &scene.vbo);
+    if (scene.dynamicVao) {
+        glDeleteVertexArrays(1, &scene.dynamicVao);
+        scene.dynamicVao = 0;
+    }
+    scene.stream.destroy();
+    scene.instanced.destroy();
+    scene.batcher.destroy();
+    scene.mesh.destroy();
+    scene.variants.reset();
+}
+
+void printJsonString(std::ostream& out, const char* text) {
+    out << '"';
+    for (const char* c = text ? text : ""; *c; ++c) {
+        if (*c == '"' || *c == '\\') {
+            out << '\\' << *c;
+        } else if (static_cast<unsigned char>(*c) >= 0x20) {
+            out << *c;
+        }
+    }
+    out << '"';
+}
+
+int runWindowed(const DemoOptions& options) {
     // Initialize GLFW
     if (!glfwInit()) {
         std::cerr << "Failed to initialize GLFW" << std::endl;
@@ -76,7 +921,7 @@ int main() {
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     
     // Create window
-    GLFWwindow* window = glfwCreateWindow(800, 600, "Graphics Demo", nullptr, nullptr);
+    GLFWwindow* window = glfwCreateWindow(options.width, options.height, "Graphics Demo", nullptr, nullptr);
     if (!window) {
         std::cerr << "Failed to create GLFW window" << std::endl;
         glfwTerminate();
@@ -87,8 +932,12 @@ int main() {
 	// Disable vsync to measure max FPS and study performance trade-offs
     glfwSwapInterval(0); // 0 = vsync off, 1 = vsync on 
 
-    double lastTime = glfwGetTime();
-	int nbFrames = 0;
+    // F1 prints the frame time report without quitting
+    InputState input;
+    glfwSetWindowUserPointer(window, &input);
+    glfwSetKeyCallback(window, keyCallback);
+
+    FrameRecorder frameRecorder;
     
     if (!gladLoadGL((GLADloadfunc)glfwGetProcAddress)) {
         std::cerr << "Failed to initialize GLAD" << std::endl;
@@ -96,68 +945,510 @@ int main() {
     }
     
     // Set viewport
-    glViewport(0, 0, 800, 600);
-    
-    // Create shader program
-    GLuint shaderProgram = createShaderProgram("shaders/vertex.glsl", "shaders/fragment.glsl");
+    glViewport(0, 0, options.width, options.height);
     
-    // Define triangle vertices
-    float vertices[] = {
-        -0.5f, -0.5f, 0.0f,
-         0.5f, -0.5f, 0.0f,
-         0.0f,  0.5f, 0.0f
+    ShaderCache shaderCache;
+    if (options.shaderCache) {
+        shaderCache.init();
+    }
+    ShaderManager shaders(shaderCache.enabled() ? &shaderCache : nullptr);
+    shaders.init();
+    JobSystem jobs(options.jobThreads);
+    Scene scene;
+    scene.jobs = &jobs;
+    if (!createScene(scene, shaders, options)) {
+        destroyScene(scene);
+        glfwTerminate();
+        return -1;
+    }
+    std::cout << "Shaders submitted in " << std::fixed << std::setprecision(2) << scene.shaderSetupMs << " ms"
+              << " (" << shaders.size() << " programs, parallel compile: " << (shaders.parallelCompile() ? "on" : "off")
+              << ", program cache: " << (shaderCache.enabled() ? "on" : "off") << ", "
+              << shaderCache.stats().hits << " hits, " << shaderCache.stats().misses << " misses)" << std::endl;
+    GpuProfiler profiler;
+
+    // Edits to the shaders and any file they #include are picked up while running
+    ShaderWatcher shaderWatcher;
+    std::vector<std::string> changedShaders;
+    if (options.hotReload) {
+        shaderWatcher.start(shaders.sourcePaths());
+    }
+
+    // With --render-thread this thread only polls events and simulates frames into the pipeline,
+    // while a render thread that owns the context draws them. Otherwise one loop does both.
+    FramePipeline pipeline;
+    std::atomic<bool> reportRequested(false);
+    std::mutex titleMutex;
+    std::string pendingTitle;
+
+    auto renderLoop = [&]() {
+        double lastTime = glfwGetTime();
+        while (true) {
+            frameRecorder.beginFrame();
+            FramePacket* packet = &scene.packet;
+            if (options.renderThread) {
+                packet = pipeline.acquire();
+                if (!packet) {
+                    break;
+                }
+            } else {
+                if (glfwWindowShouldClose(window)) {
+                    break;
+                }
+                simulateFrame(scene, scene.lod.get(), scene.frameIndex++, scene.variant, *packet);
+            }
+            frameRecorder.endPhase(FramePhase::Scene);
+            profiler.beginFrame();
+
+            drawScene(scene, *packet, frameRecorder, profiler);
+            profiler.endFrame();
+            ShaderVariantSet::VariantKey variant = packet->variant;
+
+            // Rebuilt programs are swapped in here, between draws, and only if they linked
+            if (shaderWatcher.takeChanges(changedShaders)) {
+                size_t rebuilt = shaders.reload(changedShaders);
+                if (rebuilt) {
+                    std::cout << "Reloading " << rebuilt << " shader program(s)" << std::endl;
+                }
+            }
+            shaders.poll();
+
+            glfwSwapBuffers(window);
+            frameRecorder.endPhase(FramePhase::Swap);
+            if (options.renderThread) {
+                pipeline.release(packet);
+            } else {
+                glfwPollEvents();
+                handleInput(input, scene, reportRequested);
+            }
+            frameRecorder.endPhase(FramePhase::Poll);
+
+            // Frame time stats: tail latency of the last second in the title, full report on F1
+            double currentTime = glfwGetTime();
+            if (currentTime - lastTime >= 1.0) {
+                frameRecorder.collect();
+                const FrameTimeHistogram& interval = frameRecorder.interval();
+                double fps = interval.count() / (currentTime - lastTime);
+                std::ostringstream title;
+                title << "Graphics Demo - " << scene.variants->valueName(variant, scene.qualityAxis)
+                      << " - FPS: " << std::fixed << std::setprecision(2) << fps
+                      << " | p99: " << std::setprecision(3) << interval.percentile(99.0) << " ms"
+                      << " | max: " << interval.max() << " ms";
+                if (options.renderThread) {
+                    // Only the event thread may touch the window
+                    std::lock_guard<std::mutex> lock(titleMutex);
+                    pendingTitle = title.str();
+                } else {
+                    glfwSetWindowTitle(window, title.str().c_str());
+                }
+
+                frameRecorder.resetInterval();
+                lastTime = currentTime;
+            }
+            if (reportRequested.exchange(false)) {
+                frameRecorder.collect();
+                frameRecorder.printReport(std::cout);
+                profiler.printReport(std::cout);
+                if (scene.dynamicTriangles > 0) {
+                    scene.stream.printReport(std::cout);
+                }
+                if (options.renderThread) {
+                    pipeline.printReport(std::cout);
+                }
+            }
+
+            frameRecorder.endFrame();
+        }
     };
-    
-    // Create VAO and VBO
-    GLuint VAO, VBO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-    
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
-    
-    // Render loop
-    while (!glfwWindowShouldClose(window)) {
-        // Clear screen
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
-        
-        // Draw triangle
-        glUseProgram(shaderProgram);
-        glBindVertexArray(VAO);
-        glDrawArrays(GL_TRIANGLES, 0, 3);
-        
-		// FPS calculation
-        nbFrames++;
-		double currentTime = glfwGetTime();
-
-        if (currentTime - lastTime >= 1.0) {
-            double fps = nbFrames / (currentTime - lastTime);
-            std::ostringstream title;
-			title << "Graphics Demo - FPS: " << std::fixed << std::setprecision(2) << fps;
-            glfwSetWindowTitle(window, title.str().c_str());
-            
-            nbFrames = 0;
-			lastTime = currentTime;
-        }
-
-        // Swap buffers and poll events
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+
+    if (options.renderThread) {
+        glfwMakeContextCurrent(nullptr);
+        std::thread renderThread([&]() {
+            glfwMakeContextCurrent(window);
+            renderLoop();
+            glfwMakeContextCurrent(nullptr);
+        });
+        unsigned frameIndex = 0;
+        while (!glfwWindowShouldClose(window)) {
+            FramePacket* packet = pipeline.beginPacket();
+            if (!packet) {
+                break;
+            }
+            simulateFrame(scene, scene.lod.get(), frameIndex++, scene.variant, *packet);
+            pipeline.publish(packet);
+
+            glfwPollEvents();
+            handleInput(input, scene, reportRequested);
+            std::lock_guard<std::mutex> lock(titleMutex);
+            if (!pendingTitle.empty()) {
+                glfwSetWindowTitle(window, pendingTitle.c_str());
+                pendingTitle.clear();
+            }
+        }
+        pipeline.stop();
+        renderThread.join();
+        glfwMakeContextCurrent(window);
+    } else {
+        renderLoop();
+    }
+
+    frameRecorder.collect();
+    frameRecorder.printReport(std::cout);
+    profiler.collect();
+    profiler.printReport(std::cout);
+    if (scene.dynamicTriangles > 0) {
+        scene.stream.printReport(std::cout);
+    }
+    if (options.renderThread) {
+        pipeline.printReport(std::cout);
     }
     
     // Cleanup
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteProgram(shaderProgram);
+    shaderWatcher.stop();
+    profiler.shutdown();
+    destroyScene(scene);
+    shaders.shutdown();
     
     glfwTerminate();
     return 0;
 }
+
+// Renders up to frames frames into the bound framebuffer, stopping early once maxWallMs have
+// passed (0 = no limit) or the pipeline runs dry. Frames are simulated inline, or taken from
+// pipeline when one is given. Sets frames to the number rendered and returns the wall time in ms.
+double renderOffscreen(Scene& scene, ShaderManager& shaders, FrameRecorder& frameRecorder, GpuProfiler& profiler,
+                       int& frames, double maxWallMs, FramePipeline* pipeline = nullptr) {
+    // Without a swap chain the CPU could queue frames indefinitely; a fence per frame
+    // with two frames in flight stands in for double-buffered present throttling
+    GLsync fences[2] = { nullptr, nullptr };
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    int frame = 0;
+    for (; frame < frames; ++frame) {
+        frameRecorder.beginFrame();
+        FramePacket* packet = &scene.packet;
+        if (pipeline) {
+            packet = pipeline->acquire();
+            if (!packet) {
+                break;
+            }
+        } else {
+            simulateFrame(scene, scene.lod.get(), scene.frameIndex++, scene.variant, *packet);
+        }
+        frameRecorder.endPhase(FramePhase::Scene);
+        profiler.beginFrame();
+
+        drawScene(scene, *packet, frameRecorder, profiler);
+        profiler.endFrame();
+        shaders.poll();
+
+        GLsync& fence = fences[frame % 2];
+        if (fence) {
+            glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            glDeleteSync(fence);
+        }
+        fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+        frameRecorder.endPhase(FramePhase::Swap);
+        if (pipeline) {
+            pipeline->release(packet);
+        }
+
+        frameRecorder.endFrame();
+        // Drain well before the ring can fill up
+        if ((frame & 1023) == 1023) {
+            frameRecorder.collect();
+        }
+        if (maxWallMs > 0.0
+            && std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() >= maxWallMs) {
+            ++frame;
+            break;
+        }
+    }
+    glFinish();
+    double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    for (int i = 0; i < 2; ++i) {
+        if (fences[i]) {
+            glDeleteSync(fences[i]);
+        }
+    }
+    frameRecorder.collect();
+    profiler.collect();
+    frames = frame;
+    return wallMs;
+}
+
+// Draws 1, 10, ... SweepMaxInstances instances, first with one instanced call and then with one
+// call per instance, and prints the cost of each step as JSON. Each step renders up to
+// options.frames frames, or stops after a second.
+void runInstanceSweep(Scene& scene, ShaderManager& shaders, FrameRecorder& frameRecorder, GpuProfiler& profiler,
+                      const DemoOptions& options) {
+    const double StepBudgetMs = 1000.0;
+    std::cout << std::fixed << std::setprecision(4) << "{\"mode\": \"instance_sweep\", \"renderer\": ";
+    printJsonString(std::cout, reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+    std::cout << ", \"width\": " << options.width << ", \"height\": " << options.height
+              << ", \"persistent\": " << (scene.instanced.stream().persistent() ? "true" : "false")
+              << ", \"results\": [";
+    bool first = true;
+    for (size_t count = 1; count <= SweepMaxInstances; count *= 10) {
+        layoutInstances(scene.instances, count);
+        scene.instanceCount = count;
+        for (int naive = 0; naive < 2; ++naive) {
+            scene.naiveInstances = naive != 0;
+            // A couple of warm-up frames so program resolution and first-use costs stay out
+            int warmup = 2;
+            renderOffscreen(scene, shaders, frameRecorder, profiler, warmup, 0.0);
+            frameRecorder.reset();
+            profiler.reset();
+
+            int frames = options.frames;
+            double wallMs = renderOffscreen(scene, shaders, frameRecorder, profiler, frames, StepBudgetMs);
+            const char* scopeName = scene.naiveInstances ? "instances_naive" : "instances";
+            double cpuMs = 0.0;
+            double gpuMs = 0.0;
+            for (size_t i = 0; i < profiler.scopes().size(); ++i) {
+                const GpuProfiler::ScopeStats& scope = profiler.scopes()[i];
+                if (scope.name == scopeName && scope.samples > 0) {
+                    cpuMs = scope.cpuTotalMs / scope.samples;
+                    gpuMs = scope.gpuTotalMs / scope.samples;
+                }
+            }
+            std::cout << (first ? "" : ", ") << "{\"instances\": " << count
+                      << ", \"draw\": \"" << (scene.naiveInstances ? "naive" : "instanced") << "\""
+                      << ", \"draw_calls\": " << (scene.naiveInstances ? count : 1)
+                      << ", \"frames\": " << frames
+                      << ", \"fps\": " << frames * 1000.0 / wallMs
+                      << ", \"frame_p50_ms\": " << frameRecorder.total().percentile(50.0)
+                      << ", \"frame_p99_ms\": " << frameRecorder.total().percentile(99.0)
+                      << ", \"cpu_ms\": " << cpuMs
+                      << ", \"gpu_ms\": " << gpuMs << "}";
+            std::cout.flush();
+            first = false;
+        }
+    }
+    std::cout << "]}" << std::endl;
+}
+
+// Draws the LOD discs at each of a range of fixed biases and prints the triangles drawn against
+// the frame time as JSON. Each step renders up to options.frames frames, or stops after a second.
+void runLodSweep(Scene& scene, ShaderManager& shaders, FrameRecorder& frameRecorder, GpuProfiler& profiler,
+                 const DemoOptions& options) {
+    const double StepBudgetMs = 1000.0;
+    const float biases[] = { 1.0f / 64.0f, 1.0f / 16.0f, 0.25f, 1.0f, 4.0f, 16.0f };
+    LodManager& manager = scene.lod->manager;
+    manager.setBudget(0.0);
+    std::cout << std::fixed << std::setprecision(4) << "{\"mode\": \"lod_sweep\", \"renderer\": ";
+    printJsonString(std::cout, reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+    std::cout << ", \"width\": " << options.width << ", \"height\": " << options.height
+              << ", \"discs\": " << manager.objectCount()
+              << ", \"threshold_px\": " << manager.threshold() << ", \"results\": [";
+    for (size_t b = 0; b < sizeof(biases) / sizeof(biases[0]); ++b) {
+        manager.setBias(biases[b]);
+        int warmup = 2;
+        renderOffscreen(scene, shaders, frameRecorder, profiler, warmup, 0.0);
+        frameRecorder.reset();
+        profiler.reset();
+
+        int frames = options.frames;
+        double wallMs = renderOffscreen(scene, shaders, frameRecorder, profiler, frames, StepBudgetMs);
+        double gpuMs = 0.0;
+        for (size_t i = 0; i < profiler.scopes().size(); ++i) {
+            const GpuProfiler::ScopeStats& scope = profiler.scopes()[i];
+            if (scope.name.compare(0, 7, "static_") == 0 && scope.samples > 0) {
+                gpuMs = scope.gpuTotalMs / scope.samples;
+            }
+        }
+        std::cout << (b ? ", " : "") << "{\"bias\": " << manager.bias()
+                  << ", \"triangles\": " << manager.triangles()
+                  << ", \"frames\": " << frames
+                  << ", \"fps\": " << frames * 1000.0 / wallMs
+                  << ", \"frame_p50_ms\": " << frameRecorder.total().percentile(50.0)
+                  << ", \"frame_p99_ms\": " << frameRecorder.total().percentile(99.0)
+                  << ", \"static_gpu_ms\": " << gpuMs
+                  << ", \"lod\": ";
+        manager.printJson(std::cout);
+        std::cout << "}";
+        std::cout.flush();
+    }
+    std::cout << "]}" << std::endl;
+}
+
+// Renders options.frames frames into an FBO with no visible window and prints the
+// timings as JSON on stdout. Diagnostics go to stderr so the output stays parseable.
+int runHeadless(const DemoOptions& options) {
+#ifdef GRAPHICS_DEMO_HAS_EGL
+    HeadlessContext context;
+    if (!context.create()) {
+        return -1;
+    }
+    GLADloadfunc loader = HeadlessContext::loader();
+    auto makeCurrent = [&]() { context.makeCurrent(); };
+    auto releaseCurrent = [&]() { context.release(); };
+#else
+    // No EGL: fall back to a hidden GLFW window (still needs a display server)
+    if (!glfwInit()) {
+        std::cerr << "Failed to initialize GLFW" << std::endl;
+        return -1;
+    }
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* window = glfwCreateWindow(1, 1, "Graphics Demo (headless)", nullptr, nullptr);
+    if (!window) {
+        std::cerr << "Failed to create hidden GLFW window" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    GLADloadfunc loader = (GLADloadfunc)glfwGetProcAddress;
+    auto makeCurrent = [&]() { glfwMakeContextCurrent(window); };
+    auto releaseCurrent = [&]() { glfwMakeContextCurrent(nullptr); };
+#endif
+
+    if (!gladLoadGL(loader)) {
+        std::cerr << "Failed to initialize GLAD" << std::endl;
+        // The EGL context goes with its destructor
+#ifndef GRAPHICS_DEMO_HAS_EGL
+        glfwTerminate();
+#endif
+        return -1;
+    }
+
+    int result = 0;
+    {
+        ShaderCache shaderCache;
+        if (options.shaderCache) {
+            shaderCache.init();
+        }
+        ShaderManager shaders(shaderCache.enabled() ? &shaderCache : nullptr);
+        shaders.init();
+        RenderTarget target;
+        JobSystem jobs(options.jobThreads);
+        Scene scene;
+        scene.jobs = &jobs;
+        if (!target.create(options.width, options.height) || !createScene(scene, shaders, options)) {
+            result = -1;
+        } else {
+            target.bind();
+            FrameRecorder frameRecorder;
+            GpuProfiler profiler;
+            if (options.instanceSweep) {
+                runInstanceSweep(scene, shaders, frameRecorder, profiler, options);
+            } else if (options.lodSweep) {
+                runLodSweep(scene, shaders, frameRecorder, profiler, options);
+            } else {
+                int frames = options.frames;
+                double wallMs = 0.0;
+                FramePipeline pipeline;
+                if (options.renderThread) {
+                    // This thread simulates; the context moves to the render thread for the run
+                    releaseCurrent();
+                    std::thread renderThread([&]() {
+                        makeCurrent();
+                        wallMs = renderOffscreen(scene, shaders, frameRecorder, profiler, frames, 0.0, &pipeline);
+                        pipeline.stop();
+                        releaseCurrent();
+                    });
+                    for (int i = 0; i < options.frames; ++i) {
+                        FramePacket* packet = pipeline.beginPacket();
+                        if (!packet) {
+                            break;
+                        }
+                        simulateFrame(scene, scene.lod.get(), static_cast<unsigned>(i), scene.variant, *packet);
+                        pipeline.publish(packet);
+                    }
+                    pipeline.stop();
+                    renderThread.join();
+                    makeCurrent();
+                } else {
+                    wallMs = renderOffscreen(scene, shaders, frameRecorder, profiler, frames, 0.0);
+                }
+
+                std::cout << std::fixed << std::setprecision(4) << "{\"mode\": \"headless\", \"renderer\": ";
+                printJsonString(std::cout, reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+                std::cout << ", \"gl_version\": ";
+                printJsonString(std::cout, reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+                std::cout << ", \"width\": " << options.width
+                          << ", \"height\": " << options.height
+                          << ", \"wall_ms\": " << wallMs
+                          << ", \"fps\": " << frames * 1000.0 / wallMs
+                          << ", \"shader_setup\": {\"submit_ms\": " << scene.shaderSetupMs
+                          << ", \"programs\": " << shaders.size()
+                          << ", \"variant\": \"" << scene.variants->describe(scene.variant) << "\""
+                          << ", \"parallel\": " << (shaders.parallelCompile() ? "true" : "false")
+                          << ", \"cache\": " << (shaderCache.enabled() ? "true" : "false")
+                          << ", \"hits\": " << shaderCache.stats().hits
+                          << ", \"misses\": " << shaderCache.stats().misses
+                          << ", \"rejected\": " << shaderCache.stats().rejected << "}"
+                          << ", \"timing\": ";
+                frameRecorder.printJson(std::cout);
+                std::cout << ", \"gpu_scopes\": ";
+                profiler.printJson(std::cout);
+                if (scene.dynamicTriangles > 0) {
+                    std::cout << ", \"stream\": {\"triangles\": " << scene.dynamicTriangles << ", \"buffer\": ";
+                    scene.stream.printJson(std::cout);
+                    std::cout << "}";
+                }
+                if (scene.useQueue) {
+                    std::cout << ", \"render_queue\": ";
+                    scene.queue.printJson(std::cout);
+                }
+                if (options.renderThread) {
+                    std::cout << ", \"pipeline\": ";
+                    pipeline.printJson(std::cout);
+                }
+                std::cout << ", \"jobs\": ";
+                jobs.printJson(std::cout);
+                std::cout << ", \"gl_state\": ";
+                scene.glState.printJson(std::cout);
+                if (scene.batcher.meshCount() > 0) {
+                    std::cout << ", \"culling\": {\"path\": \"" << (scene.useBvh ? "bvh" : FrustumCuller::pathName(scene.staticBounds.path())) << "\""
+                              << ", \"objects\": " << scene.staticBounds.size();
+                    if (scene.useBvh) {
+                        std::cout << ", \"bvh_nodes\": " << scene.staticTree.nodeCount() << ", \"bvh_depth\": " << scene.staticTree.depth();
+                    }
+                    std::cout << "}";
+                    std::cout << ", \"static_meshes\": ";
+                    scene.batcher.printJson(std::cout);
+                    std::cout << ", \"vertex_layout\": ";
+                    printPackingReport(std::cout, scene.colorLayout, scene.packingErrors);
+                }
+                if (scene.lod) {
+                    std::cout << ", \"lod\": ";
+                    scene.lod->manager.printJson(std::cout);
+                }
+                if (scene.mesh.vertexArray()) {
+                    size_t triangles = 0;
+                    for (size_t i = 0; i < scene.mesh.submeshCount(); ++i) {
+                        triangles += scene.mesh.triangleCount(i);
+                    }
+                    std::cout << ", \"mesh_file\": {\"path\": ";
+                    printJsonString(std::cout, scene.meshPath.c_str());
+                    std::cout << ", \"bytes\": " << scene.meshFileBytes << ", \"vertices\": " << scene.meshVertices
+                              << ", \"triangles\": " << triangles << ", \"submeshes\": " << scene.mesh.submeshCount()
+                              << ", \"open_ms\": " << scene.meshOpenMs << ", \"upload_ms\": " << scene.meshUploadMs << "}";
+                }
+                if (scene.instanceCount > 0) {
+                    std::cout << ", \"instances\": {\"count\": " << scene.instanceCount
+                              << ", \"draw\": \"" << (scene.naiveInstances ? "naive" : "instanced") << "\"}";
+                }
+                std::cout << "}" << std::endl;
+            }
+        }
+        destroyScene(scene);
+    }
+
+#ifndef GRAPHICS_DEMO_HAS_EGL
+    glfwTerminate();
+#endif
+    return result;
+}
+
+int main(int argc, char** argv) {
+    DemoOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        return -1;
+    }
+    return options.headless ? runHeadless(options) : runWindowed(options);
+}
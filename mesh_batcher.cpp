@@ -0,0 +1,218 @@
+#include "mesh_batcher.h"
+
+#include <algorithm>
+#include <cstring>
+
+MeshBatcher::MeshBatcher() {
+    frameStats = Stats();
+}
+
+MeshBatcher::~MeshBatcher() {
+    destroy();
+}
+
+MeshBatcher::MeshHandle MeshBatcher::add(ShaderManager::ProgramHandle program, const VertexFormat& format,
+                                         const void* vertices, size_t vertexCount,
+                                         const uint32_t* indices, size_t indexCount) {
+    int batchIndex = -1;
+    for (size_t i = 0; i < batches.size(); ++i) {
+        if (batches[i].program == program && batches[i].format == format) {
+            batchIndex = static_cast<int>(i);
+            break;
+        }
+    }
+    if (batchIndex < 0) {
+        Batch batch;
+        batch.program = program;
+        batch.format = format;
+        batch.vao = 0;
+        batch.vbo = 0;
+        batch.ibo = 0;
+        batches.push_back(batch);
+        batchIndex = static_cast<int>(batches.size() - 1);
+    }
+    Batch& batch = batches[batchIndex];
+
+    // Rebase the indices onto the shared vertex buffer, so no base vertex is needed to draw
+    uint32_t baseVertex = static_cast<uint32_t>(batch.vertices.size() / format.stride);
+    const char* bytes = static_cast<const char*>(vertices);
+    batch.vertices.insert(batch.vertices.end(), bytes, bytes + vertexCount * format.stride);
+
+    Mesh mesh;
+    mesh.batch = batchIndex;
+    mesh.baseVertex = baseVertex;
+    mesh.firstIndex = batch.indices.size();
+    mesh.indexCount = static_cast<GLsizei>(indexCount);
+    mesh.visible = true;
+    for (size_t i = 0; i < indexCount; ++i) {
+        batch.indices.push_back(baseVertex + indices[i]);
+    }
+    meshes.push_back(mesh);
+    batch.meshes.push_back(static_cast<MeshHandle>(meshes.size() - 1));
+    return static_cast<MeshHandle>(meshes.size() - 1);
+}
+
+MeshBatcher::MeshHandle MeshBatcher::addLevel(MeshHandle base, const uint32_t* indices, size_t indexCount) {
+    Mesh mesh = meshes[base];
+    Batch& batch = batches[mesh.batch];
+    mesh.firstIndex = batch.indices.size();
+    mesh.indexCount = static_cast<GLsizei>(indexCount);
+    mesh.visible = true;
+    for (size_t i = 0; i < indexCount; ++i) {
+        batch.indices.push_back(mesh.baseVertex + indices[i]);
+    }
+    meshes.push_back(mesh);
+    batch.meshes.push_back(static_cast<MeshHandle>(meshes.size() - 1));
+    return static_cast<MeshHandle>(meshes.size() - 1);
+}
+
+void MeshBatcher::build() {
+    // Neighbouring batches that share a program then need only one glUseProgram between them
+    std::vector<int> order(batches.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = static_cast<int>(i);
+    }
+    std::stable_sort(order.begin(), order.end(), [this](int a, int b) {
+        return batches[a].program < batches[b].program;
+    });
+    std::vector<Batch> sorted;
+    std::vector<int> remap(batches.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        remap[order[i]] = static_cast<int>(i);
+        sorted.push_back(batches[order[i]]);
+    }
+    batches.swap(sorted);
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        meshes[i].batch = remap[meshes[i].batch];
+    }
+
+    for (size_t i = 0; i < batches.size(); ++i) {
+        Batch& batch = batches[i];
+        if (batch.vao) {
+            continue;
+        }
+        glGenVertexArrays(1, &batch.vao);
+        glGenBuffers(1, &batch.vbo);
+        glGenBuffers(1, &batch.ibo);
+        glBindVertexArray(batch.vao);
+        glBindBuffer(GL_ARRAY_BUFFER, batch.vbo);
+        glBufferData(GL_ARRAY_BUFFER, batch.vertices.size(), batch.vertices.data(), GL_STATIC_DRAW);
+        batch.format.apply();
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch.ibo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, batch.indices.size() * sizeof(uint32_t), batch.indices.data(), GL_STATIC_DRAW);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        std::vector<char>().swap(batch.vertices);
+        std::vector<uint32_t>().swap(batch.indices);
+    }
+}
+
+void MeshBatcher::destroy() {
+    for (size_t i = 0; i < batches.size(); ++i) {
+        Batch& batch = batches[i];
+        if (batch.vao) {
+            glDeleteVertexArrays(1, &batch.vao);
+            glDeleteBuffers(1, &batch.vbo);
+            glDeleteBuffers(1, &batch.ibo);
+        }
+    }
+    batches.clear();
+    meshes.clear();
+}
+
+void MeshBatcher::setVisible(MeshHandle mesh, bool visible) {
+    if (mesh >= 0 && static_cast<size_t>(mesh) < meshes.size()) {
+        meshes[mesh].visible = visible;
+    }
+}
+
+void MeshBatcher::draw(ShaderManager& shaders, GlStateCache& state) {
+    frameStats = Stats();
+    GLuint currentProgram = 0;
+    for (size_t b = 0; b < batches.size(); ++b) {
+        const Batch& batch = batches[b];
+
+        // Visible meshes as index ranges, merging neighbours into one range
+        drawCounts.clear();
+        drawOffsets.clear();
+        size_t rangeEnd = 0;
+        for (size_t i = 0; i < batch.meshes.size(); ++i) {
+            const Mesh& mesh = meshes[batch.meshes[i]];
+            if (!mesh.visible) {
+                continue;
+            }
+            if (!drawCounts.empty() && rangeEnd == mesh.firstIndex) {
+                drawCounts.back() += mesh.indexCount;
+            } else {
+                drawCounts.push_back(mesh.indexCount);
+                drawOffsets.push_back(reinterpret_cast<const void*>(mesh.firstIndex * sizeof(uint32_t)));
+            }
+            rangeEnd = mesh.firstIndex + mesh.indexCount;
+            ++frameStats.meshes;
+        }
+        if (drawCounts.empty()) {
+            continue;
+        }
+
+        GLuint program = shaders.program(batch.program);
+        if (program != currentProgram) {
+            state.useProgram(program);
+            currentProgram = program;
+            ++frameStats.programBinds;
+        }
+        state.bindVertexArray(batch.vao);
+        ++frameStats.vaoBinds;
+        if (drawCounts.size() == 1) {
+            glDrawElements(GL_TRIANGLES, drawCounts[0], GL_UNSIGNED_INT, drawOffsets[0]);
+        } else {
+            glMultiDrawElements(GL_TRIANGLES, drawCounts.data(), GL_UNSIGNED_INT, drawOffsets.data(),
+                                static_cast<GLsizei>(drawCounts.size()));
+        }
+        ++frameStats.drawCalls;
+    }
+}
+
+void MeshBatcher::drawUnbatched(ShaderManager& shaders, GlStateCache& state) {
+    frameStats = Stats();
+    // Submission order, rebinding everything per mesh like a naive render loop does
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        const Mesh& mesh = meshes[i];
+        if (!mesh.visible) {
+            continue;
+        }
+        const Batch& batch = batches[mesh.batch];
+        state.useProgram(shaders.program(batch.program));
+        state.bindVertexArray(batch.vao);
+        glDrawElements(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT,
+                       reinterpret_cast<const void*>(mesh.firstIndex * sizeof(uint32_t)));
+        ++frameStats.meshes;
+        ++frameStats.programBinds;
+        ++frameStats.vaoBinds;
+        ++frameStats.drawCalls;
+    }
+}
+
+void MeshBatcher::submit(RenderQueue& queue, ShaderManager& shaders, unsigned pass) {
+    frameStats = Stats();
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        const Mesh& mesh = meshes[i];
+        if (!mesh.visible) {
+            continue;
+        }
+        const Batch& batch = batches[mesh.batch];
+        GLuint program = shaders.program(batch.program);
+        queue.pushElements(RenderQueue::makeKey(pass, program, 0, batch.vao), program, batch.vao, GL_TRIANGLES,
+                           mesh.indexCount, GL_UNSIGNED_INT, mesh.firstIndex * sizeof(uint32_t));
+        ++frameStats.meshes;
+    }
+}
+
+void MeshBatcher::printJson(std::ostream& out) const {
+    out << "{\"meshes\": " << meshes.size()
+        << ", \"batches\": " << batches.size()
+        << ", \"drawn\": " << frameStats.meshes
+        << ", \"draw_calls\": " << frameStats.drawCalls
+        << ", \"program_binds\": " << frameStats.programBinds
+        << ", \"vao_binds\": " << frameStats.vaoBinds << "}";
+}
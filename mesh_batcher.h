@@ -0,0 +1,89 @@
+#pragma once
+
+#include "gl_state.h"
+#include "glad/gl_core_33.h"
+#include "render_queue.h"
+#include "shader_manager.h"
+#include "vertex_format.h"
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// Merges static meshes into as few draw calls as possible.
+//
+// Meshes are submitted once at load time with add(). build() groups them by program and
+// vertex format and concatenates each group into one vertex and one index buffer, with the
+// indices rebased so every mesh is a contiguous index range. draw() then binds each group's
+// program and VAO once and draws its visible meshes with a single glDrawElements (all
+// adjacent) or glMultiDrawElements call. drawUnbatched() is the one-draw-per-mesh reference.
+class MeshBatcher {
+public:
+    typedef int MeshHandle;
+
+    // Per-frame counters of the last draw()/drawUnbatched()
+    struct Stats {
+        uint64_t meshes;
+        uint64_t drawCalls;
+        uint64_t programBinds;
+        uint64_t vaoBinds;
+    };
+
+    MeshBatcher();
+    ~MeshBatcher();
+
+    // Copies the mesh. indices are relative to this mesh's own vertices.
+    MeshHandle add(ShaderManager::ProgramHandle program, const VertexFormat& format,
+                   const void* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount);
+    // Another index range over the vertices of a mesh already added, such as a coarser level of
+    // detail. It gets its own handle and visibility.
+    MeshHandle addLevel(MeshHandle mesh, const uint32_t* indices, size_t indexCount);
+    // Uploads every group; the CPU-side copies are released. Needs a current context.
+    void build();
+    void destroy();
+
+    void setVisible(MeshHandle mesh, bool visible);
+    bool visible(MeshHandle mesh) const { return meshes[mesh].visible; }
+
+    void draw(ShaderManager& shaders, GlStateCache& state);
+    void drawUnbatched(ShaderManager& shaders, GlStateCache& state);
+    // Pushes one command per visible mesh and leaves the grouping to the queue's sort.
+    void submit(RenderQueue& queue, ShaderManager& shaders, unsigned pass = 0);
+
+    size_t meshCount() const { return meshes.size(); }
+    size_t batchCount() const { return batches.size(); }
+    const Stats& stats() const { return frameStats; }
+
+    // {"meshes": .., "batches": .., "drawn": .., "draw_calls": .., "program_binds": .., "vao_binds": ..}
+    void printJson(std::ostream& out) const;
+
+private:
+    MeshBatcher(const MeshBatcher&);
+    MeshBatcher& operator=(const MeshBatcher&);
+
+    struct Mesh {
+        int batch;
+        uint32_t baseVertex;  // its first vertex in the batch's vertex buffer
+        size_t firstIndex;    // into the batch's index buffer
+        GLsizei indexCount;
+        bool visible;
+    };
+
+    struct Batch {
+        ShaderManager::ProgramHandle program;
+        VertexFormat format;
+        std::vector<char> vertices;     // staging until build()
+        std::vector<uint32_t> indices;
+        GLuint vao;
+        GLuint vbo;
+        GLuint ibo;
+        std::vector<int> meshes;        // in index buffer order
+    };
+
+    std::vector<Mesh> meshes;
+    std::vector<Batch> batches;
+    // Scratch for glMultiDrawElements, reused every frame
+    std::vector<GLsizei> drawCounts;
+    std::vector<const void*> drawOffsets;
+    Stats frameStats;
+};
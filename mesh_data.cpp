@@ -0,0 +1,208 @@
+#include "mesh_data.h"
+
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+void MeshData::setAttributes(bool hasNormals, bool hasTangents, bool hasTexcoords) {
+    normals = hasNormals;
+    tangents = hasTangents;
+    texcoords = hasTexcoords;
+    stride = 3 + (normals ? 3 : 0) + (tangents ? 4 : 0) + (texcoords ? 2 : 0);
+}
+
+namespace {
+
+// Resolves a 1-based OBJ index; -1 when out of range
+long objIndex(long index, size_t count) {
+    return index >= 1 && index <= static_cast<long>(count) ? index - 1 : -1;
+}
+
+} // namespace
+
+bool loadObj(const std::string& path, MeshData& mesh) {
+    std::ifstream in(path.c_str());
+    if (!in) {
+        std::cerr << "Failed to open " << path << std::endl;
+        return false;
+    }
+    std::vector<float> positions;
+    std::vector<float> normals;
+    std::vector<float> texcoords;
+    // Face corners as position/texcoord/normal, resolved into vertices once all are read
+    std::vector<long> corners;
+    std::vector<MeshGroup> groups;
+    MeshGroup group = { std::string(), 0, 0 };
+    std::string line;
+    size_t lineNumber = 0;
+    while (std::getline(in, line)) {
+        ++lineNumber;
+        const char* text = line.c_str();
+        if (((text[0] == 'o' || text[0] == 'g') && text[1] == ' ') || std::strncmp(text, "usemtl ", 7) == 0) {
+            group.indexCount = corners.size() / 3 - group.firstIndex;
+            if (group.indexCount) {
+                groups.push_back(group);
+            }
+            group.name = line.substr(text[0] == 'u' ? 7 : 2);
+            group.firstIndex = corners.size() / 3;
+        } else if (text[0] == 'v' && text[1] == ' ') {
+            float p[3] = { 0.0f, 0.0f, 0.0f };
+            std::sscanf(text + 2, "%f %f %f", &p[0], &p[1], &p[2]);
+            positions.insert(positions.end(), p, p + 3);
+        } else if (text[0] == 'v' && text[1] == 'n' && text[2] == ' ') {
+            float n[3] = { 0.0f, 0.0f, 0.0f };
+            std::sscanf(text + 3, "%f %f %f", &n[0], &n[1], &n[2]);
+            normals.insert(normals.end(), n, n + 3);
+        } else if (text[0] == 'v' && text[1] == 't' && text[2] == ' ') {
+            float t[2] = { 0.0f, 0.0f };
+            std::sscanf(text + 3, "%f %f", &t[0], &t[1]);
+            texcoords.insert(texcoords.end(), t, t + 2);
+        } else if (text[0] == 'f' && text[1] == ' ') {
+            std::vector<long> polygon;
+            const char* cursor = text + 2;
+            for (;;) {
+                while (*cursor == ' ' || *cursor == '\t' || *cursor == '\r') {
+                    ++cursor;
+                }
+                if (!*cursor) {
+                    break;
+                }
+                char* end = nullptr;
+                long corner[3] = { 0, 0, 0 };
+                corner[0] = std::strtol(cursor, &end, 10);
+                if (end == cursor) {
+                    std::cerr << path << ":" << lineNumber << ": invalid face" << std::endl;
+                    return false;
+                }
+                cursor = end;
+                for (int k = 1; k < 3 && *cursor == '/'; ++k) {
+                    ++cursor;
+                    corner[k] = std::strtol(cursor, &end, 10);
+                    cursor = end;
+                }
+                // Negative indices count back from the elements read so far
+                const size_t counts[3] = { positions.size() / 3, texcoords.size() / 2, normals.size() / 3 };
+                for (int k = 0; k < 3; ++k) {
+                    corner[k] += corner[k] < 0 ? static_cast<long>(counts[k]) + 1 : 0;
+                }
+                polygon.insert(polygon.end(), corner, corner + 3);
+            }
+            for (size_t i = 2; i < polygon.size() / 3; ++i) {
+                corners.insert(corners.end(), polygon.begin(), polygon.begin() + 3);
+                corners.insert(corners.end(), polygon.begin() + (i - 1) * 3, polygon.begin() + (i + 1) * 3);
+            }
+        }
+    }
+
+    group.indexCount = corners.size() / 3 - group.firstIndex;
+    if (group.indexCount) {
+        groups.push_back(group);
+    }
+    mesh.groups.swap(groups);
+
+    // A vertex per corner, then one per distinct vertex
+    mesh.setAttributes(!normals.empty(), false, !texcoords.empty());
+    mesh.corners = corners.size() / 3;
+    std::vector<float> stream;
+    stream.reserve(mesh.corners * mesh.stride);
+    for (size_t i = 0; i < corners.size(); i += 3) {
+        long p = objIndex(corners[i], positions.size() / 3);
+        long t = mesh.texcoords ? objIndex(corners[i + 1], texcoords.size() / 2) : 0;
+        long n = mesh.normals ? objIndex(corners[i + 2], normals.size() / 3) : 0;
+        if (p < 0) {
+            std::cerr << path << ": face references a missing position" << std::endl;
+            return false;
+        }
+        stream.insert(stream.end(), positions.begin() + p * 3, positions.begin() + p * 3 + 3);
+        for (int k = 0; k < 3 && mesh.normals; ++k) {
+            stream.push_back(n >= 0 ? normals[n * 3 + k] : 0.0f);
+        }
+        for (int k = 0; k < 2 && mesh.texcoords; ++k) {
+            stream.push_back(t >= 0 ? texcoords[t * 2 + k] : 0.0f);
+        }
+    }
+    std::vector<char> unique;
+    size_t count = generateIndexBuffer(stream.data(), mesh.corners, mesh.stride * sizeof(float), unique, mesh.indices);
+    mesh.vertices.resize(count * mesh.stride);
+    std::copy(unique.begin(), unique.end(), reinterpret_cast<char*>(mesh.vertices.data()));
+    return true;
+}
+
+void generateTerrain(size_t triangleCount, MeshData& mesh) {
+    size_t cells = static_cast<size_t>(std::ceil(std::sqrt(triangleCount / 2.0)));
+    cells = cells < 1 ? 1 : cells;
+    mesh.setAttributes(true, false, true);
+    mesh.corners = 0;
+    mesh.vertices.clear();
+    mesh.indices.clear();
+    mesh.groups.clear();
+    mesh.vertices.reserve((cells + 1) * (cells + 1) * mesh.stride);
+    for (size_t row = 0; row <= cells; ++row) {
+        for (size_t column = 0; column <= cells; ++column) {
+            float u = static_cast<float>(column) / cells;
+            float v = static_cast<float>(row) / cells;
+            float x = u * 100.0f;
+            float z = v * 100.0f;
+            float y = 6.0f * std::sin(x * 0.05f) * std::cos(z * 0.04f) + 1.5f * std::sin(x * 0.3f + z * 0.2f);
+            float dx = 0.3f * std::cos(x * 0.05f) * std::cos(z * 0.04f) + 0.45f * std::cos(x * 0.3f + z * 0.2f);
+            float dz = -0.24f * std::sin(x * 0.05f) * std::sin(z * 0.04f) + 0.3f * std::cos(x * 0.3f + z * 0.2f);
+            float length = std::sqrt(dx * dx + 1.0f + dz * dz);
+            float vertex[8] = { x, y, z, -dx / length, 1.0f / length, -dz / length, u, v };
+            mesh.vertices.insert(mesh.vertices.end(), vertex, vertex + 8);
+        }
+    }
+    mesh.indices.reserve(cells * cells * 6);
+    for (size_t row = 0; row < cells; ++row) {
+        for (size_t column = 0; column < cells; ++column) {
+            uint32_t a = static_cast<uint32_t>(row * (cells + 1) + column);
+            uint32_t b = a + 1;
+            uint32_t c = static_cast<uint32_t>(a + cells + 1);
+            uint32_t d = c + 1;
+            uint32_t quad[6] = { a, c, b, b, c, d };
+            mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+        }
+    }
+    MeshGroup group = { "terrain", 0, mesh.indices.size() };
+    mesh.groups.assign(1, group);
+}
+
+bool writeObj(const std::string& path, const MeshData& mesh, const std::vector<uint32_t>& indices) {
+    std::ofstream out(path.c_str());
+    out << std::setprecision(7);
+    for (size_t v = 0; v < mesh.vertices.size(); v += mesh.stride) {
+        const float* vertex = &mesh.vertices[v];
+        out << "v " << vertex[0] << " " << vertex[1] << " " << vertex[2] << "\n";
+        if (mesh.normals) {
+            out << "vn " << vertex[3] << " " << vertex[4] << " " << vertex[5] << "\n";
+        }
+        if (mesh.texcoords) {
+            const float* t = vertex + mesh.texcoordOffset();
+            out << "vt " << t[0] << " " << t[1] << "\n";
+        }
+    }
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        out << "f";
+        for (int k = 0; k < 3; ++k) {
+            uint32_t index = indices[i + k] + 1;
+            out << " " << index;
+            if (mesh.texcoords || mesh.normals) {
+                out << "/";
+                if (mesh.texcoords) out << index;
+                if (mesh.normals) out << "/" << index;
+            }
+        }
+        out << "\n";
+    }
+    if (!out) {
+        std::cerr << "Failed to write " << path << std::endl;
+        return false;
+    }
+    return true;
+}
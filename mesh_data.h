@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// An indexed triangle mesh in memory, as the offline tools read and write it: interleaved float
+// vertices (position, then normal, tangent and texture coordinate when the mesh has them) and
+// 32-bit indices, split into groups that keep the source's objects and materials apart. Tangents
+// are xyz plus the bitangent's handedness in w, as in glTF.
+
+struct MeshGroup {
+    std::string name;
+    size_t firstIndex;
+    size_t indexCount;
+};
+
+struct MeshData {
+    std::vector<float> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<MeshGroup> groups;  // cover indices in order; at least one when there are triangles
+    size_t stride;     // floats per vertex
+    bool normals;
+    bool tangents;
+    bool texcoords;
+    size_t corners;    // face corners before indexing, for OBJ input
+
+    MeshData() : stride(3), normals(false), tangents(false), texcoords(false), corners(0) {}
+
+    size_t vertexCount() const { return vertices.size() / stride; }
+    // Float offsets of the attributes within a vertex, when present
+    size_t normalOffset() const { return 3; }
+    size_t tangentOffset() const { return normals ? 6 : 3; }
+    size_t texcoordOffset() const { return tangentOffset() + (tangents ? 4 : 0); }
+    // Sets the flags and the stride to match
+    void setAttributes(bool hasNormals, bool hasTangents, bool hasTexcoords);
+};
+
+// Reads a Wavefront OBJ: positions, normals and texture coordinates. Polygons are fanned into
+// triangles and identical corners merged with generateIndexBuffer(). Every o, g and usemtl line
+// starts a new group.
+bool loadObj(const std::string& path, MeshData& mesh);
+
+// Writes the triangles in indices, and every vertex, as an OBJ.
+bool writeObj(const std::string& path, const MeshData& mesh, const std::vector<uint32_t>& indices);
+
+// Rolling terrain over a square grid of about triangleCount triangles, with analytic normals and
+// one texture repeat, 100 units across.
+void generateTerrain(size_t triangleCount, MeshData& mesh);
@@ -0,0 +1,218 @@
+#include "mesh_file.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// The layout is the file format; these must not change without a version bump
+static_assert(sizeof(MeshFileHeader) == 128, "MeshFileHeader layout changed");
+static_assert(sizeof(MeshFileElement) == 20, "MeshFileElement layout changed");
+static_assert(sizeof(MeshFileSubmesh) == 40, "MeshFileSubmesh layout changed");
+
+namespace {
+
+uint64_t alignUp(uint64_t offset) {
+    return (offset + MeshFileAlignment - 1) & ~static_cast<uint64_t>(MeshFileAlignment - 1);
+}
+
+// Pads the stream with zeros up to offset
+void padTo(std::ofstream& out, uint64_t& written, uint64_t offset) {
+    static const char zeros[MeshFileAlignment] = {};
+    out.write(zeros, static_cast<std::streamsize>(offset - written));
+    written = offset;
+}
+
+bool isEncoding(uint32_t value) {
+    return value <= static_cast<uint32_t>(VertexEncoding::Unorm8);
+}
+
+bool isSemantic(uint32_t value) {
+    return value <= static_cast<uint32_t>(VertexSemantic::Color);
+}
+
+} // namespace
+
+bool writeMeshFile(const std::string& path, const VertexLayout& layout, const Dequantization& dequantization,
+                   const void* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount,
+                   std::vector<MeshFileSubmesh> submeshes) {
+    if (vertexCount > 0xffffffffu || indexCount > 0xffffffffu) {
+        std::cerr << "Mesh too large for " << path << std::endl;
+        return false;
+    }
+    MeshFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.magic = MeshFileMagic;
+    header.version = MeshFileVersion;
+    header.headerSize = sizeof(MeshFileHeader);
+    header.vertexCount = static_cast<uint32_t>(vertexCount);
+    header.vertexStride = static_cast<uint32_t>(layout.stride());
+    header.indexCount = static_cast<uint32_t>(indexCount);
+    header.indexSize = vertexCount <= 0x10000u ? 2 : 4;
+    header.elementCount = static_cast<uint32_t>(layout.elements().size());
+    header.submeshCount = static_cast<uint32_t>(submeshes.size());
+    for (int k = 0; k < 3; ++k) {
+        header.boundsMin[k] = submeshes.empty() ? 0.0f : submeshes[0].boundsMin[k];
+        header.boundsMax[k] = submeshes.empty() ? 0.0f : submeshes[0].boundsMax[k];
+        header.positionScale[k] = dequantization.scale[k];
+        header.positionOffset[k] = dequantization.offset[k];
+    }
+    for (size_t s = 0; s < submeshes.size(); ++s) {
+        MeshFileSubmesh& submesh = submeshes[s];
+        if (static_cast<size_t>(submesh.firstIndex) + submesh.indexCount > indexCount) {
+            std::cerr << "Submesh " << s << " runs past the index buffer" << std::endl;
+            return false;
+        }
+        submesh.minVertex = submesh.indexCount ? 0xffffffffu : 0;
+        submesh.maxVertex = 0;
+        for (size_t i = submesh.firstIndex; i < submesh.firstIndex + submesh.indexCount; ++i) {
+            submesh.minVertex = std::min(submesh.minVertex, indices[i]);
+            submesh.maxVertex = std::max(submesh.maxVertex, indices[i]);
+        }
+        for (int k = 0; k < 3; ++k) {
+            header.boundsMin[k] = std::min(header.boundsMin[k], submesh.boundsMin[k]);
+            header.boundsMax[k] = std::max(header.boundsMax[k], submesh.boundsMax[k]);
+        }
+    }
+    header.elementsOffset = alignUp(sizeof(MeshFileHeader));
+    header.submeshesOffset = alignUp(header.elementsOffset + header.elementCount * sizeof(MeshFileElement));
+    header.verticesOffset = alignUp(header.submeshesOffset + header.submeshCount * sizeof(MeshFileSubmesh));
+    header.indicesOffset = alignUp(header.verticesOffset + static_cast<uint64_t>(vertexCount) * header.vertexStride);
+    header.fileSize = header.indicesOffset + static_cast<uint64_t>(indexCount) * header.indexSize;
+
+    std::ofstream out(path.c_str(), std::ios::binary);
+    if (!out) {
+        std::cerr << "Failed to create " << path << std::endl;
+        return false;
+    }
+    uint64_t written = 0;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    written += sizeof(header);
+    padTo(out, written, header.elementsOffset);
+    const std::vector<VertexElement>& elements = layout.elements();
+    for (size_t e = 0; e < elements.size(); ++e) {
+        MeshFileElement element = { elements[e].location, static_cast<uint32_t>(elements[e].semantic),
+                                    static_cast<uint32_t>(elements[e].components),
+                                    static_cast<uint32_t>(elements[e].encoding), static_cast<uint32_t>(elements[e].offset) };
+        out.write(reinterpret_cast<const char*>(&element), sizeof(element));
+        written += sizeof(element);
+    }
+    padTo(out, written, header.submeshesOffset);
+    if (!submeshes.empty()) {
+        out.write(reinterpret_cast<const char*>(submeshes.data()), submeshes.size() * sizeof(MeshFileSubmesh));
+        written += submeshes.size() * sizeof(MeshFileSubmesh);
+    }
+    padTo(out, written, header.verticesOffset);
+    out.write(static_cast<const char*>(vertices), static_cast<std::streamsize>(vertexCount * header.vertexStride));
+    written += static_cast<uint64_t>(vertexCount) * header.vertexStride;
+    padTo(out, written, header.indicesOffset);
+    if (header.indexSize == 4) {
+        out.write(reinterpret_cast<const char*>(indices), static_cast<std::streamsize>(indexCount * 4));
+    } else {
+        std::vector<uint16_t> narrow(indices, indices + indexCount);
+        out.write(reinterpret_cast<const char*>(narrow.data()), static_cast<std::streamsize>(indexCount * 2));
+    }
+    if (!out) {
+        std::cerr << "Failed to write " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool MeshFile::open(const std::string& path) {
+    close();
+    if (!mapping.open(path)) {
+        std::cerr << "Failed to open " << path << std::endl;
+        return false;
+    }
+    if (!validate(path)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MeshFile::close() {
+    mapping.close();
+    headerData = nullptr;
+    submeshData = nullptr;
+    vertexLayout = VertexLayout();
+}
+
+Dequantization MeshFile::dequantization() const {
+    Dequantization result;
+    for (int k = 0; k < 3; ++k) {
+        result.scale[k] = headerData->positionScale[k];
+        result.offset[k] = headerData->positionOffset[k];
+    }
+    return result;
+}
+
+bool MeshFile::validate(const std::string& path) {
+    const MeshFileHeader* header = reinterpret_cast<const MeshFileHeader*>(mapping.data());
+    if (mapping.size() < sizeof(MeshFileHeader) || header->magic != MeshFileMagic) {
+        std::cerr << path << ": not a mesh file" << std::endl;
+        return false;
+    }
+    if (header->version != MeshFileVersion) {
+        std::cerr << path << ": mesh file version " << header->version << ", expected " << MeshFileVersion
+                  << "; convert it again" << std::endl;
+        return false;
+    }
+    // Every section must lie inside the file, in order and aligned. Offsets are checked against
+    // the file size first; the section sizes come from 32-bit counts, so the ends can't overflow.
+    if (header->fileSize != mapping.size() || header->elementsOffset > header->fileSize
+        || header->submeshesOffset > header->fileSize || header->verticesOffset > header->fileSize
+        || header->indicesOffset > header->fileSize) {
+        std::cerr << path << ": truncated or inconsistent mesh file" << std::endl;
+        return false;
+    }
+    uint64_t elementsEnd = header->elementsOffset + static_cast<uint64_t>(header->elementCount) * sizeof(MeshFileElement);
+    uint64_t submeshesEnd = header->submeshesOffset + static_cast<uint64_t>(header->submeshCount) * sizeof(MeshFileSubmesh);
+    uint64_t verticesEnd = header->verticesOffset + static_cast<uint64_t>(header->vertexCount) * header->vertexStride;
+    uint64_t indicesEnd = header->indicesOffset + static_cast<uint64_t>(header->indexCount) * header->indexSize;
+    bool aligned = header->elementsOffset % MeshFileAlignment == 0 && header->submeshesOffset % MeshFileAlignment == 0
+        && header->verticesOffset % MeshFileAlignment == 0 && header->indicesOffset % MeshFileAlignment == 0;
+    if (header->headerSize != sizeof(MeshFileHeader) || !aligned
+        || header->elementsOffset < header->headerSize || elementsEnd > header->submeshesOffset
+        || submeshesEnd > header->verticesOffset || verticesEnd > header->indicesOffset
+        || indicesEnd > header->fileSize || (header->indexSize != 2 && header->indexSize != 4)) {
+        std::cerr << path << ": truncated or inconsistent mesh file" << std::endl;
+        return false;
+    }
+
+    const MeshFileElement* elements = reinterpret_cast<const MeshFileElement*>(mapping.data() + header->elementsOffset);
+    VertexLayout layout;
+    for (uint32_t e = 0; e < header->elementCount; ++e) {
+        const MeshFileElement& element = elements[e];
+        if (!isSemantic(element.semantic) || !isEncoding(element.encoding) || element.components < 1
+            || element.components > 4 || element.offset != layout.stride()) {
+            std::cerr << path << ": invalid vertex element " << e << std::endl;
+            return false;
+        }
+        layout.add(element.location, static_cast<VertexSemantic>(element.semantic), static_cast<int>(element.components),
+                   static_cast<VertexEncoding>(element.encoding));
+    }
+    if (layout.stride() != header->vertexStride) {
+        std::cerr << path << ": vertex stride " << header->vertexStride << " does not match its layout" << std::endl;
+        return false;
+    }
+
+    const MeshFileSubmesh* submeshes = reinterpret_cast<const MeshFileSubmesh*>(mapping.data() + header->submeshesOffset);
+    for (uint32_t s = 0; s < header->submeshCount; ++s) {
+        const MeshFileSubmesh& submesh = submeshes[s];
+        if (static_cast<uint64_t>(submesh.firstIndex) + submesh.indexCount > header->indexCount
+            || (submesh.indexCount && (submesh.minVertex > submesh.maxVertex || submesh.maxVertex >= header->vertexCount))) {
+            std::cerr << path << ": invalid submesh " << s << std::endl;
+            return false;
+        }
+    }
+    // The index values themselves are not checked: that would touch every page of the index
+    // buffer, which is the parse this format exists to avoid. They are trusted as the
+    // converter wrote them.
+
+    headerData = header;
+    submeshData = submeshes;
+    vertexLayout = layout;
+    return true;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "mapped_file.h"
+#include "vertex_layout.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Binary mesh container that loads without parsing.
+//
+// The file is the GPU's view of the mesh: the vertex buffer in its final layout and the index
+// buffer in its final width, each starting on a 16-byte boundary, described by a fixed header
+// and two small tables. MeshFile maps it, checks that the header and tables are consistent with
+// the file size, and hands out pointers into the mapping that go straight to glBufferData().
+// All fields are little-endian.
+//
+//   MeshFileHeader
+//   MeshFileElement[elementCount]   vertex layout, as VertexLayout elements
+//   MeshFileSubmesh[submeshCount]   index ranges with their bounds
+//   vertices                        vertexCount * vertexStride bytes
+//   indices                         indexCount * indexSize bytes
+//
+// A reader accepts only its own version; the converter rewrites older files.
+
+const uint32_t MeshFileMagic = 0x48534d47u;  // "GMSH"
+const uint32_t MeshFileVersion = 1;
+const size_t MeshFileAlignment = 16;
+
+struct MeshFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t vertexCount;
+    uint32_t vertexStride;
+    uint32_t indexCount;
+    uint32_t indexSize;      // 2 or 4
+    uint32_t elementCount;
+    uint32_t submeshCount;
+    uint32_t reserved;
+    float boundsMin[3];
+    float boundsMax[3];
+    float positionScale[3];  // Dequantization of the positions
+    float positionOffset[3];
+    uint64_t elementsOffset;
+    uint64_t submeshesOffset;
+    uint64_t verticesOffset;
+    uint64_t indicesOffset;
+    uint64_t fileSize;
+};
+
+struct MeshFileElement {
+    uint32_t location;
+    uint32_t semantic;       // VertexSemantic
+    uint32_t components;
+    uint32_t encoding;       // VertexEncoding
+    uint32_t offset;
+};
+
+struct MeshFileSubmesh {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    uint32_t minVertex;      // range of the vertices it uses, for glDrawRangeElements
+    uint32_t maxVertex;
+    float boundsMin[3];
+    float boundsMax[3];
+};
+
+// Writes a mesh file. vertices are already in layout; indices are narrowed to 16 bits when every
+// vertex fits. The submeshes' vertex ranges are filled in here, their bounds come from the
+// caller, and the file's bounds are their union.
+bool writeMeshFile(const std::string& path, const VertexLayout& layout, const Dequantization& dequantization,
+                   const void* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount,
+                   std::vector<MeshFileSubmesh> submeshes);
+
+class MeshFile {
+public:
+    MeshFile() : headerData(nullptr), submeshData(nullptr) {}
+
+    // Maps and validates the file; on failure says why on stderr and returns false.
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const { return headerData != nullptr; }
+    const MeshFileHeader& header() const { return *headerData; }
+    size_t fileSize() const { return mapping.size(); }
+
+    const VertexLayout& layout() const { return vertexLayout; }
+    Dequantization dequantization() const;
+    size_t vertexCount() const { return headerData->vertexCount; }
+    size_t indexCount() const { return headerData->indexCount; }
+    size_t indexSize() const { return headerData->indexSize; }
+    size_t submeshCount() const { return headerData->submeshCount; }
+    const MeshFileSubmesh& submesh(size_t i) const { return submeshData[i]; }
+
+    // Pointers into the mapping, valid while the file is open
+    const void* vertices() const { return mapping.data() + headerData->verticesOffset; }
+    size_t vertexBytes() const { return static_cast<size_t>(headerData->vertexCount) * headerData->vertexStride; }
+    const void* indices() const { return mapping.data() + headerData->indicesOffset; }
+    size_t indexBytes() const { return static_cast<size_t>(headerData->indexCount) * headerData->indexSize; }
+
+private:
+    MeshFile(const MeshFile&);
+    MeshFile& operator=(const MeshFile&);
+
+    bool validate(const std::string& path);
+
+    MappedFile mapping;
+    const MeshFileHeader* headerData;
+    const MeshFileSubmesh* submeshData;
+    VertexLayout vertexLayout;
+};
@@ -0,0 +1,365 @@
+#include "mesh_optimizer.h"
+
+#include "hash.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// Cache size Forsyth's scores are tuned for; larger than the simulated FIFO on purpose, so
+// triangles near the cache's tail still pull their neighbours in
+const int ForsythCacheSize = 32;
+// Valences above this score as this; the boost is small by then
+const int MaxScoredValence = 64;
+
+// FIFO post-transform cache: a vertex hits if fewer than cacheSize misses happened since it
+// last missed
+class FifoCache {
+public:
+    FifoCache(size_t vertexCount, int size) : stamps(vertexCount, 0), time(static_cast<uint64_t>(size) + 1), size(size) {}
+
+    bool access(uint32_t vertex) {
+        if (time - stamps[vertex] < static_cast<uint64_t>(size)) {
+            return true;
+        }
+        stamps[vertex] = ++time;
+        return false;
+    }
+    // Everything misses again, as at the start of a draw
+    void flush() { time += static_cast<uint64_t>(size) + 1; }
+
+private:
+    std::vector<uint64_t> stamps;
+    uint64_t time;
+    int size;
+};
+
+struct ForsythScores {
+    float cache[ForsythCacheSize];
+    float valence[MaxScoredValence + 1];
+
+    ForsythScores() {
+        // The last triangle's vertices score a fixed amount below the best of the rest, so
+        // the next triangle is not always one that shares two of them
+        for (int i = 0; i < ForsythCacheSize; ++i) {
+            cache[i] = i < 3 ? 0.75f : std::pow(1.0f - (i - 3) * (1.0f / (ForsythCacheSize - 3)), 1.5f);
+        }
+        // Vertices with few triangles left are finished off first
+        valence[0] = 0.0f;
+        for (int i = 1; i <= MaxScoredValence; ++i) {
+            valence[i] = 2.0f / std::sqrt(static_cast<float>(i));
+        }
+    }
+
+    float vertex(int cachePosition, uint32_t liveTriangles) const {
+        if (liveTriangles == 0) {
+            return -1.0f;
+        }
+        float score = cachePosition >= 0 ? cache[cachePosition] : 0.0f;
+        return score + valence[std::min(liveTriangles, static_cast<uint32_t>(MaxScoredValence))];
+    }
+};
+
+} // namespace
+
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, int cacheSize) {
+    VertexCacheStats stats = { 0, 0.0, 0.0 };
+    FifoCache cache(vertexCount, cacheSize);
+    std::vector<uint8_t> referenced(vertexCount, 0);
+    size_t unique = 0;
+    for (size_t i = 0; i < indexCount; ++i) {
+        stats.misses += cache.access(indices[i]) ? 0 : 1;
+        unique += referenced[indices[i]] ? 0 : 1;
+        referenced[indices[i]] = 1;
+    }
+    stats.acmr = indexCount ? static_cast<double>(stats.misses) / (indexCount / 3) : 0.0;
+    stats.atvr = unique ? static_cast<double>(stats.misses) / unique : 0.0;
+    return stats;
+}
+
+size_t generateIndexBuffer(const void* vertices, size_t vertexCount, size_t vertexSize,
+                           std::vector<char>& uniqueVertices, std::vector<uint32_t>& indices) {
+    const char* bytes = static_cast<const char*>(vertices);
+    // Open addressing over unique vertex indices, at most half full
+    size_t buckets = 1;
+    while (buckets < vertexCount * 2) {
+        buckets *= 2;
+    }
+    const uint32_t Empty = ~0u;
+    std::vector<uint32_t> table(buckets, Empty);
+    uniqueVertices.clear();
+    indices.resize(vertexCount);
+    size_t unique = 0;
+    for (size_t v = 0; v < vertexCount; ++v) {
+        const char* vertex = bytes + v * vertexSize;
+        size_t bucket = static_cast<size_t>(fnv1a64(vertex, vertexSize)) & (buckets - 1);
+        while (table[bucket] != Empty && std::memcmp(&uniqueVertices[table[bucket] * vertexSize], vertex, vertexSize) != 0) {
+            bucket = (bucket + 1) & (buckets - 1);
+        }
+        if (table[bucket] == Empty) {
+            table[bucket] = static_cast<uint32_t>(unique++);
+            uniqueVertices.insert(uniqueVertices.end(), vertex, vertex + vertexSize);
+        }
+        indices[v] = table[bucket];
+    }
+    return unique;
+}
+
+void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount) {
+    static const ForsythScores scores;
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // Live triangles per vertex: the first liveCount entries of each adjacency range
+    std::vector<uint32_t> liveCount(vertexCount, 0);
+    for (size_t i = 0; i < indexCount; ++i) {
+        ++liveCount[indices[i]];
+    }
+    std::vector<size_t> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        offsets[v + 1] = offsets[v] + liveCount[v];
+    }
+    std::vector<uint32_t> adjacency(indexCount);
+    std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indexCount; ++i) {
+        adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        vertexScore[v] = scores.vertex(-1, liveCount[v]);
+    }
+    size_t best = 0;
+    float bestScore = -1.0f;
+    for (size_t t = 0; t < triangleCount; ++t) {
+        float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+        if (score > bestScore) {
+            bestScore = score;
+            best = t;
+        }
+    }
+
+    std::vector<uint32_t> output(indexCount);
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> nextCache;
+    cache.reserve(ForsythCacheSize + 3);
+    nextCache.reserve(ForsythCacheSize + 3);
+    size_t cursor = 0;
+    const size_t NoTriangle = ~static_cast<size_t>(0);
+    for (size_t written = 0; written < triangleCount; ++written) {
+        if (best == NoTriangle) {
+            // Nothing in the cache has triangles left: start again at the next unused one
+            while (emitted[cursor]) {
+                ++cursor;
+            }
+            best = cursor;
+        }
+        const uint32_t* triangle = indices + best * 3;
+        std::copy(triangle, triangle + 3, output.begin() + written * 3);
+        emitted[best] = 1;
+
+        // The triangle's vertices go to the front of the cache, and it leaves their live lists
+        nextCache.assign(triangle, triangle + 3);
+        for (int k = 0; k < 3; ++k) {
+            uint32_t vertex = triangle[k];
+            uint32_t* live = &adjacency[offsets[vertex]];
+            for (uint32_t i = 0; i < liveCount[vertex]; ++i) {
+                if (live[i] == best) {
+                    std::swap(live[i], live[liveCount[vertex] - 1]);
+                    --liveCount[vertex];
+                    break;
+                }
+            }
+        }
+        for (size_t i = 0; i < cache.size(); ++i) {
+            if (cache[i] != triangle[0] && cache[i] != triangle[1] && cache[i] != triangle[2]) {
+                nextCache.push_back(cache[i]);
+            }
+        }
+
+        // Rescore everything that moved in the cache or fell out of it, and pick the best
+        // triangle still touching the cache
+        for (size_t i = 0; i < nextCache.size(); ++i) {
+            uint32_t vertex = nextCache[i];
+            cachePosition[vertex] = i < static_cast<size_t>(ForsythCacheSize) ? static_cast<int>(i) : -1;
+            vertexScore[vertex] = scores.vertex(cachePosition[vertex], liveCount[vertex]);
+        }
+        best = NoTriangle;
+        bestScore = -1.0f;
+        for (size_t i = 0; i < nextCache.size(); ++i) {
+            uint32_t vertex = nextCache[i];
+            const uint32_t* live = &adjacency[offsets[vertex]];
+            for (uint32_t j = 0; j < liveCount[vertex]; ++j) {
+                uint32_t t = live[j];
+                float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+                if (score > bestScore) {
+                    bestScore = score;
+                    best = t;
+                }
+            }
+        }
+        if (nextCache.size() > static_cast<size_t>(ForsythCacheSize)) {
+            nextCache.resize(ForsythCacheSize);
+        }
+        cache.swap(nextCache);
+    }
+    std::copy(output.begin(), output.end(), indices);
+}
+
+void optimizeOverdraw(uint32_t* indices, size_t indexCount, const float* positions, size_t vertexCount,
+                      size_t positionStride, float threshold) {
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount < 2) {
+        return;
+    }
+    const char* base = reinterpret_cast<const char*>(positions);
+
+    // Hard boundaries: triangles whose three vertices all miss, where the cache order restarts
+    FifoCache cache(vertexCount, DefaultVertexCacheSize);
+    std::vector<size_t> hardStarts;
+    std::vector<uint32_t> misses(triangleCount);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        misses[t] = 0;
+        for (int k = 0; k < 3; ++k) {
+            misses[t] += cache.access(indices[t * 3 + k]) ? 0 : 1;
+        }
+        if (misses[t] == 3) {
+            hardStarts.push_back(t);
+        }
+    }
+    if (hardStarts.empty() || hardStarts[0] != 0) {
+        hardStarts.insert(hardStarts.begin(), 0);
+    }
+    hardStarts.push_back(triangleCount);
+
+    // Soft boundaries inside each: wherever restarting the cache keeps the run so far within
+    // threshold of the cluster's own ACMR
+    std::vector<size_t> starts;
+    for (size_t c = 0; c + 1 < hardStarts.size(); ++c) {
+        size_t begin = hardStarts[c];
+        size_t end = hardStarts[c + 1];
+        size_t clusterMisses = 0;
+        for (size_t t = begin; t < end; ++t) {
+            clusterMisses += misses[t];
+        }
+        double limit = threshold * static_cast<double>(clusterMisses) / (end - begin);
+        starts.push_back(begin);
+        cache.flush();
+        size_t runStart = begin;
+        size_t runMisses = 0;
+        for (size_t t = begin; t < end; ++t) {
+            for (int k = 0; k < 3; ++k) {
+                runMisses += cache.access(indices[t * 3 + k]) ? 0 : 1;
+            }
+            if (t + 1 < end && static_cast<double>(runMisses) / (t + 1 - runStart) <= limit) {
+                starts.push_back(t + 1);
+                cache.flush();
+                runStart = t + 1;
+                runMisses = 0;
+            }
+        }
+    }
+    starts.push_back(triangleCount);
+
+    // Each cluster's area-weighted centroid and normal, and the mesh's centroid
+    size_t clusterCount = starts.size() - 1;
+    std::vector<double> centroids(clusterCount * 3, 0.0);
+    std::vector<double> normals(clusterCount * 3, 0.0);
+    double meshCentroid[3] = { 0.0, 0.0, 0.0 };
+    double meshArea = 0.0;
+    for (size_t c = 0; c < clusterCount; ++c) {
+        double area = 0.0;
+        for (size_t t = starts[c]; t < starts[c + 1]; ++t) {
+            const float* p[3];
+            for (int k = 0; k < 3; ++k) {
+                p[k] = reinterpret_cast<const float*>(base + indices[t * 3 + k] * positionStride);
+            }
+            double u[3] = { p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] };
+            double v[3] = { p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2] };
+            double n[3] = { u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0] };
+            double weight = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for (int k = 0; k < 3; ++k) {
+                centroids[c * 3 + k] += weight * (p[0][k] + p[1][k] + p[2][k]) / 3.0;
+                normals[c * 3 + k] += n[k];
+            }
+            area += weight;
+        }
+        for (int k = 0; k < 3; ++k) {
+            meshCentroid[k] += centroids[c * 3 + k];
+            centroids[c * 3 + k] = area > 0.0 ? centroids[c * 3 + k] / area : 0.0;
+        }
+        meshArea += area;
+    }
+    for (int k = 0; k < 3; ++k) {
+        meshCentroid[k] = meshArea > 0.0 ? meshCentroid[k] / meshArea : 0.0;
+    }
+
+    // Clusters facing away from the centre tend to occlude the rest, so they go first
+    std::vector<std::pair<double, size_t> > order(clusterCount);
+    for (size_t c = 0; c < clusterCount; ++c) {
+        const double* n = &normals[c * 3];
+        double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        double facing = 0.0;
+        for (int k = 0; k < 3 && length > 0.0; ++k) {
+            facing += (centroids[c * 3 + k] - meshCentroid[k]) * n[k] / length;
+        }
+        order[c] = std::make_pair(-facing, c);
+    }
+    std::stable_sort(order.begin(), order.end());
+
+    std::vector<uint32_t> sorted;
+    sorted.reserve(indexCount);
+    for (size_t i = 0; i < clusterCount; ++i) {
+        size_t c = order[i].second;
+        sorted.insert(sorted.end(), indices + starts[c] * 3, indices + starts[c + 1] * 3);
+    }
+    VertexCacheStats before = analyzeVertexCache(indices, indexCount, vertexCount);
+    VertexCacheStats after = analyzeVertexCache(sorted.data(), sorted.size(), vertexCount);
+    if (after.acmr <= before.acmr * threshold) {
+        std::copy(sorted.begin(), sorted.end(), indices);
+    }
+}
+
+size_t vertexFetchRemap(const uint32_t* indices, size_t indexCount, size_t vertexCount, std::vector<uint32_t>& remap) {
+    remap.assign(vertexCount, ~0u);
+    uint32_t next = 0;
+    for (size_t i = 0; i < indexCount; ++i) {
+        if (remap[indices[i]] == ~0u) {
+            remap[indices[i]] = next++;
+        }
+    }
+    return next;
+}
+
+void remapVertexBuffer(void* destination, const void* vertices, size_t vertexCount, size_t vertexSize,
+                       const std::vector<uint32_t>& remap) {
+    char* out = static_cast<char*>(destination);
+    const char* in = static_cast<const char*>(vertices);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        if (remap[v] != ~0u) {
+            std::memcpy(out + remap[v] * vertexSize, in + v * vertexSize, vertexSize);
+        }
+    }
+}
+
+void remapIndexBuffer(uint32_t* indices, size_t indexCount, const std::vector<uint32_t>& remap) {
+    for (size_t i = 0; i < indexCount; ++i) {
+        indices[i] = remap[indices[i]];
+    }
+}
+
+size_t optimizeVertexFetch(void* vertices, size_t vertexCount, size_t vertexSize, uint32_t* indices, size_t indexCount) {
+    std::vector<uint32_t> remap;
+    size_t used = vertexFetchRemap(indices, indexCount, vertexCount, remap);
+    std::vector<char> reordered(used * vertexSize);
+    remapVertexBuffer(reordered.data(), vertices, vertexCount, vertexSize, remap);
+    remapIndexBuffer(indices, indexCount, remap);
+    std::copy(reordered.begin(), reordered.end(), static_cast<char*>(vertices));
+    return used;
+}
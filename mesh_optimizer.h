@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Index and vertex buffer reordering for indexed triangle meshes. Run in this order:
+//
+//   generateIndexBuffer    identical vertices of a non-indexed stream become one
+//   optimizeVertexCache    triangles reordered so recently transformed vertices get reused
+//                          (Forsyth's scoring over an LRU cache model)
+//   optimizeOverdraw       runs of that order sorted so outward-facing parts draw first,
+//                          as long as the cache efficiency stays within a threshold
+//   optimizeVertexFetch    vertices reordered by first use, so fetches walk memory forwards
+//
+// analyzeVertexCache measures the result on a FIFO cache like the post-transform caches of
+// current GPUs.
+
+// Post-transform cache efficiency of an index buffer
+struct VertexCacheStats {
+    size_t misses;   // vertex shader invocations
+    double acmr;     // misses per triangle; 0.5 is ideal on large regular meshes, 3 is worst
+    double atvr;     // misses per referenced vertex; 1 is ideal
+};
+
+// Cache size analyzeVertexCache() models unless told otherwise
+const int DefaultVertexCacheSize = 16;
+
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+                                    int cacheSize = DefaultVertexCacheSize);
+
+// vertices holds vertexCount vertices of vertexSize bytes, one per triangle corner. Vertices
+// that are byte for byte identical are merged; uniqueVertices gets them in first-use order and
+// indices one entry per input vertex. Returns the unique vertex count.
+size_t generateIndexBuffer(const void* vertices, size_t vertexCount, size_t vertexSize,
+                           std::vector<char>& uniqueVertices, std::vector<uint32_t>& indices);
+
+// Reorders the triangles in place; the vertices are untouched.
+void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+// Expects the output of optimizeVertexCache(). Splits it into clusters where the cache
+// restarts, then sorts the clusters so those facing away from the mesh centre come first.
+// Keeps the original order if the sorted one costs more than threshold times its ACMR.
+// positions is the first float of the first vertex; positionStride is in bytes.
+void optimizeOverdraw(uint32_t* indices, size_t indexCount, const float* positions, size_t vertexCount,
+                      size_t positionStride, float threshold = 1.05f);
+
+// remap gets vertexCount entries: each vertex's position in first-use order over indices, or
+// ~0u for vertices nothing uses. Several index buffers over one vertex buffer, such as the
+// levels of a LOD chain, can be remapped together by passing their concatenation. Returns the
+// used vertex count.
+size_t vertexFetchRemap(const uint32_t* indices, size_t indexCount, size_t vertexCount, std::vector<uint32_t>& remap);
+// destination receives the used vertices, which must not overlap vertices
+void remapVertexBuffer(void* destination, const void* vertices, size_t vertexCount, size_t vertexSize,
+                       const std::vector<uint32_t>& remap);
+void remapIndexBuffer(uint32_t* indices, size_t indexCount, const std::vector<uint32_t>& remap);
+
+// Both remaps for a single index buffer, in place. Unused vertices are dropped; returns the
+// vertex count left.
+size_t optimizeVertexFetch(void* vertices, size_t vertexCount, size_t vertexSize, uint32_t* indices, size_t indexCount);
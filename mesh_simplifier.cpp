@@ -0,0 +1,642 @@
+#include "mesh_simplifier.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <utility>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// lockedFlags bits
+const uint8_t LockedVertex = 1;    // never moves
+const uint8_t NonManifold = 2;     // nothing moves onto it either; its ring is not a single fan
+
+// Fans are walked with a step limit so a corrupt ring cannot hang the simplifier
+const int MaxRing = 4096;
+
+void cross(const float* a, const float* b, const float* origin, float* out) {
+    float u[3] = { a[0] - origin[0], a[1] - origin[1], a[2] - origin[2] };
+    float v[3] = { b[0] - origin[0], b[1] - origin[1], b[2] - origin[2] };
+    out[0] = u[1] * v[2] - u[2] * v[1];
+    out[1] = u[2] * v[0] - u[0] * v[2];
+    out[2] = u[0] * v[1] - u[1] * v[0];
+}
+
+} // namespace
+
+void MeshSimplifier::IndexedHeap::reset(size_t vertexCount) {
+    heap.clear();
+    position.assign(vertexCount, -1);
+}
+
+void MeshSimplifier::IndexedHeap::set(uint32_t vertex, float key) {
+    if (position[vertex] < 0) {
+        Entry entry = { key, vertex };
+        position[vertex] = static_cast<int32_t>(heap.size());
+        heap.push_back(entry);
+        siftUp(heap.size() - 1);
+        return;
+    }
+    size_t index = static_cast<size_t>(position[vertex]);
+    float previous = heap[index].key;
+    heap[index].key = key;
+    if (key < previous) {
+        siftUp(index);
+    } else {
+        siftDown(index);
+    }
+}
+
+void MeshSimplifier::IndexedHeap::remove(uint32_t vertex) {
+    if (position[vertex] < 0) {
+        return;
+    }
+    size_t index = static_cast<size_t>(position[vertex]);
+    swapEntries(index, heap.size() - 1);
+    heap.pop_back();
+    position[vertex] = -1;
+    if (index < heap.size()) {
+        siftUp(index);
+        siftDown(static_cast<size_t>(position[heap[index].vertex]));
+    }
+}
+
+uint32_t MeshSimplifier::IndexedHeap::pop() {
+    uint32_t top = heap[0].vertex;
+    remove(top);
+    return top;
+}
+
+void MeshSimplifier::IndexedHeap::siftUp(size_t index) {
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+        if (heap[parent].key <= heap[index].key) {
+            break;
+        }
+        swapEntries(index, parent);
+        index = parent;
+    }
+}
+
+void MeshSimplifier::IndexedHeap::siftDown(size_t index) {
+    for (;;) {
+        size_t smallest = index;
+        size_t left = index * 2 + 1;
+        if (left < heap.size() && heap[left].key < heap[smallest].key) {
+            smallest = left;
+        }
+        if (left + 1 < heap.size() && heap[left + 1].key < heap[smallest].key) {
+            smallest = left + 1;
+        }
+        if (smallest == index) {
+            break;
+        }
+        swapEntries(index, smallest);
+        index = smallest;
+    }
+}
+
+void MeshSimplifier::IndexedHeap::swapEntries(size_t a, size_t b) {
+    std::swap(heap[a], heap[b]);
+    position[heap[a].vertex] = static_cast<int32_t>(a);
+    position[heap[b].vertex] = static_cast<int32_t>(b);
+}
+
+MeshSimplifier::MeshSimplifier()
+    : inputVertices(nullptr),
+      inputStride(0),
+      scale(1.0f),
+      vertexTotal(0),
+      welded(0),
+      triangles(0),
+      locked(0),
+      collapseCount(0),
+      maxError(0.0f),
+      buildTime(0.0),
+      simplifyTime(0.0) {
+}
+
+bool MeshSimplifier::simplify(const float* vertices, size_t vertexCount, size_t stride,
+                              const uint32_t* indices, size_t indexCount,
+                              const std::vector<float>& ratios, std::vector<Level>& levels) {
+    levels.clear();
+    if (stride < 3 || indexCount % 3 != 0 || vertexCount >= 0x7fffffffu || indexCount >= 0x7fffffffu) {
+        std::cerr << "Mesh simplifier: invalid mesh layout" << std::endl;
+        return false;
+    }
+    for (size_t i = 0; i < indexCount; ++i) {
+        if (indices[i] >= vertexCount) {
+            std::cerr << "Mesh simplifier: index " << indices[i] << " out of range" << std::endl;
+            return false;
+        }
+    }
+    for (size_t i = 0; i < ratios.size(); ++i) {
+        if (!(ratios[i] >= 0.0f && ratios[i] <= 1.0f) || (i > 0 && ratios[i] > ratios[i - 1])) {
+            std::cerr << "Mesh simplifier: ratios must decrease within [0, 1]" << std::endl;
+            return false;
+        }
+    }
+    Clock::time_point start = Clock::now();
+    inputVertices = vertices;
+    inputStride = stride;
+    vertexTotal = vertexCount;
+    collapseCount = 0;
+    maxError = 0.0f;
+
+    // Quadrics are accumulated in the unit cube so attribute weights mean the same at any scale
+    float lower[3] = { 0.0f, 0.0f, 0.0f };
+    float upper[3] = { 0.0f, 0.0f, 0.0f };
+    for (size_t v = 0; v < vertexCount; ++v) {
+        for (int k = 0; k < 3; ++k) {
+            float value = vertices[v * stride + k];
+            lower[k] = v == 0 ? value : std::min(lower[k], value);
+            upper[k] = v == 0 ? value : std::max(upper[k], value);
+        }
+    }
+    float extent = std::max(upper[0] - lower[0], std::max(upper[1] - lower[1], upper[2] - lower[2]));
+    scale = extent > 0.0f ? 1.0f / extent : 1.0f;
+
+    // Weld by exact position. A welded vertex whose input vertices disagree on any attribute
+    // sits on a seam.
+    std::vector<uint32_t> order(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        order[v] = static_cast<uint32_t>(v);
+    }
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        const float* pa = vertices + a * stride;
+        const float* pb = vertices + b * stride;
+        if (pa[0] != pb[0]) return pa[0] < pb[0];
+        if (pa[1] != pb[1]) return pa[1] < pb[1];
+        if (pa[2] != pb[2]) return pa[2] < pb[2];
+        return a < b;
+    });
+    std::vector<uint32_t> remap(vertexCount);
+    positions.clear();
+    representative.clear();
+    lockedFlags.clear();
+    for (size_t i = 0; i < vertexCount; ++i) {
+        const float* vertex = vertices + order[i] * stride;
+        const float* first = representative.empty() ? nullptr : vertices + representative.back() * stride;
+        if (!first || !std::equal(vertex, vertex + 3, first)) {
+            representative.push_back(order[i]);
+            lockedFlags.push_back(0);
+            for (int k = 0; k < 3; ++k) {
+                positions.push_back((vertex[k] - lower[k]) * scale);
+            }
+        } else if (!std::equal(vertex + 3, vertex + stride, first + 3)) {
+            lockedFlags.back() |= LockedVertex;
+        }
+        remap[order[i]] = static_cast<uint32_t>(representative.size() - 1);
+    }
+    welded = representative.size();
+
+    // Triangles, without the ones welding collapsed to a line
+    corners.clear();
+    cornerVertices.clear();
+    for (size_t i = 0; i < indexCount; i += 3) {
+        uint32_t a = remap[indices[i]];
+        uint32_t b = remap[indices[i + 1]];
+        uint32_t c = remap[indices[i + 2]];
+        if (a == b || b == c || c == a) {
+            continue;
+        }
+        corners.push_back(a);
+        corners.push_back(b);
+        corners.push_back(c);
+        cornerVertices.insert(cornerVertices.end(), indices + i, indices + i + 3);
+    }
+    triangles = corners.size() / 3;
+    triangleAlive.assign(triangles, 1);
+
+    // Twins: bucket the half-edges by origin, then look for each one's reverse among the
+    // half-edges leaving its target. An edge used twice in one direction, or by more than two
+    // triangles, is non-manifold.
+    std::vector<uint32_t> bucketStart(welded + 1, 0);
+    for (size_t he = 0; he < corners.size(); ++he) {
+        ++bucketStart[corners[he] + 1];
+    }
+    for (size_t v = 0; v < welded; ++v) {
+        bucketStart[v + 1] += bucketStart[v];
+    }
+    std::vector<int> buckets(corners.size());
+    std::vector<uint32_t> fill(bucketStart.begin(), bucketStart.end() - 1);
+    for (size_t he = 0; he < corners.size(); ++he) {
+        buckets[fill[corners[he]]++] = static_cast<int>(he);
+    }
+    twins.assign(corners.size(), -1);
+    for (size_t he = 0; he < corners.size(); ++he) {
+        uint32_t origin = corners[he];
+        uint32_t target = corners[next(static_cast<int>(he))];
+        int twin = -1;
+        size_t reverse = 0;
+        for (uint32_t i = bucketStart[target]; i < bucketStart[target + 1]; ++i) {
+            if (corners[next(buckets[i])] == origin) {
+                twin = buckets[i];
+                ++reverse;
+            }
+        }
+        size_t forward = 0;
+        for (uint32_t i = bucketStart[origin]; i < bucketStart[origin + 1]; ++i) {
+            forward += corners[next(buckets[i])] == target ? 1 : 0;
+        }
+        if (forward == 1 && reverse == 1) {
+            twins[he] = twin;
+        } else if (forward > 1 || reverse > 1) {
+            lockedFlags[origin] |= LockedVertex | NonManifold;
+            lockedFlags[target] |= LockedVertex | NonManifold;
+        }
+    }
+
+    // An outgoing half-edge per vertex; boundaries lock both ends
+    outgoing.assign(welded, -1);
+    for (size_t he = 0; he < corners.size(); ++he) {
+        outgoing[corners[he]] = static_cast<int>(he);
+        if (twins[he] < 0) {
+            lockedFlags[corners[he]] |= LockedVertex;
+            lockedFlags[corners[next(static_cast<int>(he))]] |= LockedVertex;
+        }
+    }
+    // Triangles meeting only at a vertex: a walk around it misses some of them
+    removed.assign(welded, 0);
+    for (size_t v = 0; v < welded; ++v) {
+        if (outgoing[v] < 0) {
+            removed[v] = 1;
+            continue;
+        }
+        ring(static_cast<uint32_t>(v), ringScratch);
+        if (ringScratch.size() != bucketStart[v + 1] - bucketStart[v]) {
+            lockedFlags[v] |= LockedVertex | NonManifold;
+        }
+    }
+
+    // Area-weighted plane quadrics
+    Quadric zero = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+    quadrics.assign(welded, zero);
+    for (size_t t = 0; t < triangles; ++t) {
+        const float* p0 = &positions[corners[t * 3] * 3];
+        const float* p1 = &positions[corners[t * 3 + 1] * 3];
+        const float* p2 = &positions[corners[t * 3 + 2] * 3];
+        float n[3];
+        cross(p1, p2, p0, n);
+        double length = std::sqrt(static_cast<double>(n[0]) * n[0] + static_cast<double>(n[1]) * n[1] + static_cast<double>(n[2]) * n[2]);
+        if (length <= 0.0) {
+            continue;
+        }
+        double a = n[0] / length;
+        double b = n[1] / length;
+        double c = n[2] / length;
+        double d = -(a * p0[0] + b * p0[1] + c * p0[2]);
+        double w = length * 0.5;
+        double q[11] = { w * a * a, w * a * b, w * a * c, w * a * d, w * b * b, w * b * c, w * b * d,
+                         w * c * c, w * c * d, w * d * d, w };
+        for (int k = 0; k < 3; ++k) {
+            Quadric& target = quadrics[corners[t * 3 + k]];
+            double* dst = &target.a2;
+            const double* src = q;
+            for (int i = 0; i < 11; ++i) {
+                dst[i] += src[i];
+            }
+        }
+    }
+
+    locked = 0;
+    heap.reset(welded);
+    bestTarget.assign(welded, 0);
+    for (size_t v = 0; v < welded; ++v) {
+        locked += !removed[v] && (lockedFlags[v] & LockedVertex) ? 1 : 0;
+        updateCost(static_cast<uint32_t>(v));
+    }
+    buildTime = elapsedMs(start);
+
+    // Collapse until every target is reached, capturing each level on the way
+    start = Clock::now();
+    levels.resize(ratios.size());
+    size_t live = triangles;
+    size_t captured = 0;
+    std::vector<std::pair<float, int> > candidates;
+    for (;;) {
+        while (captured < levels.size() && live <= static_cast<size_t>(ratios[captured] * triangles)) {
+            Level& level = levels[captured++];
+            level.ratio = ratios[captured - 1];
+            level.error = maxError;
+            level.indices.reserve(live * 3);
+            for (size_t t = 0; t < triangles; ++t) {
+                if (triangleAlive[t]) {
+                    level.indices.insert(level.indices.end(), cornerVertices.begin() + t * 3, cornerVertices.begin() + t * 3 + 3);
+                }
+            }
+        }
+        if (captured == levels.size() || heap.empty()) {
+            break;
+        }
+
+        // The cheapest vertex. Its key is the collapse onto bestTarget, which may not be
+        // allowed; then its other collapses are tried, cheapest first.
+        uint32_t vertex = heap.pop();
+        ring(vertex, ringScratch);
+        int chosen = -1;
+        for (size_t i = 0; i < ringScratch.size(); ++i) {
+            if (corners[next(ringScratch[i])] == bestTarget[vertex]) {
+                chosen = ringScratch[i];
+                break;
+            }
+        }
+        if (chosen < 0 || !collapseValid(vertex, chosen)) {
+            chosen = -1;
+            ring(vertex, ringScratch);
+            candidates.clear();
+            for (size_t i = 0; i < ringScratch.size(); ++i) {
+                int halfEdge = ringScratch[i];
+                uint32_t target = corners[next(halfEdge)];
+                if (target != bestTarget[vertex] && twins[halfEdge] >= 0 && !(lockedFlags[target] & NonManifold)) {
+                    candidates.push_back(std::make_pair(collapseCost(vertex, halfEdge, nullptr), halfEdge));
+                }
+            }
+            std::sort(candidates.begin(), candidates.end());
+            for (size_t i = 0; i < candidates.size() && chosen < 0; ++i) {
+                if (collapseValid(vertex, candidates[i].second)) {
+                    chosen = candidates[i].second;
+                }
+            }
+        }
+        if (chosen >= 0) {
+            collapse(vertex, chosen);
+            live -= 2;
+        }
+    }
+    // Targets beyond what could be collapsed get the coarsest mesh reached
+    while (captured < levels.size()) {
+        levels[captured].ratio = ratios[captured];
+        levels[captured].error = maxError;
+        for (size_t t = 0; t < triangles; ++t) {
+            if (triangleAlive[t]) {
+                levels[captured].indices.insert(levels[captured].indices.end(), cornerVertices.begin() + t * 3, cornerVertices.begin() + t * 3 + 3);
+            }
+        }
+        ++captured;
+    }
+    simplifyTime = elapsedMs(start);
+    return true;
+}
+
+void MeshSimplifier::ring(uint32_t vertex, std::vector<int>& out) const {
+    // Half-edges leaving vertex, walking one way round and, at a boundary, back the other way
+    out.clear();
+    int start = outgoing[vertex];
+    int halfEdge = start;
+    bool open = false;
+    do {
+        out.push_back(halfEdge);
+        int twin = twins[prev(halfEdge)];
+        if (twin < 0) {
+            open = true;
+            break;
+        }
+        halfEdge = twin;
+    } while (halfEdge != start && out.size() < static_cast<size_t>(MaxRing));
+    if (!open) {
+        return;
+    }
+    for (int twin = twins[start]; twin >= 0 && out.size() < static_cast<size_t>(MaxRing); twin = twins[halfEdge]) {
+        halfEdge = next(twin);
+        out.push_back(halfEdge);
+    }
+}
+
+void MeshSimplifier::neighbours(uint32_t vertex, std::vector<uint32_t>& out) {
+    std::vector<int>& fan = fanScratch;
+    ring(vertex, fan);
+    out.clear();
+    for (size_t i = 0; i < fan.size(); ++i) {
+        out.push_back(corners[next(fan[i])]);
+        out.push_back(corners[prev(fan[i])]);
+    }
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+float MeshSimplifier::collapseCost(uint32_t from, int halfEdge, float* distance) const {
+    uint32_t to = corners[next(halfEdge)];
+    const Quadric& a = quadrics[from];
+    const Quadric& b = quadrics[to];
+    double x = positions[to * 3];
+    double y = positions[to * 3 + 1];
+    double z = positions[to * 3 + 2];
+    double error = (a.a2 + b.a2) * x * x + (a.b2 + b.b2) * y * y + (a.c2 + b.c2) * z * z
+                 + 2.0 * ((a.ab + b.ab) * x * y + (a.ac + b.ac) * x * z + (a.bc + b.bc) * y * z)
+                 + 2.0 * ((a.ad + b.ad) * x + (a.bd + b.bd) * y + (a.cd + b.cd) * z)
+                 + (a.d2 + b.d2);
+    error = std::max(error, 0.0);
+    if (distance) {
+        // Root mean square distance to the merged planes, back in input units
+        double area = a.area + b.area;
+        *distance = area > 0.0 ? static_cast<float>(std::sqrt(error / area) / scale) : 0.0f;
+    }
+
+    // The moving corners take the attributes the surviving vertex has on this side of the edge
+    const float* kept = inputVertices + static_cast<size_t>(cornerVertices[next(halfEdge)]) * inputStride;
+    const float* lost = inputVertices + static_cast<size_t>(representative[from]) * inputStride;
+    double attributes = 0.0;
+    for (size_t k = 3; k < inputStride; ++k) {
+        double weight = k - 3 < attributeWeights.size() ? attributeWeights[k - 3] : 1.0;
+        double difference = kept[k] - lost[k];
+        attributes += weight * difference * difference;
+    }
+    return static_cast<float>(error + attributes * a.area);
+}
+
+bool MeshSimplifier::collapseValid(uint32_t from, int halfEdge) {
+    int twin = twins[halfEdge];
+    if (twin < 0) {
+        return false;
+    }
+    uint32_t to = corners[next(halfEdge)];
+    uint32_t left = corners[prev(halfEdge)];
+    uint32_t right = corners[prev(twin)];
+
+    // Link condition: the two ends share exactly the apexes of the two triangles on the edge
+    std::vector<uint32_t>& fromRing = neighbourScratch[0];
+    std::vector<uint32_t>& toRing = neighbourScratch[1];
+    neighbours(from, fromRing);
+    neighbours(to, toRing);
+    size_t shared = 0;
+    for (size_t i = 0, j = 0; i < fromRing.size() && j < toRing.size();) {
+        if (fromRing[i] < toRing[j]) {
+            ++i;
+        } else if (toRing[j] < fromRing[i]) {
+            ++j;
+        } else {
+            ++shared;
+            ++i;
+            ++j;
+        }
+    }
+    if (shared != 2) {
+        return false;
+    }
+    // Nothing may be left with fewer than three neighbours, which would fold two triangles
+    // onto each other
+    if (fromRing.size() + toRing.size() - 4 < 3) {
+        return false;
+    }
+    uint32_t apexes[2] = { left, right };
+    for (int i = 0; i < 2; ++i) {
+        if (!(lockedFlags[apexes[i]] & LockedVertex)) {
+            ring(apexes[i], fanScratch);
+            if (fanScratch.size() <= 3) {
+                return false;
+            }
+        }
+    }
+
+    // No triangle that moves may turn over. from's ring stays in ringScratch for collapse().
+    ring(from, ringScratch);
+    const float* target = &positions[to * 3];
+    const float* source = &positions[from * 3];
+    for (size_t i = 0; i < ringScratch.size(); ++i) {
+        int edge = ringScratch[i];
+        if (edge / 3 == halfEdge / 3 || edge / 3 == twin / 3) {
+            continue;
+        }
+        const float* b = &positions[corners[next(edge)] * 3];
+        const float* c = &positions[corners[prev(edge)] * 3];
+        float before[3];
+        float after[3];
+        cross(b, c, source, before);
+        cross(b, c, target, after);
+        if (before[0] * after[0] + before[1] * after[1] + before[2] * after[2] <= 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Expects from's ring in ringScratch, as collapseValid() leaves it
+void MeshSimplifier::collapse(uint32_t from, int halfEdge) {
+    float distance = 0.0f;
+    collapseCost(from, halfEdge, &distance);
+    maxError = std::max(maxError, distance);
+
+    int twin = twins[halfEdge];
+    uint32_t to = corners[next(halfEdge)];
+    uint32_t left = corners[prev(halfEdge)];
+    uint32_t right = corners[prev(twin)];
+    uint32_t attributes = cornerVertices[next(halfEdge)];
+    neighbourScratch[1].clear();
+    for (size_t i = 0; i < ringScratch.size(); ++i) {
+        neighbourScratch[1].push_back(corners[next(ringScratch[i])]);
+    }
+    std::sort(neighbourScratch[1].begin(), neighbourScratch[1].end());
+
+    // The two triangles on the edge go; the edges they had on either side are joined up
+    int toLeft = twins[next(halfEdge)];    // left -> to
+    int fromLeft = twins[prev(halfEdge)];  // from -> left, becomes to -> left
+    int rightFrom = twins[next(twin)];     // right -> from, becomes right -> to
+    int toRight = twins[prev(twin)];       // to -> right
+    if (toLeft >= 0) twins[toLeft] = fromLeft;
+    if (fromLeft >= 0) twins[fromLeft] = toLeft;
+    if (rightFrom >= 0) twins[rightFrom] = toRight;
+    if (toRight >= 0) twins[toRight] = rightFrom;
+    triangleAlive[halfEdge / 3] = 0;
+    triangleAlive[twin / 3] = 0;
+
+    // Everything else around from now uses to, with its attributes
+    for (size_t i = 0; i < ringScratch.size(); ++i) {
+        int edge = ringScratch[i];
+        if (edge / 3 != halfEdge / 3 && edge / 3 != twin / 3) {
+            corners[edge] = to;
+            cornerVertices[edge] = attributes;
+        }
+    }
+    outgoing[to] = fromLeft;
+    outgoing[left] = toLeft >= 0 ? toLeft : next(fromLeft);
+    outgoing[right] = rightFrom;
+
+    removed[from] = 1;
+    heap.remove(from);
+    Quadric& merged = quadrics[to];
+    const Quadric& source = quadrics[from];
+    double* dst = &merged.a2;
+    const double* src = &source.a2;
+    for (int i = 0; i < 11; ++i) {
+        dst[i] += src[i];
+    }
+    ++collapseCount;
+
+    // to stays where it is and its quadric only grew, so collapses onto it only got dearer.
+    // Neighbours whose best was onto from or to are re-costed; from's other neighbours gained a
+    // new edge onto to, which may be cheaper than their best.
+    updateCost(to);
+    neighbours(to, neighbourScratch[0]);
+    for (size_t i = 0; i < neighbourScratch[0].size(); ++i) {
+        uint32_t neighbour = neighbourScratch[0][i];
+        if (bestTarget[neighbour] == from || bestTarget[neighbour] == to || !heap.contains(neighbour)) {
+            updateCost(neighbour);
+        } else if (std::binary_search(neighbourScratch[1].begin(), neighbourScratch[1].end(), neighbour)) {
+            updateEdgeCost(neighbour, to);
+        }
+    }
+}
+
+void MeshSimplifier::updateEdgeCost(uint32_t vertex, uint32_t target) {
+    if (removed[vertex] || (lockedFlags[vertex] & LockedVertex) || (lockedFlags[target] & NonManifold)) {
+        return;
+    }
+    std::vector<int>& fan = fanScratch;
+    ring(vertex, fan);
+    for (size_t i = 0; i < fan.size(); ++i) {
+        if (corners[next(fan[i])] == target && twins[fan[i]] >= 0) {
+            float cost = collapseCost(vertex, fan[i], nullptr);
+            if (cost < heap.key(vertex)) {
+                heap.set(vertex, cost);
+                bestTarget[vertex] = target;
+            }
+            return;
+        }
+    }
+}
+
+void MeshSimplifier::updateCost(uint32_t vertex) {
+    if (removed[vertex] || (lockedFlags[vertex] & LockedVertex)) {
+        heap.remove(vertex);
+        return;
+    }
+    std::vector<int>& fan = fanScratch;
+    ring(vertex, fan);
+    float best = 0.0f;
+    bool found = false;
+    for (size_t i = 0; i < fan.size(); ++i) {
+        uint32_t target = corners[next(fan[i])];
+        if (twins[fan[i]] < 0 || (lockedFlags[target] & NonManifold)) {
+            continue;
+        }
+        float cost = collapseCost(vertex, fan[i], nullptr);
+        if (!found || cost < best) {
+            best = cost;
+            bestTarget[vertex] = target;
+            found = true;
+        }
+    }
+    if (found) {
+        heap.set(vertex, best);
+    } else {
+        heap.remove(vertex);
+    }
+}
+
+void MeshSimplifier::printJson(std::ostream& out) const {
+    out << "{\"vertices\": " << vertexTotal
+        << ", \"welded\": " << welded
+        << ", \"triangles\": " << triangles
+        << ", \"locked\": " << locked
+        << ", \"collapses\": " << collapseCount
+        << ", \"build_ms\": " << buildTime
+        << ", \"simplify_ms\": " << simplifyTime << "}";
+}
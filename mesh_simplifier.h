@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// Quadric error metric simplification into a chain of levels of detail.
+//
+// Vertices are welded by position into a half-edge mesh, so attribute seams do not look like
+// holes. Simplification is half-edge collapse: a vertex moves onto one of its neighbours. That
+// never creates vertices, so every level indexes the original vertex buffer and keeps the exact
+// attributes of the vertices it uses. Collapses are ranked by the area-weighted plane quadrics
+// of both ends, evaluated at the surviving position. The squared change in the other vertex
+// attributes (normals, UVs, ...) is added on top, with a weight per attribute component.
+//
+// Boundary vertices, vertices on attribute seams and vertices on non-manifold edges are locked,
+// so outlines and seams keep their shape. A collapse is also rejected when it would break the
+// link condition (two vertices sharing more than the two neighbours of their edge) or flip a
+// triangle.
+//
+// Every vertex's cheapest collapse sits in an indexed binary heap. After a collapse only the
+// surviving vertex and its neighbours are re-costed, in place. All levels come out of one pass:
+// the index buffer is captured whenever the live triangle count reaches the next target ratio.
+class MeshSimplifier {
+public:
+    struct Level {
+        float ratio;                    // target triangles / input triangles
+        std::vector<uint32_t> indices;  // into the input vertices
+        float error;                    // largest collapse error so far, in position units
+    };
+
+    MeshSimplifier();
+
+    // One weight per attribute component, after the position; missing entries count as 1.
+    void setAttributeWeights(const std::vector<float>& weights) { attributeWeights = weights; }
+
+    // vertices holds vertexCount vertices of stride floats each, position first. ratios must
+    // decrease; levels gets one entry per ratio. Levels whose target could not be reached stop
+    // where simplification ran out of valid collapses. Returns false for invalid input.
+    bool simplify(const float* vertices, size_t vertexCount, size_t stride,
+                  const uint32_t* indices, size_t indexCount,
+                  const std::vector<float>& ratios, std::vector<Level>& levels);
+
+    // Of the last simplify()
+    size_t lockedVertices() const { return locked; }
+    size_t collapses() const { return collapseCount; }
+    double buildMs() const { return buildTime; }
+    double simplifyMs() const { return simplifyTime; }
+
+    // {"vertices": .., "welded": .., "triangles": .., "locked": .., "collapses": .., "build_ms": .., "simplify_ms": ..}
+    void printJson(std::ostream& out) const;
+
+private:
+    // Symmetric 4x4 plane quadric plus the area it was accumulated from. Doubles: in float the
+    // terms cancel badly once the errors get small.
+    struct Quadric {
+        double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+        double area;
+    };
+
+    // Binary min-heap of vertices with a position table, so keys can change in place. Keys live
+    // in the heap entries, so sifting does not chase vertex indices.
+    class IndexedHeap {
+    public:
+        void reset(size_t vertexCount);
+        bool empty() const { return heap.empty(); }
+        bool contains(uint32_t vertex) const { return position[vertex] >= 0; }
+        float key(uint32_t vertex) const { return heap[position[vertex]].key; }
+        void set(uint32_t vertex, float key);
+        void remove(uint32_t vertex);
+        uint32_t pop();
+
+    private:
+        void siftUp(size_t index);
+        void siftDown(size_t index);
+        void swapEntries(size_t a, size_t b);
+
+        struct Entry {
+            float key;
+            uint32_t vertex;
+        };
+
+        std::vector<Entry> heap;
+        std::vector<int32_t> position;
+    };
+
+    static int next(int halfEdge) { return halfEdge % 3 == 2 ? halfEdge - 2 : halfEdge + 1; }
+    static int prev(int halfEdge) { return halfEdge % 3 == 0 ? halfEdge + 2 : halfEdge - 1; }
+
+    void ring(uint32_t vertex, std::vector<int>& out) const;
+    void neighbours(uint32_t vertex, std::vector<uint32_t>& out);
+    float collapseCost(uint32_t from, int halfEdge, float* distance) const;
+    bool collapseValid(uint32_t from, int halfEdge);
+    void collapse(uint32_t from, int halfEdge);
+    void updateCost(uint32_t vertex);
+    void updateEdgeCost(uint32_t vertex, uint32_t target);
+
+    // Mesh being simplified: positions per welded vertex, three corners per triangle
+    std::vector<float> positions;         // xyz, normalised to the unit cube
+    std::vector<uint32_t> corners;        // welded vertex per corner
+    std::vector<uint32_t> cornerVertices; // input vertex per corner, for the output indices
+    std::vector<int> twins;               // opposite half-edge, -1 on boundaries
+    std::vector<int> outgoing;            // one live half-edge leaving each welded vertex
+    std::vector<uint8_t> lockedFlags;
+    std::vector<uint8_t> removed;
+    std::vector<uint8_t> triangleAlive;
+    std::vector<uint32_t> representative; // an input vertex per welded vertex, for attributes
+    std::vector<Quadric> quadrics;
+    std::vector<uint32_t> bestTarget;     // the neighbour each heap key collapses onto
+    IndexedHeap heap;
+    const float* inputVertices;
+    size_t inputStride;
+    std::vector<float> attributeWeights;
+    float scale;
+
+    // Scratch reused across collapses
+    std::vector<int> ringScratch;
+    std::vector<int> fanScratch;
+    std::vector<uint32_t> neighbourScratch[2];
+
+    size_t vertexTotal;
+    size_t welded;
+    size_t triangles;
+    size_t locked;
+    size_t collapseCount;
+    float maxError;
+    double buildTime;
+    double simplifyTime;
+};
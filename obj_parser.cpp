@@ -0,0 +1,648 @@
+#include "obj_parser.h"
+
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OBJ_PARSER_SSE 1
+#include <emmintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#endif
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Chunks are at least this big, and each thread gets several so uneven ones balance out
+const size_t MinChunkBytes = 1 << 20;
+const size_t ChunksPerThread = 8;
+
+// Negative OBJ indices are stored as Relative plus the index resolved against the chunk's own
+// counts; merge() adds the counts of the chunks before it
+const int64_t Relative = int64_t(1) << 48;
+
+const uint32_t Missing = ~0u;
+
+// Powers of ten a float holds exactly, for the fast path of parseFloat()
+const float Powers[11] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+
+bool isBlank(char c) {
+    return c == ' ' || c == '\t';
+}
+
+bool isDigit(char c) {
+    return static_cast<unsigned char>(c - '0') < 10;
+}
+
+// The '\n' ending the line that starts at p, or end
+const char* findLineEnd(const char* p, const char* end) {
+#ifdef OBJ_PARSER_SSE
+    const __m128i newline = _mm_set1_epi8('\n');
+    while (end - p >= 16) {
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), newline));
+        if (mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+            unsigned long bit;
+            _BitScanForward(&bit, static_cast<unsigned long>(mask));
+            return p + bit;
+#else
+            return p + __builtin_ctz(static_cast<unsigned>(mask));
+#endif
+        }
+        p += 16;
+    }
+#endif
+    while (p < end && *p != '\n') {
+        ++p;
+    }
+    return p;
+}
+
+// Reads the eight ASCII digits at p as one number with a few multiplies (SWAR); false when they
+// aren't all digits. Relies on little-endian loads, so only on x86.
+bool parseEightDigits(const char* p, uint32_t& value) {
+#ifdef OBJ_PARSER_SSE
+    uint64_t chunk;
+    std::memcpy(&chunk, p, 8);
+    // Every byte is 0x30-0x3f, and still is with 6 added: '0'-'9'
+    if ((chunk & 0xf0f0f0f0f0f0f0f0ull) != 0x3030303030303030ull
+        || ((chunk + 0x0606060606060606ull) & 0xf0f0f0f0f0f0f0f0ull) != 0x3030303030303030ull) {
+        return false;
+    }
+    chunk -= 0x3030303030303030ull;
+    chunk = (chunk * 10 + (chunk >> 8)) & 0x00ff00ff00ff00ffull;
+    chunk = (chunk * 100 + (chunk >> 16)) & 0x0000ffff0000ffffull;
+    chunk = (chunk * 10000 + (chunk >> 32)) & 0xffffffffull;
+    value = static_cast<uint32_t>(chunk);
+    return true;
+#else
+    (void)p;
+    (void)value;
+    return false;
+#endif
+}
+
+// Accumulates the digits at p into mantissa, keeping at most 19 significant ones; digits that
+// don't fit set truncated. Returns the end of the digits.
+const char* parseDigits(const char* p, const char* end, uint64_t& mantissa, int& significant, int& kept,
+                        bool& truncated) {
+    uint32_t eight;
+    while (end - p >= 8 && significant + 8 <= 19 && parseEightDigits(p, eight)) {
+        mantissa = mantissa * 100000000u + eight;
+        significant += mantissa ? 8 : 0;
+        kept += 8;
+        p += 8;
+    }
+    for (; p < end && isDigit(*p); ++p) {
+        if (significant < 19) {
+            mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+            significant += mantissa ? 1 : 0;
+            ++kept;
+        } else {
+            truncated = true;
+        }
+    }
+    return p;
+}
+
+// Parses the number at p, after any blanks, not reading past end. Returns the end of the number,
+// or nullptr when there isn't one. When the digits and the power of ten both fit a float exactly
+// (at most 2^24 and 10^10), one float multiply or divide rounds the value correctly (Clinger's
+// fast path, in single precision so there is no second rounding from double); the rest, and inf
+// or nan, go through strtof().
+const char* parseFloat(const char* p, const char* end, float& out) {
+    while (p < end && isBlank(*p)) {
+        ++p;
+    }
+    const char* start = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        ++p;
+    }
+    uint64_t mantissa = 0;
+    int significant = 0;
+    int integerDigits = 0;
+    int fractionDigits = 0;
+    bool truncated = false;
+    const char* digits = p;
+    p = parseDigits(p, end, mantissa, significant, integerDigits, truncated);
+    // Integer digits that didn't fit still scale the value
+    int exponent = static_cast<int>(std::min<ptrdiff_t>(p - digits - integerDigits, 100000));
+    bool any = p != digits;
+    if (p < end && *p == '.') {
+        ++p;
+        const char* fraction = p;
+        p = parseDigits(p, end, mantissa, significant, fractionDigits, truncated);
+        exponent -= fractionDigits;
+        any = any || p != fraction;
+    }
+    if (any && p < end && (*p == 'e' || *p == 'E')) {
+        const char* e = p + 1;
+        bool negativeExponent = false;
+        if (e < end && (*e == '-' || *e == '+')) {
+            negativeExponent = *e == '-';
+            ++e;
+        }
+        if (e < end && isDigit(*e)) {
+            int value = 0;
+            for (; e < end && isDigit(*e); ++e) {
+                value = std::min(value * 10 + (*e - '0'), 100000);
+            }
+            exponent += negativeExponent ? -value : value;
+            p = e;
+        }
+    }
+    if (any && !truncated && mantissa <= (uint64_t(1) << 24) && exponent >= -10 && exponent <= 10) {
+        float value = static_cast<float>(mantissa);
+        value = exponent < 0 ? value / Powers[-exponent] : value * Powers[exponent];
+        out = negative ? -value : value;
+        return p;
+    }
+    // Slow path over a terminated copy; the mapping has no terminator
+    if (!any) {
+        p = start;
+        while (p < end && !isBlank(*p) && *p != '\r' && *p != '/') {
+            ++p;
+        }
+    }
+    std::string text(start, p);
+    char* parsed = nullptr;
+    float value = std::strtof(text.c_str(), &parsed);
+    if (parsed == text.c_str()) {
+        return nullptr;
+    }
+    out = value;
+    return start + (parsed - text.c_str());
+}
+
+// Optionally signed integer at p; nullptr when there are no digits. Values too large for any
+// index saturate.
+const char* parseInt(const char* p, const char* end, int64_t& out) {
+    bool negative = p < end && *p == '-';
+    if (negative || (p < end && *p == '+')) {
+        ++p;
+    }
+    const char* digits = p;
+    int64_t value = 0;
+    for (; p < end && isDigit(*p); ++p) {
+        value = std::min<int64_t>(value * 10 + (*p - '0'), Relative / 4);
+    }
+    if (p == digits) {
+        return nullptr;
+    }
+    out = negative ? -value : value;
+    return p;
+}
+
+// A 1-based or negative OBJ index as a 0-based one, -1 when absent, or Relative plus the index
+// resolved within the chunk
+int64_t encodeIndex(int64_t index, size_t localCount) {
+    if (index > 0) {
+        return index - 1;
+    }
+    return index < 0 ? Relative + static_cast<int64_t>(localCount) + index : -1;
+}
+
+uint32_t resolveIndex(int64_t value, size_t base, size_t count) {
+    if (value >= Relative / 2) {
+        value = value - Relative + static_cast<int64_t>(base);
+    }
+    return value >= 0 && value < static_cast<int64_t>(count) ? static_cast<uint32_t>(value) : Missing;
+}
+
+uint32_t hashCorner(const uint32_t* key) {
+    uint64_t h = key[0] * 0x9e3779b97f4a7c15ull ^ key[1] * 0xc2b2ae3d27d4eb4full ^ key[2] * 0x165667b19e3779f9ull;
+    h ^= h >> 29;
+    h *= 0xbf58476d1ce4e5b9ull;
+    h ^= h >> 32;
+    return static_cast<uint32_t>(h);
+}
+
+uint32_t partitionOf(uint32_t hash, size_t partitions) {
+    return static_cast<uint32_t>((static_cast<uint64_t>(hash) * partitions) >> 32);
+}
+
+struct GroupStart {
+    std::string name;
+    size_t firstCorner;
+};
+
+struct Chunk {
+    const char* begin;
+    const char* end;
+    std::vector<float> positions;
+    std::vector<float> normals;
+    std::vector<float> texcoords;
+    std::vector<int64_t> corners;  // position, texture coordinate and normal per triangle corner
+    std::vector<GroupStart> groups;
+    size_t lines;
+    const char* error;             // static message, or nullptr
+    size_t errorLine;              // within the chunk
+    // Filled in before merge()
+    size_t positionBase;
+    size_t normalBase;
+    size_t texcoordBase;
+    size_t cornerBase;
+    size_t lineBase;
+    std::vector<std::vector<uint32_t> > partitions;  // corners by dedup partition, in order
+};
+
+// Reads up to count floats into out, zero-filling the rest; stops at the first non-number
+void readFloats(const char* p, const char* end, size_t count, std::vector<float>& out) {
+    for (size_t i = 0; i < count; ++i) {
+        float value = 0.0f;
+        if (p) {
+            p = parseFloat(p, end, value);
+            if (!p) {
+                value = 0.0f;
+            }
+        }
+        out.push_back(value);
+    }
+}
+
+std::string trimmed(const char* begin, const char* end) {
+    while (begin < end && isBlank(*begin)) {
+        ++begin;
+    }
+    while (end > begin && isBlank(end[-1])) {
+        --end;
+    }
+    return std::string(begin, end);
+}
+
+void parseChunk(Chunk& chunk) {
+    std::vector<int64_t> polygon;
+    const char* p = chunk.begin;
+    while (p < chunk.end) {
+        const char* lineEnd = findLineEnd(p, chunk.end);
+        ++chunk.lines;
+        const char* q = p;
+        const char* e = lineEnd;
+        p = lineEnd + 1;
+        while (q < e && isBlank(*q)) {
+            ++q;
+        }
+        if (e > q && e[-1] == '\r') {
+            --e;
+        }
+        size_t length = static_cast<size_t>(e - q);
+        if (length < 2) {
+            continue;
+        }
+        if (q[0] == 'v' && isBlank(q[1])) {
+            readFloats(q + 2, e, 3, chunk.positions);
+        } else if (q[0] == 'v' && q[1] == 'n' && length > 2 && isBlank(q[2])) {
+            readFloats(q + 3, e, 3, chunk.normals);
+        } else if (q[0] == 'v' && q[1] == 't' && length > 2 && isBlank(q[2])) {
+            readFloats(q + 3, e, 2, chunk.texcoords);
+        } else if (q[0] == 'f' && isBlank(q[1])) {
+            polygon.clear();
+            const char* c = q + 2;
+            for (;;) {
+                while (c < e && isBlank(*c)) {
+                    ++c;
+                }
+                if (c >= e) {
+                    break;
+                }
+                int64_t corner[3] = { 0, 0, 0 };
+                c = parseInt(c, e, corner[0]);
+                for (int k = 1; c && k < 3 && c < e && *c == '/'; ++k) {
+                    ++c;
+                    if (c < e && *c != '/' && !isBlank(*c)) {
+                        c = parseInt(c, e, corner[k]);
+                    }
+                }
+                if (!c || (c < e && !isBlank(*c))) {
+                    chunk.error = "invalid face";
+                    chunk.errorLine = chunk.lines;
+                    return;
+                }
+                polygon.push_back(encodeIndex(corner[0], chunk.positions.size() / 3));
+                polygon.push_back(encodeIndex(corner[1], chunk.texcoords.size() / 2));
+                polygon.push_back(encodeIndex(corner[2], chunk.normals.size() / 3));
+            }
+            // Fanned like loadObj()
+            for (size_t i = 2; i < polygon.size() / 3; ++i) {
+                chunk.corners.insert(chunk.corners.end(), polygon.begin(), polygon.begin() + 3);
+                chunk.corners.insert(chunk.corners.end(), polygon.begin() + (i - 1) * 3, polygon.begin() + (i + 1) * 3);
+            }
+        } else if ((q[0] == 'o' || q[0] == 'g') && isBlank(q[1])) {
+            GroupStart group = { trimmed(q + 2, e), chunk.corners.size() / 3 };
+            chunk.groups.push_back(group);
+        } else if (length > 6 && std::memcmp(q, "usemtl", 6) == 0 && isBlank(q[6])) {
+            GroupStart group = { trimmed(q + 7, e), chunk.corners.size() / 3 };
+            chunk.groups.push_back(group);
+        }
+    }
+}
+
+struct LoadContext {
+    std::vector<Chunk>* chunks;
+    size_t partitionCount;
+    size_t positionCount;
+    size_t normalCount;
+    size_t texcoordCount;
+    std::vector<float>* positions;
+    std::vector<float>* normals;
+    std::vector<float>* texcoords;
+    std::vector<uint32_t>* keys;          // position, texture coordinate, normal per corner
+    std::vector<uint32_t>* hashes;
+    std::vector<uint32_t>* cornerVertex;  // vertex within the corner's partition
+    std::vector<uint32_t>* partitionVertices;
+    std::vector<uint32_t>* firstCorner;   // per final vertex
+    MeshData* mesh;
+};
+
+void parseRange(size_t begin, size_t end, void* context) {
+    LoadContext& load = *static_cast<LoadContext*>(context);
+    for (size_t i = begin; i < end; ++i) {
+        parseChunk((*load.chunks)[i]);
+    }
+}
+
+// Copies a chunk's attributes into place, resolves its corners and sorts them into partitions
+void mergeRange(size_t begin, size_t end, void* context) {
+    LoadContext& load = *static_cast<LoadContext*>(context);
+    bool normals = load.normalCount != 0;
+    bool texcoords = load.texcoordCount != 0;
+    for (size_t i = begin; i < end; ++i) {
+        Chunk& chunk = (*load.chunks)[i];
+        std::copy(chunk.positions.begin(), chunk.positions.end(), load.positions->begin() + chunk.positionBase * 3);
+        std::copy(chunk.normals.begin(), chunk.normals.end(), load.normals->begin() + chunk.normalBase * 3);
+        std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), load.texcoords->begin() + chunk.texcoordBase * 2);
+        chunk.partitions.assign(load.partitionCount, std::vector<uint32_t>());
+        size_t cornerCount = chunk.corners.size() / 3;
+        for (size_t c = 0; c < cornerCount; ++c) {
+            const int64_t* corner = &chunk.corners[c * 3];
+            size_t global = chunk.cornerBase + c;
+            uint32_t* key = &(*load.keys)[global * 3];
+            key[0] = resolveIndex(corner[0], chunk.positionBase, load.positionCount);
+            key[1] = texcoords ? resolveIndex(corner[1], chunk.texcoordBase, load.texcoordCount) : Missing;
+            key[2] = normals ? resolveIndex(corner[2], chunk.normalBase, load.normalCount) : Missing;
+            if (key[0] == Missing) {
+                chunk.error = "face references a missing position";
+                return;
+            }
+            uint32_t hash = hashCorner(key);
+            (*load.hashes)[global] = hash;
+            chunk.partitions[partitionOf(hash, load.partitionCount)].push_back(static_cast<uint32_t>(global));
+        }
+        // Parsed data is no longer needed
+        std::vector<float>().swap(chunk.positions);
+        std::vector<float>().swap(chunk.normals);
+        std::vector<float>().swap(chunk.texcoords);
+        std::vector<int64_t>().swap(chunk.corners);
+    }
+}
+
+// Deduplicates one partition's corners with an open addressing table, visiting them in order
+void dedupRange(size_t begin, size_t end, void* context) {
+    LoadContext& load = *static_cast<LoadContext*>(context);
+    const std::vector<uint32_t>& keys = *load.keys;
+    const std::vector<uint32_t>& hashes = *load.hashes;
+    for (size_t partition = begin; partition < end; ++partition) {
+        size_t count = 0;
+        for (size_t i = 0; i < load.chunks->size(); ++i) {
+            count += (*load.chunks)[i].partitions[partition].size();
+        }
+        size_t buckets = 1;
+        while (buckets < count * 2) {
+            buckets *= 2;
+        }
+        std::vector<uint32_t> table(buckets, Missing);
+        std::vector<uint32_t> first;  // first corner of each vertex in the table
+        for (size_t i = 0; i < load.chunks->size(); ++i) {
+            const std::vector<uint32_t>& corners = (*load.chunks)[i].partitions[partition];
+            for (size_t c = 0; c < corners.size(); ++c) {
+                uint32_t corner = corners[c];
+                const uint32_t* key = &keys[corner * size_t(3)];
+                size_t bucket = hashes[corner] & (buckets - 1);
+                while (table[bucket] != Missing && std::memcmp(&keys[first[table[bucket]] * size_t(3)], key, 12) != 0) {
+                    bucket = (bucket + 1) & (buckets - 1);
+                }
+                if (table[bucket] == Missing) {
+                    table[bucket] = static_cast<uint32_t>(first.size());
+                    first.push_back(corner);
+                }
+                (*load.cornerVertex)[corner] = table[bucket];
+            }
+        }
+        (*load.partitionVertices)[partition] = static_cast<uint32_t>(first.size());
+    }
+}
+
+// Interleaves the attributes of final vertices [begin, end)
+void gatherRange(size_t begin, size_t end, void* context) {
+    LoadContext& load = *static_cast<LoadContext*>(context);
+    MeshData& mesh = *load.mesh;
+    for (size_t v = begin; v < end; ++v) {
+        const uint32_t* key = &(*load.keys)[(*load.firstCorner)[v] * size_t(3)];
+        float* vertex = &mesh.vertices[v * mesh.stride];
+        std::copy(&(*load.positions)[key[0] * size_t(3)], &(*load.positions)[key[0] * size_t(3)] + 3, vertex);
+        if (mesh.normals) {
+            for (int k = 0; k < 3; ++k) {
+                vertex[mesh.normalOffset() + k] = key[2] != Missing ? (*load.normals)[key[2] * size_t(3) + k] : 0.0f;
+            }
+        }
+        if (mesh.texcoords) {
+            for (int k = 0; k < 2; ++k) {
+                vertex[mesh.texcoordOffset() + k] = key[1] != Missing ? (*load.texcoords)[key[1] * size_t(2) + k] : 0.0f;
+            }
+        }
+    }
+}
+
+} // namespace
+
+ObjParser::ObjParser(JobSystem* jobs)
+    : jobs(jobs) {
+    std::memset(&loadStats, 0, sizeof(loadStats));
+}
+
+bool ObjParser::load(const std::string& path, MeshData& mesh) {
+    std::memset(&loadStats, 0, sizeof(loadStats));
+    Clock::time_point loadStart = Clock::now();
+    bool parallel = jobs && jobs->ownsThread();
+    int threads = parallel ? jobs->threadCount() : 1;
+    loadStats.threads = threads;
+
+    // ---- map ----
+    Clock::time_point start = Clock::now();
+    MappedFile file;
+    if (!file.open(path)) {
+        std::cerr << "Failed to open " << path << std::endl;
+        return false;
+    }
+    const char* begin = file.data();
+    const char* end = begin + file.size();
+    loadStats.bytes = file.size();
+    loadStats.mapMs = elapsedMs(start);
+
+    // ---- parse ----
+    start = Clock::now();
+    size_t chunkCount = std::max<size_t>(1, std::min(file.size() / MinChunkBytes, threads * ChunksPerThread));
+    std::vector<Chunk> chunks(chunkCount);
+    const char* cursor = begin;
+    for (size_t i = 0; i < chunkCount; ++i) {
+        Chunk& chunk = chunks[i];
+        chunk.begin = cursor;
+        const char* target = i + 1 == chunkCount ? end : std::max(cursor, begin + file.size() / chunkCount * (i + 1));
+        cursor = target < end ? std::min(end, findLineEnd(target, end) + 1) : end;
+        chunk.end = cursor;
+        chunk.lines = 0;
+        chunk.error = nullptr;
+        chunk.errorLine = 0;
+    }
+    LoadContext context;
+    std::memset(&context, 0, sizeof(context));
+    context.chunks = &chunks;
+    if (parallel) {
+        jobs->parallelFor(chunkCount, 1, parseRange, &context);
+    } else {
+        parseRange(0, chunkCount, &context);
+    }
+    for (size_t i = 0; i < chunkCount; ++i) {
+        Chunk& chunk = chunks[i];
+        chunk.positionBase = context.positionCount;
+        chunk.normalBase = context.normalCount;
+        chunk.texcoordBase = context.texcoordCount;
+        chunk.cornerBase = loadStats.corners;
+        chunk.lineBase = loadStats.lines;
+        if (chunk.error) {
+            std::cerr << path << ":" << chunk.lineBase + chunk.errorLine << ": " << chunk.error << std::endl;
+            return false;
+        }
+        context.positionCount += chunk.positions.size() / 3;
+        context.normalCount += chunk.normals.size() / 3;
+        context.texcoordCount += chunk.texcoords.size() / 2;
+        loadStats.corners += chunk.corners.size() / 3;
+        loadStats.lines += chunk.lines;
+    }
+    loadStats.parseMs = elapsedMs(start);
+    loadStats.chunks = chunkCount;
+    loadStats.positions = context.positionCount;
+    loadStats.normals = context.normalCount;
+    loadStats.texcoords = context.texcoordCount;
+    if (loadStats.corners > 0xffffffffu || context.positionCount > 0xffffffffu) {
+        std::cerr << path << ": too many vertices for 32-bit indices" << std::endl;
+        return false;
+    }
+
+    // ---- merge ----
+    start = Clock::now();
+    std::vector<float> positions(context.positionCount * 3);
+    std::vector<float> normals(context.normalCount * 3);
+    std::vector<float> texcoords(context.texcoordCount * 2);
+    std::vector<uint32_t> keys(loadStats.corners * 3);
+    std::vector<uint32_t> hashes(loadStats.corners);
+    context.partitionCount = static_cast<size_t>(threads);
+    context.positions = &positions;
+    context.normals = &normals;
+    context.texcoords = &texcoords;
+    context.keys = &keys;
+    context.hashes = &hashes;
+    if (parallel) {
+        jobs->parallelFor(chunkCount, 1, mergeRange, &context);
+    } else {
+        mergeRange(0, chunkCount, &context);
+    }
+    for (size_t i = 0; i < chunkCount; ++i) {
+        if (chunks[i].error) {
+            std::cerr << path << ": " << chunks[i].error << std::endl;
+            return false;
+        }
+    }
+    // Every group runs to the start of the next; unnamed until the first o, g or usemtl
+    std::vector<GroupStart> starts(1, GroupStart());
+    starts[0].firstCorner = 0;
+    for (size_t i = 0; i < chunkCount; ++i) {
+        for (size_t g = 0; g < chunks[i].groups.size(); ++g) {
+            starts.push_back(chunks[i].groups[g]);
+            starts.back().firstCorner += chunks[i].cornerBase;
+        }
+    }
+    mesh.groups.clear();
+    for (size_t g = 0; g < starts.size(); ++g) {
+        size_t next = g + 1 < starts.size() ? starts[g + 1].firstCorner : loadStats.corners;
+        if (next > starts[g].firstCorner) {
+            MeshGroup group = { starts[g].name, starts[g].firstCorner, next - starts[g].firstCorner };
+            mesh.groups.push_back(group);
+        }
+    }
+    loadStats.mergeMs = elapsedMs(start);
+
+    // ---- dedup ----
+    start = Clock::now();
+    std::vector<uint32_t> cornerVertex(loadStats.corners);
+    std::vector<uint32_t> partitionVertices(context.partitionCount, 0);
+    context.cornerVertex = &cornerVertex;
+    context.partitionVertices = &partitionVertices;
+    if (parallel) {
+        jobs->parallelFor(context.partitionCount, 1, dedupRange, &context);
+    } else {
+        dedupRange(0, context.partitionCount, &context);
+    }
+    std::vector<uint32_t> partitionBase(context.partitionCount, 0);
+    size_t uniqueCount = 0;
+    for (size_t p = 0; p < context.partitionCount; ++p) {
+        partitionBase[p] = static_cast<uint32_t>(uniqueCount);
+        uniqueCount += partitionVertices[p];
+    }
+    // First-use numbering: one pass in corner order
+    std::vector<uint32_t> remap(uniqueCount, Missing);
+    std::vector<uint32_t> firstCorner;
+    firstCorner.reserve(uniqueCount);
+    mesh.indices.resize(loadStats.corners);
+    for (size_t c = 0; c < loadStats.corners; ++c) {
+        uint32_t vertex = partitionBase[partitionOf(hashes[c], context.partitionCount)] + cornerVertex[c];
+        if (remap[vertex] == Missing) {
+            remap[vertex] = static_cast<uint32_t>(firstCorner.size());
+            firstCorner.push_back(static_cast<uint32_t>(c));
+        }
+        mesh.indices[c] = remap[vertex];
+    }
+    mesh.setAttributes(context.normalCount != 0, false, context.texcoordCount != 0);
+    mesh.corners = loadStats.corners;
+    mesh.vertices.resize(uniqueCount * mesh.stride);
+    context.firstCorner = &firstCorner;
+    context.mesh = &mesh;
+    size_t grain = 16384;
+    if (parallel) {
+        jobs->parallelFor(uniqueCount, grain, gatherRange, &context);
+    } else {
+        gatherRange(0, uniqueCount, &context);
+    }
+    loadStats.dedupMs = elapsedMs(start);
+
+    loadStats.vertices = uniqueCount;
+    loadStats.triangles = loadStats.corners / 3;
+    loadStats.groups = mesh.groups.size();
+    loadStats.totalMs = elapsedMs(loadStart);
+    return true;
+}
+
+void ObjParser::printJson(std::ostream& out) const {
+    const Stats& s = loadStats;
+    double mbPerSecond = s.totalMs > 0.0 ? s.bytes / (1024.0 * 1024.0) / (s.totalMs / 1000.0) : 0.0;
+    out << "{\"map_ms\": " << s.mapMs << ", \"parse_ms\": " << s.parseMs << ", \"merge_ms\": " << s.mergeMs
+        << ", \"dedup_ms\": " << s.dedupMs << ", \"total_ms\": " << s.totalMs << ", \"mb_per_s\": " << mbPerSecond
+        << ", \"bytes\": " << s.bytes << ", \"lines\": " << s.lines << ", \"chunks\": " << s.chunks
+        << ", \"positions\": " << s.positions << ", \"normals\": " << s.normals << ", \"texcoords\": " << s.texcoords
+        << ", \"corners\": " << s.corners << ", \"vertices\": " << s.vertices << ", \"triangles\": " << s.triangles
+        << ", \"groups\": " << s.groups << ", \"threads\": " << s.threads << "}";
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "job_system.h"
+#include "mesh_data.h"
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+// Chunked, multithreaded Wavefront OBJ reader for files too big for loadObj().
+//
+// The file is mapped and cut into chunks at line boundaries, and the stages run on the
+// JobSystem:
+//
+//   parse     every chunk on its own: v, vn, vt and f lines into chunk-local arrays, with
+//             numbers read by a hand-written parser (eight digits at a time where it can,
+//             rounded as strtof() would) and line ends found sixteen bytes at a time with SSE2.
+//             Relative (negative) indices are kept relative to the chunk until the counts
+//             before it are known.
+//   merge     the chunks' attributes concatenated and every corner resolved to absolute
+//             position, texture coordinate and normal indices
+//   dedup     corners with the same three indices made one vertex: hashed into as many
+//             partitions as threads, each deduplicated by its own table, then numbered in
+//             first-use order so the result doesn't depend on the thread count
+//
+// The mesh has loadObj()'s layout and groups (with names trimmed). Unlike loadObj(), which
+// merges corners whose values are equal, corners are merged when their indices are; the two
+// agree unless the file repeats values under different indices.
+class ObjParser {
+public:
+    struct Stats {
+        double mapMs;
+        double parseMs;
+        double mergeMs;
+        double dedupMs;
+        double totalMs;
+        size_t bytes;
+        size_t lines;
+        size_t chunks;
+        size_t positions;
+        size_t normals;
+        size_t texcoords;
+        size_t corners;
+        size_t vertices;
+        size_t triangles;
+        size_t groups;
+        int threads;
+    };
+
+    // jobs runs the stages; without one, or on a thread that doesn't belong to it, everything
+    // runs on the calling thread.
+    explicit ObjParser(JobSystem* jobs = nullptr);
+
+    // On failure says why on stderr and returns false; mesh is then undefined.
+    bool load(const std::string& path, MeshData& mesh);
+
+    const Stats& stats() const { return loadStats; }
+    // {"map_ms": .., "parse_ms": .., "merge_ms": .., "dedup_ms": .., "total_ms": .., "mb_per_s": .., ..}
+    void printJson(std::ostream& out) const;
+
+private:
+    ObjParser(const ObjParser&);
+    ObjParser& operator=(const ObjParser&);
+
+    JobSystem* jobs;
+    Stats loadStats;
+};
@@ -0,0 +1,398 @@
+#include "occlusion_culler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OCCLUSION_CULLER_SSE 1
+#include <emmintrin.h>
+#endif
+
+const int OcclusionCuller::DefaultWidth;
+const int OcclusionCuller::DefaultHeight;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Column-major matrix times (x, y, z, 1)
+void transformPoint(const float* m, const float* p, float* out) {
+    for (int row = 0; row < 4; ++row) {
+        out[row] = m[row] * p[0] + m[4 + row] * p[1] + m[8 + row] * p[2] + m[12 + row];
+    }
+}
+
+// Signed distance to the near plane in clip space (z >= -w)
+float nearDistance(const float* clip) {
+    return clip[2] + clip[3];
+}
+
+} // namespace
+
+OcclusionCuller::OcclusionCuller(int width, int height)
+    : useSimd(simdAvailable()),
+      occluderTriangles(0),
+      rasterizedTriangles(0),
+      renderMs(0.0),
+      pyramidMs(0.0),
+      tested(0),
+      occluded(0),
+      testMs(0.0) {
+    width = std::max(4, (width + 3) & ~3);
+    height = std::max(1, height);
+    // Halve down to a single texel; odd sizes round up so every texel has a parent
+    for (;;) {
+        Level level;
+        level.width = width;
+        level.height = height;
+        level.nearest.assign(static_cast<size_t>(width) * height, 1.0f);
+        level.farthest.assign(static_cast<size_t>(width) * height, 1.0f);
+        levels.push_back(level);
+        if (width == 1 && height == 1) {
+            break;
+        }
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+    }
+    for (int i = 0; i < 16; ++i) {
+        viewProjection[i] = i % 5 == 0 ? 1.0f : 0.0f;
+    }
+}
+
+uint32_t OcclusionCuller::addOccluder(const float* vertices, size_t vertexCount, const uint32_t* triangleIndices, size_t indexCount) {
+    Occluder occluder = { positions.size() / 3, vertexCount, indices.size(), indexCount - indexCount % 3 };
+    positions.insert(positions.end(), vertices, vertices + vertexCount * 3);
+    indices.insert(indices.end(), triangleIndices, triangleIndices + occluder.indexCount);
+    occluders.push_back(occluder);
+    return static_cast<uint32_t>(occluders.size() - 1);
+}
+
+void OcclusionCuller::clearOccluders() {
+    positions.clear();
+    indices.clear();
+    occluders.clear();
+}
+
+bool OcclusionCuller::simdAvailable() {
+#ifdef OCCLUSION_CULLER_SSE
+    return true;
+#else
+    return false;
+#endif
+}
+
+void OcclusionCuller::setSimd(bool enabled) {
+    useSimd = enabled && simdAvailable();
+}
+
+void OcclusionCuller::render(const float* matrix) {
+    Clock::time_point start = Clock::now();
+    std::copy(matrix, matrix + 16, viewProjection);
+    std::fill(levels[0].farthest.begin(), levels[0].farthest.end(), 1.0f);
+    occluderTriangles = 0;
+    rasterizedTriangles = 0;
+    tested = 0;
+    occluded = 0;
+    testMs = 0.0;
+
+    clipPositions.resize(positions.size() / 3 * 4);
+    for (size_t i = 0; i < positions.size() / 3; ++i) {
+        transformPoint(viewProjection, &positions[i * 3], &clipPositions[i * 4]);
+    }
+    for (size_t o = 0; o < occluders.size(); ++o) {
+        const Occluder& occluder = occluders[o];
+        const float* clip = &clipPositions[occluder.firstVertex * 4];
+        for (size_t i = 0; i < occluder.indexCount; i += 3) {
+            const uint32_t* triangle = &indices[occluder.firstIndex + i];
+            drawTriangle(clip + triangle[0] * 4, clip + triangle[1] * 4, clip + triangle[2] * 4);
+        }
+        occluderTriangles += occluder.indexCount / 3;
+    }
+    renderMs = elapsedMs(start);
+
+    start = Clock::now();
+    buildPyramid();
+    pyramidMs = elapsedMs(start);
+}
+
+void OcclusionCuller::drawTriangle(const float* a, const float* b, const float* c) {
+    // Entirely outside one side of the view volume: nothing to draw
+    const float* corners[3] = { a, b, c };
+    for (int axis = 0; axis < 3; ++axis) {
+        int below = 0;
+        int above = 0;
+        for (int v = 0; v < 3; ++v) {
+            below += corners[v][axis] < -corners[v][3] ? 1 : 0;
+            above += corners[v][axis] > corners[v][3] ? 1 : 0;
+        }
+        if (below == 3 || above == 3) {
+            return;
+        }
+    }
+
+    // Clip against the near plane, which leaves a triangle or a quad
+    float polygon[4][4];
+    int count = 0;
+    for (int v = 0; v < 3; ++v) {
+        const float* current = corners[v];
+        const float* next = corners[(v + 1) % 3];
+        float currentDistance = nearDistance(current);
+        float nextDistance = nearDistance(next);
+        if (currentDistance >= 0.0f) {
+            std::copy(current, current + 4, polygon[count++]);
+        }
+        if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f)) {
+            float t = currentDistance / (currentDistance - nextDistance);
+            for (int k = 0; k < 4; ++k) {
+                polygon[count][k] = current[k] + (next[k] - current[k]) * t;
+            }
+            ++count;
+        }
+    }
+    if (count < 3) {
+        return;
+    }
+
+    const Level& target = levels[0];
+    ScreenVertex screen[4];
+    for (int v = 0; v < count; ++v) {
+        float inverseW = 1.0f / polygon[v][3];
+        screen[v].x = (polygon[v][0] * inverseW * 0.5f + 0.5f) * target.width;
+        screen[v].y = (polygon[v][1] * inverseW * 0.5f + 0.5f) * target.height;
+        screen[v].z = polygon[v][2] * inverseW * 0.5f + 0.5f;
+    }
+    for (int v = 1; v + 1 < count; ++v) {
+        rasterize(screen[0], screen[v], screen[v + 1]);
+    }
+}
+
+void OcclusionCuller::rasterize(ScreenVertex v0, ScreenVertex v1, ScreenVertex v2) {
+    float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+    if (std::fabs(area) < 1e-8f) {
+        return;
+    }
+    // Occluders are drawn from both sides; make the winding counter-clockwise
+    if (area < 0.0f) {
+        std::swap(v1, v2);
+        area = -area;
+    }
+
+    Level& target = levels[0];
+    int minX = std::max(0, static_cast<int>(std::floor(std::min(v0.x, std::min(v1.x, v2.x)))));
+    int maxX = std::min(target.width - 1, static_cast<int>(std::ceil(std::max(v0.x, std::max(v1.x, v2.x)))));
+    int minY = std::max(0, static_cast<int>(std::floor(std::min(v0.y, std::min(v1.y, v2.y)))));
+    int maxY = std::min(target.height - 1, static_cast<int>(std::ceil(std::max(v0.y, std::max(v1.y, v2.y)))));
+    if (minX > maxX || minY > maxY) {
+        return;
+    }
+    ++rasterizedTriangles;
+
+    // Edge functions and depth as planes a * x + b * y + c over pixel centres. Both paths
+    // evaluate the same expressions, so they write the same depths.
+    //
+    // To stay conservative a pixel is only written when the triangle covers all of it, and then
+    // with the farthest depth the triangle has in it. A plane's extreme over a pixel is at a
+    // corner, half a pixel from the centre along both axes, so the edges are pulled in and the
+    // depth pushed back by half the planes' absolute slopes.
+    const ScreenVertex* vertices[3] = { &v0, &v1, &v2 };
+    float edgeA[3], edgeB[3], edgeC[3];
+    for (int e = 0; e < 3; ++e) {
+        const ScreenVertex& from = *vertices[(e + 1) % 3];
+        const ScreenVertex& to = *vertices[(e + 2) % 3];
+        edgeA[e] = from.y - to.y;
+        edgeB[e] = to.x - from.x;
+        edgeC[e] = -(edgeA[e] * from.x + edgeB[e] * from.y) - 0.5f * (std::fabs(edgeA[e]) + std::fabs(edgeB[e]));
+    }
+    float depthA = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / area;
+    float depthB = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) / area;
+    float depthC = v0.z - depthA * v0.x - depthB * v0.y + 0.5f * (std::fabs(depthA) + std::fabs(depthB));
+
+#ifdef OCCLUSION_CULLER_SSE
+    if (useSimd) {
+        // Rows start on a 4-pixel boundary; the width is a multiple of 4, so no lane runs off the
+        // row, and lanes outside the triangle fail the edge tests
+        int startX = minX & ~3;
+        const __m128 laneOffsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+        const __m128 zero = _mm_setzero_ps();
+        __m128 a[3], b[3], c[3];
+        for (int e = 0; e < 3; ++e) {
+            a[e] = _mm_set1_ps(edgeA[e]);
+            b[e] = _mm_set1_ps(edgeB[e]);
+            c[e] = _mm_set1_ps(edgeC[e]);
+        }
+        const __m128 da = _mm_set1_ps(depthA);
+        const __m128 db = _mm_set1_ps(depthB);
+        const __m128 dc = _mm_set1_ps(depthC);
+        for (int y = minY; y <= maxY; ++y) {
+            __m128 py = _mm_set1_ps(y + 0.5f);
+            float* row = &target.farthest[static_cast<size_t>(y) * target.width];
+            for (int column = startX; column <= maxX; column += 4) {
+                __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(column)), laneOffsets);
+                __m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a[0], px), _mm_mul_ps(b[0], py)), c[0]), zero);
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a[1], px), _mm_mul_ps(b[1], py)), c[1]), zero));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a[2], px), _mm_mul_ps(b[2], py)), c[2]), zero));
+                if (_mm_movemask_ps(inside) == 0) {
+                    continue;
+                }
+                __m128 depth = _mm_add_ps(_mm_add_ps(_mm_mul_ps(da, px), _mm_mul_ps(db, py)), dc);
+                __m128 stored = _mm_loadu_ps(row + column);
+                __m128 nearer = _mm_min_ps(stored, depth);
+                _mm_storeu_ps(row + column, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, stored)));
+            }
+        }
+        return;
+    }
+#endif
+    for (int y = minY; y <= maxY; ++y) {
+        float py = y + 0.5f;
+        float* row = &target.farthest[static_cast<size_t>(y) * target.width];
+        for (int x = minX; x <= maxX; ++x) {
+            float px = x + 0.5f;
+            bool inside = edgeA[0] * px + edgeB[0] * py + edgeC[0] >= 0.0f
+                && edgeA[1] * px + edgeB[1] * py + edgeC[1] >= 0.0f
+                && edgeA[2] * px + edgeB[2] * py + edgeC[2] >= 0.0f;
+            if (inside) {
+                float depth = depthA * px + depthB * py + depthC;
+                row[x] = std::min(row[x], depth);
+            }
+        }
+    }
+}
+
+void OcclusionCuller::buildPyramid() {
+    Level& base = levels[0];
+    base.nearest = base.farthest;
+    for (size_t l = 1; l < levels.size(); ++l) {
+        const Level& below = levels[l - 1];
+        Level& level = levels[l];
+        for (int y = 0; y < level.height; ++y) {
+            int y0 = y * 2;
+            int y1 = std::min(y0 + 1, below.height - 1);
+            for (int x = 0; x < level.width; ++x) {
+                int x0 = x * 2;
+                int x1 = std::min(x0 + 1, below.width - 1);
+                size_t i00 = static_cast<size_t>(y0) * below.width + x0;
+                size_t i01 = static_cast<size_t>(y0) * below.width + x1;
+                size_t i10 = static_cast<size_t>(y1) * below.width + x0;
+                size_t i11 = static_cast<size_t>(y1) * below.width + x1;
+                size_t i = static_cast<size_t>(y) * level.width + x;
+                level.nearest[i] = std::min(std::min(below.nearest[i00], below.nearest[i01]),
+                                            std::min(below.nearest[i10], below.nearest[i11]));
+                level.farthest[i] = std::max(std::max(below.farthest[i00], below.farthest[i01]),
+                                             std::max(below.farthest[i10], below.farthest[i11]));
+            }
+        }
+    }
+}
+
+bool OcclusionCuller::visible(const Aabb& box) const {
+    ++tested;
+    const Level& base = levels[0];
+    float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f;
+    float nearest = 1e30f;
+    // Corners as the min corner plus combinations of the three transformed edges
+    float origin[4];
+    transformPoint(viewProjection, box.min, origin);
+    float edges[3][4];
+    for (int axis = 0; axis < 3; ++axis) {
+        float size = box.max[axis] - box.min[axis];
+        for (int row = 0; row < 4; ++row) {
+            edges[axis][row] = viewProjection[axis * 4 + row] * size;
+        }
+    }
+    for (int corner = 0; corner < 8; ++corner) {
+        float clip[4];
+        for (int row = 0; row < 4; ++row) {
+            clip[row] = origin[row] + (corner & 1 ? edges[0][row] : 0.0f) + (corner & 2 ? edges[1][row] : 0.0f)
+                + (corner & 4 ? edges[2][row] : 0.0f);
+        }
+        if (nearDistance(clip) < 0.0f || clip[3] <= 0.0f) {
+            return true;
+        }
+        float inverseW = 1.0f / clip[3];
+        float x = (clip[0] * inverseW * 0.5f + 0.5f) * base.width;
+        float y = (clip[1] * inverseW * 0.5f + 0.5f) * base.height;
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        nearest = std::min(nearest, clip[2] * inverseW * 0.5f + 0.5f);
+    }
+
+    // Every pixel the rectangle touches. Off-screen parts are the frustum culler's business.
+    int fine[4] = {
+        std::max(0, static_cast<int>(std::floor(minX))),
+        std::max(0, static_cast<int>(std::floor(minY))),
+        std::min(base.width - 1, static_cast<int>(std::floor(maxX))),
+        std::min(base.height - 1, static_cast<int>(std::floor(maxY)))
+    };
+    if (fine[0] > fine[2] || fine[1] > fine[3]) {
+        return true;
+    }
+    int level = 0;
+    while (level + 1 < levelCount()
+           && ((fine[2] >> level) - (fine[0] >> level) > 1 || (fine[3] >> level) - (fine[1] >> level) > 1)) {
+        ++level;
+    }
+    if (regionVisible(level, fine[0] >> level, fine[1] >> level, fine[2] >> level, fine[3] >> level, fine, nearest)) {
+        return true;
+    }
+    ++occluded;
+    return false;
+}
+
+bool OcclusionCuller::regionVisible(int levelIndex, int x0, int y0, int x1, int y1, const int fine[4], float depth) const {
+    const Level& level = levels[levelIndex];
+    for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x) {
+            size_t i = static_cast<size_t>(y) * level.width + x;
+            if (depth > level.farthest[i]) {
+                continue;
+            }
+            if (levelIndex == 0 || depth <= level.nearest[i]) {
+                return true;
+            }
+            // Partly in front of this texel: look at its children under the rectangle
+            int child = levelIndex - 1;
+            const Level& below = levels[child];
+            int cx0 = std::max(x * 2, fine[0] >> child);
+            int cy0 = std::max(y * 2, fine[1] >> child);
+            int cx1 = std::min(std::min(x * 2 + 1, below.width - 1), fine[2] >> child);
+            int cy1 = std::min(std::min(y * 2 + 1, below.height - 1), fine[3] >> child);
+            if (regionVisible(child, cx0, cy0, cx1, cy1, fine, depth)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+size_t OcclusionCuller::cull(const std::vector<Aabb>& bounds, std::vector<uint32_t>& candidates) const {
+    Clock::time_point start = Clock::now();
+    size_t kept = 0;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        if (visible(bounds[candidates[i]])) {
+            candidates[kept++] = candidates[i];
+        }
+    }
+    candidates.resize(kept);
+    testMs += elapsedMs(start);
+    return kept;
+}
+
+void OcclusionCuller::printJson(std::ostream& out) const {
+    out << "{\"width\": " << width() << ", \"height\": " << height()
+        << ", \"simd\": " << (useSimd ? "true" : "false")
+        << ", \"occluder_triangles\": " << occluderTriangles
+        << ", \"rasterized_triangles\": " << rasterizedTriangles
+        << ", \"render_ms\": " << renderMs
+        << ", \"pyramid_ms\": " << pyramidMs
+        << ", \"tested\": " << tested
+        << ", \"occluded\": " << occluded
+        << ", \"test_ms\": " << testMs << "}";
+}
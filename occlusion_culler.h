@@ -0,0 +1,110 @@
+#pragma once
+
+#include "bvh.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// Occlusion culling against a small depth buffer rasterised on the CPU.
+//
+// Each frame render() transforms the occluder meshes with the view-projection matrix, clips them
+// against the near plane and rasterises their depth into a width x height buffer. To stay
+// conservative a triangle only writes the pixels it covers entirely, with the farthest depth it
+// has in each, so nothing peeking past a silhouette is hidden; the price is that pixels along
+// edges shared by two triangles stay open. Rows are filled 4 pixels at a time with SSE where
+// available.
+// It then builds a pyramid where every texel of a level holds the nearest and farthest depth of
+// the 2x2 texels under it.
+//
+// visible() projects an object's box to a screen rectangle and its nearest depth, and walks the
+// pyramid from the coarsest level covering the rectangle in a couple of texels. A texel whose
+// farthest depth is nearer than the object hides its part of the rectangle; one whose nearest
+// depth is farther proves the object visible; anything in between is refined one level down.
+// Boxes crossing the near plane are always visible. Nothing touches the GPU, so given the same
+// inputs the results are the same on every machine.
+//
+// Depth is NDC z mapped to [0, 1], 0 at the near plane; the buffer is cleared to 1.
+class OcclusionCuller {
+public:
+    static const int DefaultWidth = 256;
+    static const int DefaultHeight = 128;
+
+    // The width is rounded up to a multiple of 4 for the SSE rows.
+    OcclusionCuller(int width = DefaultWidth, int height = DefaultHeight);
+
+    // World-space triangle mesh, xyz positions. Occluders should be solid and no larger than what
+    // they stand for, or they hide objects that are actually visible. Returns the occluder's index.
+    uint32_t addOccluder(const float* positions, size_t vertexCount, const uint32_t* indices, size_t indexCount);
+    void clearOccluders();
+    size_t occluderCount() const { return occluders.size(); }
+
+    // viewProjection is column-major with OpenGL clip space, as for Frustum::fromMatrix().
+    void render(const float* viewProjection);
+
+    // False only when box is certainly hidden behind the occluders of the last render().
+    bool visible(const Aabb& box) const;
+    // Drops the candidates, indices into bounds, that visible() rejects. Returns how many remain.
+    size_t cull(const std::vector<Aabb>& bounds, std::vector<uint32_t>& candidates) const;
+
+    // On by default where available; off gives the scalar rasteriser, which produces the same depths.
+    void setSimd(bool enabled);
+    bool simd() const { return useSimd; }
+    static bool simdAvailable();
+
+    int width() const { return levels[0].width; }
+    int height() const { return levels[0].height; }
+    int levelCount() const { return static_cast<int>(levels.size()); }
+    // Row-major, bottom row first
+    const std::vector<float>& depthBuffer() const { return levels[0].farthest; }
+
+    // Counters of the last render() and of the tests since; the test counters are not thread-safe
+    // {"width": .., "height": .., "simd": .., "occluder_triangles": .., "rasterized_triangles": ..,
+    //  "render_ms": .., "pyramid_ms": .., "tested": .., "occluded": .., "test_ms": ..}
+    void printJson(std::ostream& out) const;
+
+private:
+    struct Occluder {
+        size_t firstVertex;
+        size_t vertexCount;
+        size_t firstIndex;
+        size_t indexCount;
+    };
+
+    // Nearest and farthest depth per texel; level 0 is the depth buffer itself
+    struct Level {
+        int width;
+        int height;
+        std::vector<float> nearest;
+        std::vector<float> farthest;
+    };
+
+    // Screen-space vertex: pixels and [0, 1] depth
+    struct ScreenVertex {
+        float x;
+        float y;
+        float z;
+    };
+
+    void drawTriangle(const float* a, const float* b, const float* c);
+    void rasterize(ScreenVertex v0, ScreenVertex v1, ScreenVertex v2);
+    void buildPyramid();
+    bool regionVisible(int level, int x0, int y0, int x1, int y1, const int fine[4], float depth) const;
+
+    std::vector<float> positions;
+    std::vector<uint32_t> indices;
+    std::vector<Occluder> occluders;
+    std::vector<float> clipPositions;  // xyzw per occluder vertex, reused every render()
+    std::vector<Level> levels;
+    float viewProjection[16];
+    bool useSimd;
+
+    size_t occluderTriangles;
+    size_t rasterizedTriangles;
+    double renderMs;
+    double pyramidMs;
+    mutable size_t tested;
+    mutable size_t occluded;
+    mutable double testMs;
+};
@@ -0,0 +1,137 @@
+#include "render_queue.h"
+
+#include <chrono>
+
+namespace {
+
+const uint64_t FieldMask = 0xFFF;
+const uint64_t DepthMask = 0xFFFFFF;
+
+} // namespace
+
+RenderQueue::RenderQueue()
+    : sorted(false) {
+    frameStats = Stats();
+}
+
+uint64_t RenderQueue::makeKey(unsigned pass, GLuint program, GLuint texture, GLuint vao, float depth, bool backToFront) {
+    if (depth < 0.0f) {
+        depth = 0.0f;
+    } else if (depth > 1.0f) {
+        depth = 1.0f;
+    }
+    uint64_t depthBits = static_cast<uint64_t>(depth * DepthMask);
+    if (backToFront) {
+        depthBits = DepthMask - depthBits;
+    }
+    return (static_cast<uint64_t>(pass & 0xF) << 60)
+         | ((program & FieldMask) << 48)
+         | ((texture & FieldMask) << 36)
+         | ((vao & FieldMask) << 24)
+         | depthBits;
+}
+
+void RenderQueue::pushArrays(uint64_t key, GLuint program, GLuint vao, GLenum mode, GLint first, GLsizei count,
+                             GLsizei instanceCount) {
+    DrawCommand command = { key, program, vao, 0, mode, 0, count, instanceCount, static_cast<uintptr_t>(first) };
+    commands.push_back(command);
+}
+
+void RenderQueue::pushElements(uint64_t key, GLuint program, GLuint vao, GLenum mode, GLsizei count, GLenum indexType,
+                               uintptr_t offset, GLsizei instanceCount) {
+    DrawCommand command = { key, program, vao, 0, mode, indexType, count, instanceCount, offset };
+    commands.push_back(command);
+}
+
+void RenderQueue::sort() {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    size_t n = commands.size();
+    order.resize(n);
+    scratch.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        order[i].key = commands[i].key;
+        order[i].index = static_cast<uint32_t>(i);
+    }
+
+    // LSD radix sort, one byte per pass. Bytes that are the same for every key (most of the
+    // depth bits in a 2D scene, the pass when there is only one) cost a histogram and no scatter.
+    for (int shift = 0; shift < 64; shift += 8) {
+        size_t histogram[256] = {};
+        for (size_t i = 0; i < n; ++i) {
+            ++histogram[(order[i].key >> shift) & 0xFF];
+        }
+        if (n == 0 || histogram[(order[0].key >> shift) & 0xFF] == n) {
+            continue;
+        }
+        size_t offset = 0;
+        for (int b = 0; b < 256; ++b) {
+            size_t count = histogram[b];
+            histogram[b] = offset;
+            offset += count;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            scratch[histogram[(order[i].key >> shift) & 0xFF]++] = order[i];
+        }
+        order.swap(scratch);
+    }
+    sorted = true;
+    frameStats.sortMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void RenderQueue::execute(GlStateCache& state) {
+    if (!sorted) {
+        sort();
+    }
+    double sortMs = frameStats.sortMs;
+    frameStats = Stats();
+    frameStats.sortMs = sortMs;
+
+    // The filter is the state cache; the switch counts are its counters over this replay
+    typedef GlStateCache::Kind Kind;
+    uint64_t programsBefore = state.issued(Kind::Program);
+    uint64_t vaosBefore = state.issued(Kind::VertexArray);
+    uint64_t texturesBefore = state.issued(Kind::Texture);
+    uint64_t elidedBefore = state.elided(Kind::Program) + state.elided(Kind::VertexArray) + state.elided(Kind::Texture);
+    for (size_t i = 0; i < order.size(); ++i) {
+        const DrawCommand& command = commands[order[i].index];
+        state.useProgram(command.program);
+        state.bindVertexArray(command.vao);
+        if (command.texture) {
+            state.bindTexture(0, GL_TEXTURE_2D, command.texture);
+        }
+
+        if (command.indexType) {
+            const void* offset = reinterpret_cast<const void*>(command.first);
+            if (command.instanceCount > 1) {
+                glDrawElementsInstanced(command.mode, command.count, command.indexType, offset, command.instanceCount);
+            } else {
+                glDrawElements(command.mode, command.count, command.indexType, offset);
+            }
+        } else {
+            GLint firstVertex = static_cast<GLint>(command.first);
+            if (command.instanceCount > 1) {
+                glDrawArraysInstanced(command.mode, firstVertex, command.count, command.instanceCount);
+            } else {
+                glDrawArrays(command.mode, firstVertex, command.count);
+            }
+        }
+        ++frameStats.commands;
+    }
+    frameStats.programSwitches = state.issued(Kind::Program) - programsBefore;
+    frameStats.vaoSwitches = state.issued(Kind::VertexArray) - vaosBefore;
+    frameStats.textureSwitches = state.issued(Kind::Texture) - texturesBefore;
+    frameStats.redundantBinds = state.elided(Kind::Program) + state.elided(Kind::VertexArray) +
+                                state.elided(Kind::Texture) - elidedBefore;
+    commands.clear();
+    order.clear();
+    sorted = false;
+}
+
+void RenderQueue::printJson(std::ostream& out) const {
+    out << "{\"commands\": " << frameStats.commands
+        << ", \"program_switches\": " << frameStats.programSwitches
+        << ", \"vao_switches\": " << frameStats.vaoSwitches
+        << ", \"texture_switches\": " << frameStats.textureSwitches
+        << ", \"redundant_binds\": " << frameStats.redundantBinds
+        << ", \"sort_ms\": " << frameStats.sortMs << "}";
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "gl_state.h"
+#include "glad/gl_core_33.h"
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// One draw, recorded instead of issued. Everything replay needs is in the packet.
+struct DrawCommand {
+    uint64_t key;
+    GLuint program;
+    GLuint vao;
+    GLuint texture;         // bound to unit 0, or 0 for none
+    GLenum mode;
+    GLenum indexType;       // 0 for glDrawArrays
+    GLsizei count;
+    GLsizei instanceCount;  // > 1 draws instanced
+    uintptr_t first;        // first vertex, or byte offset into the index buffer
+};
+
+// Frame-level command buffer.
+//
+// Scene code pushes DrawCommands in whatever order it traverses the scene. Once per frame
+// sort() orders them by their 64-bit keys with an LSD radix sort, and execute() replays them
+// through a GlStateCache, which skips program, VAO and texture binds that wouldn't change anything. The keys put the
+// pass in the top bits, then program, texture and VAO, then depth, so state changes cluster.
+//
+//   63..60 pass | 59..48 program | 47..36 texture | 35..24 vao | 23..0 depth
+class RenderQueue {
+public:
+    // Counters of the last execute()
+    struct Stats {
+        uint64_t commands;
+        uint64_t programSwitches;
+        uint64_t vaoSwitches;
+        uint64_t textureSwitches;
+        uint64_t redundantBinds;  // binds skipped because the state already matched
+        double sortMs;
+    };
+
+    RenderQueue();
+
+    // GL names are folded into 12 bits, which only matters for ordering, never for correctness.
+    // depth in [0, 1]; backToFront reverses it for blended passes.
+    static uint64_t makeKey(unsigned pass, GLuint program, GLuint texture, GLuint vao, float depth = 0.0f,
+                            bool backToFront = false);
+
+    void push(const DrawCommand& command) { commands.push_back(command); }
+    void pushArrays(uint64_t key, GLuint program, GLuint vao, GLenum mode, GLint first, GLsizei count,
+                    GLsizei instanceCount = 1);
+    void pushElements(uint64_t key, GLuint program, GLuint vao, GLenum mode, GLsizei count, GLenum indexType,
+                      uintptr_t offset, GLsizei instanceCount = 1);
+
+    // Stable: commands with equal keys keep their submission order.
+    void sort();
+    // Replays the sorted commands and clears the queue, leaving the last program and VAO bound.
+    void execute(GlStateCache& state);
+
+    size_t size() const { return commands.size(); }
+    const Stats& stats() const { return frameStats; }
+
+    // {"commands": .., "program_switches": .., "vao_switches": .., "texture_switches": .., ...}
+    void printJson(std::ostream& out) const;
+
+private:
+    struct SortEntry {
+        uint64_t key;
+        uint32_t index;
+    };
+
+    std::vector<DrawCommand> commands;
+    std::vector<SortEntry> order;
+    std::vector<SortEntry> scratch;
+    bool sorted;
+    Stats frameStats;
+};
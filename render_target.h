@@ -0,0 +1,31 @@
+#pragma once
+
+#include "glad/gl_core_33.h"
+
+// Framebuffer object with an RGBA8 color and a depth/stencil renderbuffer.
+// Used instead of the default backbuffer when rendering offscreen.
+class RenderTarget {
+public:
+    RenderTarget();
+    ~RenderTarget();
+
+    bool create(int width, int height);
+    void destroy();
+
+    // Binds the framebuffer for drawing and sets the viewport to cover it.
+    void bind() const;
+
+    GLuint framebuffer() const { return fbo; }
+    int width() const { return w; }
+    int height() const { return h; }
+
+private:
+    RenderTarget(const RenderTarget&);
+    RenderTarget& operator=(const RenderTarget&);
+
+    GLuint fbo;
+    GLuint colorBuffer;
+    GLuint depthBuffer;
+    int w;
+    int h;
+};
@@ -0,0 +1,135 @@
+#include "shader.h"
+#include "shader_cache.h"
+#include "shader_preprocessor.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// Function to load shader from file
+std::string loadShaderSource(const char* filepath) {
+    std::ifstream file(filepath);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open shader file: " << filepath << std::endl;
+        return "";
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    return buffer.str();
+}
+
+std::string injectDefines(const std::string& source, const std::string& defines) {
+    std::string block;
+    std::istringstream names(defines);
+    std::string name;
+    while (names >> name) {
+        std::string::size_type equals = name.find('=');
+        if (equals == std::string::npos) {
+            block += "#define " + name + "\n";
+        } else {
+            block += "#define " + name.substr(0, equals) + " " + name.substr(equals + 1) + "\n";
+        }
+    }
+    if (block.empty()) {
+        return source;
+    }
+
+    // Find the end of the #version line, if there is one
+    std::string::size_type insertAt = 0;
+    int line = 1;
+    std::string::size_type version = source.find("#version");
+    if (version != std::string::npos) {
+        std::string::size_type eol = source.find('\n', version);
+        insertAt = eol == std::string::npos ? source.size() : eol + 1;
+        for (std::string::size_type i = 0; i < insertAt; ++i) {
+            if (source[i] == '\n') {
+                ++line;
+            }
+        }
+    }
+    std::ostringstream result;
+    result << source.substr(0, insertAt);
+    if (insertAt > 0 && source[insertAt - 1] != '\n') {
+        result << '\n';
+    }
+    result << block << "#line " << line << "\n" << source.substr(insertAt);
+    return result.str();
+}
+
+// Function to compile shader
+GLuint compileShader(GLenum type, const char* source) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, nullptr);
+    glCompileShader(shader);
+    
+    GLint success;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        char infoLog[512];
+        glGetShaderInfoLog(shader, 512, nullptr, infoLog);
+        std::cerr << "Shader compilation failed:\n" << infoLog << std::endl;
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+GLuint linkProgram(GLuint vertexShader, GLuint fragmentShader, bool retrievable) {
+    GLuint program = glCreateProgram();
+    if (retrievable) {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    if (vertexShader) {
+        glAttachShader(program, vertexShader);
+    }
+    if (fragmentShader) {
+        glAttachShader(program, fragmentShader);
+    }
+    glLinkProgram(program);
+    
+    GLint success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        char infoLog[512];
+        glGetProgramInfoLog(program, 512, nullptr, infoLog);
+        std::cerr << "Program linking failed:\n" << infoLog << std::endl;
+    }
+    
+    if (vertexShader) {
+        glDetachShader(program, vertexShader);
+    }
+    if (fragmentShader) {
+        glDetachShader(program, fragmentShader);
+    }
+    return program;
+}
+
+// Function to create shader program
+GLuint createShaderProgram(const char* vertexPath, const char* fragmentPath, ShaderCache* cache) {
+    ShaderPreprocessor preprocessor;
+    std::string vertexSource = preprocessor.process(vertexPath);
+    std::string fragmentSource = preprocessor.process(fragmentPath);
+
+    bool useCache = cache && cache->enabled();
+    uint64_t key = 0;
+    if (useCache) {
+        key = cache->programKey(vertexSource, fragmentSource);
+        GLuint cached = cache->load(key);
+        if (cached) {
+            return cached;
+        }
+    }
+    
+    GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexSource.c_str());
+    GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentSource.c_str());
+    
+    GLuint program = linkProgram(vertexShader, fragmentShader, useCache);
+    
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+
+    if (useCache) {
+        cache->store(key, program);
+    }
+    return program;
+}
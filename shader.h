@@ -0,0 +1,26 @@
+#pragma once
+
+#include "glad/gl_core_33.h"
+
+#include <string>
+
+class ShaderCache;
+
+// Function to load shader from file. Does not expand #include; see ShaderPreprocessor.
+std::string loadShaderSource(const char* filepath);
+
+// Inserts a #define for each space-separated NAME or NAME=VALUE in defines right after the
+// #version line (which must stay first), followed by a #line directive so compiler errors
+// still point at the original line numbers.
+std::string injectDefines(const std::string& source, const std::string& defines);
+
+// Function to compile shader. Returns 0 and logs the info log on failure.
+GLuint compileShader(GLenum type, const char* source);
+
+// Links two compiled shaders. Returns the program even if linking failed (the error is logged).
+// retrievable requests GL_PROGRAM_BINARY_RETRIEVABLE_HINT so the result can be cached.
+GLuint linkProgram(GLuint vertexShader, GLuint fragmentShader, bool retrievable = false);
+
+// Function to create shader program, expanding #include directives. When a cache is given, a stored binary for the same
+// sources and driver is used instead of compiling, and freshly linked programs are stored.
+GLuint createShaderProgram(const char* vertexPath, const char* fragmentPath, ShaderCache* cache = nullptr);
@@ -0,0 +1,173 @@
+#include "shader_cache.h"
+#include "hash.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+const uint32_t CacheMagic = 0x42504447; // "GDPB"
+const uint32_t CacheVersion = 1;
+
+// Fixed-size header in front of the driver's binary blob
+struct CacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t format;
+    uint32_t length;
+};
+
+bool makeDirectory(const std::string& path) {
+#ifdef _WIN32
+    int result = _mkdir(path.c_str());
+#else
+    int result = mkdir(path.c_str(), 0755);
+#endif
+    return result == 0 || errno == EEXIST;
+}
+
+std::string glString(GLenum name) {
+    const GLubyte* value = glGetString(name);
+    return value ? reinterpret_cast<const char*>(value) : "";
+}
+
+} // namespace
+
+ShaderCache::ShaderCache(const std::string& directory)
+    : directory(directory), driverHash(0), available(false) {
+    counters.hits = counters.misses = counters.rejected = counters.stored = 0;
+}
+
+bool ShaderCache::init() {
+    available = false;
+    if (!GLAD_GL_ARB_get_program_binary || !glGetProgramBinary || !glProgramBinary || !glProgramParameteri) {
+        return false;
+    }
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    if (formats <= 0) {
+        return false;
+    }
+    if (!makeDirectory(directory)) {
+        std::cerr << "Shader cache disabled, cannot create " << directory << std::endl;
+        return false;
+    }
+
+    uint64_t hash = fnv1a64(glString(GL_VENDOR));
+    hash = fnv1a64(glString(GL_RENDERER), hash);
+    driverHash = fnv1a64(glString(GL_VERSION), hash);
+    available = true;
+    return true;
+}
+
+uint64_t ShaderCache::programKey(const std::string& vertexSource, const std::string& fragmentSource,
+                                 const std::string& defines) const {
+    uint64_t hash = fnv1a64(&driverHash, sizeof(driverHash));
+    hash = fnv1a64(defines, hash);
+    hash = fnv1a64(vertexSource, hash);
+    return fnv1a64(fragmentSource, hash);
+}
+
+std::string ShaderCache::entryPath(uint64_t key) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+    return directory + "/" + name;
+}
+
+GLuint ShaderCache::load(uint64_t key) {
+    if (!available) {
+        return 0;
+    }
+    std::string path = entryPath(key);
+    std::ifstream file(path.c_str(), std::ios::binary);
+    CacheHeader header;
+    if (!file.is_open() || !file.read(reinterpret_cast<char*>(&header), sizeof(header))
+        || header.magic != CacheMagic || header.version != CacheVersion || header.key != key) {
+        ++counters.misses;
+        return 0;
+    }
+    // The length comes off the disk: check it against what's actually there before allocating,
+    // so a truncated or corrupt entry can't ask for gigabytes
+    file.seekg(0, std::ios::end);
+    std::streamoff size = file.tellg();
+    file.seekg(static_cast<std::streamoff>(sizeof(header)));
+    if (size != static_cast<std::streamoff>(sizeof(header) + header.length)) {
+        file.close();
+        std::remove(path.c_str());
+        ++counters.misses;
+        return 0;
+    }
+    std::vector<char> binary(header.length);
+    if (!file.read(binary.data(), static_cast<std::streamsize>(binary.size()))) {
+        file.close();
+        std::remove(path.c_str());
+        ++counters.misses;
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+    GLint success = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        // Driver changed in a way the key didn't capture; drop the entry and recompile
+        glDeleteProgram(program);
+        file.close();
+        std::remove(path.c_str());
+        ++counters.rejected;
+        return 0;
+    }
+    ++counters.hits;
+    return program;
+}
+
+void ShaderCache::store(uint64_t key, GLuint program) {
+    if (!available) {
+        return;
+    }
+    GLint success = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (!success || length <= 0) {
+        return;
+    }
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+
+    CacheHeader header;
+    header.magic = CacheMagic;
+    header.version = CacheVersion;
+    header.key = key;
+    header.format = format;
+    header.length = static_cast<uint32_t>(length);
+
+    // Write to a temporary and rename so a crash never leaves a truncated entry behind
+    std::string path = entryPath(key);
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream file(tempPath.c_str(), std::ios::binary | std::ios::trunc);
+        if (!file.write(reinterpret_cast<const char*>(&header), sizeof(header))
+            || !file.write(binary.data(), length)) {
+            std::cerr << "Failed to write shader cache entry " << tempPath << std::endl;
+            return;
+        }
+    }
+    std::remove(path.c_str());
+    if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+        std::remove(tempPath.c_str());
+        return;
+    }
+    ++counters.stored;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "glad/gl_core_33.h"
+
+#include <cstdint>
+#include <string>
+
+// On-disk cache of linked program binaries (glGetProgramBinary / glProgramBinary).
+//
+// Entries are keyed by a hash of the shader sources, the preprocessor defines and the
+// driver identity (GL_VENDOR, GL_RENDERER, GL_VERSION), so a driver update simply misses.
+// If the driver still rejects a binary it is deleted and the caller compiles from source.
+class ShaderCache {
+public:
+    struct Stats {
+        unsigned hits;
+        unsigned misses;
+        unsigned rejected; // binary found but the driver refused it
+        unsigned stored;
+    };
+
+    explicit ShaderCache(const std::string& directory = "shader_cache");
+
+    // Needs a current context. Leaves the cache disabled when the driver exposes no
+    // program binary formats, in which case load() always misses and store() is a no-op.
+    bool init();
+    bool enabled() const { return available; }
+
+    uint64_t programKey(const std::string& vertexSource, const std::string& fragmentSource,
+                        const std::string& defines = std::string()) const;
+
+    // Returns a linked program, or 0 on a miss or a rejected binary.
+    GLuint load(uint64_t key);
+    // Writes the binary of a successfully linked program. The program must have been
+    // linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set.
+    void store(uint64_t key, GLuint program);
+
+    const Stats& stats() const { return counters; }
+    const std::string& path() const { return directory; }
+
+private:
+    std::string entryPath(uint64_t key) const;
+
+    std::string directory;
+    uint64_t driverHash;
+    bool available;
+    Stats counters;
+};
@@ -0,0 +1,332 @@
+#include "shader_manager.h"
+#include "hash.h"
+#include "shader.h"
+#include "shader_cache.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+void logShaderFailure(GLuint shader, const std::string& path, const ShaderPreprocessor& preprocessor) {
+    if (!shader) {
+        return;
+    }
+    GLint success = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        char infoLog[512];
+        glGetShaderInfoLog(shader, 512, nullptr, infoLog);
+        std::cerr << "Shader compilation failed (" << path << "):\n" << infoLog;
+        // Errors inside an #include are reported against its source-string number
+        std::string legend = preprocessor.sourceLegend();
+        if (!legend.empty()) {
+            std::cerr << "Source strings: 0 = " << path << ", " << legend << "\n";
+        }
+        std::cerr << std::flush;
+    }
+}
+
+} // namespace
+
+const ShaderManager::ProgramHandle ShaderManager::InvalidProgram;
+
+ShaderManager::ShaderManager(ShaderCache* cache)
+    : cache(cache), parallel(false), generation(0) {
+}
+
+ShaderManager::~ShaderManager() {
+    shutdown();
+}
+
+void ShaderManager::init() {
+    parallel = GLAD_GL_KHR_parallel_shader_compile && glMaxShaderCompilerThreadsKHR;
+    if (parallel) {
+        // 0xFFFFFFFF lets the implementation pick its own thread count
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);
+    }
+}
+
+void ShaderManager::shutdown() {
+    for (size_t i = 0; i < entries.size(); ++i) {
+        Entry& entry = entries[i];
+        if (entry.state == State::Linking) {
+            resolve(entry);
+        }
+        if (entry.program) {
+            glDeleteProgram(entry.program);
+            entry.program = 0;
+            ++generation;
+        }
+    }
+    entries.clear();
+}
+
+ShaderManager::ProgramHandle ShaderManager::add(const std::string& vertexPath, const std::string& fragmentPath,
+                                                const std::string& defines) {
+    Entry entry;
+    entry.vertexPath = ShaderPreprocessor::normalizePath(vertexPath);
+    entry.fragmentPath = ShaderPreprocessor::normalizePath(fragmentPath);
+    entry.defines = defines;
+    entry.program = 0;
+    entry.linked = false;
+    entry.state = State::Queued;
+    loadSources(entry, entry.pending.vertexSource, entry.pending.fragmentSource);
+    entry.pending.cacheKey = 0;
+    entry.pending.program = 0;
+    entry.pending.vertexShader = 0;
+    entry.pending.fragmentShader = 0;
+    entries.push_back(entry);
+    return static_cast<ProgramHandle>(entries.size() - 1);
+}
+
+bool ShaderManager::loadSources(Entry& entry, std::string& vertexSource, std::string& fragmentSource) {
+    entry.dependencies.clear();
+    vertexSource = preprocessor.process(entry.vertexPath, &entry.dependencies);
+    fragmentSource = preprocessor.process(entry.fragmentPath, &entry.dependencies);
+    if (vertexSource.empty() || fragmentSource.empty()) {
+        return false;
+    }
+    vertexSource = injectDefines(vertexSource, entry.defines);
+    fragmentSource = injectDefines(fragmentSource, entry.defines);
+    return true;
+}
+
+GLuint ShaderManager::compile(GLenum type, const std::string& source, std::vector<std::pair<uint64_t, GLuint> >& compiled) {
+    // Programs commonly share a stage (one vertex shader, many fragment shaders); compile it once
+    uint64_t key = fnv1a64(source, fnv1a64(&type, sizeof(type)));
+    for (size_t i = 0; i < compiled.size(); ++i) {
+        if (compiled[i].first == key) {
+            return compiled[i].second;
+        }
+    }
+    GLuint shader = glCreateShader(type);
+    const char* text = source.c_str();
+    glShaderSource(shader, 1, &text, nullptr);
+    glCompileShader(shader);
+    compiled.push_back(std::make_pair(key, shader));
+    return shader;
+}
+
+void ShaderManager::submit() {
+    bool useCache = cache && cache->enabled();
+    std::vector<std::pair<uint64_t, GLuint> > compiled;
+
+    // Pass 1: cache lookups and compiles. No status queries, so nothing here waits on the compiler.
+    for (size_t i = 0; i < entries.size(); ++i) {
+        Entry& entry = entries[i];
+        if (entry.state != State::Queued) {
+            continue;
+        }
+        Build& build = entry.pending;
+        if (useCache) {
+            build.cacheKey = cache->programKey(build.vertexSource, build.fragmentSource, entry.defines);
+            GLuint cached = cache->load(build.cacheKey);
+            if (cached) {
+                if (entry.program) {
+                    glDeleteProgram(entry.program);
+                    ++generation;
+                }
+                entry.program = cached;
+                entry.linked = true;
+                entry.state = State::Ready;
+                continue;
+            }
+        }
+        build.vertexShader = compile(GL_VERTEX_SHADER, build.vertexSource, compiled);
+        build.fragmentShader = compile(GL_FRAGMENT_SHADER, build.fragmentSource, compiled);
+    }
+
+    // Pass 2: links. A link may be issued before its shaders finish compiling.
+    for (size_t i = 0; i < entries.size(); ++i) {
+        Entry& entry = entries[i];
+        if (entry.state != State::Queued) {
+            continue;
+        }
+        Build& build = entry.pending;
+        build.program = glCreateProgram();
+        if (useCache) {
+            glProgramParameteri(build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+        glAttachShader(build.program, build.vertexShader);
+        glAttachShader(build.program, build.fragmentShader);
+        glLinkProgram(build.program);
+        entry.state = State::Linking;
+    }
+
+    // Shaders are only flagged here; GL frees them once the last program detaches them
+    for (size_t i = 0; i < compiled.size(); ++i) {
+        glDeleteShader(compiled[i].second);
+    }
+}
+
+void ShaderManager::resolve(Entry& entry) {
+    Build& build = entry.pending;
+    GLint success = GL_FALSE;
+    glGetProgramiv(build.program, GL_LINK_STATUS, &success);
+    bool ok = success == GL_TRUE;
+    if (!ok) {
+        logShaderFailure(build.vertexShader, entry.vertexPath, preprocessor);
+        logShaderFailure(build.fragmentShader, entry.fragmentPath, preprocessor);
+        char infoLog[512];
+        glGetProgramInfoLog(build.program, 512, nullptr, infoLog);
+        std::cerr << "Program linking failed " << describe(entry) << ":\n" << infoLog << std::endl;
+    } else if (cache && cache->enabled()) {
+        cache->store(build.cacheKey, build.program);
+    }
+    glDetachShader(build.program, build.vertexShader);
+    glDetachShader(build.program, build.fragmentShader);
+    build.vertexShader = 0;
+    build.fragmentShader = 0;
+
+    if (ok || !entry.program) {
+        // Swap in the new program. A failed first build is kept so program() still returns a name.
+        if (entry.program) {
+            glDeleteProgram(entry.program);
+            ++generation;
+        }
+        entry.program = build.program;
+        entry.linked = ok;
+    } else {
+        std::cerr << "Keeping previous version of " << describe(entry) << std::endl;
+        glDeleteProgram(build.program);
+    }
+    build.program = 0;
+    entry.state = State::Ready;
+}
+
+bool ShaderManager::poll() {
+    bool done = true;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        Entry& entry = entries[i];
+        if (entry.state == State::Ready) {
+            continue;
+        }
+        if (entry.state == State::Linking) {
+            GLint complete = GL_FALSE;
+            if (parallel) {
+                glGetProgramiv(entry.pending.program, GL_COMPLETION_STATUS_KHR, &complete);
+            }
+            // A reload has to be finished somewhere; without the extension that is here, between frames
+            if (complete || entry.program) {
+                resolve(entry);
+                continue;
+            }
+        }
+        done = false;
+    }
+    return done;
+}
+
+void ShaderManager::resolveAll() {
+    submit();
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (entries[i].state == State::Linking) {
+            resolve(entries[i]);
+        }
+    }
+}
+
+size_t ShaderManager::reload(const std::vector<std::string>& changedPaths) {
+    // Drop the stale mappings first; the edited files may have been truncated and rewritten
+    preprocessor.invalidate(changedPaths);
+    // Programs whose root files include a changed file, however indirectly
+    std::vector<std::string> affected = preprocessor.affectedFiles(changedPaths);
+    for (size_t i = 0; i < changedPaths.size(); ++i) {
+        std::string path = ShaderPreprocessor::normalizePath(changedPaths[i]);
+        size_t users = 0;
+        for (size_t j = 0; j < entries.size(); ++j) {
+            const std::vector<std::string>& dependencies = entries[j].dependencies;
+            users += std::find(dependencies.begin(), dependencies.end(), path) != dependencies.end();
+        }
+        if (users) {
+            std::cout << path << " changed: " << users << " program(s) invalidated" << std::endl;
+        }
+    }
+
+    size_t queued = 0;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        Entry& entry = entries[i];
+        bool invalidated = std::find(affected.begin(), affected.end(), entry.vertexPath) != affected.end()
+                           || std::find(affected.begin(), affected.end(), entry.fragmentPath) != affected.end();
+        if (!invalidated) {
+            continue;
+        }
+        if (entry.state == State::Linking) {
+            resolve(entry); // finish the build in flight before starting another
+        }
+
+        std::string vertexSource;
+        std::string fragmentSource;
+        std::vector<std::string> previousDependencies = entry.dependencies;
+        if (!loadSources(entry, vertexSource, fragmentSource)) {
+            entry.dependencies.swap(previousDependencies);
+            continue; // file mid-save or deleted; the next change event will retry
+        }
+        // Editors often touch a file without changing it; skip those
+        if (entry.state == State::Ready && entry.linked
+            && vertexSource == entry.pending.vertexSource && fragmentSource == entry.pending.fragmentSource) {
+            continue;
+        }
+        entry.pending.vertexSource = vertexSource;
+        entry.pending.fragmentSource = fragmentSource;
+        entry.state = State::Queued;
+        ++queued;
+    }
+    if (queued) {
+        submit();
+    }
+    return queued;
+}
+
+GLuint ShaderManager::program(ProgramHandle handle) {
+    if (handle < 0 || static_cast<size_t>(handle) >= entries.size()) {
+        return 0;
+    }
+    Entry& entry = entries[handle];
+    if (!entry.program) {
+        if (entry.state == State::Queued) {
+            submit();
+        }
+        if (entry.state == State::Linking) {
+            resolve(entry);
+        }
+    }
+    return entry.program;
+}
+
+bool ShaderManager::linked(ProgramHandle handle) {
+    program(handle);
+    return handle >= 0 && static_cast<size_t>(handle) < entries.size() && entries[handle].linked;
+}
+
+size_t ShaderManager::pendingCount() const {
+    size_t count = 0;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (entries[i].state != State::Ready) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+std::string ShaderManager::describe(const Entry& entry) {
+    std::string text = "(" + entry.vertexPath + ", " + entry.fragmentPath;
+    if (!entry.defines.empty()) {
+        text += " [" + entry.defines + "]";
+    }
+    return text + ")";
+}
+
+std::vector<std::string> ShaderManager::sourcePaths() const {
+    std::vector<std::string> paths;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        const std::vector<std::string>& dependencies = entries[i].dependencies;
+        for (size_t j = 0; j < dependencies.size(); ++j) {
+            if (std::find(paths.begin(), paths.end(), dependencies[j]) == paths.end()) {
+                paths.push_back(dependencies[j]);
+            }
+        }
+    }
+    return paths;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "glad/gl_core_33.h"
+#include "shader_preprocessor.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ShaderCache;
+
+// Owns the demo's shader programs and builds them without serialising on the driver.
+//
+// Programs are declared with add() and built together by submit(): every distinct shader is
+// compiled, then every program is linked, without querying any status in between. With
+// GL_KHR_parallel_shader_compile the driver works on them in the background and poll() can
+// check GL_COMPLETION_STATUS_KHR without blocking. Link status is only queried when a
+// program is first used through program(), or when poll() sees it complete.
+//
+// Sources go through a ShaderPreprocessor, so #include "file" works and each program knows every
+// file it was built from. reload() rebuilds programs whose sources changed into a second GL program. The handle keeps
+// returning the old program until the new one has linked; if it fails, the old one stays.
+class ShaderManager {
+public:
+    typedef int ProgramHandle;
+    static const ProgramHandle InvalidProgram = -1;
+
+    explicit ShaderManager(ShaderCache* cache = nullptr);
+    ~ShaderManager();
+
+    // Needs a current context. Asks the driver for as many compiler threads as it likes.
+    void init();
+    void shutdown();
+
+    // Declares a program; sources are read now, GL work is deferred to submit().
+    // defines (space-separated NAME or NAME=VALUE) are injected into both stages.
+    ProgramHandle add(const std::string& vertexPath, const std::string& fragmentPath,
+                      const std::string& defines = std::string());
+    // Issues compiles and links for every queued program.
+    void submit();
+    // Resolves programs the driver has finished. Returns true when none are outstanding.
+    // Without the parallel compile extension nothing can be checked without blocking, so a
+    // first build is left for program() to resolve, while reloads are resolved here.
+    bool poll();
+    // Blocks until every program is resolved.
+    void resolveAll();
+
+    // Re-reads the sources of programs that use any of the given files, directly or through an
+    // #include, and rebuilds the ones whose text actually changed. Call between frames; the swap happens in poll().
+    // Returns the number of programs queued for rebuilding.
+    size_t reload(const std::vector<std::string>& changedPaths);
+
+    // GL name of the program, resolving its first build if needed. Linking failures are logged
+    // once; the (unusable) program is still returned, as createShaderProgram() does.
+    GLuint program(ProgramHandle handle);
+    bool linked(ProgramHandle handle);
+
+    bool parallelCompile() const { return parallel; }
+    size_t size() const { return entries.size(); }
+    size_t pendingCount() const;
+    // Bumped whenever a program handed out by program() is deleted, after which GL may reuse its
+    // name. Anything that remembers program names (GlStateCache) must forget them when it changes.
+    uint64_t programGeneration() const { return generation; }
+    // Every shader file used by a declared program, includes too, without duplicates.
+    std::vector<std::string> sourcePaths() const;
+
+private:
+    enum class State {
+        Ready,
+        Queued,
+        Linking
+    };
+
+    // A program being built, either the first version or a reload
+    struct Build {
+        std::string vertexSource;
+        std::string fragmentSource;
+        uint64_t cacheKey;
+        GLuint program;
+        GLuint vertexShader;
+        GLuint fragmentShader;
+    };
+
+    struct Entry {
+        std::string vertexPath;
+        std::string fragmentPath;
+        std::string defines;
+        std::vector<std::string> dependencies; // both stages and everything they include
+        GLuint program; // what program() returns
+        bool linked;
+        State state;
+        Build pending;
+    };
+
+    bool loadSources(Entry& entry, std::string& vertexSource, std::string& fragmentSource);
+    GLuint compile(GLenum type, const std::string& source, std::vector<std::pair<uint64_t, GLuint> >& compiled);
+    void resolve(Entry& entry);
+    static std::string describe(const Entry& entry);
+
+    ShaderCache* cache;
+    ShaderPreprocessor preprocessor;
+    std::vector<Entry> entries;
+    bool parallel;
+    uint64_t generation;
+};
@@ -0,0 +1,235 @@
+#include "shader_preprocessor.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+std::string directoryOf(const std::string& path) {
+    std::string::size_type slash = path.find_last_of('/');
+    return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+bool isBlank(char c) {
+    return c == ' ' || c == '\t';
+}
+
+// Parses `#include "name"` (or <name>) at the start of [p, end). Returns false for any other line.
+bool parseInclude(const char* p, const char* end, std::string& name) {
+    while (p < end && isBlank(*p)) {
+        ++p;
+    }
+    if (p == end || *p != '#') {
+        return false;
+    }
+    ++p;
+    while (p < end && isBlank(*p)) {
+        ++p;
+    }
+    static const char keyword[] = "include";
+    const size_t keywordLength = sizeof(keyword) - 1;
+    if (static_cast<size_t>(end - p) < keywordLength || !std::equal(keyword, keyword + keywordLength, p)) {
+        return false;
+    }
+    p += keywordLength;
+    while (p < end && isBlank(*p)) {
+        ++p;
+    }
+    if (p == end || (*p != '"' && *p != '<')) {
+        return false;
+    }
+    char close = *p == '"' ? '"' : '>';
+    const char* nameBegin = ++p;
+    while (p < end && *p != close) {
+        ++p;
+    }
+    if (p == end) {
+        return false;
+    }
+    name.assign(nameBegin, p);
+    return !name.empty();
+}
+
+} // namespace
+
+ShaderPreprocessor::ShaderPreprocessor()
+    : sourceNames(1, "<root>") {
+}
+
+std::string ShaderPreprocessor::normalizePath(const std::string& path) {
+    std::string unified = path;
+    std::replace(unified.begin(), unified.end(), '\\', '/');
+    bool absolute = !unified.empty() && unified[0] == '/';
+
+    std::vector<std::string> parts;
+    std::istringstream segments(unified);
+    std::string segment;
+    while (std::getline(segments, segment, '/')) {
+        if (segment.empty() || segment == ".") {
+            continue;
+        }
+        if (segment == ".." && !parts.empty() && parts.back() != "..") {
+            parts.pop_back();
+        } else {
+            parts.push_back(segment);
+        }
+    }
+    std::string result = absolute ? "/" : "";
+    for (size_t i = 0; i < parts.size(); ++i) {
+        result += (i ? "/" : "") + parts[i];
+    }
+    return result;
+}
+
+const ShaderPreprocessor::SourceFile* ShaderPreprocessor::load(const std::string& path) {
+    std::map<std::string, SourceFile>::iterator it = files.find(path);
+    if (it != files.end()) {
+        return &it->second;
+    }
+    SourceFile file;
+    if (!file.mapping.open(path)) {
+        return nullptr;
+    }
+
+    // Scan once for include directives; expansion later just copies the spans between them
+    const char* data = file.mapping.data();
+    size_t size = file.mapping.size();
+    std::string directory = directoryOf(path);
+    std::vector<std::string>& includeEdges = edges[path];
+    includeEdges.clear();
+    int line = 1;
+    for (size_t begin = 0; begin < size; ++line) {
+        const char* newline = static_cast<const char*>(std::memchr(data + begin, '\n', size - begin));
+        size_t end = newline ? static_cast<size_t>(newline - data) + 1 : size;
+        std::string name;
+        if (parseInclude(data + begin, data + end, name)) {
+            Include include;
+            include.begin = begin;
+            include.end = end;
+            include.line = line;
+            include.path = normalizePath(directory + name);
+            file.includes.push_back(include);
+            includeEdges.push_back(include.path);
+        }
+        begin = end;
+    }
+
+    SourceFile& cached = files[path];
+    cached = std::move(file);
+    return &cached;
+}
+
+int ShaderPreprocessor::sourceIndex(const std::string& path) {
+    for (size_t i = 1; i < sourceNames.size(); ++i) {
+        if (sourceNames[i] == path) {
+            return static_cast<int>(i);
+        }
+    }
+    sourceNames.push_back(path);
+    return static_cast<int>(sourceNames.size() - 1);
+}
+
+bool ShaderPreprocessor::expand(const std::string& path, int index, std::string& out,
+                                std::vector<std::string>& included, const std::string& includedFrom) {
+    included.push_back(path);
+
+    const SourceFile* file = load(path);
+    if (!file) {
+        std::cerr << "Failed to open shader file: " << path;
+        if (!includedFrom.empty()) {
+            std::cerr << " (included from " << includedFrom << ")";
+        }
+        std::cerr << std::endl;
+        return false;
+    }
+
+    const char* data = file->mapping.data();
+    size_t copied = 0;
+    for (size_t i = 0; i < file->includes.size(); ++i) {
+        const Include& include = file->includes[i];
+        out.append(data + copied, include.begin - copied);
+
+        // Already pasted into this program (this also ends include cycles)
+        if (std::find(included.begin(), included.end(), include.path) == included.end()) {
+            std::ostringstream location;
+            location << path << ":" << include.line;
+            int includeIndex = sourceIndex(include.path);
+            out += "#line 1 " + std::to_string(includeIndex) + "\n";
+            if (!expand(include.path, includeIndex, out, included, location.str())) {
+                return false;
+            }
+            if (!out.empty() && out[out.size() - 1] != '\n') {
+                out += '\n';
+            }
+        }
+        // Resume numbering on the line after the directive
+        out += "#line " + std::to_string(include.line + 1) + " " + std::to_string(index) + "\n";
+        copied = include.end;
+    }
+    out.append(data + copied, file->mapping.size() - copied);
+    return true;
+}
+
+std::string ShaderPreprocessor::process(const std::string& path, std::vector<std::string>* dependencies) {
+    std::string normalized = normalizePath(path);
+    std::string out;
+    std::vector<std::string> included;
+    bool ok = expand(normalized, 0, out, included, std::string());
+    if (dependencies) {
+        for (size_t i = 0; i < included.size(); ++i) {
+            if (std::find(dependencies->begin(), dependencies->end(), included[i]) == dependencies->end()) {
+                dependencies->push_back(included[i]);
+            }
+        }
+    }
+    return ok ? out : std::string();
+}
+
+void ShaderPreprocessor::invalidate(const std::vector<std::string>& paths) {
+    for (size_t i = 0; i < paths.size(); ++i) {
+        files.erase(normalizePath(paths[i]));
+    }
+}
+
+std::vector<std::string> ShaderPreprocessor::affectedFiles(const std::vector<std::string>& changed) const {
+    std::vector<std::string> affected;
+    for (size_t i = 0; i < changed.size(); ++i) {
+        std::string path = normalizePath(changed[i]);
+        if (std::find(affected.begin(), affected.end(), path) == affected.end()) {
+            affected.push_back(path);
+        }
+    }
+    // Walk the include edges backwards until nothing new is reached
+    bool grew = true;
+    while (grew) {
+        grew = false;
+        for (std::map<std::string, std::vector<std::string> >::const_iterator it = edges.begin(); it != edges.end(); ++it) {
+            if (std::find(affected.begin(), affected.end(), it->first) != affected.end()) {
+                continue;
+            }
+            for (size_t i = 0; i < it->second.size(); ++i) {
+                if (std::find(affected.begin(), affected.end(), it->second[i]) != affected.end()) {
+                    affected.push_back(it->first);
+                    grew = true;
+                    break;
+                }
+            }
+        }
+    }
+    return affected;
+}
+
+const std::string& ShaderPreprocessor::sourceName(int index) const {
+    static const std::string unknown = "<unknown>";
+    return index >= 0 && static_cast<size_t>(index) < sourceNames.size() ? sourceNames[index] : unknown;
+}
+
+std::string ShaderPreprocessor::sourceLegend() const {
+    std::ostringstream legend;
+    for (size_t i = 1; i < sourceNames.size(); ++i) {
+        legend << (i > 1 ? ", " : "") << i << " = " << sourceNames[i];
+    }
+    return legend.str();
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "mapped_file.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+// Expands #include "file" directives in GLSL and keeps the include graph.
+//
+// Every file is memory-mapped once and served from the cache until invalidate() drops it;
+// expansion copies straight from the mappings into the output. Includes are resolved
+// relative to the including file and pasted in once per program (as if every file had
+// #pragma once), so cycles are harmless. #line directives keep compiler errors pointing at
+// the right place: the root file is source string 0, includes get stable numbers >= 1 that
+// sourceName() maps back to paths.
+class ShaderPreprocessor {
+public:
+    ShaderPreprocessor();
+
+    // Expanded source of path, or an empty string if it or any include can't be read.
+    // Every file read is appended to dependencies (path itself first), without duplicates.
+    std::string process(const std::string& path, std::vector<std::string>* dependencies = nullptr);
+
+    // Unmaps the given files so the next process() reads them again. Call before the files
+    // are re-read after an edit, never while an old mapping may be truncated under a reader.
+    void invalidate(const std::vector<std::string>& paths);
+
+    // The changed files plus every file that includes one of them, directly or not.
+    std::vector<std::string> affectedFiles(const std::vector<std::string>& changed) const;
+
+    // Path of an include by its #line source-string number ("<root>" for 0).
+    const std::string& sourceName(int index) const;
+    // "1 = shaders/noise.glsl, 2 = ..." for annotating compiler logs.
+    std::string sourceLegend() const;
+    size_t cachedFileCount() const { return files.size(); }
+
+    // Joins and cleans up "." and ".." segments; backslashes become slashes.
+    static std::string normalizePath(const std::string& path);
+
+private:
+    struct Include {
+        size_t begin;    // byte range of the directive line in the mapping
+        size_t end;      // (including its newline)
+        int line;        // 1-based line number of the directive
+        std::string path;
+    };
+
+    struct SourceFile {
+        MappedFile mapping;
+        std::vector<Include> includes;
+    };
+
+    const SourceFile* load(const std::string& path);
+    bool expand(const std::string& path, int sourceIndex, std::string& out,
+                std::vector<std::string>& included, const std::string& includedFrom);
+    int sourceIndex(const std::string& path);
+
+    std::map<std::string, SourceFile> files;
+    // Include graph edges (file -> files it includes); outlives invalidate() until re-parsed
+    std::map<std::string, std::vector<std::string> > edges;
+    std::vector<std::string> sourceNames;
+};
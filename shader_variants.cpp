@@ -0,0 +1,105 @@
+#include "shader_variants.h"
+
+#include <iostream>
+
+ShaderVariantSet::ShaderVariantSet(ShaderManager& shaders, const std::string& vertexPath, const std::string& fragmentPath)
+    : shaders(shaders), vertexPath(vertexPath), fragmentPath(fragmentPath), keyBits(0), table(1, ShaderManager::InvalidProgram) {
+}
+
+int ShaderVariantSet::addAxis(const std::string& name, const std::vector<std::string>& values) {
+    int bits = 0;
+    while ((static_cast<size_t>(1) << bits) < values.size()) {
+        ++bits;
+    }
+    if (values.empty() || keyBits + bits > MaxKeyBits) {
+        std::cerr << "Shader variant axis " << name << " does not fit the key" << std::endl;
+        return -1;
+    }
+    Axis axis;
+    axis.name = name;
+    axis.values = values;
+    axis.shift = keyBits;
+    axis.mask = (static_cast<VariantKey>(1) << bits) - 1;
+    axes.push_back(axis);
+    keyBits += bits;
+    table.assign(static_cast<size_t>(1) << keyBits, ShaderManager::InvalidProgram);
+    return static_cast<int>(axes.size() - 1);
+}
+
+ShaderVariantSet::VariantKey ShaderVariantSet::next(VariantKey key, int axis) const {
+    int v = value(key, axis) + 1;
+    if (v >= static_cast<int>(axes[axis].values.size())) {
+        v = 0;
+    }
+    return with(key, axis, v);
+}
+
+bool ShaderVariantSet::valid(VariantKey key) const {
+    if (key >= table.size()) {
+        return false;
+    }
+    // An axis with a non-power-of-two value count leaves unused bit patterns
+    for (size_t i = 0; i < axes.size(); ++i) {
+        if (static_cast<size_t>(value(key, static_cast<int>(i))) >= axes[i].values.size()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string ShaderVariantSet::defines(VariantKey key) const {
+    std::string result;
+    for (size_t i = 0; i < axes.size(); ++i) {
+        const std::string& define = axes[i].values[value(key, static_cast<int>(i))];
+        if (!define.empty()) {
+            result += (result.empty() ? "" : " ") + define;
+        }
+    }
+    return result;
+}
+
+std::string ShaderVariantSet::describe(VariantKey key) const {
+    std::string result;
+    for (size_t i = 0; i < axes.size(); ++i) {
+        const std::string& define = axes[i].values[value(key, static_cast<int>(i))];
+        result += (i ? " " : "") + axes[i].name + "=" + (define.empty() ? "-" : define);
+    }
+    return result;
+}
+
+ShaderManager::ProgramHandle ShaderVariantSet::build(VariantKey key) {
+    ShaderManager::ProgramHandle handle = shaders.add(vertexPath, fragmentPath, defines(key));
+    table[key] = handle;
+    return handle;
+}
+
+void ShaderVariantSet::precompile() {
+    for (VariantKey key = 0; key < table.size(); ++key) {
+        if (valid(key) && table[key] == ShaderManager::InvalidProgram) {
+            build(key);
+        }
+    }
+    shaders.submit();
+}
+
+GLuint ShaderVariantSet::program(VariantKey key) {
+    if (!valid(key)) {
+        return 0;
+    }
+    ShaderManager::ProgramHandle handle = table[key];
+    if (handle == ShaderManager::InvalidProgram) {
+        handle = build(key);
+        shaders.submit();
+    }
+    return shaders.program(handle);
+}
+
+size_t ShaderVariantSet::builtCount() const {
+    size_t count = 0;
+    for (size_t i = 0; i < table.size(); ++i) {
+        if (table[i] != ShaderManager::InvalidProgram) {
+            ++count;
+        }
+    }
+    return count;
+}
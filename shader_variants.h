@@ -0,0 +1,71 @@
+#pragma once
+
+#include "shader_manager.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Permutations of one vertex/fragment pair over a set of #define axes.
+//
+// Each axis is a list of mutually exclusive defines (an empty string means "define nothing"),
+// packed into a few bits of a VariantKey. All axes together index a flat table of program
+// handles, so looking a variant up on the hot path is a shift, a mask and an array read.
+// Variants are built either all at once with precompile(), which lets the driver compile
+// them in parallel, or lazily the first time a key is requested.
+class ShaderVariantSet {
+public:
+    typedef uint32_t VariantKey;
+    static const int MaxKeyBits = 16;
+
+    ShaderVariantSet(ShaderManager& shaders, const std::string& vertexPath, const std::string& fragmentPath);
+
+    // Declares an axis and returns its index, or -1 after saying why on stderr when its values
+    // don't fit the key; check before passing it to with() or value(). Must be called before any
+    // variant is built.
+    int addAxis(const std::string& name, const std::vector<std::string>& values);
+
+    // Returns key with the given axis set to values[value].
+    VariantKey with(VariantKey key, int axis, int value) const {
+        const Axis& a = axes[axis];
+        return (key & ~(a.mask << a.shift)) | (static_cast<VariantKey>(value) << a.shift);
+    }
+    int value(VariantKey key, int axis) const {
+        return static_cast<int>((key >> axes[axis].shift) & axes[axis].mask);
+    }
+    // Cycles the axis to its next value, wrapping around.
+    VariantKey next(VariantKey key, int axis) const;
+
+    // Queues every valid permutation for compilation and submits them in one batch.
+    void precompile();
+
+    // GL program for the key, building it first if it isn't in the table yet.
+    GLuint program(VariantKey key);
+
+    int axisCount() const { return static_cast<int>(axes.size()); }
+    const std::string& axisName(int axis) const { return axes[axis].name; }
+    const std::string& valueName(VariantKey key, int axis) const { return axes[axis].values[value(key, axis)]; }
+    // Space-separated defines for a key, as handed to ShaderManager::add().
+    std::string defines(VariantKey key) const;
+    // e.g. "QUALITY=QUALITY_HIGH DITHER=-"
+    std::string describe(VariantKey key) const;
+    size_t builtCount() const;
+
+private:
+    struct Axis {
+        std::string name;
+        std::vector<std::string> values;
+        int shift;
+        VariantKey mask;
+    };
+
+    bool valid(VariantKey key) const;
+    ShaderManager::ProgramHandle build(VariantKey key);
+
+    ShaderManager& shaders;
+    std::string vertexPath;
+    std::string fragmentPath;
+    std::vector<Axis> axes;
+    int keyBits;
+    std::vector<ShaderManager::ProgramHandle> table;
+};
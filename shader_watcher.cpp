@@ -0,0 +1,147 @@
+#include "shader_watcher.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sys/stat.h>
+#include <sys/types.h>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// How long a file must be quiet before its change is reported
+const int SettleMs = 50;
+// Poll interval of the stop flag (inotify) or of file times (fallback)
+const int WakeMs = 100;
+
+#ifndef __linux__
+time_t modificationTime(const std::string& path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 ? info.st_mtime : 0;
+}
+#endif
+
+} // namespace
+
+ShaderWatcher::ShaderWatcher()
+    : stopRequested(false), inotifyFd(-1) {
+}
+
+ShaderWatcher::~ShaderWatcher() {
+    stop();
+}
+
+bool ShaderWatcher::start(const std::vector<std::string>& watchedFiles) {
+    stop();
+    files = watchedFiles;
+    directories.clear();
+    stopRequested = false;
+
+#ifdef __linux__
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0) {
+        std::cerr << "inotify unavailable, shader hot-reload disabled" << std::endl;
+        return false;
+    }
+    for (size_t i = 0; i < files.size(); ++i) {
+        std::string::size_type slash = files[i].find_last_of('/');
+        std::string prefix = slash == std::string::npos ? std::string() : files[i].substr(0, slash + 1);
+        bool known = false;
+        for (size_t j = 0; j < directories.size(); ++j) {
+            known = known || directories[j].second == prefix;
+        }
+        if (known) {
+            continue;
+        }
+        // Editors that write a temp file and rename it over the original show up as IN_MOVED_TO
+        std::string directory = prefix.empty() ? "." : prefix;
+        int watch = inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+        if (watch < 0) {
+            std::cerr << "Cannot watch " << directory << ", shader hot-reload disabled" << std::endl;
+            close(inotifyFd);
+            inotifyFd = -1;
+            directories.clear();
+            return false;
+        }
+        directories.push_back(std::make_pair(watch, prefix));
+    }
+#endif
+
+    worker = std::thread(&ShaderWatcher::run, this);
+    return true;
+}
+
+void ShaderWatcher::stop() {
+    if (worker.joinable()) {
+        stopRequested = true;
+        worker.join();
+    }
+#ifdef __linux__
+    if (inotifyFd >= 0) {
+        close(inotifyFd);
+        inotifyFd = -1;
+    }
+#endif
+}
+
+void ShaderWatcher::notify(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (std::find(changed.begin(), changed.end(), path) == changed.end()) {
+        changed.push_back(path);
+    }
+    lastEvent = Clock::now();
+}
+
+bool ShaderWatcher::takeChanges(std::vector<std::string>& paths) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (changed.empty() || Clock::now() - lastEvent < std::chrono::milliseconds(SettleMs)) {
+        return false;
+    }
+    paths.swap(changed);
+    changed.clear();
+    return true;
+}
+
+void ShaderWatcher::run() {
+#ifdef __linux__
+    alignas(struct inotify_event) char buffer[4096];
+    while (!stopRequested) {
+        struct pollfd descriptor = { inotifyFd, POLLIN, 0 };
+        if (::poll(&descriptor, 1, WakeMs) <= 0) {
+            continue;
+        }
+        ssize_t length;
+        while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+            for (char* p = buffer; p < buffer + length;) {
+                const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(p);
+                if (event->len > 0) {
+                    for (size_t i = 0; i < directories.size(); ++i) {
+                        if (directories[i].first == event->wd) {
+                            notify(directories[i].second + event->name);
+                        }
+                    }
+                }
+                p += sizeof(struct inotify_event) + event->len;
+            }
+        }
+    }
+#else
+    std::vector<time_t> times(files.size());
+    for (size_t i = 0; i < files.size(); ++i) {
+        times[i] = modificationTime(files[i]);
+    }
+    while (!stopRequested) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(WakeMs));
+        for (size_t i = 0; i < files.size(); ++i) {
+            time_t t = modificationTime(files[i]);
+            if (t != times[i]) {
+                times[i] = t;
+                notify(files[i]);
+            }
+        }
+    }
+#endif
+}
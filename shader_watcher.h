@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Watches shader files from a background thread and reports which ones changed.
+//
+// On Linux the thread blocks on inotify for every directory holding one of the files (shared
+// #include files may live next to the shaders or elsewhere); other platforms poll the
+// modification time of the given files a few times per second. The render thread picks the
+// changes up between frames with takeChanges() and does all GL work itself.
+class ShaderWatcher {
+public:
+    ShaderWatcher();
+    ~ShaderWatcher();
+
+    // files are paths as ShaderManager::sourcePaths() reports them; changes come back in the same form.
+    bool start(const std::vector<std::string>& files);
+    void stop();
+
+    // Returns the paths changed since the last call, once no new event has arrived for a
+    // short settle time (editors often save a file in several steps).
+    bool takeChanges(std::vector<std::string>& paths);
+
+    bool running() const { return worker.joinable(); }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    void run();
+    void notify(const std::string& path);
+
+    std::vector<std::string> files;
+    // inotify watch descriptor -> directory prefix of the names it reports
+    std::vector<std::pair<int, std::string> > directories;
+    std::thread worker;
+    std::atomic<bool> stopRequested;
+    int inotifyFd;
+
+    std::mutex mutex;
+    std::vector<std::string> changed;
+    Clock::time_point lastEvent;
+};
@@ -1,8 +1,31 @@
 #version 330 core
 
+// Variant axes (injected as #defines after the #version line):
+//   QUALITY_LOW / QUALITY_MEDIUM / QUALITY_HIGH  flat colour / cheap gradient / per-pixel noise
+//   DITHER                                        4x4 ordered dither to hide banding
+
 out vec4 FragColor;
 
+const vec3 baseColor = vec3(0.914, 0.816, 1.0);
+
+// Kept outside the #if: the #line directives around an include must not be skipped
+#include "noise.glsl"
+
 void main()
 {
-    FragColor = vec4(0.914, 0.816, 1.0, 1.0);
+    vec3 color = baseColor;
+#if defined(QUALITY_MEDIUM)
+    color *= 0.85 + 0.15 * clamp(gl_FragCoord.y * 0.0015, 0.0, 1.0);
+#elif defined(QUALITY_HIGH)
+    color *= 0.8 + 0.3 * fbm(gl_FragCoord.xy * 0.02);
+#endif
+#ifdef DITHER
+    const float bayer[16] = float[16]( 0.0,  8.0,  2.0, 10.0,
+                                      12.0,  4.0, 14.0,  6.0,
+                                       3.0, 11.0,  1.0,  9.0,
+                                      15.0,  7.0, 13.0,  5.0);
+    ivec2 cell = ivec2(gl_FragCoord.xy) & 3;
+    color += (bayer[cell.y * 4 + cell.x] / 16.0 - 0.5) / 255.0;
+#endif
+    FragColor = vec4(color, 1.0);
 }
@@ -0,0 +1,32 @@
+#version 330 core
+
+// Many copies of one mesh. With INSTANCED, placement and colour come from per-instance
+// attributes (divisor 1); without it they are uniforms set before every draw, which is the
+// naive one-draw-per-object path the instanced one is measured against.
+
+layout (location = 0) in vec3 aPos;
+#ifdef INSTANCED
+layout (location = 1) in vec4 aPlacement; // xy offset, scale, rotation phase
+layout (location = 2) in vec4 aColor;
+#else
+uniform vec4 uPlacement;
+uniform vec4 uColor;
+#endif
+
+uniform float uTime;
+
+out vec4 vColor;
+
+void main()
+{
+#ifdef INSTANCED
+    vec4 placement = aPlacement;
+    vColor = aColor;
+#else
+    vec4 placement = uPlacement;
+    vColor = uColor;
+#endif
+    float angle = uTime + placement.w;
+    mat2 rotation = mat2(cos(angle), sin(angle), -sin(angle), cos(angle));
+    gl_Position = vec4(rotation * aPos.xy * placement.z + placement.xy, aPos.z, 1.0);
+}
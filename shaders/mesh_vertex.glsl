@@ -0,0 +1,25 @@
+#version 330 core
+
+// A mesh loaded from a mesh file (see GpuMesh), turning about its vertical axis and scaled to
+// fit the viewport, coloured by its normal
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+
+uniform vec4 uPositionScale;  // dequantisation from the file
+uniform vec4 uPositionOffset;
+uniform vec4 uFit;            // xyz centre of the bounds, w 1 / their largest half-extent
+uniform float uTime;
+
+out vec4 vColor;
+
+void main()
+{
+    vec3 position = (aPos * uPositionScale.xyz + uPositionOffset.xyz - uFit.xyz) * uFit.w;
+    float c = cos(uTime);
+    float s = sin(uTime);
+    mat3 turn = mat3(c, 0.0, -s, 0.0, 1.0, 0.0, s, 0.0, c);
+    position = turn * position;
+    gl_Position = vec4(position.xy * 0.9, position.z * 0.5, 1.0);
+    vColor = vec4(normalize(turn * aNormal + vec3(1e-6)) * 0.5 + 0.5, 1.0);
+}
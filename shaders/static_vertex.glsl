@@ -0,0 +1,24 @@
+#version 330 core
+
+// Static geometry, already in clip space, with a colour per vertex (see MeshBatcher)
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec4 aColor;
+
+#ifdef QUANTIZED
+// 16-bit normalised positions arrive in [0, 1]; this maps them back (see VertexLayout)
+uniform vec4 uPositionScale;
+uniform vec4 uPositionOffset;
+#endif
+
+out vec4 vColor;
+
+void main()
+{
+#ifdef QUANTIZED
+    gl_Position = vec4(aPos * uPositionScale.xyz + uPositionOffset.xyz, 1.0);
+#else
+    gl_Position = vec4(aPos, 1.0);
+#endif
+    vColor = aColor;
+}
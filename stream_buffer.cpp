@@ -0,0 +1,177 @@
+#include "stream_buffer.h"
+
+#include <chrono>
+#include <iostream>
+
+namespace {
+
+// Keeps every region start aligned for any vertex or uniform data we'd put in it
+const size_t RegionAlignment = 256;
+
+} // namespace
+
+const int StreamBuffer::RegionCount;
+
+StreamBuffer::StreamBuffer()
+    : name(0), persistentMap(false), regionBytes(0), persistentBase(nullptr), mapped(nullptr),
+      mappedBegin(0), region(0), cursor(0) {
+    for (int i = 0; i < RegionCount; ++i) {
+        fences[i] = nullptr;
+    }
+    counters = Stats();
+}
+
+StreamBuffer::~StreamBuffer() {
+    destroy();
+}
+
+bool StreamBuffer::create(size_t size, bool allowPersistent) {
+    destroy();
+    regionBytes = (size + RegionAlignment - 1) / RegionAlignment * RegionAlignment;
+    GLsizeiptr totalBytes = static_cast<GLsizeiptr>(regionBytes * RegionCount);
+
+    // Map through the copy-write binding so the caller's GL_ARRAY_BUFFER binding is left alone
+    glGenBuffers(1, &name);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, name);
+    persistentMap = allowPersistent && GLAD_GL_ARB_buffer_storage && glBufferStorage;
+    if (persistentMap) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_COPY_WRITE_BUFFER, totalBytes, nullptr, flags);
+        persistentBase = static_cast<char*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, totalBytes, flags));
+        if (!persistentBase) {
+            std::cerr << "Persistent mapping failed, streaming through glMapBufferRange instead" << std::endl;
+            persistentMap = false;
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            glDeleteBuffers(1, &name);
+            glGenBuffers(1, &name);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, name);
+        }
+    }
+    if (!persistentMap) {
+        // Allocated once; later maps only ever invalidate ranges, never orphan the buffer
+        glBufferData(GL_COPY_WRITE_BUFFER, totalBytes, nullptr, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    region = RegionCount - 1; // beginFrame() advances to region 0
+    cursor = 0;
+    return true;
+}
+
+void StreamBuffer::destroy() {
+    if (!name) {
+        return;
+    }
+    for (int i = 0; i < RegionCount; ++i) {
+        if (fences[i]) {
+            glDeleteSync(fences[i]);
+            fences[i] = nullptr;
+        }
+    }
+    if (persistentBase || mapped) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, name);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    glDeleteBuffers(1, &name);
+    name = 0;
+    persistentBase = nullptr;
+    mapped = nullptr;
+    persistentMap = false;
+}
+
+void StreamBuffer::beginFrame() {
+    region = (region + 1) % RegionCount;
+    cursor = 0;
+    GLsync& fence = fences[region];
+    if (fence) {
+        // Poll first so the common case costs nothing; only a real stall is timed
+        GLenum status = glClientWaitSync(fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED) {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            counters.stallMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            ++counters.stalls;
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+    ++counters.frames;
+}
+
+void* StreamBuffer::allocate(size_t size, size_t alignment, size_t& offset) {
+    size_t base = region * regionBytes;
+    size_t aligned = alignment > 1 ? (base + cursor + alignment - 1) / alignment * alignment - base : cursor;
+    if (!name || aligned + size > regionBytes) {
+        ++counters.overflows;
+        return nullptr;
+    }
+
+    char* destination;
+    if (persistentMap) {
+        destination = persistentBase + base + aligned;
+    } else {
+        if (!mapped) {
+            // Map the rest of the region; the fence in beginFrame() already guarantees the GPU is done with it
+            mappedBegin = cursor;
+            const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT
+                                   | GL_MAP_FLUSH_EXPLICIT_BIT;
+            glBindBuffer(GL_COPY_WRITE_BUFFER, name);
+            mapped = static_cast<char*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(base + mappedBegin),
+                                                         static_cast<GLsizeiptr>(regionBytes - mappedBegin), flags));
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            if (!mapped) {
+                std::cerr << "Failed to map stream buffer region" << std::endl;
+                return nullptr;
+            }
+        }
+        destination = mapped + (aligned - mappedBegin);
+    }
+
+    cursor = aligned + size;
+    if (cursor > counters.peakBytes) {
+        counters.peakBytes = cursor;
+    }
+    offset = base + aligned;
+    return destination;
+}
+
+void StreamBuffer::commit() {
+    if (!mapped) {
+        return; // persistent and coherent: stores are visible once the draw is issued
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, name);
+    glFlushMappedBufferRange(GL_COPY_WRITE_BUFFER, 0, static_cast<GLsizeiptr>(cursor - mappedBegin));
+    if (glUnmapBuffer(GL_COPY_WRITE_BUFFER) != GL_TRUE) {
+        std::cerr << "Stream buffer contents lost while mapped" << std::endl;
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    mapped = nullptr;
+}
+
+void StreamBuffer::endFrame() {
+    if (!name) {
+        return;
+    }
+    commit();
+    fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void StreamBuffer::printReport(std::ostream& out) const {
+    out << "Stream buffer: " << (persistentMap ? "persistent" : "unsynchronized map") << ", "
+        << RegionCount << " x " << regionBytes / 1024 << " KB regions, peak " << counters.peakBytes / 1024 << " KB/frame, "
+        << counters.stalls << " stalls in " << counters.frames << " frames (" << counters.stallMs << " ms)";
+    if (counters.overflows) {
+        out << ", " << counters.overflows << " overflowed allocations";
+    }
+    out << "\n";
+}
+
+void StreamBuffer::printJson(std::ostream& out) const {
+    out << "{\"persistent\": " << (persistentMap ? "true" : "false")
+        << ", \"region_kb\": " << regionBytes / 1024
+        << ", \"peak_kb\": " << counters.peakBytes / 1024
+        << ", \"stalls\": " << counters.stalls
+        << ", \"stall_ms\": " << counters.stallMs
+        << ", \"overflows\": " << counters.overflows << "}";
+}
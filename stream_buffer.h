@@ -0,0 +1,69 @@
+#pragma once
+
+#include "glad/gl_core_33.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+// Ring of RegionCount equally sized regions in one GL buffer, for data rewritten every frame.
+//
+// Each frame writes into its own region with plain memcpy-style stores, and a fence taken at
+// endFrame() protects it until the GPU has consumed it, so neither side waits on the other
+// while there are RegionCount frames of slack. With ARB_buffer_storage the whole buffer is
+// mapped once, persistently and coherently. Otherwise each upload maps the region with
+// GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT (the fences already provide the
+// synchronisation) and commit() flushes and unmaps it before drawing.
+class StreamBuffer {
+public:
+    static const int RegionCount = 3;
+
+    struct Stats {
+        uint64_t frames;
+        uint64_t stalls;     // frames that found their region still in use by the GPU
+        double stallMs;      // time spent waiting for those
+        uint64_t overflows;  // allocations that didn't fit in a region
+        size_t peakBytes;    // most bytes allocated in one frame
+    };
+
+    StreamBuffer();
+    ~StreamBuffer();
+
+    // Needs a current context. allowPersistent = false forces the map/unmap path.
+    bool create(size_t regionSize, bool allowPersistent = true);
+    void destroy();
+
+    // Waits (rarely) for the next region to be released by the GPU and starts writing into it.
+    void beginFrame();
+    // Reserves size bytes in this frame's region. Returns where to write them and sets offset
+    // to their position in buffer(), or returns nullptr if the region is full.
+    void* allocate(size_t size, size_t alignment, size_t& offset);
+    // Makes everything allocated so far visible to GL. Call before drawing from it.
+    void commit();
+    // Fences this frame's region. Allocations after this go to the next frame.
+    void endFrame();
+
+    GLuint buffer() const { return name; }
+    bool persistent() const { return persistentMap; }
+    size_t regionSize() const { return regionBytes; }
+    const Stats& stats() const { return counters; }
+
+    void printReport(std::ostream& out) const;
+    // {"persistent": .., "region_kb": .., "stalls": .., "stall_ms": .., "overflows": .., "peak_kb": ..}
+    void printJson(std::ostream& out) const;
+
+private:
+    StreamBuffer(const StreamBuffer&);
+    StreamBuffer& operator=(const StreamBuffer&);
+
+    GLuint name;
+    bool persistentMap;
+    size_t regionBytes;
+    char* persistentBase;  // whole buffer while persistently mapped
+    char* mapped;          // transient mapping of [mappedBegin, region end) otherwise
+    size_t mappedBegin;
+    int region;
+    size_t cursor;         // next free byte in the current region
+    GLsync fences[RegionCount];
+    Stats counters;
+};
@@ -0,0 +1,188 @@
+// Offline converter to the binary mesh format (see mesh_file.h).
+//
+// Reads a Wavefront OBJ with ObjParser or a glTF 2.0 .gltf or .glb with GltfLoader, both on
+// --jobs=N threads (glTF instances of the default scene are baked into world space), or
+// generates a heightfield with --generate. Each OBJ group or glTF instance primitive becomes a
+// submesh. Every submesh's triangles are reordered for the vertex cache and for
+// overdraw, and the shared vertices by first use, unless --no-optimize is given. The vertices are
+// written as floats, or with --quantize in the compact layout (16-bit positions, 10:10:10:2
+// normals and tangents, half texture coordinates). Prints the timings, sizes, the import stages
+// and, when quantising, the round-trip error as JSON.
+//
+// Usage: mesh_convert [input.obj|.gltf|.glb | --generate=TRIANGLES] --output=FILE [--quantize]
+//                     [--no-optimize] [--jobs=N]
+
+#include "gltf_loader.h"
+#include "job_system.h"
+#include "mesh_data.h"
+#include "mesh_file.h"
+#include "mesh_optimizer.h"
+#include "obj_parser.h"
+#include "vertex_layout.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+bool hasExtension(const std::string& path, const char* extension) {
+    size_t length = std::strlen(extension);
+    if (path.size() < length) {
+        return false;
+    }
+    for (size_t i = 0; i < length; ++i) {
+        if (std::tolower(static_cast<unsigned char>(path[path.size() - length + i])) != extension[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string inputPath;
+    size_t generate = 0;
+    std::string outputPath;
+    bool quantize = false;
+    bool optimize = true;
+    int jobThreads = -1;
+    const char* usage = "Usage: mesh_convert [input.obj|.gltf|.glb | --generate=TRIANGLES] --output=FILE [--quantize] "
+                        "[--no-optimize] [--jobs=N]";
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (std::strncmp(arg, "--generate=", 11) == 0) {
+            generate = static_cast<size_t>(std::atoll(arg + 11));
+        } else if (std::strncmp(arg, "--output=", 9) == 0) {
+            outputPath = arg + 9;
+        } else if (std::strcmp(arg, "--quantize") == 0) {
+            quantize = true;
+        } else if (std::strcmp(arg, "--no-optimize") == 0) {
+            optimize = false;
+        } else if (std::strncmp(arg, "--jobs=", 7) == 0) {
+            jobThreads = std::atoi(arg + 7) - 1;
+        } else if (arg[0] != '-' && inputPath.empty()) {
+            inputPath = arg;
+        } else {
+            std::cerr << "Unknown option: " << arg << "\n" << usage << std::endl;
+            return 1;
+        }
+    }
+    if (inputPath.empty() == (generate == 0) || outputPath.empty()) {
+        std::cerr << "Expected an input file or --generate, and --output\n" << usage << std::endl;
+        return 1;
+    }
+
+    MeshData mesh;
+    bool gltf = hasExtension(inputPath, ".gltf") || hasExtension(inputPath, ".glb");
+    JobSystem jobs(generate ? 0 : jobThreads);
+    GltfLoader loader(&jobs);
+    ObjParser parser(&jobs);
+    Clock::time_point start = Clock::now();
+    if (generate) {
+        generateTerrain(generate, mesh);
+    } else if (gltf) {
+        GltfScene scene;
+        if (!loader.load(inputPath, scene)) {
+            return 1;
+        }
+        flattenGltfScene(scene, mesh);
+    } else if (!parser.load(inputPath, mesh)) {
+        return 1;
+    }
+    double loadMs = elapsedMs(start);
+    if (mesh.indices.empty()) {
+        std::cerr << inputPath << ": no triangles" << std::endl;
+        return 1;
+    }
+
+    start = Clock::now();
+    size_t vertexCount = mesh.vertexCount();
+    if (optimize) {
+        for (size_t g = 0; g < mesh.groups.size(); ++g) {
+            uint32_t* indices = mesh.indices.data() + mesh.groups[g].firstIndex;
+            size_t indexCount = mesh.groups[g].indexCount;
+            optimizeVertexCache(indices, indexCount, vertexCount);
+            optimizeOverdraw(indices, indexCount, mesh.vertices.data(), vertexCount, mesh.stride * sizeof(float));
+        }
+        vertexCount = optimizeVertexFetch(mesh.vertices.data(), vertexCount, mesh.stride * sizeof(float),
+                                          mesh.indices.data(), mesh.indices.size());
+        mesh.vertices.resize(vertexCount * mesh.stride);
+    }
+    double optimizeMs = elapsedMs(start);
+
+    std::vector<MeshFileSubmesh> submeshes;
+    for (size_t g = 0; g < mesh.groups.size(); ++g) {
+        MeshFileSubmesh submesh;
+        std::memset(&submesh, 0, sizeof(submesh));
+        submesh.firstIndex = static_cast<uint32_t>(mesh.groups[g].firstIndex);
+        submesh.indexCount = static_cast<uint32_t>(mesh.groups[g].indexCount);
+        for (size_t i = submesh.firstIndex; i < submesh.firstIndex + submesh.indexCount; ++i) {
+            const float* position = &mesh.vertices[mesh.indices[i] * mesh.stride];
+            for (int k = 0; k < 3; ++k) {
+                submesh.boundsMin[k] = i == submesh.firstIndex ? position[k] : std::min(submesh.boundsMin[k], position[k]);
+                submesh.boundsMax[k] = i == submesh.firstIndex ? position[k] : std::max(submesh.boundsMax[k], position[k]);
+            }
+        }
+        submeshes.push_back(submesh);
+    }
+
+    VertexEncoding positionEncoding = quantize ? VertexEncoding::Unorm16 : VertexEncoding::Float32;
+    VertexLayout layout;
+    layout.add(0, VertexSemantic::Position, 3, positionEncoding);
+    if (mesh.normals) {
+        layout.add(1, VertexSemantic::Normal, 3, quantize ? VertexEncoding::Packed1010102 : VertexEncoding::Float32);
+    }
+    if (mesh.tangents) {
+        layout.add(3, VertexSemantic::Tangent, 4, quantize ? VertexEncoding::Packed1010102 : VertexEncoding::Float32);
+    }
+    if (mesh.texcoords) {
+        layout.add(2, VertexSemantic::TexCoord, 2, quantize ? VertexEncoding::Half : VertexEncoding::Float32);
+    }
+    start = Clock::now();
+    std::vector<char> packed;
+    Dequantization dequantization;
+    std::vector<PackingError> errors;
+    if (!packVertices(layout, mesh.vertices.data(), vertexCount, packed, dequantization, nullptr, &errors)
+        || !writeMeshFile(outputPath, layout, dequantization, packed.data(), vertexCount, mesh.indices.data(),
+                          mesh.indices.size(), submeshes)) {
+        return 1;
+    }
+    double writeMs = elapsedMs(start);
+
+    MeshFile written;
+    if (!written.open(outputPath)) {
+        return 1;
+    }
+    std::cout << std::fixed << std::setprecision(4)
+              << "{\"input\": \"" << (generate ? "generated" : inputPath) << "\""
+              << ", \"output\": \"" << outputPath << "\""
+              << ", \"load_ms\": " << loadMs << ", \"optimize_ms\": " << optimizeMs << ", \"write_ms\": " << writeMs
+              << ", \"vertices\": " << vertexCount << ", \"triangles\": " << mesh.indices.size() / 3
+              << ", \"submeshes\": " << submeshes.size() << ", \"index_size\": " << written.indexSize()
+              << ", \"bytes\": " << written.fileSize();
+    if (gltf) {
+        std::cout << ", \"gltf\": ";
+        loader.printJson(std::cout);
+    } else if (!generate) {
+        std::cout << ", \"obj\": ";
+        parser.printJson(std::cout);
+    }
+    std::cout << ", \"vertex_layout\": ";
+    printPackingReport(std::cout, layout, errors);
+    std::cout << "}" << std::endl;
+    return 0;
+}
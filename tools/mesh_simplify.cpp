@@ -0,0 +1,194 @@
+// Offline level of detail generator.
+//
+// Reads a Wavefront OBJ with loadObj() or generates a heightfield with --generate, and
+// simplifies it once into a chain of levels at the given triangle ratios with MeshSimplifier.
+// Every level shares the input's vertex buffer. Each level's triangles are then
+// reordered for the vertex cache and for overdraw, and the shared vertices by first use over the
+// whole chain, unless --no-optimize is given. Prints the timings and, per level, the triangle
+// count, the geometric error and the ACMR/ATVR before and after reordering as JSON. The errors
+// are what LodManager::addMesh expects.
+//
+// With --output=PREFIX each level is also written to PREFIX_lodN.obj. With --quantize the
+// vertices are also packed into the compact layout (16-bit positions, 10:10:10:2 normals, half
+// texture coordinates) and the report gets its size and round-trip error.
+//
+// Usage: mesh_simplify [input.obj | --generate=TRIANGLES] [--ratios=0.5,0.25,..]
+//                      [--attribute-weight=W] [--no-optimize] [--output=PREFIX] [--quantize]
+
+#include "mesh_data.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+#include "vertex_layout.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string inputPath;
+    size_t generate = 0;
+    std::vector<float> ratios;
+    float attributeWeight = 0.5f;
+    bool optimize = true;
+    std::string outputPrefix;
+    bool quantize = false;
+    const char* usage = "Usage: mesh_simplify [input.obj | --generate=TRIANGLES] [--ratios=0.5,0.25,..] "
+                        "[--attribute-weight=W] [--no-optimize] [--output=PREFIX] [--quantize]";
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (std::strncmp(arg, "--generate=", 11) == 0) {
+            generate = static_cast<size_t>(std::atoll(arg + 11));
+        } else if (std::strncmp(arg, "--ratios=", 9) == 0) {
+            std::stringstream list(arg + 9);
+            std::string item;
+            while (std::getline(list, item, ',')) {
+                ratios.push_back(static_cast<float>(std::atof(item.c_str())));
+            }
+        } else if (std::strncmp(arg, "--attribute-weight=", 19) == 0) {
+            attributeWeight = static_cast<float>(std::atof(arg + 19));
+        } else if (std::strcmp(arg, "--no-optimize") == 0) {
+            optimize = false;
+        } else if (std::strncmp(arg, "--output=", 9) == 0) {
+            outputPrefix = arg + 9;
+        } else if (std::strcmp(arg, "--quantize") == 0) {
+            quantize = true;
+        } else if (arg[0] != '-' && inputPath.empty()) {
+            inputPath = arg;
+        } else {
+            std::cerr << "Unknown option: " << arg << "\n" << usage << std::endl;
+            return 1;
+        }
+    }
+    if (inputPath.empty() == (generate == 0)) {
+        std::cerr << "Expected either an input file or --generate\n" << usage << std::endl;
+        return 1;
+    }
+    if (ratios.empty()) {
+        const float defaults[] = { 0.5f, 0.25f, 0.125f, 0.0625f, 0.03125f };
+        ratios.assign(defaults, defaults + 5);
+    }
+    // The full mesh is level 0
+    if (ratios[0] != 1.0f) {
+        ratios.insert(ratios.begin(), 1.0f);
+    }
+
+    MeshData mesh;
+    Clock::time_point start = Clock::now();
+    if (generate) {
+        generateTerrain(generate, mesh);
+    } else if (!loadObj(inputPath, mesh)) {
+        return 1;
+    }
+    double loadMs = elapsedMs(start);
+
+    MeshSimplifier simplifier;
+    simplifier.setAttributeWeights(std::vector<float>(mesh.stride - 3, attributeWeight));
+    std::vector<MeshSimplifier::Level> levels;
+    if (!simplifier.simplify(mesh.vertices.data(), mesh.vertices.size() / mesh.stride, mesh.stride,
+                             mesh.indices.data(), mesh.indices.size(), ratios, levels)) {
+        return 1;
+    }
+
+    // Triangle order per level; the shared vertices by first use, finest level first
+    std::vector<VertexCacheStats> before;
+    std::vector<VertexCacheStats> after;
+    size_t vertexCount = mesh.vertices.size() / mesh.stride;
+    start = Clock::now();
+    for (size_t i = 0; i < levels.size(); ++i) {
+        std::vector<uint32_t>& indices = levels[i].indices;
+        before.push_back(analyzeVertexCache(indices.data(), indices.size(), vertexCount));
+        if (optimize) {
+            optimizeVertexCache(indices.data(), indices.size(), vertexCount);
+            optimizeOverdraw(indices.data(), indices.size(), mesh.vertices.data(), vertexCount, mesh.stride * sizeof(float));
+        }
+    }
+    if (optimize) {
+        std::vector<uint32_t> chain;
+        for (size_t i = 0; i < levels.size(); ++i) {
+            chain.insert(chain.end(), levels[i].indices.begin(), levels[i].indices.end());
+        }
+        std::vector<uint32_t> remap;
+        size_t used = vertexFetchRemap(chain.data(), chain.size(), vertexCount, remap);
+        std::vector<float> reordered(used * mesh.stride);
+        remapVertexBuffer(reordered.data(), mesh.vertices.data(), vertexCount, mesh.stride * sizeof(float), remap);
+        mesh.vertices.swap(reordered);
+        vertexCount = used;
+        for (size_t i = 0; i < levels.size(); ++i) {
+            remapIndexBuffer(levels[i].indices.data(), levels[i].indices.size(), remap);
+        }
+    }
+    for (size_t i = 0; i < levels.size(); ++i) {
+        after.push_back(analyzeVertexCache(levels[i].indices.data(), levels[i].indices.size(), vertexCount));
+    }
+    double optimizeMs = elapsedMs(start);
+
+    VertexLayout layout;
+    layout.add(0, VertexSemantic::Position, 3, VertexEncoding::Unorm16);
+    if (mesh.normals) {
+        layout.add(1, VertexSemantic::Normal, 3, VertexEncoding::Packed1010102);
+    }
+    if (mesh.texcoords) {
+        layout.add(2, VertexSemantic::TexCoord, 2, VertexEncoding::Half);
+    }
+    std::vector<char> packed;
+    Dequantization dequantization;
+    std::vector<PackingError> packingErrors;
+    double quantizeMs = 0.0;
+    if (quantize) {
+        start = Clock::now();
+        if (!packVertices(layout, mesh.vertices.data(), vertexCount, packed, dequantization, nullptr, &packingErrors)) {
+            return 1;
+        }
+        quantizeMs = elapsedMs(start);
+    }
+
+    std::cout << std::fixed << std::setprecision(4)
+              << "{\"input\": \"" << (generate ? "generated" : inputPath) << "\""
+              << ", \"load_ms\": " << loadMs;
+    if (mesh.corners) {
+        std::cout << ", \"corners\": " << mesh.corners;
+    }
+    std::cout << ", \"stats\": ";
+    simplifier.printJson(std::cout);
+    std::cout << ", \"optimize_ms\": " << optimizeMs
+              << ", \"vertex_cache\": " << DefaultVertexCacheSize << ", \"levels\": [";
+    for (size_t i = 0; i < levels.size(); ++i) {
+        std::cout << (i ? ", " : "") << "{\"ratio\": " << levels[i].ratio
+                  << ", \"triangles\": " << levels[i].indices.size() / 3
+                  << ", \"error\": " << std::setprecision(6) << levels[i].error << std::setprecision(4)
+                  << ", \"acmr_before\": " << before[i].acmr << ", \"acmr_after\": " << after[i].acmr
+                  << ", \"atvr_before\": " << before[i].atvr << ", \"atvr_after\": " << after[i].atvr << "}";
+    }
+    std::cout << "]";
+    if (quantize) {
+        std::cout << ", \"quantize_ms\": " << quantizeMs
+                  << ", \"vertex_bytes\": " << vertexCount * layout.unpacked().stride()
+                  << ", \"packed_bytes\": " << packed.size() << ", \"vertex_layout\": ";
+        printPackingReport(std::cout, layout, packingErrors);
+    }
+    std::cout << "}" << std::endl;
+
+    for (size_t i = 0; i < levels.size() && !outputPrefix.empty(); ++i) {
+        std::ostringstream path;
+        path << outputPrefix << "_lod" << i << ".obj";
+        if (!writeObj(path.str(), mesh, levels[i].indices)) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "glad/gl_core_33.h"
+#include "vertex_layout.h"
+
+#include <vector>
+
+// Interleaved vertex layout: which attributes a vertex has and where they sit in it.
+struct VertexAttribute {
+    GLuint location;
+    GLint components;
+    GLenum type;
+    GLboolean normalized;
+    GLuint offset;
+
+    bool operator==(const VertexAttribute& other) const {
+        return location == other.location && components == other.components && type == other.type
+            && normalized == other.normalized && offset == other.offset;
+    }
+};
+
+struct VertexFormat {
+    std::vector<VertexAttribute> attributes;
+    GLsizei stride;
+
+    VertexFormat() : stride(0) {}
+
+    // Appends an attribute right after the previous one and grows the stride to match.
+    VertexFormat& add(GLuint location, GLint components, GLenum type, GLboolean normalized, GLuint size) {
+        VertexAttribute attribute = { location, components, type, normalized, static_cast<GLuint>(stride) };
+        attributes.push_back(attribute);
+        stride += size;
+        return *this;
+    }
+
+    // The GL attributes for a declarative layout. Packed 10:10:10:2 always feeds all four
+    // components; a shader that declares vec3 ignores w.
+    static VertexFormat fromLayout(const VertexLayout& layout) {
+        VertexFormat format;
+        const std::vector<VertexElement>& elements = layout.elements();
+        for (size_t i = 0; i < elements.size(); ++i) {
+            const VertexElement& e = elements[i];
+            GLint components = e.components;
+            GLenum type = GL_FLOAT;
+            GLboolean normalized = GL_TRUE;
+            switch (e.encoding) {
+            case VertexEncoding::Float32: type = GL_FLOAT; normalized = GL_FALSE; break;
+            case VertexEncoding::Half: type = GL_HALF_FLOAT; normalized = GL_FALSE; break;
+            case VertexEncoding::Unorm16: type = GL_UNSIGNED_SHORT; break;
+            case VertexEncoding::Snorm16: type = GL_SHORT; break;
+            case VertexEncoding::Packed1010102: type = GL_INT_2_10_10_10_REV; components = 4; break;
+            case VertexEncoding::Unorm8: type = GL_UNSIGNED_BYTE; break;
+            }
+            VertexAttribute attribute = { e.location, components, type, normalized, static_cast<GLuint>(e.offset) };
+            format.attributes.push_back(attribute);
+        }
+        format.stride = static_cast<GLsizei>(layout.stride());
+        return format;
+    }
+
+    // Points the bound VAO's attributes at the buffer bound to GL_ARRAY_BUFFER.
+    void apply() const {
+        for (size_t i = 0; i < attributes.size(); ++i) {
+            const VertexAttribute& a = attributes[i];
+            glVertexAttribPointer(a.location, a.components, a.type, a.normalized, stride,
+                                  reinterpret_cast<const void*>(static_cast<size_t>(a.offset)));
+            glEnableVertexAttribArray(a.location);
+        }
+    }
+
+    bool operator==(const VertexFormat& other) const {
+        return stride == other.stride && attributes == other.attributes;
+    }
+};
@@ -0,0 +1,388 @@
+#include "vertex_layout.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+uint32_t encodeUnorm(float value, int bits) {
+    float maximum = static_cast<float>((1u << bits) - 1);
+    return static_cast<uint32_t>(std::floor(std::max(0.0f, std::min(value, 1.0f)) * maximum + 0.5f));
+}
+
+float decodeUnorm(uint32_t code, int bits) {
+    return code / static_cast<float>((1u << bits) - 1);
+}
+
+// Two's complement code in the low bits of the result
+int32_t encodeSnorm(float value, int bits) {
+    float maximum = static_cast<float>((1u << bits) - 1);
+    float code = std::floor((std::max(-1.0f, std::min(value, 1.0f)) * maximum - 1.0f) * 0.5f + 0.5f);
+    float lowest = -static_cast<float>(1u << (bits - 1));
+    return static_cast<int32_t>(std::max(lowest, std::min(code, -lowest - 1.0f)));
+}
+
+float decodeSnorm(int32_t code, int bits) {
+    return (2.0f * code + 1.0f) / static_cast<float>((1u << bits) - 1);
+}
+
+int32_t signExtend(uint32_t value, int bits) {
+    uint32_t sign = 1u << (bits - 1);
+    value &= (1u << bits) - 1;
+    return static_cast<int32_t>(value ^ sign) - static_cast<int32_t>(sign);
+}
+
+bool directional(VertexSemantic semantic) {
+    return semantic == VertexSemantic::Normal || semantic == VertexSemantic::Tangent;
+}
+
+bool quantisedPosition(const VertexElement& element) {
+    return element.semantic == VertexSemantic::Position
+        && (element.encoding == VertexEncoding::Unorm16 || element.encoding == VertexEncoding::Snorm16);
+}
+
+// Writes one element of one vertex; values are already in the encoding's range
+void encodeElement(const VertexElement& element, const float* values, char* out) {
+    switch (element.encoding) {
+    case VertexEncoding::Float32:
+        std::memcpy(out, values, element.components * sizeof(float));
+        break;
+    case VertexEncoding::Half:
+        for (int c = 0; c < element.components; ++c) {
+            uint16_t half = floatToHalf(values[c]);
+            std::memcpy(out + c * 2, &half, 2);
+        }
+        break;
+    case VertexEncoding::Unorm16:
+        for (int c = 0; c < element.components; ++c) {
+            uint16_t code = static_cast<uint16_t>(encodeUnorm(values[c], 16));
+            std::memcpy(out + c * 2, &code, 2);
+        }
+        break;
+    case VertexEncoding::Snorm16:
+        for (int c = 0; c < element.components; ++c) {
+            int16_t code = static_cast<int16_t>(encodeSnorm(values[c], 16));
+            std::memcpy(out + c * 2, &code, 2);
+        }
+        break;
+    case VertexEncoding::Packed1010102: {
+        uint32_t word = 0;
+        for (int c = 0; c < 3; ++c) {
+            word |= (static_cast<uint32_t>(encodeSnorm(values[c], 10)) & 0x3ffu) << (c * 10);
+        }
+        float w = element.components == 4 ? values[3] : 0.0f;
+        word |= (static_cast<uint32_t>(encodeSnorm(w, 2)) & 0x3u) << 30;
+        std::memcpy(out, &word, 4);
+        break;
+    }
+    case VertexEncoding::Unorm8:
+        for (int c = 0; c < element.components; ++c) {
+            out[c] = static_cast<char>(encodeUnorm(values[c], 8));
+        }
+        break;
+    }
+}
+
+void decodeElement(const VertexElement& element, const char* in, float* values) {
+    switch (element.encoding) {
+    case VertexEncoding::Float32:
+        std::memcpy(values, in, element.components * sizeof(float));
+        break;
+    case VertexEncoding::Half:
+        for (int c = 0; c < element.components; ++c) {
+            uint16_t half;
+            std::memcpy(&half, in + c * 2, 2);
+            values[c] = halfToFloat(half);
+        }
+        break;
+    case VertexEncoding::Unorm16:
+        for (int c = 0; c < element.components; ++c) {
+            uint16_t code;
+            std::memcpy(&code, in + c * 2, 2);
+            values[c] = decodeUnorm(code, 16);
+        }
+        break;
+    case VertexEncoding::Snorm16:
+        for (int c = 0; c < element.components; ++c) {
+            int16_t code;
+            std::memcpy(&code, in + c * 2, 2);
+            values[c] = decodeSnorm(code, 16);
+        }
+        break;
+    case VertexEncoding::Packed1010102: {
+        uint32_t word;
+        std::memcpy(&word, in, 4);
+        for (int c = 0; c < 3; ++c) {
+            values[c] = decodeSnorm(signExtend(word >> (c * 10), 10), 10);
+        }
+        if (element.components == 4) {
+            values[3] = decodeSnorm(signExtend(word >> 30, 2), 2);
+        }
+        break;
+    }
+    case VertexEncoding::Unorm8:
+        for (int c = 0; c < element.components; ++c) {
+            values[c] = decodeUnorm(static_cast<unsigned char>(in[c]), 8);
+        }
+        break;
+    }
+}
+
+} // namespace
+
+VertexLayout& VertexLayout::add(unsigned location, VertexSemantic semantic, int components, VertexEncoding encoding) {
+    VertexElement element = { location, semantic, components, encoding, bytes };
+    list.push_back(element);
+    bytes += encodedSize(encoding, components);
+    floats += static_cast<size_t>(components);
+    return *this;
+}
+
+VertexLayout VertexLayout::unpacked() const {
+    VertexLayout layout;
+    for (size_t i = 0; i < list.size(); ++i) {
+        layout.add(list[i].location, list[i].semantic, list[i].components, VertexEncoding::Float32);
+    }
+    return layout;
+}
+
+size_t VertexLayout::encodedSize(VertexEncoding encoding, int components) {
+    size_t size = 0;
+    switch (encoding) {
+    case VertexEncoding::Float32: size = 4 * components; break;
+    case VertexEncoding::Half:
+    case VertexEncoding::Unorm16:
+    case VertexEncoding::Snorm16: size = 2 * components; break;
+    case VertexEncoding::Packed1010102: size = 4; break;
+    case VertexEncoding::Unorm8: size = components; break;
+    }
+    return (size + 3) & ~static_cast<size_t>(3);
+}
+
+bool packVertices(const VertexLayout& layout, const float* source, size_t vertexCount,
+                  std::vector<char>& packed, Dequantization& dequantization,
+                  const Dequantization* range, std::vector<PackingError>* errors) {
+    const std::vector<VertexElement>& elements = layout.elements();
+    size_t floats = layout.floatCount();
+    std::vector<size_t> sourceOffsets;
+    size_t sourceOffset = 0;
+    for (size_t e = 0; e < elements.size(); ++e) {
+        const VertexElement& element = elements[e];
+        if (element.components < 1 || element.components > 4
+            || (element.encoding == VertexEncoding::Packed1010102 && element.components < 3)
+            || (quantisedPosition(element) && element.components > 3)) {
+            std::cerr << "Cannot encode " << element.components << " " << semanticName(element.semantic)
+                      << " components as " << encodingName(element.encoding) << std::endl;
+            return false;
+        }
+        sourceOffsets.push_back(sourceOffset);
+        sourceOffset += static_cast<size_t>(element.components);
+    }
+
+    // The position range: given, the mesh's bounds, or identity when positions stay floats
+    for (int k = 0; k < 3; ++k) {
+        dequantization.scale[k] = 1.0f;
+        dequantization.offset[k] = 0.0f;
+    }
+    for (size_t e = 0; e < elements.size(); ++e) {
+        const VertexElement& element = elements[e];
+        if (!quantisedPosition(element)) {
+            continue;
+        }
+        if (range) {
+            dequantization = *range;
+            break;
+        }
+        for (int k = 0; k < element.components; ++k) {
+            float lower = 0.0f;
+            float upper = 0.0f;
+            for (size_t v = 0; v < vertexCount; ++v) {
+                float value = source[v * floats + sourceOffsets[e] + k];
+                lower = v == 0 ? value : std::min(lower, value);
+                upper = v == 0 ? value : std::max(upper, value);
+            }
+            float extent = upper > lower ? upper - lower : 1.0f;
+            if (element.encoding == VertexEncoding::Unorm16) {
+                dequantization.scale[k] = extent;
+                dequantization.offset[k] = lower;
+            } else {
+                dequantization.scale[k] = extent * 0.5f;
+                dequantization.offset[k] = (lower + upper) * 0.5f;
+            }
+        }
+        break;
+    }
+
+    packed.assign(vertexCount * layout.stride(), 0);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        for (size_t e = 0; e < elements.size(); ++e) {
+            const VertexElement& element = elements[e];
+            float values[4];
+            std::copy(source + v * floats + sourceOffsets[e], source + v * floats + sourceOffsets[e] + element.components, values);
+            if (quantisedPosition(element)) {
+                for (int k = 0; k < element.components; ++k) {
+                    values[k] = (values[k] - dequantization.offset[k]) / dequantization.scale[k];
+                }
+            }
+            encodeElement(element, values, &packed[v * layout.stride() + element.offset]);
+        }
+    }
+
+    if (errors) {
+        std::vector<float> decoded;
+        unpackVertices(layout, packed.data(), vertexCount, dequantization, decoded);
+        errors->clear();
+        for (size_t e = 0; e < elements.size(); ++e) {
+            const VertexElement& element = elements[e];
+            PackingError error = { element.semantic, element.encoding, 0.0, 0.0 };
+            double sumSquares = 0.0;
+            for (size_t v = 0; v < vertexCount; ++v) {
+                const float* a = source + v * floats + sourceOffsets[e];
+                const float* b = &decoded[v * floats + sourceOffsets[e]];
+                double value = 0.0;
+                if (directional(element.semantic)) {
+                    double dot = 0.0;
+                    double la = 0.0;
+                    double lb = 0.0;
+                    for (int k = 0; k < 3; ++k) {
+                        dot += static_cast<double>(a[k]) * b[k];
+                        la += static_cast<double>(a[k]) * a[k];
+                        lb += static_cast<double>(b[k]) * b[k];
+                    }
+                    double cosine = la > 0.0 && lb > 0.0 ? dot / std::sqrt(la * lb) : 1.0;
+                    value = std::acos(std::max(-1.0, std::min(cosine, 1.0))) * 57.29577951308232;
+                } else {
+                    for (int k = 0; k < element.components; ++k) {
+                        value = std::max(value, std::fabs(static_cast<double>(a[k]) - b[k]));
+                    }
+                }
+                error.maxError = std::max(error.maxError, value);
+                sumSquares += value * value;
+            }
+            error.rmsError = vertexCount ? std::sqrt(sumSquares / vertexCount) : 0.0;
+            errors->push_back(error);
+        }
+    }
+    return true;
+}
+
+void unpackVertices(const VertexLayout& layout, const char* packed, size_t vertexCount,
+                    const Dequantization& dequantization, std::vector<float>& out) {
+    const std::vector<VertexElement>& elements = layout.elements();
+    size_t floats = layout.floatCount();
+    out.assign(vertexCount * floats, 0.0f);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        float* vertex = &out[v * floats];
+        for (size_t e = 0; e < elements.size(); ++e) {
+            const VertexElement& element = elements[e];
+            decodeElement(element, packed + v * layout.stride() + element.offset, vertex);
+            if (quantisedPosition(element)) {
+                for (int k = 0; k < element.components; ++k) {
+                    vertex[k] = vertex[k] * dequantization.scale[k] + dequantization.offset[k];
+                }
+            }
+            vertex += element.components;
+        }
+    }
+}
+
+uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, 4);
+    uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000u);
+    uint32_t magnitude = bits & 0x7fffffffu;
+    if (magnitude >= 0x7f800000u) {
+        // Infinity stays infinity, NaN stays a (quiet) NaN
+        return sign | 0x7c00u | (magnitude > 0x7f800000u ? 0x200u : 0u);
+    }
+    if (magnitude >= 0x477ff000u) {
+        // Rounds past 65504
+        return sign | 0x7c00u;
+    }
+    if (magnitude < 0x38800000u) {
+        // Below the smallest normal half: a subnormal, rounded to nearest even
+        if (magnitude < 0x33000000u) {
+            return sign;
+        }
+        uint32_t exponent = magnitude >> 23;
+        uint32_t mantissa = (magnitude & 0x7fffffu) | 0x800000u;
+        uint32_t shift = 126 - exponent;
+        uint32_t half = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1u))) {
+            ++half;
+        }
+        return static_cast<uint16_t>(sign | half);
+    }
+    // Rebias the exponent from 127 to 15 and round the mantissa to nearest even; a carry rolls
+    // into the exponent as it should
+    uint32_t half = (magnitude - 0x38000000u) >> 13;
+    uint32_t remainder = magnitude & 0x1fffu;
+    if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u))) {
+        ++half;
+    }
+    return static_cast<uint16_t>(sign | half);
+}
+
+float halfToFloat(uint16_t value) {
+    uint32_t sign = static_cast<uint32_t>(value & 0x8000u) << 16;
+    uint32_t exponent = (value >> 10) & 0x1fu;
+    uint32_t mantissa = value & 0x3ffu;
+    uint32_t bits;
+    if (exponent == 0) {
+        float magnitude = std::ldexp(static_cast<float>(mantissa), -24);
+        return sign ? -magnitude : magnitude;
+    } else if (exponent == 31) {
+        bits = sign | 0x7f800000u | (mantissa << 13);
+    } else {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    float result;
+    std::memcpy(&result, &bits, 4);
+    return result;
+}
+
+const char* semanticName(VertexSemantic semantic) {
+    switch (semantic) {
+    case VertexSemantic::Position: return "position";
+    case VertexSemantic::Normal: return "normal";
+    case VertexSemantic::Tangent: return "tangent";
+    case VertexSemantic::TexCoord: return "texcoord";
+    case VertexSemantic::Color: return "color";
+    }
+    return "unknown";
+}
+
+const char* encodingName(VertexEncoding encoding) {
+    switch (encoding) {
+    case VertexEncoding::Float32: return "float32";
+    case VertexEncoding::Half: return "half";
+    case VertexEncoding::Unorm16: return "unorm16";
+    case VertexEncoding::Snorm16: return "snorm16";
+    case VertexEncoding::Packed1010102: return "int_2_10_10_10_rev";
+    case VertexEncoding::Unorm8: return "unorm8";
+    }
+    return "unknown";
+}
+
+void printPackingReport(std::ostream& out, const VertexLayout& layout, const std::vector<PackingError>& errors) {
+    // Errors span orders of magnitude; print them with significant digits rather than fixed
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision(4);
+    out.unsetf(std::ios::floatfield);
+    out << "{\"stride\": " << layout.stride()
+        << ", \"float_stride\": " << layout.unpacked().stride()
+        << ", \"elements\": [";
+    for (size_t i = 0; i < errors.size(); ++i) {
+        out << (i ? ", " : "") << "{\"semantic\": \"" << semanticName(errors[i].semantic) << "\""
+            << ", \"encoding\": \"" << encodingName(errors[i].encoding) << "\""
+            << ", \"max_error\": " << errors[i].maxError
+            << ", \"rms_error\": " << errors[i].rmsError << "}";
+    }
+    out << "]}";
+    out.flags(flags);
+    out.precision(precision);
+}
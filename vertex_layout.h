@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// Vertex layouts described by what each attribute holds and how it is encoded, and the
+// converter that packs float vertices into them.
+//
+// A layout is a list of elements: a shader location, a semantic, a component count and an
+// encoding. Elements follow each other in order, each padded to 4 bytes. VertexFormat::fromLayout()
+// turns a layout into GL attribute formats. The compact encodings are the usual ones:
+//
+//   positions        Unorm16/Snorm16, mapped from the mesh's bounds; the shader maps them back
+//                    with the Dequantization packVertices() returns
+//   normals/tangents Packed1010102 (GL_INT_2_10_10_10_REV); a tangent's w holds its handedness
+//   texcoords        Half
+//   colours          Unorm8
+//
+// Signed normalised values decode as in GL 3.3, (2c + 1) / (2^bits - 1). That rule cannot
+// represent 0 exactly, and the encoder rounds for it.
+
+enum class VertexSemantic { Position, Normal, Tangent, TexCoord, Color };
+
+enum class VertexEncoding {
+    Float32,        // 4 bytes per component
+    Half,           // IEEE 754 half floats
+    Unorm16,        // [0, 1]
+    Snorm16,        // [-1, 1]
+    Packed1010102,  // signed normalised x, y, z in 10 bits and w in 2, one word
+    Unorm8          // [0, 1], a byte per component
+};
+
+struct VertexElement {
+    unsigned location;
+    VertexSemantic semantic;
+    int components;
+    VertexEncoding encoding;
+    size_t offset;  // bytes into the vertex
+};
+
+class VertexLayout {
+public:
+    VertexLayout() : bytes(0), floats(0) {}
+
+    // Appends an element after the previous one.
+    VertexLayout& add(unsigned location, VertexSemantic semantic, int components, VertexEncoding encoding);
+
+    const std::vector<VertexElement>& elements() const { return list; }
+    size_t stride() const { return bytes; }
+    // Floats per vertex of the unpacked form: every component of every element, in order
+    size_t floatCount() const { return floats; }
+    // The same elements, all Float32
+    VertexLayout unpacked() const;
+
+    // Bytes an element takes, padding included
+    static size_t encodedSize(VertexEncoding encoding, int components);
+
+private:
+    std::vector<VertexElement> list;
+    size_t bytes;
+    size_t floats;
+};
+
+// How packed positions map back: position = decoded * scale + offset, per axis. Identity
+// unless positions use Unorm16 or Snorm16.
+struct Dequantization {
+    float scale[3];
+    float offset[3];
+};
+
+// One element's error after a round trip through its encoding. In the element's own units;
+// for normals and tangents, the angle between the original and the decoded vector in degrees.
+struct PackingError {
+    VertexSemantic semantic;
+    VertexEncoding encoding;
+    double maxError;
+    double rmsError;
+};
+
+// source holds vertexCount vertices of layout.floatCount() floats, elements in layout order.
+// Positions in Unorm16/Snorm16 are quantised against range if given, so meshes drawn together
+// can share one dequantisation, and against the mesh's own bounds otherwise. errors, if given,
+// gets one entry per element. Returns false for an element its encoding cannot hold:
+// Packed1010102 needs 3 or 4 components and quantised positions at most 3.
+bool packVertices(const VertexLayout& layout, const float* source, size_t vertexCount,
+                  std::vector<char>& packed, Dequantization& dequantization,
+                  const Dequantization* range = nullptr, std::vector<PackingError>* errors = nullptr);
+
+// Decodes packed vertices to floats the way the vertex shader sees them after dequantisation.
+void unpackVertices(const VertexLayout& layout, const char* packed, size_t vertexCount,
+                    const Dequantization& dequantization, std::vector<float>& out);
+
+uint16_t floatToHalf(float value);
+float halfToFloat(uint16_t value);
+
+const char* semanticName(VertexSemantic semantic);
+const char* encodingName(VertexEncoding encoding);
+
+// {"stride": .., "float_stride": .., "elements": [{"semantic": .., "encoding": .., "max_error": .., "rms_error": ..}, ..]}
+void printPackingReport(std::ostream& out, const VertexLayout& layout, const std::vector<PackingError>& errors);